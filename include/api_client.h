@@ -0,0 +1,111 @@
+#ifndef API_CLIENT_H
+#define API_CLIENT_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include "config.h"
+#include "api_connection.h"
+
+// ==========================================
+// SHARED API CONNECTION
+// ==========================================
+//
+// One warm keep-alive connection to API_URL, shared by every request the
+// firmware makes. The TCP/TLS handshake is paid once; later requests go
+// straight out on the open socket. If the server has closed an idle
+// connection, a request that could not go out is retried once on a
+// fresh one; one that went out and got no answer is not. That policy is
+// ApiConnection (api_connection.h); this file puts HTTPClient and the
+// socket under it.
+//
+// Usage (the request holds the connection until it goes out of scope):
+//
+//   ApiRequest req(ENDPOINT_CHECK_IN);
+//   req.addHeader("Content-Type", "application/json");
+//   int code = req.POST(payload, len);
+//   deserializeJson(doc, req.body(), DeserializationOption::Filter(filter));
+
+#define API_MAX_EXTRA_HEADERS 4
+#define API_MAX_COLLECT_HEADERS 4
+
+#define API_WAIT_FOREVER UINT32_MAX
+#define API_ERROR_BUSY (-100)   // Connection held by another task; outside HTTPClient's codes
+
+// Response body read straight off the socket. Chunked transfer encoding is
+// decoded and reads stop at the end of the body, so JSON can be parsed in
+// place without first copying the body into a String. Whatever the parser
+// leaves unread is drained when the request ends, and the kept-alive
+// socket is then positioned at the next response.
+class ApiBodyStream : public Stream {
+public:
+  ApiBodyStream() : client(NULL), chunked(false), remaining(0), done(true), firstChunk(true) {}
+
+  void begin(Stream* client, int contentLength, bool chunked);
+  void drain();
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t) override { return 0; }
+
+private:
+  bool nextChunk();
+  bool readLine(char* line, size_t size);
+
+  Stream* client;
+  bool chunked;
+  int32_t remaining;  // Bytes left in the body or current chunk, -1 = until close
+  bool done;
+  bool firstChunk;
+};
+
+class ApiRequest {
+public:
+  // Waits up to waitMs for the connection, which the network task may be
+  // holding for a whole request. The loop task passes API_LOOP_WAIT: a
+  // request that does not get it in time fails with API_ERROR_BUSY.
+  explicit ApiRequest(const char* endpoint, uint32_t waitMs = API_WAIT_FOREVER);
+  ~ApiRequest();
+
+  // Headers are kept and re-applied if the request has to be resent
+  void addHeader(const char* name, const String& value);
+
+  // Response headers to keep for http().header(name); keys must outlive the request
+  void collectHeaders(const char* keys[], size_t count);
+
+  int GET();
+  int POST(const String& body);
+  int POST(const uint8_t* body, size_t len);
+
+  // Response body after GET/POST, for parsing in place
+  Stream& body();
+
+  // Collected response headers and size after GET/POST
+  HTTPClient& http();
+
+private:
+  int send(const char* method, const uint8_t* body, size_t len);
+  static int exchange(void* request);
+
+  const char* endpoint;
+  bool owner;               // Holds connectionMutex
+  const char* method;
+  const uint8_t* payload;
+  size_t payloadLen;
+  const char* headerKeys[API_MAX_COLLECT_HEADERS + 1];  // + Transfer-Encoding
+  size_t headerKeyCount;
+  bool bodyStarted;
+  ApiBodyStream bodyStream;
+  uint8_t headerCount;
+  const char* headerNames[API_MAX_EXTRA_HEADERS];
+  String headerValues[API_MAX_EXTRA_HEADERS];
+
+  ApiRequest(const ApiRequest&);
+  ApiRequest& operator=(const ApiRequest&);
+};
+
+void initApiClient();
+ApiStats getApiStats();
+void printApiStats();
+
+#endif // API_CLIENT_H
@@ -0,0 +1,82 @@
+#ifndef API_CONNECTION_H
+#define API_CONNECTION_H
+
+#include <stdint.h>
+#include "hal.h"
+
+// ==========================================
+// KEEP-ALIVE CONNECTION POLICY
+// ==========================================
+//
+// When the shared API connection (api_client.h) pays for a handshake: a
+// warm socket is reused; with none, one is opened; if a kept-alive
+// socket turns out to be dead when the request goes out (the server
+// closed it while idle), the request is resent once on a fresh one. A
+// request that fails on a connection just opened is not resent, nor one
+// that went out whole and then timed out or broke off in the response:
+// the server may have acted on it, and a check-in POST must not be
+// stored twice.
+//
+// The socket is behind ApiTransport (WiFiClientSecure + HTTPClient on the
+// board, a fake TLS server on the host) and the request itself is a
+// callback, so the policy and its stats run in the native tests.
+
+// Same values as HTTPClient's HTTPC_ERROR_*
+#define API_ERROR_CONNECTION_REFUSED (-1)
+#define API_ERROR_SEND_HEADER_FAILED (-2)
+#define API_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define API_ERROR_NOT_CONNECTED (-4)
+#define API_ERROR_CONNECTION_LOST (-5)      // Closed before the response headers
+#define API_ERROR_READ_TIMEOUT (-11)
+
+struct ApiStats {
+  uint32_t requests;          // Requests that got an HTTP response
+  uint32_t failures;          // Requests that ended in a transport error
+  uint32_t handshakes;        // New TCP/TLS connections opened
+  uint32_t staleRetries;      // Kept-alive socket was dead, request resent
+  uint32_t lastHandshakeMs;
+  uint32_t totalHandshakeMs;
+  uint32_t lastRequestMs;     // Send to response headers
+  uint32_t totalRequestMs;
+};
+
+class ApiTransport {
+public:
+  virtual ~ApiTransport() {}
+  // Open as far as the client can tell (a peer close may not show yet)
+  virtual bool connected() = 0;
+  // TCP connect plus TLS handshake. False on failure or when refused
+  // locally (not enough heap for TLS).
+  virtual bool connect() = 0;
+  virtual void close() = 0;
+};
+
+// Send the request on the open connection and read the response headers.
+// Returns the HTTP status, or a negative value on transport error.
+typedef int (*ApiExchangeFn)(void* request);
+
+typedef bool (*ApiLinkFn)();
+
+class ApiConnection {
+public:
+  ApiConnection(ApiTransport& transport, HalClock& clock, HalLog& log, ApiLinkFn linkUp);
+
+  // secure: handshakes are timed as TLS_CONNECT rather than HTTP_CONNECT
+  void begin(bool secure);
+
+  int send(ApiExchangeFn exchange, void* request);
+
+  const ApiStats& stats() const { return st; }
+
+private:
+  bool ensureConnected(bool& reused);
+
+  ApiTransport& transport;
+  HalClock& clock;
+  HalLog& log;
+  ApiLinkFn linkUp;
+  bool secure;
+  ApiStats st;
+};
+
+#endif // API_CONNECTION_H
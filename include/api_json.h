@@ -0,0 +1,128 @@
+#ifndef API_JSON_H
+#define API_JSON_H
+
+#include <stddef.h>
+#include <string.h>
+#include <ArduinoJson.h>
+#include "checkin_dispatcher.h"
+#include "event_poller.h"
+
+// ==========================================
+// API RESPONSE PARSING
+// ==========================================
+//
+// API responses are parsed straight off the body with a filter that keeps
+// only the fields read below. The document lives on the allocator the
+// caller passes, which on the device is the task's JsonArena (json_arena.h).
+// So a response is never copied into a String and its parse takes nothing
+// from the heap, however large the body the server sends.
+//
+// Body is anything ArduinoJson reads: the ApiBodyStream of a request on
+// the board, a string or a chunked fake body in the native tests.
+// The filters are built once at boot by begin(), on the heap.
+//
+// Request bodies are built the same way, in the arena, and written into a
+// caller buffer.
+
+// Name sent for a reader/door ("Main", "Side", ...)
+typedef const char* (*DoorNameFn)(uint8_t reader);
+
+class ApiJson {
+public:
+  void begin() {
+    eventFilter["event"]["id"] = true;
+    eventFilter["event"]["name"] = true;
+    eventFilter["event"]["handle"] = true;
+
+    checkinFilter["studentName"] = true;
+
+    JsonObject result = batchFilter["results"].add<JsonObject>();
+    result["seq"] = true;
+    result["status"] = true;
+    result["studentName"] = true;
+  }
+
+  // {"event": {"id": "...", "name": "...", "handle": 7}}; handle is optional
+  template <class Body>
+  DeserializationError readActiveEvent(Body& body, ArduinoJson::Allocator* arena, ActiveEvent& event) const {
+    JsonDocument doc(arena);
+    DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(eventFilter));
+    if (!error) {
+      copy(event.id, sizeof(event.id), doc["event"]["id"] | "");
+      copy(event.name, sizeof(event.name), doc["event"]["name"] | "");
+      event.handle = doc["event"]["handle"] | 0;
+    }
+    return error;
+  }
+
+  // {"studentName": "..."} answering one check-in
+  template <class Body>
+  DeserializationError readCheckin(Body& body, ArduinoJson::Allocator* arena, char* studentName, size_t nameSize) const {
+    JsonDocument doc(arena);
+    DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(checkinFilter));
+    copy(studentName, nameSize, error ? "" : doc["studentName"] | "");
+    return error;
+  }
+
+  // {"results": [{"seq": 12, "status": 200, "studentName": "..."}, ...]}
+  // matched back to recs by seq; results not in the body are left as they are
+  template <class Body>
+  DeserializationError readBatchResults(Body& body, ArduinoJson::Allocator* arena, const CheckinRecord* recs,
+                                        size_t count, CheckinItemResult* results) const {
+    JsonDocument doc(arena);
+    DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(batchFilter));
+    if (error) {
+      return error;
+    }
+    for (JsonObjectConst item : doc["results"].as<JsonArrayConst>()) {
+      uint32_t seq = item["seq"] | 0;
+      for (size_t i = 0; i < count; i++) {
+        if (recs[i].seq == seq) {
+          results[i].status = item["status"] | -1;
+          copy(results[i].studentName, sizeof(results[i].studentName), item["studentName"] | "");
+          break;
+        }
+      }
+    }
+    return error;
+  }
+
+  // {"deviceId": "...", "checkIns": [{"uid", "eventId", "seq", "door", "ts"}, ...]}
+  // written into out. Returns its length, or 0 if the records do not fit
+  // the arena or out; fewer of them at a time will.
+  size_t writeBatch(ArduinoJson::Allocator* arena, const char* deviceId, const CheckinRecord* recs, size_t count,
+                    DoorNameFn doorName, char* out, size_t outSize) const {
+    JsonDocument doc(arena);
+    doc["deviceId"] = deviceId;
+    JsonArray items = doc["checkIns"].to<JsonArray>();
+    for (size_t i = 0; i < count; i++) {
+      JsonObject item = items.add<JsonObject>();
+      item["uid"] = CardUid(recs[i].uid, recs[i].uidLen).text().c_str();
+      item["eventId"] = recs[i].eventId;
+      item["seq"] = recs[i].seq;
+      item["door"] = doorName(recs[i].reader);
+      if (recs[i].timestamp != 0) {
+        item["ts"] = recs[i].timestamp;
+      }
+    }
+    if (doc.overflowed() || measureJson(doc) >= outSize) {
+      return 0;
+    }
+    return serializeJson(doc, out, outSize);
+  }
+
+private:
+  static void copy(char* out, size_t outSize, const char* text) {
+    if (outSize == 0) {
+      return;
+    }
+    strncpy(out, text, outSize - 1);
+    out[outSize - 1] = '\0';
+  }
+
+  JsonDocument eventFilter;
+  JsonDocument checkinFilter;
+  JsonDocument batchFilter;
+};
+
+#endif // API_JSON_H
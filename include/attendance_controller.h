@@ -0,0 +1,126 @@
+#ifndef ATTENDANCE_CONTROLLER_H
+#define ATTENDANCE_CONTROLLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+#include "card_uid.h"
+#include "checkin_dispatcher.h"
+#include "roster.h"
+#include "ui_scheduler.h"
+#include "event_poller.h"
+
+// ==========================================
+// ATTENDANCE STATE MACHINE
+// ==========================================
+//
+// Event handling, roster-first tap decisions and result screens for
+// attendance mode. Everything that needs the network, flash or the
+// RTOS is reached through AttendanceBackend, and everything else through
+// the HAL, so this builds and runs in the native environment unchanged.
+
+enum AttendanceState {
+  ATT_NO_EVENT,           // No event in memory, waiting for double tap
+  ATT_FETCHING_EVENT,     // Fetching event from API
+  ATT_READY,              // Ready to scan cards
+  ATT_CHECKING_IN         // Processing check-in
+};
+
+#define ATT_EVENT_NAME_MAX EVENT_NAME_MAX
+
+class AttendanceBackend {
+public:
+  virtual ~AttendanceBackend() {}
+  // Ask the server for the running event; false if there is none
+  virtual bool fetchActiveEvent(char* id, size_t idSize, char* name, size_t nameSize) = 0;
+  // Next event the background poller saw the server switch to, if any
+  virtual bool takeEventChange(ActiveEvent& event) = 0;
+  // Have the poller fetch the active event soon and report it even if
+  // it has not changed
+  virtual void refreshEvent() = 0;
+  // Bring the roster of eventId up to date (best effort). Need not be
+  // done on return: until it is, taps go to the server.
+  virtual void syncRoster(const char* eventId) = 0;
+  // Event dropped - forget anything stored for it, the roster too
+  virtual void eventCleared() = 0;
+  // Roster lookups for a tap: true if the roster holds eventId and is
+  // not being synced, and then held until releaseRoster()
+  virtual bool acquireRoster(const char* eventId) = 0;
+  virtual void releaseRoster() = 0;
+  // False if taps cannot be journaled (flash unavailable)
+  virtual bool journalReady() = 0;
+  // A tap went into the dispatcher queue - wake whoever drains it
+  virtual void tapSubmitted() = 0;
+  // Unix time, 0 if the clock is not synced
+  virtual uint32_t timestamp() = 0;
+};
+
+class AttendanceController {
+public:
+  AttendanceController(CheckinDispatcher& dispatcher, Roster& roster, AttendanceBackend& backend,
+                       HalDisplay& display, HalClock& clock, UiScheduler& ui, HalLog& log);
+
+  // Entering attendance mode
+  void begin();
+
+  // Back on an event after a reboot: ready at once, roster from flash
+  // and then synced
+  void resume(const char* eventId, const char* eventName);
+
+  // A card tapped at reader (door), detected at tappedUs (HalClock::micros).
+  // Returns false if the tap was turned away (no event, busy): tapping
+  // the card again is the way to retry it.
+  bool onTap(const CardUid& uid, uint8_t reader, uint32_t tappedUs);
+
+  // Show one check-in result from the network side, if any
+  void pollResults();
+
+  // Switch over to an event the server made active, if the poller saw
+  // one, or drop the event if the server has none. Called between taps.
+  // Returns true if the event changed.
+  bool pollEventChange();
+
+  // The held result screen ran out - back to the ready screen
+  void onScreenTimeout();
+
+  void onFetchButton();
+  // Re-fetch the active event with one loaded: same event, the roster is
+  // synced; another one, it is switched to; none, the current one stays
+  void onRefreshButton();
+  void onClearButton();
+  void clearEvent();
+
+  // Hand a tap to the dispatcher. Returns false if it was not accepted.
+  bool submit(const CardUid& uid, uint8_t reader, uint32_t tappedUs, uint8_t tag = 0);
+
+  AttendanceState state() const { return currentState; }
+  const char* eventId() const { return activeEventId; }
+  const char* eventName() const { return activeEventName; }
+  uint32_t inFlight() const { return checkinsInFlight; }
+
+  // Bumped whenever the event (or its roster) changes - time to persist
+  uint32_t sessionChanges() const { return changes; }
+
+private:
+  void showReady();
+  void adoptEvent(const char* id, const char* name);
+  bool answerFromRoster(RosterEntry& entry, const CardUid& uid, uint8_t reader, uint32_t tappedUs);
+  void resultShown(uint32_t tappedUs);
+
+  CheckinDispatcher& dispatcher;
+  Roster& roster;
+  AttendanceBackend& backend;
+  HalDisplay& display;
+  HalClock& clock;
+  UiScheduler& ui;
+  HalLog& log;
+
+  AttendanceState currentState;
+  char activeEventId[CHECKIN_EVENT_ID_MAX + 1];
+  char activeEventName[ATT_EVENT_NAME_MAX + 1];
+  uint32_t checkinsInFlight;  // Submitted taps without a result yet
+  uint32_t scrollStep;        // Ready screen marquee position; 0 = start over
+  uint32_t changes;
+};
+
+#endif // ATTENDANCE_CONTROLLER_H
@@ -4,40 +4,44 @@
 #include <Arduino.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
-#include <Adafruit_SSD1306.h>
 #include "config.h"
+#include "hal.h"
+#include "attendance_controller.h"
+#include "session_state.h"
 
 // ==========================================
-// ATTENDANCE MODE STATE
+// FUNCTION DECLARATIONS
 // ==========================================
+//
+// Board side of attendance mode: journal, network task, API calls and the
+// roster store. The state machine itself is AttendanceController.
 
-enum AttendanceState {
-  ATT_NO_EVENT,           // No event in memory, waiting for double tap
-  ATT_FETCHING_EVENT,     // Fetching event from API
-  ATT_READY,              // Ready to scan cards
-  ATT_CHECKING_IN         // Processing check-in
-};
+// Journal, network task and the stored roster of the resumed event load
+// on a boot task, beside the display and reader bring-up. Journal cursor
+// and roster version come from the stored session, which must outlive
+// the boot task. waitCheckinQueue() joins it; false if the journal is
+// unavailable.
+void startCheckinQueue(const SessionState& session);
+bool waitCheckinQueue();
 
-// ==========================================
-// FUNCTION DECLARATIONS
-// ==========================================
+// Roster sync asked for before the link was up, or while memory was
+// low - wake the network task to run it
+void syncDeferredRoster();
+void printRosterStats();
+void printEventPollerStats();
+
+// Poll jitter; from startWiFi(), before the network task runs
+void seedEventPoller(uint32_t seed);
+const char* getDoorName(uint8_t reader);
+
+// For saving the session: version of the stored roster of the event
+// (0 until the network task has it) and journal cursor
+uint32_t rosterVersion();
+void journalCursor(uint32_t& next, uint32_t& tail);
 
-void initAttendanceMode();
-void runAttendanceMode(Adafruit_SSD1306& display, String cardUid);
-void handleFetchButton(Adafruit_SSD1306& display, bool isLongPress);
-void handleClearButton(Adafruit_SSD1306& display);
-bool fetchActiveEvent();
-bool checkInCard(String cardUid);
-void clearActiveEvent();
-String getActiveEventId();
-String getActiveEventName();
-
-// Display functions for attendance mode
-void displayNoEvent(Adafruit_SSD1306& display);
-void displayFetchingEvent(Adafruit_SSD1306& display);
-void displayAttendanceReady(Adafruit_SSD1306& display, String eventName);
-void displayCheckingIn(Adafruit_SSD1306& display, String uid);
-void displayWelcome(Adafruit_SSD1306& display, String studentName);
-void displayAttendanceError(Adafruit_SSD1306& display, String error);
+// The attendance state machine wired to the journal, roster and API.
+// Built on first call; later calls return the same controller.
+AttendanceController& attendanceController(HalDisplay& display, HalClock& clock,
+                                           UiScheduler& ui, HalLog& log);
 
 #endif // ATTENDANCE_MODE_H
@@ -0,0 +1,44 @@
+#ifndef BATCH_POLICY_H
+#define BATCH_POLICY_H
+
+#include <stdint.h>
+
+// ==========================================
+// BATCH FLUSH POLICY
+// ==========================================
+//
+// Decides when the network task should send the check-ins it has gathered.
+// A batch goes out as soon as any of these holds:
+//   - it is full (maxItems),
+//   - the oldest waiting tap has waited deadlineMs,
+//   - no new tap arrived for idleMs (the door went quiet).
+// With maxItems == 1 every record is sent on its own (per-tap mode).
+
+class BatchFlushPolicy {
+public:
+  BatchFlushPolicy(uint16_t maxItems, uint32_t deadlineMs, uint32_t idleMs);
+
+  // A fresh tap was journaled and is waiting for the next batch
+  void onEnqueue(uint32_t nowMs);
+
+  // Every waiting tap was sent (or handed back as queued)
+  void onFlush();
+
+  bool shouldFlush(uint32_t nowMs, uint32_t queued) const;
+
+  // How long the network task may sleep before shouldFlush() can change
+  uint32_t msUntilFlush(uint32_t nowMs, uint32_t maxWaitMs) const;
+
+  uint16_t batchSize() const { return maxItems; }
+  void setBatchSize(uint16_t items) { maxItems = items > 0 ? items : 1; }
+
+private:
+  uint16_t maxItems;
+  uint32_t deadlineMs;
+  uint32_t idleMs;
+  bool waiting;
+  uint32_t firstEnqueueAt;
+  uint32_t lastEnqueueAt;
+};
+
+#endif // BATCH_POLICY_H
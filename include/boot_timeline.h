@@ -0,0 +1,40 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stdint.h>
+#include "hal.h"
+
+// ==========================================
+// BOOT TIMELINE
+// ==========================================
+//
+// Where the time from reset to the first card read goes. setup() marks
+// the end of each step with HalClock::micros() (which counts from app
+// start; the ROM and second-stage bootloader are not included), and the
+// first loop pass that polls the readers marks the device card-ready.
+// The report shows each step against BOOT_BUDGET_MS.
+
+#define BOOT_STEPS_MAX 16
+
+class BootTimeline {
+public:
+  BootTimeline();
+
+  // The step that just finished (name must be a literal)
+  void mark(const char* step, uint32_t nowUs);
+
+  // First pass of the loop; later calls are ignored
+  void cardReady(uint32_t nowUs);
+  bool isCardReady() const { return readyUs != 0; }
+  uint32_t cardReadyUs() const { return readyUs; }
+
+  void print(HalLog& out, uint32_t budgetMs) const;
+
+private:
+  const char* names[BOOT_STEPS_MAX];
+  uint32_t endUs[BOOT_STEPS_MAX];
+  uint8_t count;
+  uint32_t readyUs;
+};
+
+#endif // BOOT_TIMELINE_H
@@ -0,0 +1,107 @@
+#ifndef BUTTON_GESTURES_H
+#define BUTTON_GESTURES_H
+
+#include <stdint.h>
+#include "hal.h"
+
+// ==========================================
+// BUTTON GESTURES
+// ==========================================
+//
+// Raw, timestamped edges in (from the GPIO ISRs on the board), gestures
+// out. Edges are debounced by time: a level counts once no further edge
+// has come for the debounce time, and it counts from the first edge of
+// the burst, so contact bounce does not shorten or lengthen a press.
+//
+// Everything is timed from the edge timestamps, not from when poll()
+// runs. A loop held up by a blocking request still sees the press that
+// happened meanwhile, with its real length.
+//
+//   Short   pressed and released, shorter than the long press time
+//   Long    held for the long press time; reported as soon as it is
+//           reached (or on release, if nothing polled in between)
+//   Double  two short presses within the double-tap gap. Only for
+//           buttons that have it enabled: their short press is reported
+//           once the gap has passed without a second one.
+//
+// No Arduino dependencies; edge traces replay on the host.
+
+#define BUTTON_COUNT 2
+#define GESTURE_QUEUE 8
+
+enum GestureType {
+  GESTURE_SHORT,
+  GESTURE_LONG,
+  GESTURE_DOUBLE
+};
+
+struct ButtonGesture {
+  HalButton button;
+  GestureType type;
+  uint32_t atMs;          // Edge that completed it (long: when the hold time was reached)
+};
+
+struct GestureStats {
+  uint32_t edges;         // Raw edges seen
+  uint32_t presses;       // Debounced presses
+  uint32_t glitches;      // Bursts that settled back to where they started
+};
+
+class ButtonGestures {
+public:
+  ButtonGestures(uint32_t debounceMs, uint32_t longMs, uint32_t doubleGapMs);
+
+  // Double-tap detection for one button (off by default)
+  void enableDoubleTap(HalButton button, bool on);
+
+  // Raw edges, oldest first
+  void onEdge(const ButtonEdge& edge);
+
+  // Settle edges and timers up to nowMs; true with the next gesture
+  bool poll(uint32_t nowMs, ButtonGesture& out);
+
+  // Time until poll() can have something new (debounce, long press or
+  // double-tap deadline), at most maxWaitMs
+  uint32_t msUntilNext(uint32_t nowMs, uint32_t maxWaitMs) const;
+
+  bool isDown(HalButton button) const { return buttons[button].stable; }
+  const GestureStats& stats() const { return st; }
+
+private:
+  enum Phase {
+    PHASE_IDLE,
+    PHASE_DOWN,           // Held
+    PHASE_GAP             // Released after a short press, a second may follow
+  };
+
+  struct Button {
+    bool raw;             // Level of the last edge
+    bool stable;          // Debounced level
+    bool settling;        // Edges since the last stable level
+    uint32_t burstStart;
+    uint32_t lastEdge;
+
+    Phase phase;
+    bool second;          // Current press is the second of a double tap
+    bool longSent;
+    bool doubleTap;
+    uint32_t phaseStart;  // Press start (DOWN) or release (GAP)
+  };
+
+  void settle(HalButton button, uint32_t upToMs);
+  void timers(HalButton button, uint32_t upToMs);
+  void pressed(HalButton button, uint32_t atMs);
+  void released(HalButton button, uint32_t atMs);
+  void emit(HalButton button, GestureType type, uint32_t atMs);
+
+  uint32_t debounceMs;
+  uint32_t longMs;
+  uint32_t doubleGapMs;
+  Button buttons[BUTTON_COUNT];
+  ButtonGesture queue[GESTURE_QUEUE];
+  uint8_t head;
+  uint8_t count;
+  GestureStats st;
+};
+
+#endif // BUTTON_GESTURES_H
@@ -0,0 +1,123 @@
+#ifndef CARD_UID_H
+#define CARD_UID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ==========================================
+// CARD UID
+// ==========================================
+//
+// Raw UID of a tapped card. It is a small fixed-size value, so it goes from
+// the reader to the journal by copy and never touches the heap. Text such
+// as "AA:BB:CC:DD" is only produced when something needs it (a log line,
+// the screen, a JSON body), and it is written into a buffer the caller owns.
+//
+// Everything here is constexpr and has no Arduino dependencies, so it also
+// builds on a Linux host.
+
+#define CARD_UID_MAX        10                  // ISO 14443A UIDs are 4, 7 or 10 bytes
+#define CARD_UID_TEXT_SIZE  (CARD_UID_MAX * 3)  // "AA:BB:..." for 10 bytes + NUL
+
+// Formatted UID on the stack: Serial.println(uid.text().c_str())
+struct CardUidText {
+  char str[CARD_UID_TEXT_SIZE];
+  const char* c_str() const { return str; }
+};
+
+class CardUid {
+public:
+  constexpr CardUid() : len(0), bytes{} {}
+
+  // Bytes beyond CARD_UID_MAX are dropped
+  constexpr CardUid(const uint8_t* data, size_t count) : len(0), bytes{} {
+    while (len < count && len < CARD_UID_MAX) {
+      bytes[len] = data[len];
+      len++;
+    }
+  }
+
+  // "AA:BB:CC:DD" (':' '-' or ' ' between bytes, either case) -> bytes.
+  // Parsing stops at the first character that is neither hex nor a separator.
+  static constexpr CardUid parse(const char* text) {
+    CardUid uid;
+    int high = -1;
+    for (const char* p = text; p && *p && uid.len < CARD_UID_MAX; p++) {
+      int nibble = hexValue(*p);
+      if (nibble < 0) {
+        if (*p != ':' && *p != '-' && *p != ' ') {
+          break;
+        }
+        continue;
+      }
+      if (high < 0) {
+        high = nibble;
+      } else {
+        uid.bytes[uid.len++] = (uint8_t)((high << 4) | nibble);
+        high = -1;
+      }
+    }
+    return uid;
+  }
+
+  constexpr uint8_t size() const { return len; }
+  constexpr bool empty() const { return len == 0; }
+  constexpr const uint8_t* data() const { return bytes; }
+
+  // Length of the "AA:BB:CC:DD" form, without the NUL
+  constexpr size_t textLength() const { return len ? len * 3 - 1 : 0; }
+
+  // Write "AA:BB:CC:DD" into out, truncated to outSize - 1 characters and
+  // always NUL-terminated. Returns the number of characters written.
+  constexpr size_t format(char* out, size_t outSize) const {
+    if (outSize == 0) {
+      return 0;
+    }
+    size_t pos = 0;
+    for (uint8_t i = 0; i < len; i++) {
+      char chunk[3] = { ':', hexDigit(bytes[i] >> 4), hexDigit(bytes[i] & 0x0F) };
+      for (size_t c = i ? 0 : 1; c < 3 && pos + 1 < outSize; c++) {
+        out[pos++] = chunk[c];
+      }
+    }
+    out[pos] = '\0';
+    return pos;
+  }
+
+  constexpr CardUidText text() const {
+    CardUidText t{};
+    format(t.str, sizeof(t.str));
+    return t;
+  }
+
+  constexpr bool operator==(const CardUid& other) const {
+    if (len != other.len) {
+      return false;
+    }
+    for (uint8_t i = 0; i < len; i++) {
+      if (bytes[i] != other.bytes[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  constexpr bool operator!=(const CardUid& other) const { return !(*this == other); }
+
+private:
+  static constexpr char hexDigit(uint8_t nibble) {
+    return (char)(nibble < 10 ? '0' + nibble : 'A' + nibble - 10);
+  }
+
+  static constexpr int hexValue(char c) {
+    return c >= '0' && c <= '9' ? c - '0'
+         : c >= 'A' && c <= 'F' ? c - 'A' + 10
+         : c >= 'a' && c <= 'f' ? c - 'a' + 10
+         : -1;
+  }
+
+  uint8_t len;
+  uint8_t bytes[CARD_UID_MAX];
+};
+
+#endif // CARD_UID_H
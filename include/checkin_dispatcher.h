@@ -0,0 +1,150 @@
+#ifndef CHECKIN_DISPATCHER_H
+#define CHECKIN_DISPATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "checkin_log.h"
+#include "batch_policy.h"
+#include "spsc_queue.h"
+
+// ==========================================
+// CHECK-IN DISPATCHER
+// ==========================================
+//
+// Moves check-ins between the card task and the network task:
+//
+//   card task --submit()--> [tap queue] --runOnce()--> journal + HTTP
+//   UI        <-takeResult()-- [result queue] <--------'
+//
+// Only the network task calls runOnce(), and it is the only code that
+// touches the CheckinLog. Journaled records are sent in batches from the
+// oldest pending one (see BatchFlushPolicy); results are matched back to
+// the taps waiting on them by seq. The HTTP calls and link check are
+// injected so the same logic runs on a host against a fake transport.
+
+#define CHECKIN_NAME_MAX 32
+
+// Returned by a batch send when the request for this many records does not
+// fit in memory. The dispatcher halves the batch and sends again. Outside
+// HTTPClient's error codes (-1..-11), so a transport failure such as
+// HTTPC_ERROR_TOO_LESS_RAM is a failed send, not a smaller batch.
+#define CHECKIN_BATCH_TOO_LARGE (-101)
+
+enum CheckInResult {
+  CHECKIN_OK,             // Server accepted, student name available
+  CHECKIN_DUPLICATE,      // Server says already checked in (409)
+  CHECKIN_QUEUED,         // Saved to journal, server unreachable - will replay
+  CHECKIN_FAILED          // Rejected by server or journal full
+};
+
+struct TapRequest {
+  uint32_t timestamp;
+  uint8_t tag;                            // Opaque to the dispatcher, echoed in TapResult
+  uint32_t tappedUs;                      // When the card was detected, echoed in TapResult
+  CardUid uid;
+  uint8_t reader;                         // Reader/door the card was tapped at
+  char eventId[CHECKIN_EVENT_ID_MAX + 1];
+};
+
+struct TapResult {
+  CheckInResult result;
+  uint8_t tag;
+  uint32_t tappedUs;
+  uint32_t seq;
+  uint32_t pending;                       // Journal backlog after this tap
+  char studentName[CHECKIN_NAME_MAX + 1];
+};
+
+// Per-record outcome inside a batch response
+struct CheckinItemResult {
+  int status;                             // HTTP-style status, -1 if missing
+  char studentName[CHECKIN_NAME_MAX + 1];
+};
+
+// Deliver one record. Fills studentName on success.
+// Returns the HTTP status, or a negative value on transport error.
+typedef int (*CheckinSendFn)(const CheckinRecord& rec, char* studentName, size_t nameSize);
+
+// Deliver several records in one request, filling results[i] for recs[i].
+// Returns the HTTP status of the whole request, or CHECKIN_BATCH_TOO_LARGE.
+typedef int (*CheckinBatchSendFn)(const CheckinRecord* recs, size_t count, CheckinItemResult* results);
+
+typedef bool (*CheckinLinkFn)();
+
+class CheckinDispatcher {
+public:
+  // sendBatch may be NULL for per-tap mode (one request per record)
+  CheckinDispatcher(CheckinLog& journal, CheckinSendFn send,
+                    CheckinBatchSendFn sendBatch, CheckinLinkFn linkUp);
+
+  // Card task. Returns false if the tap queue is full.
+  bool submit(const TapRequest& tap);
+
+  // UI. Returns false if no result is waiting.
+  bool takeResult(TapResult& out);
+
+  // Network task: journal queued taps, then send a batch if the policy
+  // says so. Returns true if it sent something (call again right away).
+  bool runOnce(uint32_t nowMs);
+
+  // How long the network task may sleep before runOnce() has work
+  uint32_t idleWaitMs(uint32_t nowMs) const;
+
+  uint32_t tapsDropped() const { return droppedTaps; }
+  uint32_t resultsDropped() const { return droppedResults; }
+  uint32_t batchesSent() const { return sentBatches; }
+  uint32_t recordsSent() const { return sentRecords; }
+
+private:
+  void acceptTap(const TapRequest& tap, uint32_t nowMs);
+  bool flush(uint32_t nowMs);
+  bool backingOff(uint32_t nowMs) const;
+  void noteFailure(uint32_t nowMs);
+  void regrowBatch();
+  void postResult(CheckInResult result, uint32_t seq, uint8_t tag, uint32_t tappedUs,
+                  const char* studentName);
+  void routeResult(uint32_t seq, int status, const char* studentName);
+  void releaseWaiting(CheckInResult result);
+  bool waitingNext();
+
+  CheckinLog& journal;
+  CheckinSendFn send;
+  CheckinBatchSendFn sendBatch;
+  CheckinLinkFn linkUp;
+  BatchFlushPolicy policy;
+
+  SpscQueue<TapRequest, CHECKIN_TAP_QUEUE_SIZE> taps;
+  SpscQueue<TapResult, CHECKIN_TAP_QUEUE_SIZE> results;
+
+  // Fresh taps journaled but not yet answered
+  struct WaitingTap {
+    uint32_t seq;
+    uint8_t tag;
+    uint32_t tappedUs;
+  };
+  WaitingTap waiting[CHECKIN_TAP_QUEUE_SIZE];
+  uint32_t waitingCount;
+
+  // Scratch for the batch being sent (kept off the task stack)
+  CheckinRecord batch[CHECKIN_BATCH_MAX];
+  CheckinItemResult batchResults[CHECKIN_BATCH_MAX];
+
+  bool batchShrunk;          // Halved for memory; grows back (not for a missing endpoint)
+  uint16_t fitStreak;         // Good flushes since the batch last changed size
+  bool wasLinkUp;
+  uint32_t nextReplayAt;
+  uint32_t replayBackoff;
+  volatile uint32_t droppedTaps;
+  volatile uint32_t droppedResults;
+  uint32_t sentBatches;
+  uint32_t sentRecords;
+};
+
+// A definitive answer from the server (2xx/4xx) means the record is done;
+// transport errors and 5xx leave it in the journal for replay.
+inline bool isCheckinDelivered(int httpCode) {
+  return httpCode >= 200 && httpCode < 500;
+}
+
+#endif // CHECKIN_DISPATCHER_H
@@ -0,0 +1,90 @@
+#ifndef CHECKIN_LOG_H
+#define CHECKIN_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "card_uid.h"
+
+// ==========================================
+// CHECK-IN JOURNAL
+// ==========================================
+//
+// Durable ring log of check-ins waiting to reach the server. Every tap is
+// appended here before anything touches the network, so a Wi-Fi drop or a
+// reboot never loses it. Records live in fixed 64-byte slots (slot =
+// seq % capacity); each slot carries its own CRC, so a write torn by power
+// loss simply reads back as an empty slot on the next boot.
+//
+// This file has no Arduino dependencies: the flash backend lives behind
+// CheckinLogStorage, so the log itself also builds on a Linux host.
+
+#define CHECKIN_UID_MAX       CARD_UID_MAX
+#define CHECKIN_EVENT_ID_MAX  38   // Event IDs are UUIDs (36 chars)
+#define CHECKIN_SLOT_SIZE     64
+
+struct CheckinRecord {
+  uint32_t seq;                            // Monotonic; with device and event, the idempotency key
+  uint32_t timestamp;                      // Unix time, 0 if clock not synced
+  uint8_t uidLen;
+  uint8_t uid[CHECKIN_UID_MAX];
+  char eventId[CHECKIN_EVENT_ID_MAX + 1];  // NUL-terminated
+  uint8_t reader;                          // Reader/door index
+};
+
+// Byte-addressed backing store (a LittleFS file on the device, RAM on host)
+class CheckinLogStorage {
+public:
+  virtual ~CheckinLogStorage() {}
+  virtual size_t size() const = 0;
+  virtual bool read(size_t offset, uint8_t* data, size_t len) = 0;
+  virtual bool write(size_t offset, const uint8_t* data, size_t len) = 0;
+};
+
+class CheckinLog {
+public:
+  CheckinLog();
+
+  // Scan storage and rebuild head/tail. Returns false if storage is unusable.
+  // With a cursor saved on an earlier run (nextSequence() and
+  // oldestSequence() then), only the slots written since are read; a
+  // cursor that does not match the slots falls back to the full scan, and
+  // nextHint stays the floor of nextSequence() even then.
+  bool begin(CheckinLogStorage* storage, uint32_t nextHint = 0, uint32_t tailHint = 0);
+
+  // Slots read to find the head in the last begin()
+  uint32_t slotsScanned() const { return scanned; }
+
+  // Append a record, assigning rec.seq. Returns false if the log is full
+  // (oldest pending record would be overwritten) or the write failed.
+  bool append(CheckinRecord& rec);
+
+  // Oldest record not yet acknowledged by the server
+  bool peek(CheckinRecord& out);
+
+  // Read a specific record; false if it is delivered, torn or out of range.
+  // Walk from oldestSequence() to nextSequence() to collect a batch.
+  bool readPending(uint32_t seq, CheckinRecord& out);
+  uint32_t oldestSequence();
+
+  // Mark a record as delivered (server gave a definitive answer)
+  bool ack(uint32_t seq);
+
+  uint32_t pendingCount() const { return nextSeq - tailSeq; }
+  uint32_t capacity() const { return slotCount; }
+  uint32_t nextSequence() const { return nextSeq; }
+  // Lower bound of oldestSequence() without touching storage (for begin() hints)
+  uint32_t tailSequence() const { return tailSeq; }
+
+private:
+  bool readSlot(uint32_t slot, CheckinRecord& out, uint8_t& state);
+  bool resumeFrom(uint32_t nextHint, uint32_t tailHint);
+  void advanceTail();
+
+  CheckinLogStorage* storage;
+  uint32_t slotCount;
+  uint32_t nextSeq;   // Sequence number for the next append
+  uint32_t tailSeq;   // Oldest sequence that may still be pending
+  uint32_t scanned;
+};
+
+#endif // CHECKIN_LOG_H
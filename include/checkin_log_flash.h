@@ -0,0 +1,30 @@
+#ifndef CHECKIN_LOG_FLASH_H
+#define CHECKIN_LOG_FLASH_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "checkin_log.h"
+
+// ==========================================
+// LITTLEFS BACKEND FOR THE CHECK-IN JOURNAL
+// ==========================================
+//
+// The journal is one preallocated file on the LittleFS partition. Every
+// write is followed by flush(), which commits it to flash before the tap
+// is confirmed on screen.
+
+class LittleFsLogStorage : public CheckinLogStorage {
+public:
+  // Open (or create and 0xFF-fill) the journal file. LittleFS must be mounted.
+  bool begin(const char* path, size_t bytes);
+
+  size_t size() const override { return fileSize; }
+  bool read(size_t offset, uint8_t* data, size_t len) override;
+  bool write(size_t offset, const uint8_t* data, size_t len) override;
+
+private:
+  File file;
+  size_t fileSize = 0;
+};
+
+#endif // CHECKIN_LOG_FLASH_H
@@ -0,0 +1,71 @@
+#ifndef CHECKIN_WIRE_H
+#define CHECKIN_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "checkin_log.h"
+#include "checkin_dispatcher.h"
+
+// ==========================================
+// COMPACT CHECK-IN FRAMES
+// ==========================================
+//
+// Binary alternative to the JSON check-in bodies: raw UID bytes, the
+// event as a numeric handle instead of its UUID, and no field names. A
+// one-tap frame with a 4-byte UID is 32 bytes against ~190 of JSON.
+//
+// Only used when the server offers it: /api/events/active then includes
+// an event "handle". Frames go to ENDPOINT_CHECK_IN_BATCH with
+// Content-Type CHECKIN_WIRE_TYPE; a server that answers 415 gets JSON
+// until the event is fetched again, one that answers 404 or 405 (no batch
+// endpoint) until reboot. The answer may be a result frame or the usual
+// JSON.
+//
+// Request frame (little-endian):
+//   0       CHECKIN_WIRE_REQUEST
+//   1       CHECKIN_WIRE_VERSION
+//   2       record count (1..255)
+//   3       device id length
+//   4..7    event handle
+//   8..     device id (no NUL)
+//   then per record: seq u32, timestamp u32, door u8, uid length u8, uid
+//
+// Result frame:
+//   0       CHECKIN_WIRE_RESULT
+//   1       CHECKIN_WIRE_VERSION
+//   2       item count
+//   3       0
+//   then per item: seq u32, status u16, name length u8, name (no NUL)
+//
+// Decoders check every length against the buffer and reject the whole
+// frame on anything out of range. No Arduino dependencies.
+
+#define CHECKIN_WIRE_TYPE "application/vnd.aatcc.checkin"
+#define CHECKIN_WIRE_VERSION 1
+#define CHECKIN_WIRE_REQUEST 0xC1
+#define CHECKIN_WIRE_RESULT 0xC2
+#define CHECKIN_WIRE_DEVICE_MAX 32
+#define CHECKIN_WIRE_RECORD_MAX (10 + CHECKIN_UID_MAX)
+#define CHECKIN_WIRE_ITEM_MAX (7 + CHECKIN_NAME_MAX)
+
+// Returns the frame length, 0 if it does not fit in outSize (or count is
+// 0 or over 255). Record eventIds are not sent - the handle stands for them.
+size_t encodeCheckinFrame(const char* deviceId, uint32_t eventHandle, const CheckinRecord* recs,
+                          size_t count, uint8_t* out, size_t outSize);
+
+// Server side of the above (host tools). Decoded records have an empty
+// eventId. deviceId gets at most CHECKIN_WIRE_DEVICE_MAX + 1 bytes.
+bool decodeCheckinFrame(const uint8_t* frame, size_t len, char* deviceId, uint32_t& eventHandle,
+                        CheckinRecord* recs, size_t maxRecs, size_t& count);
+
+// Server side: one item per record, statuses and names from results
+size_t encodeResultFrame(const CheckinRecord* recs, const CheckinItemResult* results, size_t count,
+                         uint8_t* out, size_t outSize);
+
+// Fills results[i] for each item whose seq matches recs[i] (as the JSON
+// batch parser does); items for other seqs are skipped. False if the
+// frame is malformed, in which case results are left as they were.
+bool decodeResultFrame(const uint8_t* frame, size_t len, const CheckinRecord* recs, size_t count,
+                       CheckinItemResult* results);
+
+#endif // CHECKIN_WIRE_H
@@ -8,8 +8,25 @@
 // RFID-RC522 (SPI Interface)
 // Using VSPI (default SPI for ESP32)
 // These pins are known to work reliably on most ESP32 boards
-#define RC522_SS_PIN    5   // SDA/SS - Chip Select (GPIO5/D5)
-#define RC522_RST_PIN   27  // Reset pin (GPIO27/D27)
+#define RC522_RST_PIN   27  // Reset pin (GPIO27/D27), shared by all readers
+
+// Reader array - one RC522 per door, all on VSPI, each with its own SDA/SS.
+// List one chip-select pin and one door name per reader.
+#define RC522_READER_COUNT  2
+#define RC522_SS_PINS       { 5, 33 }            // Chip selects (GPIO5 = first door)
+#define RC522_DOOR_NAMES    { "Main", "Side" }   // Sent with each check-in
+
+// Card detection. 0 = poll every reader continuously (the IRQ pin is not
+// connected, as in the wiring docs). 1 = IRQ mode: each reader's IRQ pin,
+// wired to RC522_IRQ_PINS, wakes the main task when a card answers a
+// probe; between probes the antenna is off. A board without that wiring
+// never sees a card in IRQ mode.
+#define CARD_DETECT_IRQ     0
+#define RC522_IRQ_PINS      { 34, 35 }           // IRQ mode: one per reader; input-only pins are fine here
+
+// RC522 SPI clock for probes, select and halt (the chip takes up to 10 MHz;
+// 4000000 is the MFRC522 library default, for long or noisy wiring)
+#define RC522_SPI_CLOCK     10000000
 
 // SPI Pins (ESP32 Default VSPI - Hardware defined, cannot change)
 // MOSI: GPIO23 (hardware defined)
@@ -23,6 +40,10 @@
 #define OLED_WIDTH     128
 #define OLED_HEIGHT    64
 #define OLED_RESET     -1   // No reset pin
+#define OLED_I2C_CLOCK 800000  // Hz; SSD1306 modules take 400k-1M, drop to 400000 if the panel glitches
+#define OLED_TASK_CORE 0       // Display task (sends changed pages over I2C)
+#define OLED_TASK_STACK 3072
+#define OLED_TASK_PRIORITY 1
 
 // Button
 #define BUTTON_PIN     25   // Mode switch / Fetch event button
@@ -47,17 +68,113 @@
 #define ENDPOINT_CARDS_DETECTED "/api/cards/detected"
 #define ENDPOINT_CARDS_STATUS "/api/cards/status/"
 #define ENDPOINT_CHECK_IN "/api/check-in"
+#define ENDPOINT_CHECK_IN_BATCH "/api/check-in/batch"
 #define ENDPOINT_EVENTS_ACTIVE "/api/events/active"
+#define ENDPOINT_EVENT_ROSTER "/api/events/roster"   // ?eventId=<id>[&since=<version>]
 
 // Timing Constants
-#define CARD_COOLDOWN 2000           // 2 seconds between same card reads (ms)
+#define CARD_COOLDOWN 2000           // Same card again within 2 s, at any door, is ignored (ms)
 #define BUTTON_DEBOUNCE 50           // Button debounce time (ms)
 #define API_TIMEOUT 10000            // 10 seconds HTTP timeout
+#define API_LOOP_WAIT 200            // Longest the loop task waits for the shared connection (ms)
 #define CARD_SENT_WAIT_TIME 5000     // Wait 5 seconds after sending card before accepting next
 #define BUTTON_LONG_PRESS 5000       // 5 seconds hold to switch modes
+#define BUTTON_DOUBLE_TAP 300        // Second press within this of the first release is a double tap (ms)
+#define BUTTON_EDGE_QUEUE 32         // Raw edges buffered per button between loop passes (power of two)
 #define CHECKIN_SUCCESS_DISPLAY 1000 // Display welcome message for 1 second
+#define CHECKIN_ERROR_DISPLAY 2000   // Attendance error screens (ms)
+#define CARD_ERROR_DISPLAY 3000      // Registration error screens (ms)
+#define UI_RESULT_MIN_DISPLAY 400    // A queued check-in result replaces the previous one after this long (ms)
+#define TEXT_SCROLL_INTERVAL 300     // Long event names scroll one character this often (ms)
+#define CARD_SENSE_INTERVAL 100      // IRQ mode: ms between card probes (antenna off in between)
+#define CARD_SENSE_WINDOW 5          // IRQ mode: ms the antenna stays on waiting for an answer
+#define CARD_IRQ_IDLE_WAIT 50        // IRQ mode: longest main-task sleep (check-in results)
 #define BUZZER_DURATION 200          // Buzzer beep duration (ms)
 
+// Offline Check-in Journal (LittleFS)
+#define CHECKIN_LOG_PATH "/checkin.log"
+#define CHECKIN_LOG_CAPACITY 512     // Journal slots (64 bytes each = 32 KB)
+#define CHECKIN_RETRY_MIN 1000       // First replay retry after a failure (ms)
+#define CHECKIN_RETRY_MAX 60000      // Replay backoff ceiling (ms)
+#define NTP_SERVER "pool.ntp.org"    // Clock source for check-in timestamps
+
+// Network Worker Task
+#define CHECKIN_TAP_QUEUE_SIZE 16    // Taps in flight between reader and network (power of 2)
+#define NET_TASK_CORE 0              // Arduino loop() runs on core 1
+#define NET_TASK_STACK 8192          // Bytes - HTTPClient + TLS need the headroom
+#define NET_TASK_PRIORITY 1
+#define NET_TASK_IDLE_WAIT 100       // Max sleep between replay checks (ms)
+
+// Batched Check-ins
+#define CHECKIN_BATCH_MAX 16         // Records per batch POST (1 = one request per tap)
+#define CHECKIN_BATCH_DEADLINE 250   // Max time a tap waits for its batch (ms)
+#define CHECKIN_BATCH_IDLE 40        // Flush early once no tap arrived for this long (ms)
+#define CHECKIN_BATCH_REGROW 32      // A batch halved for memory doubles again after this many good flushes
+#define CHECKIN_WIRE_BINARY 1        // Compact binary frames when the server offers them (0 = JSON only)
+
+// Active Event Poller (network task)
+#define EVENT_POLL_INTERVAL 30000    // Conditional GET of the active event this often, +-25% (ms)
+#define EVENT_POLL_RETRY 2000        // First retry after a failed poll, doubling up to the interval (ms)
+
+// Roster Cache
+#define ROSTER_MAX_ENTRIES 20000     // ~20 bytes each + names; the top end needs PSRAM
+#define ROSTER_SNAPSHOT_PATH "/roster.bin"  // Last synced roster, for delta sync after reboot
+
+// Session Persistence (NVS) + Boot
+#define SESSION_NVS_NAMESPACE "session"
+#define SESSION_NVS_KEY "state"
+#define SESSION_CURSOR_STRIDE 32     // Save the journal cursor after this many appends
+#define BOOT_BUDGET_MS 1000          // Reset to card-ready target for the boot report
+#define BOOT_TASK_CORE 0             // Journal + stored roster load, beside display/reader init
+#define BOOT_TASK_STACK 6144
+#define BOOT_TASK_PRIORITY 1
+
+// WiFi (joins in the background from reset; taps are journaled until then)
+#define WIFI_SETUP_AP "ESP32-AATCC"       // Setup portal network name
+#define WIFI_NVS_NAMESPACE "wifi"         // Last AP joined (BSSID + channel) for a scan-free join
+#define WIFI_FAST_CONNECT_TIMEOUT 3000    // Join of a known AP (cached, or just lost) before scanning (ms)
+#define WIFI_CONNECT_TIMEOUT 15000        // Nothing joined this long after reset: open the portal (ms)
+#define WIFI_PORTAL_TIMEOUT 180           // Setup portal closes after this long (s)
+
+// WiFi Supervisor (reconnect, backoff, roaming)
+#define WIFI_EXTRA_NETWORKS { { "", "" } }  // More { "ssid", "password" } to roam between; "" = none
+#define WIFI_NETWORKS_MAX 4               // Portal network + extras
+#define WIFI_SCAN_MAX 16                  // APs considered per scan
+#define WIFI_ATTEMPT_TIMEOUT 10000        // Scan or scan-picked join not done by then: failed (ms)
+#define WIFI_BACKOFF_MIN 500              // Retry delay after the first failure (ms, jittered)
+#define WIFI_BACKOFF_MAX 16000            // Retry delay ceiling (ms)
+#define WIFI_RSSI_CHECK 5000              // Signal check while online (ms)
+#define WIFI_ROAM_RSSI -75                // Weaker than this: scan for a better AP (dBm)
+#define WIFI_ROAM_HYSTERESIS 8            // Roam only to an AP at least this much stronger (dB)
+#define WIFI_ROAM_SCAN_INTERVAL 30000     // At most one roam scan this often (ms)
+#define WIFI_TASK_CORE 0
+#define WIFI_TASK_STACK 4096
+#define WIFI_TASK_PRIORITY 1
+// Fixed address instead of DHCP (saves a round trip on every join).
+// Comma-separated octets; leave WIFI_STATIC_IP undefined for DHCP.
+// #define WIFI_STATIC_IP 192, 168, 1, 50
+// #define WIFI_GATEWAY   192, 168, 1, 1
+// #define WIFI_SUBNET    255, 255, 255, 0
+// #define WIFI_DNS       192, 168, 1, 1
+
+// JSON Buffers (fixed, so requests never grow the heap)
+#define JSON_DOC_CAPACITY 2048        // Arena for one request/response document (bytes)
+#define JSON_BATCH_DOC_CAPACITY 4096  // Arena for batch check-in documents (bytes)
+#define JSON_PAYLOAD_MAX 256          // Serialized single check-in / card body
+#define JSON_BATCH_PAYLOAD_MAX (CHECKIN_BATCH_MAX * 160 + 64)  // ~140 bytes per item worst case
+
+// Metrics Endpoint
+#define METRICS_PORT 80              // GET /metrics (Prometheus text format)
+#define METRICS_CHUNK_SIZE 512       // Response buffered and sent in chunks of this size
+
+// Memory Watch (heap fragmentation vs. the next TLS handshake)
+#define MEM_SAMPLE_INTERVAL 1000     // Heap + stack sample from the loop (ms)
+#define MEM_TLS_BLOCK 16896          // Largest single block a handshake takes (16 KB record buffer + overhead)
+#define MEM_TLS_HEAP 40960           // Heap a new TLS session takes in all (bytes)
+#define MEM_LOW_MARGIN 12288         // Less to spare than this over either: degraded (bytes)
+#define MEM_RECOVER_MARGIN 4096      // Clear a threshold by this much to leave its level (bytes)
+#define MEM_STACK_WARN 512           // Stack high-water mark below this is flagged (bytes)
+
 // Serial Debug
 #define SERIAL_BAUD 115200
 
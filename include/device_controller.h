@@ -0,0 +1,97 @@
+#ifndef DEVICE_CONTROLLER_H
+#define DEVICE_CONTROLLER_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "card_uid.h"
+#include "reader_array.h"
+#include "uid_cache.h"
+#include "session_state.h"
+#include "attendance_controller.h"
+#include "ui_scheduler.h"
+#include "button_gestures.h"
+
+// ==========================================
+// DEVICE STATE MACHINE
+// ==========================================
+//
+// Top-level mode (registration / attendance), the two buttons, and where
+// a tap goes.
+//
+//   Fetch  short: fetch the active event (attendance)
+//          double: refresh the loaded event and its roster (attendance,
+//                  event loaded)
+//          long: switch mode
+//   Clear  short: clear the event (attendance)
+//
+// Double tap is only listened for while it means something, so a single
+// press is not held back by the double-tap gap otherwise. Hardware comes
+// in through the HAL, so this runs in the native environment unchanged.
+
+enum DeviceMode {
+  MODE_REGISTRATION,    // Phase 2: Card registration mode
+  MODE_ATTENDANCE       // Phase 3: Event attendance mode
+};
+
+// Report a card to the server for registration; returns the HTTP status
+typedef int (*CardRegisterFn)(const CardUid& uid);
+
+class DeviceController {
+public:
+  DeviceController(AttendanceController& attendance, CardRegisterFn registerCard,
+                   HalDisplay& display, HalClock& clock, HalButtons& buttons,
+                   UiScheduler& ui, HalLog& log);
+
+  // Show the start screen (registration mode)
+  void begin();
+
+  // Start where a previous run left off: attendance mode goes straight
+  // to the stored event. Registration mode is the same as begin().
+  void resume(const SessionState& session);
+
+  // Bumped on every mode or event change - time to persist the session
+  uint32_t sessionChanges() const { return modeChanges + attendance.sessionChanges(); }
+
+  // Screen/buzzer deadlines, buttons, then any check-in result waiting
+  // to be shown. Never blocks.
+  void poll();
+
+  // How long the loop may sleep before poll() has work, at most maxWaitMs
+  uint32_t msUntilNext(uint32_t maxWaitMs);
+
+  // True if the card was let through less than CARD_COOLDOWN ago, at
+  // any door; such a tap is ignored. Call before anything else is done
+  // with a tap. A tap onTap() turned away (busy) does not count.
+  bool dropRepeat(const CardTap& tap);
+
+  // A new card at one of the readers
+  void onTap(const CardTap& tap);
+
+  void switchMode();
+  DeviceMode mode() const { return currentMode; }
+  const UidCache& recentCards() const { return recent; }
+
+private:
+  void pollButtons();
+  void onGesture(const ButtonGesture& gesture);
+  void onFetchGesture(GestureType type);
+  void onClearGesture();
+  void handleRegistration(const CardUid& uid);
+  void onScreenTimeout();
+
+  AttendanceController& attendance;
+  CardRegisterFn registerCard;
+  HalDisplay& display;
+  HalClock& clock;
+  HalButtons& buttons;
+  UiScheduler& ui;
+  HalLog& log;
+
+  DeviceMode currentMode;
+  bool cardSentWait;      // Registration: card just sent, next one not accepted yet
+  ButtonGestures gestures;
+  UidCache recent;        // Cards let through lately (per event / mode)
+  uint32_t modeChanges;
+};
+
+#endif // DEVICE_CONTROLLER_H
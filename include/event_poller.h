@@ -0,0 +1,108 @@
+#ifndef EVENT_POLLER_H
+#define EVENT_POLLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+#include "checkin_log.h"
+#include "spsc_queue.h"
+
+// ==========================================
+// ACTIVE EVENT POLLER
+// ==========================================
+//
+// Keeps an eye on the server's active event from the network task, so
+// a session change reaches the device without staff pressing anything:
+//
+//   network task --runOnce()--> GET /api/events/active (If-None-Match)
+//   loop task    <-takeChange()-- [change queue] <--'
+//
+// Polls are conditional: the ETag of the last answer goes out as
+// If-None-Match, and an unchanged event costs a 304 with no body. A new
+// event id (or a refresh() ask) is queued for the loop task, which
+// switches over between taps; nothing on the tap path waits on the
+// network. The server going to no active event is queued too, as an
+// event with an empty id, so the device stops taking check-ins for an
+// event that has ended.
+//
+// Polls are spread over EVENT_POLL_INTERVAL +-25% so a room of devices
+// does not hit the server in step; failures retry from EVENT_POLL_RETRY,
+// doubling up to the interval. The HTTP call and link check are injected
+// so the policy runs on a host against a mock endpoint.
+
+#define EVENT_NAME_MAX 64
+#define EVENT_ETAG_MAX 63
+
+struct ActiveEvent {
+  char id[CHECKIN_EVENT_ID_MAX + 1];
+  char name[EVENT_NAME_MAX + 1];
+  uint32_t handle;          // Wire handle (checkin_wire.h), 0 if none
+};
+
+enum EventFetchResult {
+  EVENT_FETCH_CHANGED,      // 200: event (and etag) filled in
+  EVENT_FETCH_UNCHANGED,    // 304: same as the etag sent
+  EVENT_FETCH_NONE,         // No active event on the server
+  EVENT_FETCH_FAILED        // Transport error or 5xx
+};
+
+// GET the active event. etag (may be empty) goes out as If-None-Match;
+// on 200 it is replaced by the response's ETag ("" if none).
+typedef EventFetchResult (*EventFetchFn)(char* etag, size_t etagSize, ActiveEvent& event);
+
+typedef bool (*EventLinkFn)();
+
+struct EventPollerStats {
+  uint32_t polls;           // Requests made
+  uint32_t notModified;     // Answered 304
+  uint32_t changes;         // Events queued for the loop task
+  uint32_t failures;
+};
+
+class EventPoller {
+public:
+  EventPoller(EventFetchFn fetch, EventLinkFn linkUp, uint32_t seed);
+
+  // Reseed the poll jitter, e.g. once the radio feeds the RNG
+  void seed(uint32_t value) { rng = value ? value : 1; }
+
+  // Network task: poll if due. Returns true if a request was made.
+  bool runOnce(uint32_t nowMs);
+
+  // How long the network task may sleep before runOnce() has work
+  uint32_t idleWaitMs(uint32_t nowMs) const;
+
+  // Any task: poll on the next runOnce() without If-None-Match, and
+  // queue the answer even if it is the event already known (entering
+  // attendance mode, staff asking)
+  void refresh() { refreshAsked.store(true, std::memory_order_release); }
+
+  // Loop task: the next event to switch to, if any; an empty id means
+  // the server has none
+  bool takeChange(ActiveEvent& out) { return changed.pop(out); }
+
+  const EventPollerStats& stats() const { return st; }
+
+private:
+  void schedule(uint32_t nowMs, bool failed);
+  uint32_t nextRandom();
+
+  EventFetchFn fetch;
+  EventLinkFn linkUp;
+  SpscQueue<ActiveEvent, 4> changed;
+  std::atomic<bool> refreshAsked;
+
+  char etag[EVENT_ETAG_MAX + 1];
+  char knownId[CHECKIN_EVENT_ID_MAX + 1];   // Last event the server named ("" = none yet)
+  bool knownNone;           // "No active event" queued since the last event
+  ActiveEvent scratch;
+  bool forceNext;           // A refresh whose poll failed: redo it on the retry
+  bool waitingLink;         // Due, but the link is down
+  uint32_t nextPollMs;
+  uint8_t failStreak;
+  uint32_t rng;
+  EventPollerStats st;
+};
+
+#endif // EVENT_POLLER_H
@@ -0,0 +1,50 @@
+#ifndef FRAME_DIFF_H
+#define FRAME_DIFF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ==========================================
+// SSD1306 FRAME DIFF
+// ==========================================
+//
+// The SSD1306 framebuffer is 8 pages of 128 columns, one byte per column
+// per page (8 vertical pixels). diffFrame() compares a new frame with a
+// shadow of what the panel shows and returns, per page, the column range
+// that changed; only those bytes need to go over I2C. The shadow is
+// updated as it goes, so it always matches the panel after the spans are
+// sent.
+//
+// Also a small model of what a transfer costs on the wire, used by the
+// renderer stats and the native benchmark. No Arduino dependencies.
+
+#define FRAME_COLUMNS 128
+#define FRAME_PAGES 8
+#define FRAME_BYTES (FRAME_COLUMNS * FRAME_PAGES)
+
+// Data bytes per I2C write after the 0x40 control byte (ESP32 Wire
+// buffer is 128 bytes)
+#define FRAME_I2C_CHUNK 127
+
+struct DirtySpan {
+  uint8_t page;
+  uint8_t first;  // First changed column
+  uint8_t last;   // Last changed column (inclusive)
+};
+
+// Fills spans (room for FRAME_PAGES) and returns how many pages changed
+uint8_t diffFrame(const uint8_t* frame, uint8_t* shadow, DirtySpan* spans);
+
+// Framebuffer bytes the spans cover
+size_t spanDataBytes(const DirtySpan* spans, uint8_t count);
+
+// Bytes on the wire including address, control and windowing commands
+size_t spanWireBytes(const DirtySpan* spans, uint8_t count);
+
+// The same for a full-frame display() (window = whole panel)
+size_t fullFrameWireBytes();
+
+// Transfer time at clockHz, 9 clocks per byte (8 data bits + ACK)
+uint32_t wireTimeUs(size_t wireBytes, uint32_t clockHz);
+
+#endif // FRAME_DIFF_H
@@ -0,0 +1,86 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ==========================================
+// HARDWARE ABSTRACTION
+// ==========================================
+//
+// The state machines (DeviceController, AttendanceController) and the
+// screens only talk to the outside world through these interfaces. On the
+// board they are backed by the real peripherals (hal_esp32.h). In the
+// native environment they are backed by simulated devices, so the whole
+// tap-to-welcome path runs on Linux with a virtual clock.
+//
+// The other seams already exist: card readers are CardReader
+// (reader_array.h), and HTTP transport for check-ins is the send
+// functions given to CheckinDispatcher.
+
+class HalClock {
+public:
+  virtual ~HalClock() {}
+  virtual uint32_t millis() = 0;
+  virtual uint32_t micros() = 0;     // For latency metrics
+  virtual void delay(uint32_t ms) = 0;
+};
+
+// Text subset of Adafruit_GFX used by the screens (128x64, size 1 = 6x8 px)
+class HalDisplay {
+public:
+  virtual ~HalDisplay() {}
+  virtual void clearDisplay() = 0;
+  virtual void setTextSize(uint8_t size) = 0;
+  virtual void setCursor(int16_t x, int16_t y) = 0;
+  virtual void write(const char* text, size_t len) = 0;
+  virtual void display() = 0;   // Push the frame to the panel
+  // SSD1306 page-layout framebuffer, or null if the display has none
+  virtual uint8_t* buffer() { return nullptr; }
+
+  void print(const char* text);
+  void println(const char* text = "");
+};
+
+// Timed patterns are played by UiScheduler; the buzzer only switches
+class HalBuzzer {
+public:
+  virtual ~HalBuzzer() {}
+  virtual void set(bool on) = 0;
+};
+
+enum HalButton {
+  BUTTON_FETCH,   // Fetch event / hold to switch mode
+  BUTTON_CLEAR    // Clear event
+};
+
+// One raw level change, timestamped when it happened (in the GPIO ISR
+// on the board). Contact bounce comes through as it is; ButtonGestures
+// debounces.
+struct ButtonEdge {
+  HalButton button;
+  bool down;
+  uint32_t ms;
+};
+
+class HalButtons {
+public:
+  virtual ~HalButtons() {}
+  // Next edge, oldest first; false when there is none
+  virtual bool nextEdge(ButtonEdge& edge) = 0;
+};
+
+// Serial console on the board, stdout on the host
+class HalLog {
+public:
+  virtual ~HalLog() {}
+  virtual void write(const char* text) = 0;
+
+  void println(const char* text) {
+    write(text);
+    write("\n");
+  }
+  void printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#endif // HAL_H
@@ -0,0 +1,88 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include "hal.h"
+#include "spsc_queue.h"
+#include "config.h"
+#include "oled_renderer.h"
+
+// ==========================================
+// HAL ON THE BOARD
+// ==========================================
+
+class EspClock : public HalClock {
+public:
+  uint32_t millis() override { return ::millis(); }
+  uint32_t micros() override { return ::micros(); }
+  void delay(uint32_t ms) override { ::delay(ms); }
+};
+
+// Draws into the Adafruit buffer; frames go out through OledRenderer
+class Ssd1306Display : public HalDisplay {
+public:
+  Ssd1306Display(Adafruit_SSD1306& oled, OledRenderer& renderer) : oled(oled), renderer(renderer) {}
+  void clearDisplay() override { oled.clearDisplay(); }
+  void setTextSize(uint8_t size) override { oled.setTextSize(size); }
+  void setCursor(int16_t x, int16_t y) override { oled.setCursor(x, y); }
+  void write(const char* text, size_t len) override { oled.write((const uint8_t*)text, len); }
+  void display() override { renderer.submit(); }
+  uint8_t* buffer() override { return oled.getBuffer(); }
+
+private:
+  Adafruit_SSD1306& oled;
+  OledRenderer& renderer;
+};
+
+class GpioBuzzer : public HalBuzzer {
+public:
+  explicit GpioBuzzer(uint8_t pin) : pin(pin) {}
+  void set(bool on) override { digitalWrite(pin, on ? HIGH : LOW); }
+
+private:
+  uint8_t pin;
+};
+
+// Active-low buttons with internal pull-ups. A CHANGE interrupt per pin
+// timestamps every edge into that button's queue, so presses are seen
+// with their real timing even while the loop is busy. If a queue fills
+// up, the edges after it are lost and the current level is reported
+// instead once the loop catches up.
+class GpioButtons : public HalButtons {
+public:
+  GpioButtons(uint8_t fetchPin, uint8_t clearPin);
+
+  // After pinMode: attach the interrupts
+  void begin();
+  bool nextEdge(ButtonEdge& edge) override;
+
+  // Task woken by button edges (the one that calls nextEdge)
+  static void setWakeTask(TaskHandle_t task);
+
+  uint32_t dropped() const { return droppedEdges; }
+
+private:
+  struct Line {
+    GpioButtons* owner;
+    HalButton button;
+    uint8_t pin;
+    SpscQueue<ButtonEdge, BUTTON_EDGE_QUEUE> edges;
+    volatile bool overflow;
+    ButtonEdge next;        // Popped, not handed out yet (edges are merged by time)
+    bool hasNext;
+  };
+
+  static void IRAM_ATTR onEdge(void* arg);
+  bool peek(Line& line);
+
+  Line lines[2];
+  volatile uint32_t droppedEdges;
+};
+
+class SerialLog : public HalLog {
+public:
+  void write(const char* text) override { Serial.print(text); }
+};
+
+#endif // HAL_ESP32_H
@@ -0,0 +1,123 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ArduinoJson.h>
+
+// ==========================================
+// FIXED-CAPACITY JSON STORAGE
+// ==========================================
+//
+// ArduinoJson 7 grows documents on the heap. Give a document an arena
+// instead and its memory comes from a buffer we own. A document that
+// outgrows it reports NoMemory (or overflowed()); it never takes more
+// heap.
+//
+//   static JsonArena<JSON_DOC_CAPACITY> arena;
+//   JsonDocument doc(&arena);
+//
+// Blocks are bump-allocated. The arena rewinds when its last live block is
+// freed, so a static arena can back one document after another, but only
+// one document should use it at a time.
+
+template <size_t N>
+class JsonArena : public ArduinoJson::Allocator {
+public:
+  JsonArena() : used(0), peakUsed(0), liveBlocks(0), lastBlock(0) {}
+
+  void* allocate(size_t size) override {
+    size_t offset = used + HEADER;
+    size_t end = offset + align(size);
+    if (end > N) {
+      return nullptr;
+    }
+    writeSize(offset, size);
+    lastBlock = offset;
+    used = end;
+    liveBlocks++;
+    if (used > peakUsed) {
+      peakUsed = used;
+    }
+    return buffer + offset;
+  }
+
+  void deallocate(void* ptr) override {
+    if (!ptr || liveBlocks == 0) {
+      return;
+    }
+    if (offsetOf(ptr) == lastBlock) {
+      used = lastBlock - HEADER;
+    }
+    if (--liveBlocks == 0) {
+      used = 0;
+    }
+  }
+
+  void* reallocate(void* ptr, size_t newSize) override {
+    if (!ptr) {
+      return allocate(newSize);
+    }
+
+    size_t offset = offsetOf(ptr);
+    size_t oldSize = readSize(offset);
+
+    // The newest block can grow or shrink where it is
+    if (offset == lastBlock) {
+      size_t end = offset + align(newSize);
+      if (end > N) {
+        return nullptr;
+      }
+      writeSize(offset, newSize);
+      used = end;
+      if (used > peakUsed) {
+        peakUsed = used;
+      }
+      return ptr;
+    }
+
+    // Older blocks shrink in place; growing one means moving it
+    if (newSize <= oldSize) {
+      writeSize(offset, newSize);
+      return ptr;
+    }
+    void* moved = allocate(newSize);
+    if (moved) {
+      memcpy(moved, ptr, oldSize);
+      liveBlocks--;  // The old copy is abandoned
+    }
+    return moved;
+  }
+
+  size_t capacity() const { return N; }
+  size_t usedBytes() const { return used; }
+  size_t peakBytes() const { return peakUsed; }
+
+private:
+  static const size_t ALIGN = sizeof(void*) > 4 ? sizeof(void*) : 4;
+  static const size_t HEADER = ALIGN;  // Block size, padded to keep alignment
+
+  static size_t align(size_t size) { return (size + ALIGN - 1) & ~(ALIGN - 1); }
+
+  size_t offsetOf(void* ptr) const { return (size_t)((uint8_t*)ptr - buffer); }
+
+  void writeSize(size_t offset, size_t size) {
+    uint32_t value = (uint32_t)size;
+    memcpy(buffer + offset - HEADER, &value, sizeof(value));
+  }
+
+  size_t readSize(size_t offset) const {
+    uint32_t value;
+    memcpy(&value, buffer + offset - HEADER, sizeof(value));
+    return value;
+  }
+
+  alignas(8) uint8_t buffer[N];
+  size_t used;
+  size_t peakUsed;
+  size_t liveBlocks;
+  size_t lastBlock;  // Offset of the newest block (0 = none)
+};
+
+#endif // JSON_ARENA_H
@@ -0,0 +1,50 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// ==========================================
+// FIXED-BUCKET LATENCY HISTOGRAM
+// ==========================================
+//
+// Durations in microseconds, counted into fixed 1-2.5-5 buckets from 50us
+// to 10s plus an overflow bucket. Recording is a bucket search and three
+// relaxed atomic adds, so it is cheap enough for the tap path and may be
+// called from the loop and network tasks at once. Percentiles are
+// estimated from the buckets (linear within a bucket), which is what a
+// Prometheus histogram_quantile() would report from the same data.
+//
+// No Arduino dependencies, so it also builds on a Linux host.
+
+#define LATENCY_BUCKETS 17   // Finite bounds; bucket LATENCY_BUCKETS is +Inf
+
+class LatencyHistogram {
+public:
+  LatencyHistogram();
+
+  void record(uint32_t us);
+  void reset();
+
+  uint32_t count() const { return total.load(std::memory_order_relaxed); }
+  uint64_t sumUs() const { return sum.load(std::memory_order_relaxed); }
+  uint32_t maxUs() const { return peak.load(std::memory_order_relaxed); }
+
+  // Samples in bucket i (0..LATENCY_BUCKETS, the last one is overflow)
+  uint32_t bucketCount(size_t i) const { return buckets[i].load(std::memory_order_relaxed); }
+
+  // Estimated value below which 'fraction' (0..1) of samples fall; 0 if empty
+  uint32_t percentileUs(float fraction) const;
+
+  // Upper bound of bucket i in microseconds (i < LATENCY_BUCKETS)
+  static uint32_t bucketBoundUs(size_t i);
+
+private:
+  std::atomic<uint32_t> buckets[LATENCY_BUCKETS + 1];
+  std::atomic<uint32_t> total;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint32_t> peak;
+};
+
+#endif // LATENCY_HISTOGRAM_H
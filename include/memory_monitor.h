@@ -0,0 +1,38 @@
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+#include "hal.h"
+#include "memory_watch.h"
+
+// ==========================================
+// MEMORY MONITOR
+// ==========================================
+//
+// The MemoryWatch on the ESP32 heap (internal RAM, where mbedTLS
+// allocates) and the loop, net, wifi and oled tasks. The loop task
+// samples it every MEM_SAMPLE_INTERVAL; any task reads memoryDegraded().
+//
+// While degraded, the network task stops logging each request (every
+// line is a String built and freed between TLS records) and roster syncs
+// wait, since a sync reallocs the roster's arrays as it grows; one that
+// was already running stops before its next item. Deferred and stopped
+// syncs run once the heap has recovered. At CRITICAL the API client does
+// not open new connections; the journal keeps the taps until it can.
+
+MemoryWatch& memoryWatch();
+
+// Loop task, once per pass. True on the pass the level changed.
+bool pollMemoryMonitor();
+
+// Safe from any task
+bool memoryDegraded();
+
+// Whether a bulk block (the roster's arrays) of this size may be taken:
+// from PSRAM if the board has it, else only if a TLS session plus
+// MEM_LOW_MARGIN still fit in internal RAM beside it
+bool bulkBlockFits(size_t bytes);
+
+void printMemoryStats(HalLog& out);
+void writeMemoryMetrics(HalLog& out);
+
+#endif // MEMORY_MONITOR_H
@@ -0,0 +1,200 @@
+#ifndef MEMORY_WATCH_H
+#define MEMORY_WATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+#include "hal.h"
+
+// ==========================================
+// MEMORY WATCH
+// ==========================================
+//
+// Heap and stack telemetry, plus an early warning for the one allocation
+// the device cannot do without: a new TLS session. mbedTLS takes one
+// record buffer of ~17 KB in a single block, and ~40 KB in all, when a
+// connection is opened. After a long day of String churn and roster
+// reallocs the heap can have that much free but not in one piece.
+//
+// update() samples free heap, the largest free block, the lowest free
+// heap since boot and each task's stack high-water mark, and sets the
+// level:
+//
+//   OK        a handshake fits, with MEM_LOW_MARGIN to spare
+//   LOW       it still fits, but not by much: the firmware sheds what it
+//             can (request logging, roster syncs) so the heap recovers
+//   CRITICAL  it would fail now; new connections are not attempted
+//
+// While a session is open its heap is counted as free for the next
+// handshake, which reuses it once the old connection is closed. A heap
+// with no other block the size of its record buffer is still LOW: one
+// unlucky allocation into the freed buffer and the reconnect fails.
+//
+// A level is only left once the heap is MEM_RECOVER_MARGIN clear of its
+// threshold, so a heap hovering at the edge does not flap.
+//
+// Heap use is also tagged by subsystem. A MemScope around an operation
+// charges the heap it took (or gave back) to a tag; subsystems that know
+// their own footprint (the roster) report it with setHeld(). Scopes see
+// the whole heap, so another task allocating meanwhile is charged too:
+// the tags say where the heap went, roughly, not to the byte.
+//
+// The heap and tasks are read through MemoryProbe, so the policy runs on
+// a host against a simulated heap (test/test_memory_watch).
+
+enum MemTag {
+  MEM_TAG_NETWORK,        // TLS sessions, HTTP client, request logging
+  MEM_TAG_JSON,           // Parse filters and other heap-backed documents
+  MEM_TAG_DISPLAY,        // Frame buffer, display task
+  MEM_TAG_ROSTER,         // Roster entries and name pool
+  MEM_TAG_COUNT
+};
+
+enum MemTask {
+  MEM_TASK_LOOP,
+  MEM_TASK_NET,
+  MEM_TASK_WIFI,
+  MEM_TASK_OLED,
+  MEM_TASK_COUNT
+};
+
+enum MemoryLevel {
+  MEMORY_OK,
+  MEMORY_LOW,
+  MEMORY_CRITICAL
+};
+
+class MemoryProbe {
+public:
+  virtual ~MemoryProbe() {}
+  virtual uint32_t freeHeap() = 0;
+  virtual uint32_t largestBlock() = 0;
+  virtual uint32_t minFreeHeap() = 0;     // Lowest free heap since boot
+  // Stack size and high-water mark (bytes never used) of a task; false
+  // if it is not running
+  virtual bool stack(MemTask task, uint32_t& size, uint32_t& unused) = 0;
+};
+
+// Counters, as read by stats(): update() counts from the loop task,
+// tlsFits() and tlsOpened() from the network task
+struct MemoryStats {
+  uint32_t samples;
+  uint32_t lowEntered;      // Times the level went from OK to LOW or worse
+  uint32_t criticalEntered;
+  uint32_t degradedMs;      // Time spent at LOW or CRITICAL, up to the last sample
+  uint32_t tlsRefused;      // Connections not attempted, the handshake would not fit
+  uint32_t tlsOpened;       // Handshakes measured by tlsOpened()
+  uint32_t tlsLastBytes;    // Heap the last handshake took
+  uint32_t tlsMaxBytes;
+  uint32_t lowestFree;      // Lowest sampled values
+  uint32_t lowestLargest;
+};
+
+struct MemTagStats {
+  int32_t held;             // Charged and not given back
+  int32_t peak;
+  uint32_t charges;
+};
+
+class MemoryWatch {
+public:
+  MemoryWatch(MemoryProbe& probe, uint32_t tlsBlock, uint32_t tlsHeap);
+
+  // Sample everything and update the level (loop task). True when the
+  // level changed.
+  bool update(uint32_t nowMs);
+
+  MemoryLevel level() const { return lvl.load(std::memory_order_acquire); }
+  bool degraded() const { return level() != MEMORY_OK; }
+
+  // Any task, just before opening a connection: samples the heap now.
+  // False (and counted) if the handshake would not fit.
+  bool tlsFits();
+
+  // A new TLS session took this much heap (also shown, for calibrating
+  // MEM_TLS_HEAP), and was closed again
+  void tlsOpened(int32_t heapBytes);
+  void tlsClosed() { sessionBytes.store(0, std::memory_order_relaxed); }
+
+  // Heap a subsystem took (positive) or gave back (negative)
+  void charge(MemTag tag, int32_t bytes);
+  // Footprint a subsystem counts itself, replacing what it was charged
+  void setHeld(MemTag tag, uint32_t bytes);
+
+  MemoryProbe& heapProbe() { return probe; }
+  MemTagStats tagStats(MemTag tag) const;
+  MemoryStats stats() const;
+  uint32_t lastFree() const { return heapFree; }
+  uint32_t lastLargest() const { return heapLargest; }
+
+  void print(HalLog& out) const;
+  // Prometheus text exposition format (gauges + counters)
+  void writePrometheus(HalLog& out) const;
+
+  static const char* levelName(MemoryLevel level);
+  static const char* tagName(MemTag tag);
+  static const char* taskName(MemTask task);
+
+private:
+  MemoryLevel levelFor(uint32_t freeBytes, uint32_t largestBytes, MemoryLevel current) const;
+
+  struct Tag {
+    std::atomic<int32_t> held;
+    std::atomic<int32_t> peak;
+    std::atomic<uint32_t> charges;
+  };
+
+  struct Counters {
+    std::atomic<uint32_t> samples;
+    std::atomic<uint32_t> lowEntered;
+    std::atomic<uint32_t> criticalEntered;
+    std::atomic<uint32_t> degradedMs;
+    std::atomic<uint32_t> tlsRefused;
+    std::atomic<uint32_t> tlsOpened;
+    std::atomic<uint32_t> tlsLastBytes;
+    std::atomic<uint32_t> tlsMaxBytes;
+    std::atomic<uint32_t> lowestFree;
+    std::atomic<uint32_t> lowestLargest;
+  };
+
+  struct TaskStack {
+    bool running;
+    uint32_t size;
+    uint32_t unused;
+  };
+
+  MemoryProbe& probe;
+  uint32_t tlsBlock;
+  uint32_t tlsHeap;
+  std::atomic<MemoryLevel> lvl;
+  std::atomic<uint32_t> sessionBytes;   // Held by the open TLS session, 0 if none
+  uint32_t sampledAt;
+  uint32_t heapFree;
+  uint32_t heapLargest;
+  uint32_t heapMinFree;
+  Tag tags[MEM_TAG_COUNT];
+  TaskStack stacks[MEM_TASK_COUNT];
+  Counters st;
+};
+
+// Charges the heap change across its lifetime to a tag
+class MemScope {
+public:
+  MemScope(MemoryWatch& watch, MemTag tag)
+    : watch(watch), tag(tag), startFree(watch.heapProbe().freeHeap()) {}
+  ~MemScope() { watch.charge(tag, taken()); }
+
+  // Heap taken since the scope opened (negative: freed)
+  int32_t taken() const { return (int32_t)(startFree - watch.heapProbe().freeHeap()); }
+
+private:
+  MemoryWatch& watch;
+  MemTag tag;
+  uint32_t startFree;
+
+  MemScope(const MemScope&);
+  MemScope& operator=(const MemScope&);
+};
+
+#endif // MEMORY_WATCH_H
@@ -0,0 +1,19 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// ==========================================
+// LOCAL METRICS ENDPOINT
+// ==========================================
+//
+// GET http://<device-ip>:METRICS_PORT/metrics returns the tap path
+// histograms (tap_metrics.h) and the heap and stack gauges
+// (memory_monitor.h) in Prometheus text format. Requests are served
+// from loop(), between taps; a scrape takes a few milliseconds.
+
+void initMetricsServer();
+void pollMetricsServer();
+
+#endif // METRICS_SERVER_H
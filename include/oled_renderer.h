@@ -0,0 +1,67 @@
+#ifndef OLED_RENDERER_H
+#define OLED_RENDERER_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_SSD1306.h>
+#include "config.h"
+#include "frame_diff.h"
+
+// ==========================================
+// ASYNC PARTIAL-UPDATE OLED RENDERER
+// ==========================================
+//
+// Screens draw into the Adafruit framebuffer as before. submit() copies
+// the finished frame into a hand-off buffer and returns at once; a
+// display task diffs it against a shadow of the panel (frame_diff.h) and
+// sends only the changed columns of the changed pages over I2C at
+// OLED_I2C_CLOCK. Drawing therefore never waits for the bus, and a frame
+// superseded before the task got to it is simply skipped.
+//
+//   draw buffer (Adafruit) --submit()--> pending --task--> shadow = panel
+//
+// After begin() the display task owns the I2C bus.
+
+struct OledStats {
+  uint32_t submitted;     // Frames handed over by submit()
+  uint32_t sent;          // Frames that changed something on the panel
+  uint32_t superseded;    // Replaced by a newer frame before being sent
+  uint64_t wireBytes;     // Bytes on the I2C bus, commands included
+  uint32_t lastFlushUs;
+  uint32_t maxFlushUs;
+};
+
+class OledRenderer {
+public:
+  OledRenderer(Adafruit_SSD1306& oled, TwoWire& wire, uint8_t i2cAddr);
+
+  // Start the display task. Call after oled.begin() and the last direct
+  // oled.display(): the panel is assumed to show the current buffer.
+  bool begin();
+
+  // Queue the drawn frame. Before begin() this is a plain full display().
+  void submit();
+
+  OledStats stats();
+
+private:
+  static void taskEntry(void* param);
+  void run();
+  void sendSpan(const DirtySpan& span, const uint8_t* frame);
+
+  Adafruit_SSD1306& oled;
+  TwoWire& wire;
+  uint8_t addr;
+
+  uint8_t frames[2][FRAME_BYTES];   // Hand-off + the one being sent
+  uint8_t* pending;
+  uint8_t* sending;
+  bool hasPending;
+  uint8_t shadow[FRAME_BYTES];      // What the panel shows
+
+  portMUX_TYPE lock;
+  TaskHandle_t task;
+  OledStats st;
+};
+
+#endif // OLED_RENDERER_H
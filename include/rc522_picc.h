@@ -0,0 +1,138 @@
+#ifndef RC522_PICC_H
+#define RC522_PICC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "card_uid.h"
+
+// ==========================================
+// RC522 CARD PROTOCOL (REQA / ANTICOLLISION / SELECT / HALT)
+// ==========================================
+//
+// The ISO 14443A exchanges the tap path needs, with as few SPI
+// transactions as the chip allows. Compared to the MFRC522 library's
+// PICC_IsNewCardPresent / PICC_ReadCardSerial / PICC_HaltA:
+//
+//   - Framing registers (TxMode, RxMode, ModWidth, CollReg) are set once
+//     in begin(), not before every probe. TxControlReg is shadowed, so
+//     antenna on/off is one write.
+//   - StartSend goes in the same write as the frame's bit count, and
+//     while a Transceive command is still running only StartSend is
+//     needed to send the next frame (no Idle + Transceive rewrite).
+//   - The status registers (ComIrq, Error, FIFOLevel, Control, Status2)
+//     come back in one transaction, first read once the answer is due
+//     rather than polled from the moment the frame is sent. Answers come
+//     a fixed time after the command (ISO 14443-3 FDT), so a card that
+//     has not started answering by then is not there: no waiting for
+//     the chip's timer.
+//   - CRC_A is computed here, not by the chip's coprocessor (9 SPI
+//     transactions per CRC in the library, two per cascade level).
+//   - HLTA is sent without waiting out a timeout for the answer a
+//     halted card never gives (25 ms in the library). The chip's own
+//     receive timeout is cut to 1 ms as a backstop.
+//   - The FIFO is only flushed when something was left in it.
+//
+// SPI goes through Rc522Bus, so the same code runs on a host against a
+// simulated chip (test/test_rc522_picc).
+
+// Chip registers (datasheet numbering, not shifted for the SPI address byte)
+#define RC522_REG_COMMAND       0x01
+#define RC522_REG_COM_IRQ       0x04
+#define RC522_REG_DIV_IRQ       0x05
+#define RC522_REG_ERROR         0x06
+#define RC522_REG_STATUS2       0x08
+#define RC522_REG_FIFO_DATA     0x09
+#define RC522_REG_FIFO_LEVEL    0x0A
+#define RC522_REG_CONTROL       0x0C
+#define RC522_REG_BIT_FRAMING   0x0D
+#define RC522_REG_COLL          0x0E
+#define RC522_REG_TX_MODE       0x12
+#define RC522_REG_RX_MODE       0x13
+#define RC522_REG_TX_CONTROL    0x14
+#define RC522_REG_CRC_RESULT_H  0x21
+#define RC522_REG_CRC_RESULT_L  0x22
+#define RC522_REG_MOD_WIDTH     0x24
+#define RC522_REG_T_MODE        0x2A
+#define RC522_REG_T_PRESCALER   0x2B
+#define RC522_REG_T_RELOAD_H    0x2C
+#define RC522_REG_T_RELOAD_L    0x2D
+
+#define RC522_CMD_IDLE          0x00
+#define RC522_CMD_CALC_CRC      0x03
+#define RC522_CMD_TRANSCEIVE    0x0C
+
+#define RC522_FIFO_SIZE         64
+
+// SPI access to one chip. Every call is one transaction (chip select
+// asserted once).
+class Rc522Bus {
+public:
+  virtual ~Rc522Bus() {}
+  // len bytes to one register (several bytes only make sense for the FIFO)
+  virtual void write(uint8_t reg, const uint8_t* data, size_t len) = 0;
+  // out[i] = regs[i]; registers may differ or repeat (FIFO). len <= RC522_FIFO_SIZE.
+  virtual void read(const uint8_t* regs, uint8_t* out, size_t len) = 0;
+  virtual void waitUs(uint32_t us) = 0;
+};
+
+struct Rc522BusStats {
+  uint32_t transactions;
+  uint32_t bytes;         // Including address bytes
+};
+
+// ISO 14443A CRC (CRC_A), low byte first on the air
+uint16_t rc522CrcA(const uint8_t* data, size_t len);
+
+class Rc522Picc {
+public:
+  explicit Rc522Picc(Rc522Bus& bus);
+
+  // After the library's PCD_Init: framing and receive timeout set once,
+  // antenna state read
+  void begin();
+
+  // REQA; true if a card in the field answered
+  bool requestA();
+
+  // REQA without waiting (IRQ mode probe: the answer raises RxIRq).
+  // Call probeAnswered() once it has.
+  void startRequestA();
+  void probeAnswered();
+
+  // Anticollision + select over all cascade levels, for a card that has
+  // just answered REQA. False on timeout, collision or CRC error.
+  bool select(CardUid& uid, uint8_t& sak);
+
+  // HLTA: the card stays quiet until it leaves the field
+  void haltA();
+
+  // Stop the running command and clear the IRQ flags (IRQ pin released)
+  void idle();
+
+  void antenna(bool on);
+
+  const Rc522BusStats& stats() const { return st; }
+
+private:
+  enum Result { RESULT_OK, RESULT_TIMEOUT, RESULT_COLLISION, RESULT_ERROR };
+  enum ChipState {
+    CHIP_IDLE,            // No command running
+    CHIP_READY,           // Transceive running, last frame answered: StartSend alone sends the next
+    CHIP_BUSY             // Transceive in an unknown phase: Idle before the next command
+  };
+
+  void startTransceive(const uint8_t* data, size_t len, uint8_t lastBits);
+  Result finishTransceive(uint8_t* back, size_t backMax, size_t& backLen, uint32_t dueUs);
+  Result transceive(const uint8_t* data, size_t len, uint8_t* back, size_t backMax, size_t& backLen);
+  void writeReg(uint8_t reg, uint8_t value);
+  void write(uint8_t reg, const uint8_t* data, size_t len);
+  void read(const uint8_t* regs, uint8_t* out, size_t len);
+
+  Rc522Bus& bus;
+  ChipState chip;
+  bool fifoEmpty;           // Nothing left unread in the FIFO: no flush needed
+  uint8_t txControl;        // Shadow of TxControlReg
+  Rc522BusStats st;
+};
+
+#endif // RC522_PICC_H
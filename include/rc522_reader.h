@@ -0,0 +1,102 @@
+#ifndef RC522_READER_H
+#define RC522_READER_H
+
+#include <Arduino.h>
+#include <MFRC522.h>
+#include <SPI.h>
+#include "config.h"
+#include "reader_array.h"
+#include "rc522_picc.h"
+
+// ==========================================
+// RC522 CARD READER
+// ==========================================
+//
+// One MFRC522 behind the CardReader interface, in one of two modes:
+//
+//   Poll - every readCard() asks the chip for a new card over SPI
+//          (PICC_IsNewCardPresent), with the antenna on all the time.
+//
+//   IRQ  - sense() sends a REQA probe every CARD_SENSE_INTERVAL ms and
+//          leaves the antenna on for CARD_SENSE_WINDOW ms. A card that
+//          answers raises RxIRq on the IRQ pin (ComIEnReg/DivIEnReg), and
+//          the ISR wakes the main task. Between probes the antenna is off
+//          and the SPI bus is silent. The RC522 has no hardware low-power
+//          card detection, so the field is duty-cycled instead.
+//
+// A card that has been read is halted, so it does not answer the next
+// probes and is only seen again after it leaves the field.
+//
+// The MFRC522 library only resets and configures the chip (PCD_Init).
+// Probes, select and halt go through Rc522Picc (rc522_picc.h) on an SPI
+// transport clocked at RC522_SPI_CLOCK.
+
+// Rc522Bus on the shared VSPI bus, one chip select per reader
+class Rc522SpiBus : public Rc522Bus {
+public:
+  Rc522SpiBus() : ssPin(0), settings(RC522_SPI_CLOCK, MSBFIRST, SPI_MODE0) {}
+  void begin(uint8_t pin) { ssPin = pin; }
+
+  void write(uint8_t reg, const uint8_t* data, size_t len) override;
+  void read(const uint8_t* regs, uint8_t* out, size_t len) override;
+  void waitUs(uint32_t us) override { delayMicroseconds(us); }
+
+private:
+  uint8_t ssPin;
+  SPISettings settings;
+};
+
+struct Rc522Stats {
+  uint32_t probes;        // REQA commands sent (every poll in poll mode)
+  uint32_t irqs;          // Probes answered by a card (IRQ mode)
+  uint64_t busyUs;        // Time spent in SPI transactions with this reader
+  uint32_t lastDetectUs;  // IRQ edge to UID read (IRQ mode)
+  uint32_t maxDetectUs;
+};
+
+class Rc522CardReader : public CardReader {
+public:
+  Rc522CardReader();
+
+  // Init the chip; irqPin < 0 selects poll mode. Returns the version
+  // register (0x00 or 0xFF means the chip did not answer).
+  byte begin(uint8_t ssPin, uint8_t rstPin, int irqPin);
+
+  bool readCard(CardUid& uid) override;
+  void release() override;
+
+  // IRQ mode: start or end a probe as scheduled. Returns ms until this
+  // reader needs sense() again (0xFFFFFFFF in poll mode).
+  uint32_t sense(uint32_t nowMs);
+
+  bool irqMode() const { return irqPin >= 0; }
+  const Rc522Stats& stats() const { return st; }
+  const Rc522BusStats& spiStats() const { return picc.stats(); }
+
+  // SAK of the last card read (0x08 MIFARE Classic 1K, 0x00 Ultralight/NTAG, 0x20 ISO 14443-4)
+  uint8_t sak() const { return lastSak; }
+
+  // Task woken by reader IRQs (the one that calls sense/readCard)
+  static void setWakeTask(TaskHandle_t task);
+
+  // Library instance: reset, init and the version dump only
+  MFRC522 rfid;
+
+private:
+  static void IRAM_ATTR onIrq(void* arg);
+  void startProbe(uint32_t nowMs);
+  void endProbe(uint32_t nowMs);
+  bool readSerial(CardUid& uid);
+
+  Rc522SpiBus bus;
+  Rc522Picc picc;
+  int irqPin;
+  uint8_t lastSak;
+  volatile bool irqPending;
+  volatile uint32_t irqAtUs;
+  bool probing;             // Antenna on, waiting for an answer
+  uint32_t nextSenseMs;
+  Rc522Stats st;
+};
+
+#endif // RC522_READER_H
@@ -0,0 +1,71 @@
+#ifndef READER_ARRAY_H
+#define READER_ARRAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "card_uid.h"
+
+// ==========================================
+// READER ARRAY
+// ==========================================
+//
+// Several card readers (one per door) feeding one check-in pipeline.
+// Readers are polled round-robin, and each call resumes after the reader
+// that produced the last tap, so a busy door cannot starve a quiet one.
+// Every card that enters a field is reported; repeats of a recent card
+// are dropped by DeviceController (uid_cache.h).
+//
+// This file has no Arduino dependencies: the RC522 driver sits behind
+// CardReader, so the scheduler also builds on a Linux host with
+// simulated readers.
+
+#define READER_MAX 4
+
+// One physical reader
+class CardReader {
+public:
+  virtual ~CardReader() {}
+  // True if a card newly entered the field; fills uid
+  virtual bool readCard(CardUid& uid) = 0;
+  // Done with the current card (halt it so it is not re-read at once)
+  virtual void release() = 0;
+};
+
+struct CardTap {
+  CardUid uid;
+  uint8_t reader;   // Reader id given to add(), doubles as the door
+};
+
+struct ReaderStats {
+  uint32_t polls;
+  uint32_t taps;
+};
+
+class ReaderArray {
+public:
+  ReaderArray();
+
+  // Register a reader under the id its taps are tagged with
+  bool add(CardReader* reader, uint8_t id);
+
+  // Poll every reader at most once, starting after the last reader served.
+  // Returns true with the first card found.
+  bool poll(CardTap& tap);
+
+  uint8_t size() const { return count; }
+  uint8_t id(uint8_t index) const { return slots[index].id; }
+  const ReaderStats& stats(uint8_t index) const { return slots[index].stats; }
+
+private:
+  struct Slot {
+    CardReader* reader;
+    uint8_t id;
+    ReaderStats stats;
+  };
+
+  Slot slots[READER_MAX];
+  uint8_t count;
+  uint8_t next;         // Reader to poll first on the next call
+};
+
+#endif // READER_ARRAY_H
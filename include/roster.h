@@ -0,0 +1,142 @@
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "checkin_log.h"
+
+// ==========================================
+// EVENT ROSTER CACHE
+// ==========================================
+//
+// Local copy of the active event's attendee list, so a tap can be answered
+// ("Welcome <name>" / "Already checked in") without a network round trip.
+//
+// Entries are kept sorted by a 32-bit hash of the UID. A bucket index on
+// the top ROSTER_INDEX_BITS of the hash narrows a lookup to a handful of
+// entries, which are then binary searched and compared byte for byte.
+// Names live in one shared string pool. Both arrays come from malloc, which
+// on ESP32 boards with PSRAM places blocks this large in external RAM.
+//
+// Build with add() ... finalize(); find() is valid after finalize().
+//
+// Delta sync: the roster carries the server's version. upsert()/remove()
+// apply a delta in place - updates and removals (tombstones) hit sorted
+// entries directly, new UIDs are staged at the end and still found by a
+// short linear scan. finalize() folds them in and drops the tombstones.
+//
+// Full sync: beginReload() ... reload() ... endReload() replaces the list
+// in place rather than from empty, so a check-in made on this device and
+// not yet reported back by the server keeps its ROSTER_CHECKED_IN. Entries
+// the new list did not mention are dropped only if it arrived complete.
+//
+// Growth: each array realloc asks the grow guard (if set) whether a block
+// that size may be taken. On a board without PSRAM a 20k roster would
+// leave no room for a TLS session, so the device only lets the roster
+// grow while a handshake still fits beside it; add() then fails and the
+// sync counts the entry as skipped.
+
+#define ROSTER_ALLOWED     0x01   // Registered for this event
+#define ROSTER_CHECKED_IN  0x02   // Already checked in (server or this device)
+#define ROSTER_SEEN        0x40   // In the list being reloaded (until endReload())
+#define ROSTER_REMOVED     0x80   // Tombstone until the next finalize()
+
+#define ROSTER_INDEX_BITS  10
+#define ROSTER_NAME_MAX    32
+#define ROSTER_GROW_STEP   256    // Entries added when doubling would not fit
+
+struct RosterEntry {
+  uint32_t hash;
+  uint32_t nameOffset;
+  uint8_t flags;
+  uint8_t uidLen;
+  uint8_t uid[CHECKIN_UID_MAX];
+};
+
+// Byte sink/source for snapshots (a LittleFS file on the device)
+class RosterSink {
+public:
+  virtual ~RosterSink() {}
+  virtual bool write(const void* data, size_t len) = 0;
+};
+
+class RosterSource {
+public:
+  virtual ~RosterSource() {}
+  virtual bool read(void* data, size_t len) = 0;
+};
+
+// May a block of this many bytes be allocated for the roster?
+typedef bool (*RosterGrowFn)(size_t blockBytes);
+
+class Roster {
+public:
+  Roster();
+  ~Roster();
+
+  void clear();
+
+  // Stage an entry. Returns false when full or out of memory.
+  bool add(const uint8_t* uid, uint8_t uidLen, const char* name, uint8_t flags);
+
+  // Sort and index the staged entries, dropping removed ones
+  void finalize();
+
+  // Delta updates. A device-side check-in survives an upsert that does not
+  // know about it yet.
+  bool upsert(const uint8_t* uid, uint8_t uidLen, const char* name, uint8_t flags);
+  bool remove(const uint8_t* uid, uint8_t uidLen);
+
+  // Full sync over the current list. complete: the whole list was read, so
+  // entries it did not mention are removed. Then finalize().
+  void beginReload();
+  bool reload(const uint8_t* uid, uint8_t uidLen, const char* name, uint8_t flags);
+  void endReload(bool complete);
+
+  void setGrowGuard(RosterGrowFn fits) { growFits = fits; }
+
+  RosterEntry* find(const uint8_t* uid, uint8_t uidLen);
+  const char* nameOf(const RosterEntry& entry) const;
+
+  uint32_t size() const { return count; }
+  bool ready() const { return sorted && count > 0; }
+
+  uint32_t version() const { return rosterVersion; }
+  void setVersion(uint32_t version) { rosterVersion = version; }
+
+  // Snapshot of a finalized roster, tagged with its event ID.
+  // load() fails (leaving the roster empty) if the tag does not match.
+  bool save(RosterSink& sink, const char* eventId) const;
+  bool load(RosterSource& source, const char* eventId);
+
+  // Bytes held by entries, names and index (allocated, not just used)
+  size_t memoryBytes() const;
+  size_t nameBytes() const { return namesUsed; }
+
+  static uint32_t hashUid(const uint8_t* uid, uint8_t uidLen);
+
+private:
+  bool reserveEntries(uint32_t wanted);
+  bool reserveNames(uint32_t wanted);
+  RosterEntry* findSorted(uint32_t hash, const uint8_t* uid, uint8_t uidLen);
+  bool rename(RosterEntry* entry, const char* name);
+
+  RosterEntry* entries;
+  uint32_t count;
+  uint32_t sortedCount;   // entries[0..sortedCount) are sorted and indexed
+  uint32_t capacity;
+  uint32_t rosterVersion;
+
+  char* names;
+  uint32_t namesUsed;
+  uint32_t namesCapacity;
+
+  uint32_t index[(1 << ROSTER_INDEX_BITS) + 1];
+  bool sorted;
+  RosterGrowFn growFits;
+
+  Roster(const Roster&);
+  Roster& operator=(const Roster&);
+};
+
+#endif // ROSTER_H
@@ -0,0 +1,123 @@
+#ifndef ROSTER_SYNC_H
+#define ROSTER_SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+#include "roster.h"
+#include "hal.h"
+
+// ==========================================
+// ROSTER SYNC
+// ==========================================
+//
+// One sync of the roster with the server. The device sends the version it
+// holds and the server answers with one of:
+//   304                              - nothing changed
+//   200, X-Roster-Mode: delta        - adds/removes since that version
+//   200, X-Roster-Mode: full         - the whole list (first sync, or too old)
+// X-Roster-Version carries the version the response brings us to.
+//
+// Full list, read one attendee at a time off the body so a 20k-entry list
+// never has to fit in RAM as JSON (only the current item is held, in the
+// item allocator - a fixed arena on the device):
+//   {"roster": [{"uid": "AA:BB:CC:DD", "name": "...", "allowed": true,
+//                "checkedIn": false}, ...]}
+// The array is found by its key, with any whitespace around ':' and '['.
+// After each item comes ',' or ']'; anything else (an item that does not
+// parse, a body cut short) leaves the list incomplete. What was read is
+// kept, nothing is dropped, and the version is not claimed, so the next
+// sync is full. An item that parses but has no usable UID (missing, not
+// hex, longer than a card's) is the server's to fix: it is logged and
+// counted, and the version is still taken - the next full list would
+// carry it again. Only entries the roster had no room for drop it.
+//
+// Delta, small and parsed in one heap document:
+//   {"adds": [<roster item>, ...], "removes": ["AA:BB:CC:DD", ...]}
+// A delta only applies over the version it was asked against. One that
+// comes while the roster has no version is discarded and the full list
+// asked for instead.
+//
+// A sync that starts with the heap fine can still run it short as the
+// roster grows. The memory guard, if set, is asked before each full-list
+// item and before a delta is parsed; when it says no the sync stops
+// there. What was read is kept and the version is not claimed, as for a
+// list cut short, and the result says it was stopped so the caller can
+// sync again once the heap has recovered.
+//
+// The server is behind RosterServer (ApiRequest on the board, a mock
+// server in the native tests).
+
+// Response body, a byte at a time
+class RosterInput {
+public:
+  virtual ~RosterInput() {}
+  // Next byte, or -1 at the end of the body (or on timeout)
+  virtual int read() = 0;
+};
+
+struct RosterReply {
+  uint32_t version;       // X-Roster-Version
+  bool delta;             // X-Roster-Mode: delta
+  RosterInput* body;
+};
+
+class RosterServer {
+public:
+  virtual ~RosterServer() {}
+  // GET the roster of an event. since: the version held (0 = none); full:
+  // the whole list whatever the version. Returns the HTTP status; on 200
+  // the reply is filled in and its body readable until the next get().
+  virtual int get(const char* eventId, uint32_t since, bool full, RosterReply& reply) = 0;
+};
+
+enum RosterSyncOutcome {
+  ROSTER_SYNC_CURRENT,    // 304, nothing to do
+  ROSTER_SYNC_UPDATED,    // Applied, at the server's version
+  ROSTER_SYNC_PARTIAL,    // Applied what could be read; version 0, next sync is full
+  ROSTER_SYNC_FAILED      // No usable answer; the roster is as it was
+};
+
+struct RosterSyncResult {
+  RosterSyncOutcome outcome;
+  int httpCode;
+  bool delta;
+  uint32_t version;       // Version the server answered with
+  uint32_t applied;       // Entries added, updated or removed
+  uint32_t skipped;       // Entries that did not fit (capacity, heap)
+  uint32_t invalid;       // Items without a usable UID, ignored
+  uint32_t requests;
+  bool stopped;           // The memory guard stopped it; sync again later
+};
+
+// True while the heap can take more of the roster
+typedef bool (*RosterMemoryFn)();
+
+class RosterSync {
+public:
+  // itemAllocator holds the one full-list item being parsed
+  RosterSync(Roster& roster, HalLog& log, ArduinoJson::Allocator* itemAllocator);
+
+  // Build the parse filters (heap, once at boot)
+  void begin();
+
+  void setMemoryGuard(RosterMemoryFn ok) { memoryOk = ok; }
+
+  RosterSyncResult sync(RosterServer& server, const char* eventId);
+
+private:
+  RosterSyncOutcome readFull(RosterInput& body, RosterSyncResult& result);
+  RosterSyncOutcome readDelta(RosterInput& body, RosterSyncResult& result);
+
+  Roster& roster;
+  HalLog& log;
+  ArduinoJson::Allocator* itemAllocator;
+  RosterMemoryFn memoryOk;
+  JsonDocument itemFilter;
+  JsonDocument deltaFilter;
+
+  RosterSync(const RosterSync&);
+  RosterSync& operator=(const RosterSync&);
+};
+
+#endif // ROSTER_SYNC_H
@@ -0,0 +1,125 @@
+#ifndef SCREEN_TEMPLATE_H
+#define SCREEN_TEMPLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+#include "frame_diff.h"
+
+// ==========================================
+// SCREEN TEMPLATES
+// ==========================================
+//
+// A screen is a constexpr description: static text at fixed positions
+// plus the fields filled in at runtime. The static layer is drawn through
+// the font once and kept as pixels, so showing a screen again is one
+// framebuffer copy followed by glyph rendering for the fields only.
+// Fields are fitted to the cells they have instead of wrapping into the
+// lines below.
+//
+// Layouts are checked at compile time (templateFits): static text must
+// fit on its line and fields must not overlap static text, since the
+// static layer is drawn under them.
+
+#define SCREEN_CHAR_WIDTH 6      // Built-in font cell at text size 1
+#define SCREEN_CHAR_HEIGHT 8
+#define SCREEN_FIELD_MAX 32      // Longest fitted field (characters)
+#define SCREEN_CACHE_SLOTS 4     // Static layers kept (FRAME_BYTES each)
+#define SCREEN_SCROLL_GAP 3      // Spaces between the end and the start again
+#define SCREEN_SCROLL_PAUSE 4    // Steps to rest at the start of each pass
+
+enum FitMode {
+  FIT_CLIP,       // Cut at the edge
+  FIT_ELLIPSIS,   // Cut and end with "..."
+  FIT_SHRINK,     // Drop to text size 1 if needed, then ellipsize
+  FIT_SCROLL      // Marquee, one character per step
+};
+
+struct StaticText {
+  int16_t x;
+  int16_t y;
+  uint8_t size;
+  const char* text;
+};
+
+struct TextField {
+  int16_t x;
+  int16_t y;
+  uint8_t size;
+  FitMode fit;
+};
+
+struct ScreenTemplate {
+  const StaticText* texts;
+  uint8_t textCount;
+  const TextField* fields;
+  uint8_t fieldCount;
+};
+
+template <size_t T, size_t F>
+constexpr ScreenTemplate screenTemplate(const StaticText (&texts)[T], const TextField (&fields)[F]) {
+  return { texts, (uint8_t)T, fields, (uint8_t)F };
+}
+
+template <size_t T>
+constexpr ScreenTemplate screenTemplate(const StaticText (&texts)[T]) {
+  return { texts, (uint8_t)T, nullptr, 0 };
+}
+
+template <size_t F>
+constexpr ScreenTemplate fieldsOnly(const TextField (&fields)[F]) {
+  return { nullptr, 0, fields, (uint8_t)F };
+}
+
+// Character cells from x to the right edge at the given text size
+constexpr size_t fieldColumns(int16_t x, uint8_t size) {
+  return (size_t)(FRAME_COLUMNS - x) / (SCREEN_CHAR_WIDTH * size);
+}
+
+constexpr size_t constexprLength(const char* text) {
+  size_t n = 0;
+  while (text[n] != '\0') {
+    n++;
+  }
+  return n;
+}
+
+// A field owns its row from x to the right edge
+constexpr bool fieldOverlaps(const TextField& field, const StaticText& t) {
+  return field.y < t.y + SCREEN_CHAR_HEIGHT * t.size && t.y < field.y + SCREEN_CHAR_HEIGHT * field.size &&
+         field.x < t.x + (int16_t)(constexprLength(t.text) * SCREEN_CHAR_WIDTH * t.size);
+}
+
+constexpr bool templateFits(const ScreenTemplate& screen) {
+  for (size_t i = 0; i < screen.textCount; i++) {
+    const StaticText& t = screen.texts[i];
+    if (constexprLength(t.text) > fieldColumns(t.x, t.size) ||
+        t.y + SCREEN_CHAR_HEIGHT * t.size > FRAME_PAGES * 8) {
+      return false;
+    }
+  }
+  for (size_t f = 0; f < screen.fieldCount; f++) {
+    const TextField& field = screen.fields[f];
+    if (fieldColumns(field.x, field.size) == 0 ||
+        field.y + SCREEN_CHAR_HEIGHT * field.size > FRAME_PAGES * 8) {
+      return false;
+    }
+    for (size_t i = 0; i < screen.textCount; i++) {
+      if (fieldOverlaps(field, screen.texts[i])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The part of text that goes in columns cells (NUL terminated in out).
+// step only matters for FIT_SCROLL. Returns the length written.
+size_t fitText(const char* text, size_t columns, FitMode mode, uint32_t step, char* out, size_t outSize);
+
+// Static layer (cached) and then values[i] into fields[i]. Returns true
+// if a FIT_SCROLL field is moving - draw again with step + 1 to advance.
+bool drawScreen(HalDisplay& display, const ScreenTemplate& screen,
+                const char* const* values = nullptr, uint32_t step = 0);
+
+#endif // SCREEN_TEMPLATE_H
@@ -0,0 +1,37 @@
+#ifndef SCREENS_H
+#define SCREENS_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "card_uid.h"
+
+// ==========================================
+// SCREENS
+// ==========================================
+//
+// Every OLED screen the firmware shows, drawn through HalDisplay so the
+// same layouts render on the panel and in the native simulator. Layouts
+// are templates (screen_template.h): only the variable text is rendered
+// per call.
+
+// Boot / status
+void displayOnOLED(HalDisplay& display, const char* line1, const char* line2, const char* line3);
+void displayWifiSetup(HalDisplay& display, const char* apName);
+
+// Registration mode
+void displayReady(HalDisplay& display);
+void displaySending(HalDisplay& display, const CardUid& uid);
+void displayWaiting(HalDisplay& display);
+void displayError(HalDisplay& display, const char* line1, const char* line2);
+
+// Attendance mode
+void displayNoEvent(HalDisplay& display);
+void displayFetchingEvent(HalDisplay& display);
+// True while a long event name scrolls: call again with scrollStep + 1
+bool displayAttendanceReady(HalDisplay& display, const char* eventName, uint32_t scrollStep = 0);
+void displayCheckingIn(HalDisplay& display, const CardUid& uid);
+void displayWelcome(HalDisplay& display, const char* studentName);
+void displaySavedOffline(HalDisplay& display, uint32_t pending);
+void displayAttendanceError(HalDisplay& display, const char* error);
+
+#endif // SCREENS_H
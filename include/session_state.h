@@ -0,0 +1,41 @@
+#ifndef SESSION_STATE_H
+#define SESSION_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "checkin_log.h"
+#include "attendance_controller.h"
+
+// ==========================================
+// SESSION STATE
+// ==========================================
+//
+// What the device was doing, kept in NVS so a reboot mid-event (brownout,
+// watchdog) comes back on the same event instead of in registration mode:
+// the mode, the active event, the roster version the flash snapshot should
+// have, and the journal cursor so the check-in log does not need a full
+// scan.
+//
+// Stored as one blob: magic, layout version, fields, CRC-32. decode()
+// rejects anything that fails the CRC or holds impossible values, and the
+// device then boots as if nothing was stored. No Arduino dependencies.
+
+#define SESSION_MAGIC 0x4E534553u   // "SESN"
+#define SESSION_LAYOUT 1
+#define SESSION_BLOB_MAX (20 + CHECKIN_EVENT_ID_MAX + ATT_EVENT_NAME_MAX + 4)
+
+struct SessionState {
+  bool attendanceMode;
+  char eventId[CHECKIN_EVENT_ID_MAX + 1];   // Empty if no event loaded
+  char eventName[ATT_EVENT_NAME_MAX + 1];
+  uint32_t rosterVersion;                   // Version of the stored roster snapshot
+  uint32_t journalNext;                     // CheckinLog::nextSequence()
+  uint32_t journalTail;                     // CheckinLog::oldestSequence()
+};
+
+// Returns the blob length (at most SESSION_BLOB_MAX)
+size_t encodeSession(const SessionState& state, uint8_t* out);
+
+bool decodeSession(const uint8_t* blob, size_t len, SessionState& state);
+
+#endif // SESSION_STATE_H
@@ -0,0 +1,19 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include "session_state.h"
+
+// ==========================================
+// SESSION STORE (NVS)
+// ==========================================
+//
+// SessionState in NVS (Preferences namespace SESSION_NVS_NAMESPACE). A
+// save that would write the same bytes again is skipped, so calling
+// saveSession() often does not wear the flash.
+
+// False (and state cleared) if nothing valid is stored
+bool loadSession(SessionState& state);
+
+void saveSession(const SessionState& state);
+
+#endif // SESSION_STORE_H
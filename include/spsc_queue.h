@@ -0,0 +1,59 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+// ==========================================
+// LOCK-FREE SINGLE-PRODUCER / SINGLE-CONSUMER RING
+// ==========================================
+//
+// Exactly one task may call push() and exactly one (other) task may call
+// pop(). Indices are free-running counters; only the producer writes head
+// and only the consumer writes tail, so no lock or critical section is
+// needed. Capacity must be a power of two.
+
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+  SpscQueue() : head(0), tail(0) {}
+
+  // Producer side. Returns false if the queue is full.
+  bool push(const T& item) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+    slots[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if the queue is empty.
+  bool pop(T& out) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    out = slots[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called from a third task
+  size_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+  static size_t capacity() { return N; }
+
+private:
+  T slots[N];
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,41 @@
+#ifndef TAP_METRICS_H
+#define TAP_METRICS_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "latency_histogram.h"
+
+// ==========================================
+// TAP PATH METRICS
+// ==========================================
+//
+// One latency histogram per stage of a tap, from card select to the
+// result on screen. Stages are timed where they happen (reader, API
+// client, JSON, OLED, controller) and recorded here. The report goes out
+// as Prometheus text on /metrics (metrics_server.h) and as a table on the
+// serial console ('s' command).
+
+enum TapStage {
+  STAGE_PICC_SELECT,      // Anticollision + select, UID read from the card
+  STAGE_UID_FORMAT,       // UID bytes to text for the request body
+  STAGE_HTTP_CONNECT,     // New plain TCP connection to the API
+  STAGE_TLS_CONNECT,      // New TLS connection (TCP + handshake)
+  STAGE_HTTP_REQUEST,     // Request sent to response headers received
+  STAGE_RESPONSE_PARSE,   // Check-in response body read and parsed
+  STAGE_OLED_FLUSH,       // Changed pages sent to the panel (display task)
+  STAGE_TAP_TO_SCREEN,    // Card detected to result shown (end to end)
+  STAGE_COUNT
+};
+
+void recordStage(TapStage stage, uint32_t us);
+const LatencyHistogram& stageHistogram(TapStage stage);
+const char* stageName(TapStage stage);
+void resetTapMetrics();
+
+// Prometheus text exposition format (histograms + p50/p95/p99 gauges)
+void writePrometheusMetrics(HalLog& out);
+
+// Human-readable table for the serial console
+void printTapMetrics(HalLog& out);
+
+#endif // TAP_METRICS_H
@@ -0,0 +1,53 @@
+#ifndef UI_SCHEDULER_H
+#define UI_SCHEDULER_H
+
+#include <stdint.h>
+#include "hal.h"
+
+// ==========================================
+// UI / FEEDBACK SCHEDULER
+// ==========================================
+//
+// Timed screens and buzzer patterns without blocking the main loop. A
+// result screen is held until a deadline instead of delay()ing over it,
+// so cards and buttons keep being read; anything new simply replaces the
+// screen. Buzzer patterns are steps that switch the buzzer on and off at
+// deadlines. Both are advanced by poll(), called on every loop pass.
+
+#define UI_PATTERN_MAX 8
+
+class UiScheduler {
+public:
+  explicit UiScheduler(HalBuzzer& buzzer);
+
+  // Keep the screen just drawn for ms; poll() reports when it is over
+  void holdScreen(uint32_t nowMs, uint32_t ms);
+  // A screen without a timeout replaced the held one
+  void releaseScreen();
+  bool screenHeld() const { return holding; }
+  uint32_t heldForMs(uint32_t nowMs) const { return nowMs - heldSince; }
+
+  // Alternating on/off durations in ms, starting with on. Replaces any
+  // pattern still playing.
+  void playBuzzer(uint32_t nowMs, const uint16_t* steps, uint8_t count);
+
+  // Advance the buzzer. Returns true once when the held screen expires.
+  bool poll(uint32_t nowMs);
+
+  // Time until poll() has something to do, at most maxWaitMs
+  uint32_t msUntilNext(uint32_t nowMs, uint32_t maxWaitMs) const;
+
+private:
+  HalBuzzer& buzzer;
+
+  bool holding;
+  uint32_t heldSince;
+  uint32_t screenDeadline;
+
+  uint16_t pattern[UI_PATTERN_MAX];
+  uint8_t patternSteps;
+  uint8_t patternStep;      // Step playing now (== patternSteps when idle)
+  uint32_t stepDeadline;
+};
+
+#endif // UI_SCHEDULER_H
@@ -0,0 +1,68 @@
+#ifndef UID_CACHE_H
+#define UID_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "card_uid.h"
+
+// ==========================================
+// RECENT CARD CACHE
+// ==========================================
+//
+// The last UID_CACHE_ENTRIES cards let through, each with the time it was
+// seen. A card seen again inside the window is a duplicate and is dropped
+// before anything else happens (no beep, no roster lookup, no request).
+// This covers a card slid across two antennas and students taking turns
+// at one reader, which a single "last card" cooldown does not.
+//
+// Entries sit in a ring in the order they were let through; the oldest
+// is replaced when the ring is full. An open-addressing table (linear
+// probing) maps a UID to its ring slot, so a lookup is a hash and one or
+// two compares. Fixed size, no heap, no Arduino dependencies.
+
+#define UID_CACHE_ENTRIES 16   // Cards remembered (at most)
+#define UID_CACHE_BUCKETS 32   // Hash table size (power of two, > entries)
+
+class UidCache {
+  static_assert((UID_CACHE_BUCKETS & (UID_CACHE_BUCKETS - 1)) == 0, "UID_CACHE_BUCKETS must be a power of two");
+  static_assert(UID_CACHE_BUCKETS > UID_CACHE_ENTRIES, "UID_CACHE_BUCKETS must exceed UID_CACHE_ENTRIES");
+
+public:
+  explicit UidCache(uint32_t windowMs);
+
+  // True if uid was let through less than windowMs ago (a hit). Otherwise
+  // remembers it as seen at nowMs and returns false.
+  bool seenRecently(const CardUid& uid, uint32_t nowMs);
+
+  // Forget uid, so its next tap is let through (this one was turned away)
+  void forget(const CardUid& uid);
+
+  // Forget every card (new event, mode change)
+  void clear();
+
+  uint32_t hits() const { return hitCount; }
+  uint32_t misses() const { return missCount; }
+  uint8_t size() const;
+
+private:
+  struct Entry {
+    CardUid uid;
+    uint32_t seenMs;
+    uint8_t home;     // Bucket the UID hashes to
+    bool live;
+  };
+
+  static uint8_t hash(const CardUid& uid);
+  int find(const CardUid& uid, uint8_t home) const;   // Bucket index or -1
+  void removeBucket(size_t bucket);
+  void append(const CardUid& uid, uint8_t home, uint32_t nowMs);
+
+  Entry ring[UID_CACHE_ENTRIES];
+  uint8_t buckets[UID_CACHE_BUCKETS];   // Ring index + 1, 0 = empty
+  uint8_t head;                         // Next ring slot to fill
+  uint32_t windowMs;
+  uint32_t hitCount;
+  uint32_t missCount;
+};
+
+#endif // UID_CACHE_H
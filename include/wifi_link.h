@@ -0,0 +1,37 @@
+#ifndef WIFI_LINK_H
+#define WIFI_LINK_H
+
+#include "hal.h"
+#include "ui_scheduler.h"
+
+// ==========================================
+// WIFI LINK
+// ==========================================
+//
+// The WifiSupervisor on the Arduino Wi-Fi driver, run by its own task:
+// Wi-Fi events come in through a queue, and joins, reconnects, backoff
+// and roaming happen there, never on the loop or network task. Everyone
+// else reads wifiLinkUp(), which does not block.
+//
+// Association starts in startWiFi() and runs beside the rest of setup();
+// taps go to the offline journal until the link is up. The AP joined
+// last (BSSID and channel, in NVS) is tried first, which skips the scan;
+// WIFI_STATIC_IP skips DHCP as well.
+//
+// With no stored network, or none joined within WIFI_CONNECT_TIMEOUT,
+// the WiFiManager setup portal opens - non-blocking, so cards are still
+// read and journaled while staff configure the network.
+
+// Start joining the stored networks and the supervisor task; returns at once
+void startWiFi();
+
+// Link state as the supervisor sees it; safe from any task
+bool wifiLinkUp();
+
+// Once per loop pass (loop task). Shows the setup screen while the
+// portal is open, and returns true on the pass the link comes up.
+bool pollWiFi(HalDisplay& display, UiScheduler& ui);
+
+void printWifiStats();
+
+#endif // WIFI_LINK_H
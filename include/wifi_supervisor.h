@@ -0,0 +1,142 @@
+#ifndef WIFI_SUPERVISOR_H
+#define WIFI_SUPERVISOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+
+// ==========================================
+// WIFI SUPERVISOR
+// ==========================================
+//
+// Keeps the station on the best known AP. Joins go to the strongest AP
+// of any configured network found by a scan (or straight to a remembered
+// one, no scan). A failed join backs off exponentially, with jitter so a
+// room full of devices does not retry in step after the AP reboots. A
+// dropped link is rejoined at once on the same AP. While online a weak
+// signal triggers an occasional scan, and a clearly stronger AP is roamed
+// to.
+//
+// The radio is behind WifiDriver and events come in through onEvent(),
+// so the policy runs on a host against a fake driver. One task calls
+// everything except linkUp(), which any task may read.
+
+#define WIFI_SSID_MAX 32
+#define WIFI_PASS_MAX 64
+
+struct WifiNetwork {
+  char ssid[WIFI_SSID_MAX + 1];
+  char pass[WIFI_PASS_MAX + 1];
+};
+
+// One AP of a network; channel 0 = not pinned, the driver finds it
+struct WifiAp {
+  char ssid[WIFI_SSID_MAX + 1];
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t rssi;
+};
+
+enum LinkEvent {
+  LINK_EV_UP,             // Associated and addressed
+  LINK_EV_DOWN,           // Link lost, or a join failed
+  LINK_EV_SCAN_DONE
+};
+
+enum LinkState {
+  LINK_IDLE,              // Nothing configured, or paused (setup portal)
+  LINK_SCANNING,          // Looking for the strongest known AP
+  LINK_JOINING,
+  LINK_ONLINE,
+  LINK_BACKOFF            // Waiting to retry after a failed join
+};
+
+class WifiDriver {
+public:
+  virtual ~WifiDriver() {}
+  // Join net. ap pins BSSID and channel when ap->channel != 0.
+  virtual void connect(const WifiNetwork& net, const WifiAp* ap) = 0;
+  virtual void disconnect() = 0;
+  // Background scan; LINK_EV_SCAN_DONE follows. False if it could not start.
+  virtual bool startScan() = 0;
+  // After LINK_EV_SCAN_DONE: up to max APs heard
+  virtual size_t scanResults(WifiAp* out, size_t max) = 0;
+  // The AP currently joined (with its RSSI); false if none
+  virtual bool currentAp(WifiAp& out) = 0;
+};
+
+struct WifiStats {
+  uint32_t joins;         // Times the link came up
+  uint32_t drops;         // Times it went down while online
+  uint32_t attempts;      // Joins started
+  uint32_t failures;      // Joins that failed or timed out
+  uint32_t scans;
+  uint32_t roams;
+  uint32_t downMs;        // Offline time after the first join (closed outages)
+  uint32_t lastBackoffMs;
+};
+
+class WifiSupervisor {
+public:
+  WifiSupervisor(WifiDriver& driver, uint32_t seed);
+
+  // Reseed the backoff jitter, e.g. once the radio feeds the RNG
+  void seed(uint32_t value) { rng = value ? value : 1; }
+
+  // Networks to join, in preference order for joins without a scan.
+  // False if the list is full or ssid is empty.
+  bool addNetwork(const char* ssid, const char* pass);
+  void clearNetworks();
+  uint8_t networkCount() const { return count; }
+
+  // Start joining. hint is the AP joined last (tried first, no scan);
+  // may be NULL.
+  void begin(uint32_t nowMs, const WifiAp* hint);
+
+  // Stop joining (something else owns the radio). A link that comes up
+  // meanwhile is still taken. begin() starts again.
+  void pause();
+
+  void onEvent(LinkEvent event, uint32_t nowMs);
+
+  // Timeouts, backoff, signal checks. Returns how long until poll() has
+  // something to do.
+  uint32_t poll(uint32_t nowMs);
+
+  bool linkUp() const { return up.load(std::memory_order_acquire); }
+  LinkState state() const { return current; }
+  const WifiAp& ap() const { return joined; }
+  const WifiStats& stats() const { return st; }
+
+private:
+  void join(uint32_t nowMs, const WifiAp& target, uint32_t timeoutMs);
+  void scan(uint32_t nowMs);
+  void failed(uint32_t nowMs);
+  void setUp(bool linkIsUp, uint32_t nowMs);
+  void onScanDone(uint32_t nowMs);
+  bool strongestKnown(WifiAp& out);
+  int networkOf(const char* ssid) const;
+  uint32_t backoffMs();
+  uint32_t nextRandom();
+
+  WifiDriver& driver;
+  WifiNetwork networks[WIFI_NETWORKS_MAX];
+  uint8_t count;
+  uint8_t nextBlind;          // Round robin for joins without scan results
+
+  LinkState current;
+  std::atomic<bool> up;
+  bool everUp;
+  bool roamScan;              // Scan in progress while online
+  bool dropExpected;          // We left the old AP for a new one
+  WifiAp joined;              // AP of the link (or being joined)
+  uint32_t deadline;          // Join/scan timeout, end of backoff, next signal check
+  uint32_t lastRoamScan;
+  uint32_t downSince;
+  uint8_t failStreak;
+  uint32_t rng;
+  WifiStats st;
+};
+
+#endif // WIFI_SUPERVISOR_H
@@ -0,0 +1,334 @@
+#include "api_client.h"
+#include "hal_esp32.h"
+#include "wifi_link.h"
+#include "memory_monitor.h"
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+
+// ==========================================
+// CONNECTION STATE
+// ==========================================
+
+static WiFiClientSecure tlsClient;
+static WiFiClient plainClient;
+static HTTPClient sharedHttp;
+static SemaphoreHandle_t connectionMutex = NULL;
+
+static String apiHost;
+static uint16_t apiPort = 443;
+static bool apiSecure = true;
+
+// The socket under ApiConnection: WiFiClientSecure (or plain WiFiClient
+// for an http:// API_URL) with HTTPClient on top
+class EspApiTransport : public ApiTransport {
+public:
+  bool connected() override;
+  bool connect() override;
+  void close() override;
+};
+
+static EspApiTransport transport;
+static EspClock apiClock;
+static SerialLog apiLog;
+static ApiConnection connection(transport, apiClock, apiLog, wifiLinkUp);
+
+// ==========================================
+// INITIALIZATION
+// ==========================================
+
+void initApiClient() {
+  // Split API_URL into scheme, host and port once
+  String url = API_URL;
+  apiSecure = url.startsWith("https://");
+  url = url.substring(url.indexOf("//") + 2);
+
+  int slash = url.indexOf('/');
+  if (slash >= 0) {
+    url = url.substring(0, slash);
+  }
+
+  int colon = url.indexOf(':');
+  if (colon >= 0) {
+    apiHost = url.substring(0, colon);
+    apiPort = url.substring(colon + 1).toInt();
+  } else {
+    apiHost = url;
+    apiPort = apiSecure ? 443 : 80;
+  }
+
+  // No CA pinned, same as the per-request clients this replaces
+  tlsClient.setInsecure();
+  tlsClient.setHandshakeTimeout(API_TIMEOUT / 1000);
+
+  sharedHttp.setReuse(true);
+  sharedHttp.setTimeout(API_TIMEOUT);
+
+  connectionMutex = xSemaphoreCreateMutex();
+  connection.begin(apiSecure);
+
+  Serial.println("✓ API client ready: " + apiHost + ":" + String(apiPort) + (apiSecure ? " (TLS)" : ""));
+}
+
+static WiFiClient& activeClient() {
+  if (apiSecure) {
+    return tlsClient;
+  }
+  return plainClient;
+}
+
+bool EspApiTransport::connected() {
+  return activeClient().connected();
+}
+
+// Close the socket (and free a TLS session's buffers)
+void EspApiTransport::close() {
+  MemScope heap(memoryWatch(), MEM_TAG_NETWORK);
+  sharedHttp.end();
+  activeClient().stop();
+  memoryWatch().tlsClosed();
+}
+
+bool EspApiTransport::connect() {
+  // A handshake that cannot get its buffers fails anyway, after churning
+  // the heap; the journal keeps the taps until there is room
+  if (apiSecure && !memoryWatch().tlsFits()) {
+    Serial.println("✗ API connect skipped: not enough contiguous heap for TLS");
+    return false;
+  }
+
+  MemScope heap(memoryWatch(), MEM_TAG_NETWORK);
+  if (!activeClient().connect(apiHost.c_str(), apiPort)) {
+    Serial.println("✗ API connect failed: " + apiHost);
+    return false;
+  }
+  if (apiSecure) {
+    memoryWatch().tlsOpened(heap.taken());
+  }
+  return true;
+}
+
+// ==========================================
+// RESPONSE BODY STREAM
+// ==========================================
+
+void ApiBodyStream::begin(Stream* source, int contentLength, bool isChunked) {
+  client = source;
+  chunked = isChunked;
+  remaining = chunked ? 0 : contentLength;
+  done = !chunked && contentLength == 0;
+  firstChunk = true;
+}
+
+bool ApiBodyStream::readLine(char* line, size_t size) {
+  size_t len = 0;
+  uint8_t c;
+  while (client->readBytes(&c, 1) == 1) {
+    if (c == '\n') {
+      line[len] = '\0';
+      return true;
+    }
+    if (c != '\r' && len + 1 < size) {
+      line[len++] = (char)c;
+    }
+  }
+  return false;
+}
+
+// Step over "\r\n<hex size>[;ext]\r\n"; the last chunk (size 0) is followed
+// by optional trailers and an empty line.
+bool ApiBodyStream::nextChunk() {
+  if (!chunked) {
+    done = true;
+    return false;
+  }
+
+  char line[32];
+  if (!firstChunk && !readLine(line, sizeof(line))) {
+    done = true;
+    return false;
+  }
+  firstChunk = false;
+
+  if (!readLine(line, sizeof(line))) {
+    done = true;
+    return false;
+  }
+  remaining = (int32_t)strtol(line, NULL, 16);
+
+  if (remaining <= 0) {
+    while (readLine(line, sizeof(line)) && line[0] != '\0') {
+      // Trailer headers - ignored
+    }
+    remaining = 0;
+    done = true;
+    return false;
+  }
+  return true;
+}
+
+int ApiBodyStream::available() {
+  if (done) {
+    return 0;
+  }
+  int avail = client->available();
+  if (remaining > 0 && avail > remaining) {
+    return remaining;
+  }
+  return remaining == 0 ? (avail > 0 ? 1 : 0) : avail;
+}
+
+int ApiBodyStream::read() {
+  if (done || (remaining == 0 && !nextChunk())) {
+    return -1;
+  }
+  uint8_t c;
+  if (client->readBytes(&c, 1) != 1) {
+    done = true;
+    return -1;
+  }
+  if (remaining > 0) {
+    remaining--;
+  }
+  return c;
+}
+
+int ApiBodyStream::peek() {
+  if (done || (remaining == 0 && !nextChunk())) {
+    return -1;
+  }
+  return client->peek();
+}
+
+void ApiBodyStream::drain() {
+  uint8_t scratch[64];
+  while (!done) {
+    if (remaining == 0 && !nextChunk()) {
+      break;
+    }
+    if (remaining < 0) {
+      // No length: take what has arrived, the server closes after it
+      while (client->available() > 0) {
+        client->read();
+      }
+      done = true;
+      break;
+    }
+    size_t want = remaining < (int32_t)sizeof(scratch) ? remaining : sizeof(scratch);
+    size_t got = client->readBytes(scratch, want);
+    if (got == 0) {
+      done = true;
+      break;
+    }
+    remaining -= got;
+  }
+}
+
+// ==========================================
+// API REQUEST
+// ==========================================
+
+ApiRequest::ApiRequest(const char* endpoint, uint32_t waitMs)
+  : endpoint(endpoint), owner(false), method(NULL), payload(NULL), payloadLen(0), headerKeyCount(0),
+    bodyStarted(false), headerCount(0) {
+  TickType_t wait = waitMs == API_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(waitMs);
+  owner = xSemaphoreTake(connectionMutex, wait) == pdTRUE;
+  // Needed to tell a chunked body from a sized one
+  headerKeys[headerKeyCount++] = "Transfer-Encoding";
+}
+
+ApiRequest::~ApiRequest() {
+  if (!owner) {
+    return;
+  }
+  // Finish a body read in place so the next response starts cleanly
+  if (bodyStarted) {
+    bodyStream.drain();
+  }
+  // Keeps the socket open if the server allows it
+  sharedHttp.end();
+  xSemaphoreGive(connectionMutex);
+}
+
+void ApiRequest::collectHeaders(const char* keys[], size_t count) {
+  for (size_t i = 0; i < count && headerKeyCount <= API_MAX_COLLECT_HEADERS; i++) {
+    headerKeys[headerKeyCount++] = keys[i];
+  }
+}
+
+void ApiRequest::addHeader(const char* name, const String& value) {
+  if (headerCount < API_MAX_EXTRA_HEADERS) {
+    headerNames[headerCount] = name;
+    headerValues[headerCount] = value;
+    headerCount++;
+  }
+}
+
+int ApiRequest::GET() {
+  return send("GET", NULL, 0);
+}
+
+int ApiRequest::POST(const String& body) {
+  return send("POST", (const uint8_t*)body.c_str(), body.length());
+}
+
+int ApiRequest::POST(const uint8_t* body, size_t len) {
+  return send("POST", body, len);
+}
+
+Stream& ApiRequest::body() {
+  if (!bodyStarted) {
+    bodyStarted = true;
+    bool chunked = sharedHttp.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+    bodyStream.begin(&activeClient(), sharedHttp.getSize(), chunked);
+  }
+  return bodyStream;
+}
+
+HTTPClient& ApiRequest::http() {
+  return sharedHttp;
+}
+
+int ApiRequest::send(const char* requestMethod, const uint8_t* body, size_t len) {
+  if (!owner) {
+    Serial.println("✗ API connection busy - " + String(endpoint) + " not sent");
+    return API_ERROR_BUSY;
+  }
+  method = requestMethod;
+  payload = body;
+  payloadLen = len;
+  return connection.send(exchange, this);
+}
+
+// One attempt on the open connection (ApiConnection may call it twice)
+int ApiRequest::exchange(void* request) {
+  ApiRequest& req = *(ApiRequest*)request;
+
+  sharedHttp.begin(activeClient(), apiHost.c_str(), apiPort, req.endpoint, apiSecure);
+  sharedHttp.collectHeaders(req.headerKeys, req.headerKeyCount);
+  sharedHttp.addHeader("x-device-api-key", DEVICE_API_KEY);
+  for (uint8_t i = 0; i < req.headerCount; i++) {
+    sharedHttp.addHeader(req.headerNames[i], req.headerValues[i]);
+  }
+  return sharedHttp.sendRequest(req.method, (uint8_t*)req.payload, req.payloadLen);
+}
+
+// ==========================================
+// STATS
+// ==========================================
+
+ApiStats getApiStats() {
+  return connection.stats();
+}
+
+void printApiStats() {
+  const ApiStats& stats = connection.stats();
+  Serial.println("API connection stats:");
+  Serial.println("  Requests: " + String(stats.requests) + " (" + String(stats.failures) + " failed)");
+  Serial.println("  Handshakes: " + String(stats.handshakes) + ", stale retries: " + String(stats.staleRetries));
+  if (stats.handshakes > 0) {
+    Serial.println("  Handshake avg: " + String(stats.totalHandshakeMs / stats.handshakes) + "ms (last " + String(stats.lastHandshakeMs) + "ms)");
+  }
+  if (stats.requests > 0) {
+    Serial.println("  Request avg: " + String(stats.totalRequestMs / stats.requests) + "ms (last " + String(stats.lastRequestMs) + "ms)");
+  }
+}
@@ -0,0 +1,89 @@
+#include "api_connection.h"
+#include "tap_metrics.h"
+#include <string.h>
+
+ApiConnection::ApiConnection(ApiTransport& transport, HalClock& clock, HalLog& log, ApiLinkFn linkUp)
+  : transport(transport), clock(clock), log(log), linkUp(linkUp), secure(true) {
+  memset(&st, 0, sizeof(st));
+}
+
+void ApiConnection::begin(bool isSecure) {
+  secure = isSecure;
+  memset(&st, 0, sizeof(st));
+}
+
+// Open the connection if it is not already warm. Returns false on failure;
+// 'reused' tells the caller whether a stale socket is a possible cause.
+bool ApiConnection::ensureConnected(bool& reused) {
+  if (transport.connected()) {
+    reused = true;
+    return true;
+  }
+
+  reused = false;
+  transport.close();
+
+  uint32_t start = clock.micros();
+  if (!transport.connect()) {
+    return false;
+  }
+
+  // WiFiClientSecure connects and handshakes in one call, so a TLS
+  // connection is timed as a whole
+  uint32_t connectUs = clock.micros() - start;
+  recordStage(secure ? STAGE_TLS_CONNECT : STAGE_HTTP_CONNECT, connectUs);
+
+  st.handshakes++;
+  st.lastHandshakeMs = connectUs / 1000;
+  st.totalHandshakeMs += st.lastHandshakeMs;
+  log.printf("API connection opened in %lums\n", (unsigned long)st.lastHandshakeMs);
+  return true;
+}
+
+// Errors that mean a dead socket rather than a slow or failing server:
+// the request did not get out, or the peer had closed before answering
+static bool staleSocketError(int httpCode) {
+  return httpCode == API_ERROR_SEND_HEADER_FAILED || httpCode == API_ERROR_SEND_PAYLOAD_FAILED ||
+         httpCode == API_ERROR_NOT_CONNECTED || httpCode == API_ERROR_CONNECTION_LOST;
+}
+
+int ApiConnection::send(ApiExchangeFn exchange, void* request) {
+  if (!linkUp()) {
+    st.failures++;
+    return API_ERROR_CONNECTION_REFUSED;
+  }
+
+  int httpCode = API_ERROR_CONNECTION_REFUSED;
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    bool reused;
+    if (!ensureConnected(reused)) {
+      break;
+    }
+
+    uint32_t start = clock.micros();
+    httpCode = exchange(request);
+
+    if (httpCode > 0) {
+      uint32_t requestUs = clock.micros() - start;
+      recordStage(STAGE_HTTP_REQUEST, requestUs);
+      st.requests++;
+      st.lastRequestMs = requestUs / 1000;
+      st.totalRequestMs += st.lastRequestMs;
+      return httpCode;
+    }
+
+    if (!reused || !staleSocketError(httpCode)) {
+      break;
+    }
+
+    // Server closed the idle connection under us - reconnect and resend once
+    log.println("API connection went stale, reconnecting");
+    st.staleRetries++;
+    transport.close();
+  }
+
+  st.failures++;
+  transport.close();
+  return httpCode;
+}
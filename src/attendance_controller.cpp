@@ -0,0 +1,358 @@
+#include "attendance_controller.h"
+#include "screens.h"
+#include "tap_metrics.h"
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+
+// Tap already answered on screen from the roster; the server result is
+// only a background confirmation
+#define TAP_SHOWN_LOCALLY 1
+
+AttendanceController::AttendanceController(CheckinDispatcher& dispatcher, Roster& roster,
+                                           AttendanceBackend& backend, HalDisplay& display,
+                                           HalClock& clock, UiScheduler& ui, HalLog& log)
+  : dispatcher(dispatcher), roster(roster), backend(backend), display(display), clock(clock), ui(ui), log(log),
+    currentState(ATT_NO_EVENT), checkinsInFlight(0), scrollStep(0), changes(0) {
+  activeEventId[0] = '\0';
+  activeEventName[0] = '\0';
+}
+
+// ==========================================
+// INITIALIZATION
+// ==========================================
+
+void AttendanceController::begin() {
+  currentState = ATT_NO_EVENT;
+  activeEventId[0] = '\0';
+  activeEventName[0] = '\0';
+  scrollStep = 0;
+  changes++;
+  // Whatever the server has running is picked up without a button press
+  backend.refreshEvent();
+  log.println("\n========================================");
+  log.println("ATTENDANCE MODE INITIALIZED");
+  log.println("========================================");
+}
+
+void AttendanceController::resume(const char* eventId, const char* eventName) {
+  begin();
+  snprintf(activeEventId, sizeof(activeEventId), "%s", eventId);
+  snprintf(activeEventName, sizeof(activeEventName), "%s", eventName);
+  backend.syncRoster(activeEventId);
+  changes++;
+  currentState = ATT_READY;
+  showReady();
+  log.printf("✓ Resumed event: %s\n", activeEventName);
+}
+
+void AttendanceController::showReady() {
+  // A name too long for the line scrolls; the next step comes as a screen timeout
+  if (displayAttendanceReady(display, activeEventName, scrollStep)) {
+    scrollStep++;
+    ui.holdScreen(clock.millis(), TEXT_SCROLL_INTERVAL);
+  }
+}
+
+// ==========================================
+// TAPS
+// ==========================================
+
+// End of the tap path: the answer is on the panel
+void AttendanceController::resultShown(uint32_t tappedUs) {
+  recordStage(STAGE_TAP_TO_SCREEN, clock.micros() - tappedUs);
+}
+
+bool AttendanceController::onTap(const CardUid& cardUid, uint8_t reader, uint32_t tappedUs) {
+  // Accept cards while earlier check-ins are still in flight
+  bool accepting = currentState == ATT_READY || currentState == ATT_CHECKING_IN;
+
+  if (!accepting || cardUid.empty()) {
+    return false;
+  }
+
+  // Whatever comes next replaces the ready screen
+  scrollStep = 0;
+
+  // Answer from the roster when we can - no network round trip. While it
+  // is being synced, or still holds another event, the server decides.
+  if (backend.acquireRoster(activeEventId)) {
+    RosterEntry* entry = roster.find(cardUid.data(), cardUid.size());
+    bool accepted = entry && answerFromRoster(*entry, cardUid, reader, tappedUs);
+    backend.releaseRoster();
+    if (entry) {
+      return accepted;
+    }
+  }
+
+  // The answer replaces whatever screen is up, held or not
+  uint32_t now = clock.millis();
+
+  // Not in the roster (or none loaded) - the server decides
+  if (!submit(cardUid, reader, tappedUs)) {
+    displayAttendanceError(display, "Busy, tap again");
+    ui.holdScreen(now, CHECKIN_ERROR_DISPLAY);
+    return false;
+  }
+
+  checkinsInFlight++;
+  currentState = ATT_CHECKING_IN;
+  displayCheckingIn(display, cardUid);
+  ui.releaseScreen();
+  return true;
+}
+
+// With the roster held. Returns false if the tap was turned away.
+bool AttendanceController::answerFromRoster(RosterEntry& entry, const CardUid& cardUid, uint8_t reader,
+                                            uint32_t tappedUs) {
+  // The answer replaces whatever screen is up, held or not
+  uint32_t now = clock.millis();
+
+  if (!(entry.flags & ROSTER_ALLOWED)) {
+    log.println("✗ Not registered for this event (roster)");
+    displayAttendanceError(display, "Not registered");
+    resultShown(tappedUs);
+    ui.holdScreen(now, CHECKIN_ERROR_DISPLAY);
+  } else if (entry.flags & ROSTER_CHECKED_IN) {
+    log.println("⚠️ Already checked in (roster)");
+    displayAttendanceError(display, "Already checked in");
+    resultShown(tappedUs);
+    ui.holdScreen(now, CHECKIN_ERROR_DISPLAY);
+  } else if (!submit(cardUid, reader, tappedUs, TAP_SHOWN_LOCALLY)) {
+    displayAttendanceError(display, "Busy, tap again");
+    ui.holdScreen(now, CHECKIN_ERROR_DISPLAY);
+    return false;
+  } else {
+    // Journaled; the network task confirms it with the server later
+    entry.flags |= ROSTER_CHECKED_IN;
+    log.printf("✅ CHECK-IN (roster): %s\n", roster.nameOf(entry));
+    displayWelcome(display, roster.nameOf(entry));
+    resultShown(tappedUs);
+    ui.holdScreen(now, CHECKIN_SUCCESS_DISPLAY);
+  }
+  return true;
+}
+
+bool AttendanceController::submit(const CardUid& cardUid, uint8_t reader, uint32_t tappedUs, uint8_t tag) {
+  if (activeEventId[0] == '\0') {
+    log.println("✗ No active event!");
+    return false;
+  }
+
+  if (!backend.journalReady()) {
+    log.println("✗ Check-in journal unavailable!");
+    return false;
+  }
+
+  // Snapshot the event now - it may be cleared before the tap is processed
+  TapRequest tap = {};
+  tap.timestamp = backend.timestamp();
+  tap.tag = tag;
+  tap.tappedUs = tappedUs;
+  tap.uid = cardUid;
+  tap.reader = reader;
+  strncpy(tap.eventId, activeEventId, CHECKIN_EVENT_ID_MAX);
+
+  if (!dispatcher.submit(tap)) {
+    log.println("✗ Tap queue full!");
+    return false;
+  }
+
+  backend.tapSubmitted();
+  return true;
+}
+
+void AttendanceController::pollResults() {
+  // Give the result on screen a moment before the next queued one replaces it
+  uint32_t now = clock.millis();
+  if (ui.screenHeld() && ui.heldForMs(now) < UI_RESULT_MIN_DISPLAY) {
+    return;
+  }
+
+  TapResult res;
+  if (!dispatcher.takeResult(res)) {
+    return;
+  }
+
+  if (res.tag == TAP_SHOWN_LOCALLY) {
+    // Screen already showed the roster answer - just report disagreements
+    if (res.result == CHECKIN_FAILED) {
+      log.printf("✗ Server rejected check-in #%u accepted from roster\n", (unsigned)res.seq);
+    }
+    return;
+  }
+
+  if (checkinsInFlight > 0) {
+    checkinsInFlight--;
+  }
+  scrollStep = 0;
+
+  switch (res.result) {
+    case CHECKIN_OK:
+      log.printf("✅ CHECK-IN SUCCESS! Student: %s\n", res.studentName);
+      displayWelcome(display, res.studentName);
+      resultShown(res.tappedUs);
+      ui.holdScreen(now, CHECKIN_SUCCESS_DISPLAY);
+      break;
+    case CHECKIN_QUEUED:
+      // Tap is safe in the journal - confirm now, sync later
+      log.printf("⚠️ Check-in #%u queued (%u pending)\n", (unsigned)res.seq, (unsigned)res.pending);
+      displaySavedOffline(display, res.pending);
+      resultShown(res.tappedUs);
+      ui.holdScreen(now, CHECKIN_SUCCESS_DISPLAY);
+      break;
+    case CHECKIN_DUPLICATE:
+      log.println("⚠️ Already checked in!");
+      displayAttendanceError(display, "Already checked in");
+      resultShown(res.tappedUs);
+      ui.holdScreen(now, CHECKIN_ERROR_DISPLAY);
+      break;
+    default:
+      log.println("✗ Check-in failed");
+      displayAttendanceError(display, "Check-in failed");
+      resultShown(res.tappedUs);
+      ui.holdScreen(now, CHECKIN_ERROR_DISPLAY);
+      break;
+  }
+
+  // Ready again once nothing is outstanding; the screen follows on timeout
+  if (checkinsInFlight == 0 && currentState == ATT_CHECKING_IN) {
+    currentState = ATT_READY;
+  }
+}
+
+void AttendanceController::onScreenTimeout() {
+  // Still waiting on the server: leave the last screen up until its result
+  if (currentState == ATT_READY) {
+    showReady();
+  } else if (currentState == ATT_NO_EVENT) {
+    displayNoEvent(display);
+  }
+}
+
+// ==========================================
+// EVENT CHANGES
+// ==========================================
+
+bool AttendanceController::pollEventChange() {
+  ActiveEvent event;
+  if (!backend.takeEventChange(event)) {
+    return false;
+  }
+  if (currentState == ATT_FETCHING_EVENT || strcmp(event.id, activeEventId) == 0) {
+    return false;
+  }
+  if (event.id[0] == '\0') {
+    // The event ended on the server: no more check-ins for it. Taps
+    // already submitted still go out; their results are still shown.
+    log.println("No active event on the server - clearing");
+    clearEvent();
+    scrollStep = 0;
+    currentState = ATT_NO_EVENT;
+    if (!ui.screenHeld()) {
+      displayNoEvent(display);
+    }
+    return true;
+  }
+  log.printf("Active event is now %s - switching\n", event.name);
+  adoptEvent(event.id, event.name);
+  return true;
+}
+
+// Between taps, without waiting on the network: the next tap already
+// goes to the new event, to the server until the backend has its roster
+// in. Check-ins already submitted keep the event they were tapped for,
+// and a result screen on the panel stays up; the ready screen follows it.
+void AttendanceController::adoptEvent(const char* id, const char* name) {
+  snprintf(activeEventId, sizeof(activeEventId), "%s", id);
+  snprintf(activeEventName, sizeof(activeEventName), "%s", name);
+  backend.syncRoster(activeEventId);
+  changes++;
+  scrollStep = 0;
+  if (currentState == ATT_NO_EVENT) {
+    currentState = ATT_READY;
+  }
+  if (!ui.screenHeld()) {
+    showReady();
+  }
+}
+
+// ==========================================
+// BUTTON HANDLING
+// ==========================================
+
+void AttendanceController::onFetchButton() {
+  // Fetch event from API (only when no event loaded)
+  if (currentState != ATT_NO_EVENT) {
+    log.println("Fetch button ignored - event already loaded");
+    return;
+  }
+
+  log.println("Fetch button pressed - getting active event");
+  ui.releaseScreen();
+  scrollStep = 0;
+  currentState = ATT_FETCHING_EVENT;
+  displayFetchingEvent(display);
+
+  if (backend.fetchActiveEvent(activeEventId, sizeof(activeEventId),
+                               activeEventName, sizeof(activeEventName))) {
+    backend.syncRoster(activeEventId);
+    changes++;
+    currentState = ATT_READY;
+    showReady();
+    log.println("Event loaded successfully");
+  } else {
+    activeEventId[0] = '\0';
+    activeEventName[0] = '\0';
+    currentState = ATT_NO_EVENT;
+    displayNoEvent(display);
+    log.println("No active event found");
+  }
+}
+
+void AttendanceController::onRefreshButton() {
+  if (currentState != ATT_READY && currentState != ATT_CHECKING_IN) {
+    log.println("Refresh ignored - no event loaded");
+    return;
+  }
+
+  char id[sizeof(activeEventId)];
+  char name[sizeof(activeEventName)];
+  if (!backend.fetchActiveEvent(id, sizeof(id), name, sizeof(name))) {
+    log.println("Refresh failed - keeping the current event");
+    return;
+  }
+
+  if (strcmp(id, activeEventId) == 0) {
+    backend.syncRoster(activeEventId);
+    changes++;
+    log.println("Event unchanged - syncing roster");
+    return;
+  }
+
+  ui.releaseScreen();
+  adoptEvent(id, name);
+  log.printf("Switched to event %s\n", activeEventId);
+}
+
+void AttendanceController::onClearButton() {
+  // Clear event only if we're in ready state
+  if (currentState == ATT_READY) {
+    log.println("Clear button pressed - removing event");
+    ui.releaseScreen();
+    scrollStep = 0;
+    clearEvent();
+    currentState = ATT_NO_EVENT;
+    displayNoEvent(display);
+  } else {
+    log.println("Clear button ignored - no event to clear");
+  }
+}
+
+void AttendanceController::clearEvent() {
+  activeEventId[0] = '\0';
+  activeEventName[0] = '\0';
+  backend.eventCleared();
+  changes++;
+  log.println("Event cleared from memory");
+}
@@ -1,329 +1,902 @@
 #include "attendance_mode.h"
+#include "checkin_log.h"
+#include "checkin_log_flash.h"
+#include "checkin_dispatcher.h"
+#include "checkin_wire.h"
+#include "event_poller.h"
+#include "api_client.h"
+#include "roster.h"
+#include "roster_sync.h"
+#include "json_arena.h"
+#include "api_json.h"
+#include "tap_metrics.h"
+#include "memory_monitor.h"
+#include "wifi_link.h"
+#include "hal_esp32.h"
 #include <WiFi.h>
+#include <LittleFS.h>
+#include <time.h>
 
 // ==========================================
 // STATE VARIABLES
 // ==========================================
 
-static AttendanceState currentState = ATT_NO_EVENT;
-static String activeEventId = "";
-static String activeEventName = "";
-static String lastCheckedInStudent = ""; // Store last check-in for display
-static int lastCheckInStatus = 0; // Store HTTP status code
+// Door names, indexed by reader (RC522_SS_PINS order)
+static const char* const doorNames[RC522_READER_COUNT] = RC522_DOOR_NAMES;
+
+// Attendee list of the active event. Loaded and synced by the network
+// task; the loop task looks taps up in it between syncs, under
+// rosterLock, and sends them to the server while a sync holds it.
+static Roster roster;
+static String rosterEventId = "";          // Event the roster holds (under rosterLock)
+static SemaphoreHandle_t rosterLock = NULL;
+
+// Loop task -> network task: the event to load and sync the roster of
+// ("" = drop it), and the version stored for it (for the session)
+static portMUX_TYPE rosterMux = portMUX_INITIALIZER_UNLOCKED;
+static char rosterWantedId[CHECKIN_EVENT_ID_MAX + 1] = "";
+static uint32_t rosterSavedVersion = 0;
+static std::atomic<bool> rosterSyncPending(false);
+
+// Roster version the session says the snapshot of this event should have
+static char sessionEventId[CHECKIN_EVENT_ID_MAX + 1] = "";
+static uint32_t sessionRosterVersion = 0;
+
+// Offline check-in journal + network worker
+static int postCheckIn(const CheckinRecord& rec, char* studentName, size_t nameSize);
+static int postCheckInBatch(const CheckinRecord* recs, size_t count, CheckinItemResult* results);
+static int postFrame(const CheckinRecord* recs, size_t count, uint32_t handle, CheckinItemResult* results);
+static bool frameRefused(int httpCode);
+static bool isLinkUp();
+static void networkTask(void* param);
+static bool loadRosterSnapshot(const char* eventId);
+static bool runRosterSync();
+static EventFetchResult pollActiveEvent(char* etag, size_t etagSize, ActiveEvent& event);
+static void noteRosterMemory();
+static void printRosterCounts();
+static bool rosterHeapOk();
+
+static LittleFsLogStorage checkinStorage;
+static CheckinLog checkinLog;
+static CheckinDispatcher dispatcher(checkinLog, postCheckIn, postCheckInBatch, isLinkUp);
+static TaskHandle_t netTaskHandle = NULL;
+static bool checkinLogReady = false;
+static EventPoller eventPoller(pollActiveEvent, isLinkUp, 1);   // Seeded in startWiFi()
+static SemaphoreHandle_t storageReady = NULL;   // Given by the boot task
+
+// JSON storage: one arena per task, used by one document at a time
+static JsonArena<JSON_DOC_CAPACITY> loopJsonArena;
+static JsonArena<JSON_BATCH_DOC_CAPACITY> netJsonArena;
+static char netPayload[JSON_BATCH_PAYLOAD_MAX];   // Also holds binary frames
+
+// Full-list items are parsed one at a time in the network task's arena
+static SerialLog rosterLog;
+static RosterSync rosterSync(roster, rosterLog, &netJsonArena);
+
+// Compact check-in frames: the handle the server gave the active event,
+// and whether it still takes frames. Written by the loop task (event
+// fetch) and the network task (refusals), read by the network task.
+static portMUX_TYPE wireMux = portMUX_INITIALIZER_UNLOCKED;
+static char wireEventId[CHECKIN_EVENT_ID_MAX + 1] = "";
+static uint32_t wireHandle = 0;
+static bool wireBinary = false;
+static bool wireNoEndpoint = false;   // 404/405 on a frame: no batch endpoint, until reboot
+
+// Response parsing with filters built once at boot
+static ApiJson apiJson;
 
 // ==========================================
 // INITIALIZATION
 // ==========================================
 
-void initAttendanceMode() {
-  currentState = ATT_NO_EVENT;
-  activeEventId = "";
-  activeEventName = "";
-  Serial.println("\n========================================");
-  Serial.println("ATTENDANCE MODE INITIALIZED");
-  Serial.println("========================================");
+static void initJsonFilters() {
+  apiJson.begin();
+  rosterSync.begin();
+}
+
+static bool initCheckinQueue(const SessionState& session) {
+  {
+    MemScope heap(memoryWatch(), MEM_TAG_JSON);
+    initJsonFilters();
+  }
+  roster.setGrowGuard(bulkBlockFits);
+  rosterSync.setMemoryGuard(rosterHeapOk);
+  rosterLock = xSemaphoreCreateMutex();
+  
+  snprintf(sessionEventId, sizeof(sessionEventId), "%s", session.eventId);
+  sessionRosterVersion = session.rosterVersion;
+  
+  Serial.println("\nInitializing check-in journal...");
+
+  if (!LittleFS.begin(true)) {
+    Serial.println("✗ LittleFS mount failed - check-ins will not survive reboot");
+    return false;
+  }
+
+  // The saved cursor spares reading every slot; it is checked against the slots
+  if (!checkinStorage.begin(CHECKIN_LOG_PATH, CHECKIN_LOG_CAPACITY * CHECKIN_SLOT_SIZE) ||
+      !checkinLog.begin(&checkinStorage, session.journalNext, session.journalTail)) {
+    Serial.println("✗ Check-in journal unavailable");
+    return false;
+  }
+
+  Serial.println("✓ Check-in journal ready");
+  Serial.println("  Pending: " + String(checkinLog.pendingCount()) + "/" + String(checkinLog.capacity()) +
+                 ", " + String(checkinLog.slotsScanned()) + " slots read");
+
+  // From here on only the network task touches the journal
+  if (xTaskCreatePinnedToCore(networkTask, "net", NET_TASK_STACK, NULL,
+                              NET_TASK_PRIORITY, &netTaskHandle, NET_TASK_CORE) != pdPASS) {
+    Serial.println("✗ Network task creation failed");
+    return false;
+  }
+
+  checkinLogReady = true;
+  Serial.println("✓ Network task started on core " + String(NET_TASK_CORE));
+  return true;
+}
+
+// Journal, network task, and the roster of the event the session resumes
+// (in memory before the first tap; fetchRoster() then only syncs it)
+static void loadStorage(const SessionState& session) {
+  initCheckinQueue(session);
+  if (session.attendanceMode && session.eventId[0] != '\0') {
+    snprintf(rosterWantedId, sizeof(rosterWantedId), "%s", session.eventId);
+    xSemaphoreTake(rosterLock, portMAX_DELAY);
+    rosterEventId = session.eventId;
+    if (!loadRosterSnapshot(session.eventId)) {
+      roster.clear();
+    }
+    rosterSavedVersion = roster.version();
+    noteRosterMemory();
+    xSemaphoreGive(rosterLock);
+  }
+}
+
+static void storageBootTask(void* param) {
+  loadStorage(*(const SessionState*)param);
+  xSemaphoreGive(storageReady);
+  vTaskDelete(NULL);
+}
+
+void startCheckinQueue(const SessionState& session) {
+  storageReady = xSemaphoreCreateBinary();
+  if (storageReady &&
+      xTaskCreatePinnedToCore(storageBootTask, "boot-fs", BOOT_TASK_STACK, (void*)&session,
+                              BOOT_TASK_PRIORITY, NULL, BOOT_TASK_CORE) == pdPASS) {
+    return;
+  }
+
+  Serial.println("✗ Boot task creation failed - loading journal inline");
+  if (storageReady) {
+    vSemaphoreDelete(storageReady);
+    storageReady = NULL;
+  }
+  loadStorage(session);
+}
+
+bool waitCheckinQueue() {
+  if (storageReady) {
+    xSemaphoreTake(storageReady, portMAX_DELAY);
+    vSemaphoreDelete(storageReady);
+    storageReady = NULL;
+  }
+  return checkinLogReady;
 }
 
 // ==========================================
-// MAIN ATTENDANCE MODE LOGIC
+// NETWORK TASK
 // ==========================================
 
-void runAttendanceMode(Adafruit_SSD1306& display, String cardUid) {
-  // Only process card if we're in ready state and have a valid UID
-  if (currentState == ATT_READY && cardUid.length() > 0) {
-    currentState = ATT_CHECKING_IN;
-    displayCheckingIn(display, cardUid);
-    
-    bool success = checkInCard(cardUid);
-    
-    if (success) {
-      // Display welcome message with student name from checkInCard
-      displayWelcome(display, lastCheckedInStudent);
-      delay(CHECKIN_SUCCESS_DISPLAY);
-    } else {
-      // Check error type
-      if (lastCheckInStatus == 409) {
-        displayAttendanceError(display, "Already checked in");
-      } else {
-        displayAttendanceError(display, "Check-in failed");
-      }
-      delay(2000);
+// Drains the tap queue and sends journaled check-ins in batches, then
+// runs a roster sync the loop task asked for, and polls the active event
+// when nothing is waiting to go out. Sleeps until the card task submits
+// a tap or asks for a sync, the current batch or event poll is due, or
+// NET_TASK_IDLE_WAIT passes so replay backoff can expire.
+static void networkTask(void* param) {
+  for (;;) {
+    if (dispatcher.runOnce(millis()) || runRosterSync() || eventPoller.runOnce(millis())) {
+      continue;
     }
-    
-    // Return to ready state
-    currentState = ATT_READY;
-    displayAttendanceReady(display, activeEventName);
+    uint32_t now = millis();
+    uint32_t waitMs = dispatcher.idleWaitMs(now);
+    uint32_t pollWait = eventPoller.idleWaitMs(now);
+    if (pollWait < waitMs) {
+      waitMs = pollWait;
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs > 0 ? waitMs : 1));
   }
 }
 
 // ==========================================
-// BUTTON HANDLING
+// WIRE FORMAT
 // ==========================================
 
-void handleFetchButton(Adafruit_SSD1306& display, bool isLongPress) {
-  if (isLongPress) {
-    // Long press is for mode switch (handled in main.cpp)
-    Serial.println("Long press - mode switch");
-    return;
-  }
-  
-  // Short press - fetch event from API (only when no event loaded)
-  if (currentState == ATT_NO_EVENT) {
-    Serial.println("Fetch button pressed - getting active event");
-    currentState = ATT_FETCHING_EVENT;
-    displayFetchingEvent(display);
-    
-    if (fetchActiveEvent()) {
-      currentState = ATT_READY;
-      displayAttendanceReady(display, activeEventName);
-      Serial.println("Event loaded successfully");
-    } else {
-      currentState = ATT_NO_EVENT;
-      displayNoEvent(display);
-      Serial.println("No active event found");
-    }
-  } else {
-    Serial.println("Fetch button ignored - event already loaded");
+// A fetched event with a handle means the server takes binary frames
+// again, even if an older build of it answered 415 before. A server with
+// no batch endpoint at all (404/405) is not asked again: every tap would
+// pay for a refused frame before its JSON POST.
+static void setWireEvent(const char* eventId, uint32_t handle) {
+  portENTER_CRITICAL(&wireMux);
+  snprintf(wireEventId, sizeof(wireEventId), "%s", eventId);
+  wireHandle = wireNoEndpoint ? 0 : handle;
+  wireBinary = CHECKIN_WIRE_BINARY && wireHandle != 0;
+  portEXIT_CRITICAL(&wireMux);
+}
+
+// 415: frames off until the next event fetch. 404/405: the handle is
+// dropped for good.
+static void disableWireBinary(bool noEndpoint) {
+  portENTER_CRITICAL(&wireMux);
+  wireBinary = false;
+  if (noEndpoint) {
+    wireNoEndpoint = true;
+    wireHandle = 0;
   }
+  portEXIT_CRITICAL(&wireMux);
 }
 
-void handleClearButton(Adafruit_SSD1306& display) {
-  // Clear event only if we're in ready state
-  if (currentState == ATT_READY) {
-    Serial.println("Clear button pressed - removing event");
-    clearActiveEvent();
-    currentState = ATT_NO_EVENT;
-    displayNoEvent(display);
-  } else {
-    Serial.println("Clear button ignored - no event to clear");
+// Handle to send recs under, or 0 for JSON: frames carry one event, so
+// all records must be for the event the handle was given for (records
+// journaled before a reboot go as JSON until the event is fetched again)
+static uint32_t wireHandleFor(const CheckinRecord* recs, size_t count) {
+  portENTER_CRITICAL(&wireMux);
+  uint32_t handle = wireBinary ? wireHandle : 0;
+  for (size_t i = 0; i < count && handle != 0; i++) {
+    if (strcmp(recs[i].eventId, wireEventId) != 0) {
+      handle = 0;
+    }
   }
+  portEXIT_CRITICAL(&wireMux);
+  return handle;
 }
 
 // ==========================================
 // API FUNCTIONS
 // ==========================================
 
-bool fetchActiveEvent() {
-  if (WiFi.status() != WL_CONNECTED) {
+static bool readActiveEvent(Stream& body, ArduinoJson::Allocator* arena, ActiveEvent& event) {
+  DeserializationError error = apiJson.readActiveEvent(body, arena, event);
+  if (error) {
+    Serial.println("✗ JSON parse error: " + String(error.c_str()));
+    return false;
+  }
+  return true;
+}
+
+static bool fetchActiveEvent(char* id, size_t idSize, char* name, size_t nameSize) {
+  if (!wifiLinkUp()) {
     Serial.println("✗ WiFi not connected!");
     return false;
   }
   
-  HTTPClient http;
-  String url = String(API_URL) + String(ENDPOINT_EVENTS_ACTIVE);
-  
-  Serial.println("GET " + url);
+  // Loop task: a poll or check-in in flight turns the fetch away rather
+  // than holding up card reading
+  ApiRequest req(ENDPOINT_EVENTS_ACTIVE, API_LOOP_WAIT);
   
-  http.begin(url);
-  http.addHeader("x-device-api-key", DEVICE_API_KEY);
-  http.setTimeout(API_TIMEOUT);
+  Serial.println("GET " + String(ENDPOINT_EVENTS_ACTIVE));
   
-  int httpCode = http.GET();
+  int httpCode = req.GET();
   
   Serial.println("Response code: " + String(httpCode));
   
-  if (httpCode == 200) {
-    String response = http.getString();
-    Serial.println("Response: " + response);
-    
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, response);
-    
-    if (error) {
-      Serial.println("✗ JSON parse error: " + String(error.c_str()));
-      http.end();
-      return false;
-    }
-    
-    // Parse event data
-    activeEventId = doc["event"]["id"].as<String>();
-    activeEventName = doc["event"]["name"].as<String>();
+  ActiveEvent event;
+  if (httpCode == 200 && readActiveEvent(req.body(), &loopJsonArena, event) && event.id[0] != '\0') {
+    snprintf(id, idSize, "%s", event.id);
+    snprintf(name, nameSize, "%s", event.name);
+    setWireEvent(id, event.handle);
     
     Serial.println("✅ Event loaded:");
-    Serial.println("  ID: " + activeEventId);
-    Serial.println("  Name: " + activeEventName);
+    Serial.println("  ID: " + String(id));
+    Serial.println("  Name: " + String(name));
+    if (event.handle != 0) {
+      Serial.println("  Wire handle: " + String(event.handle) + (wireBinary ? " (binary check-ins)" : ""));
+    }
     
-    http.end();
     return true;
   }
   
   Serial.println("✗ No active event found");
-  http.end();
   return false;
 }
 
-bool checkInCard(String cardUid) {
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("✗ WiFi not connected!");
-    return false;
+// Background poll (network task): the ETag of the last answer goes out
+// as If-None-Match, so an unchanged event is a 304 without a body
+static EventFetchResult pollActiveEvent(char* etag, size_t etagSize, ActiveEvent& event) {
+  static const char* headerKeys[] = { "ETag" };
+  ApiRequest req(ENDPOINT_EVENTS_ACTIVE);
+  if (etag[0] != '\0') {
+    req.addHeader("If-None-Match", String(etag));
+  }
+  req.collectHeaders(headerKeys, 1);
+  
+  int httpCode = req.GET();
+  if (httpCode == 304) {
+    return EVENT_FETCH_UNCHANGED;
+  }
+  if (httpCode == 404) {
+    return EVENT_FETCH_NONE;
+  }
+  if (httpCode != 200 || !readActiveEvent(req.body(), &netJsonArena, event)) {
+    return EVENT_FETCH_FAILED;
+  }
+  if (event.id[0] == '\0') {
+    return EVENT_FETCH_NONE;
   }
   
-  if (activeEventId.length() == 0) {
-    Serial.println("✗ No active event!");
+  snprintf(etag, etagSize, "%s", req.http().header("ETag").c_str());
+  setWireEvent(event.id, event.handle);
+  Serial.println("Active event on the server: " + String(event.name));
+  return EVENT_FETCH_CHANGED;
+}
+
+void seedEventPoller(uint32_t seed) {
+  eventPoller.seed(seed);
+}
+
+void printEventPollerStats() {
+  const EventPollerStats& st = eventPoller.stats();
+  Serial.println("Event poller:");
+  Serial.println("  Polls: " + String(st.polls) + " (" + String(st.notModified) + " not modified), " +
+                 String(st.changes) + " changes, " + String(st.failures) + " failures");
+}
+
+// Roster snapshots go through a temp file + rename so a reboot mid-write
+// never leaves a half-written snapshot behind
+class FileRosterSink : public RosterSink {
+public:
+  explicit FileRosterSink(File& file) : file(file) {}
+  bool write(const void* data, size_t len) override {
+    return file.write((const uint8_t*)data, len) == len;
+  }
+private:
+  File& file;
+};
+
+class FileRosterSource : public RosterSource {
+public:
+  explicit FileRosterSource(File& file) : file(file) {}
+  bool read(void* data, size_t len) override {
+    return file.read((uint8_t*)data, len) == len;
+  }
+private:
+  File& file;
+};
+
+static bool loadRosterSnapshot(const char* eventId) {
+  File file = LittleFS.open(ROSTER_SNAPSHOT_PATH, "r");
+  if (!file) {
     return false;
   }
+  FileRosterSource source(file);
+  bool loaded = roster.load(source, eventId);
+  file.close();
   
-  HTTPClient http;
-  String url = String(API_URL) + String(ENDPOINT_CHECK_IN);
+  if (loaded) {
+    Serial.println("✓ Stored roster v" + String(roster.version()) + " (" + String(roster.size()) + " entries)");
+  }
   
-  Serial.println("POST " + url);
+  // The session remembers which version was last written. A snapshot that
+  // disagrees is still usable for lookups, but not as a delta base.
+  if (loaded && sessionRosterVersion != 0 && strcmp(eventId, sessionEventId) == 0 &&
+      roster.version() != sessionRosterVersion) {
+    Serial.println("⚠️ Roster snapshot is v" + String(roster.version()) + ", session expected v" +
+                   String(sessionRosterVersion) + " - next sync is full");
+    roster.setVersion(0);
+  }
+  sessionRosterVersion = 0;
+  return loaded;
+}
+
+static void saveRosterSnapshot(const char* eventId) {
+  const char* tempPath = ROSTER_SNAPSHOT_PATH ".tmp";
+  File file = LittleFS.open(tempPath, "w");
+  if (!file) {
+    return;
+  }
+  FileRosterSink sink(file);
+  bool saved = roster.save(sink, eventId);
+  file.close();
   
-  http.begin(url);
-  http.addHeader("Content-Type", "application/json");
-  http.addHeader("x-device-api-key", DEVICE_API_KEY);
-  http.setTimeout(API_TIMEOUT);
+  if (saved) {
+    LittleFS.remove(ROSTER_SNAPSHOT_PATH);
+    LittleFS.rename(tempPath, ROSTER_SNAPSHOT_PATH);
+  } else {
+    LittleFS.remove(tempPath);
+    Serial.println("✗ Roster snapshot write failed");
+  }
+}
+
+// The HTTP side of a roster sync: GET on the shared connection, the body
+// read straight off the socket
+class StreamRosterInput : public RosterInput {
+public:
+  explicit StreamRosterInput(Stream& stream) : stream(stream) {}
+  int read() override {
+    char c;
+    return stream.readBytes(&c, 1) == 1 ? (uint8_t)c : -1;   // Waits up to the stream timeout
+  }
+private:
+  Stream& stream;
+};
+
+class ApiRosterServer : public RosterServer {
+public:
+  ApiRosterServer() : req(NULL), input(NULL) {}
+  ~ApiRosterServer() { release(); }
+
+  int get(const char* eventId, uint32_t since, bool full, RosterReply& reply) override {
+    release();
+    endpoint = String(ENDPOINT_EVENT_ROSTER) + "?eventId=" + String(eventId);
+    if (full) {
+      endpoint += "&full=1";
+    } else if (since > 0) {
+      endpoint += "&since=" + String(since);
+    }
+    Serial.println("GET " + endpoint);
+
+    static const char* headerKeys[] = { "X-Roster-Version", "X-Roster-Mode" };
+    req = new ApiRequest(endpoint.c_str());
+    req->collectHeaders(headerKeys, 2);
+    int httpCode = req->GET();
+    if (httpCode == 200) {
+      req->body().setTimeout(API_TIMEOUT);
+      input = new StreamRosterInput(req->body());
+      reply.version = req->http().header("X-Roster-Version").toInt();
+      reply.delta = req->http().header("X-Roster-Mode") == "delta";
+      reply.body = input;
+    }
+    return httpCode;
+  }
+
+private:
+  void release() {
+    delete input;
+    delete req;
+    input = NULL;
+    req = NULL;
+  }
+
+  String endpoint;
+  ApiRequest* req;
+  StreamRosterInput* input;
+};
+
+// Bring the roster for the active event up to date (RosterSync: 304,
+// delta or full list). Without a roster every tap simply goes to the
+// server as before. Network task, holding rosterLock.
+static bool fetchRoster(const char* eventId) {
+  if (rosterEventId != eventId) {
+    rosterEventId = eventId;
+    if (!loadRosterSnapshot(eventId)) {
+      roster.clear();
+    }
+  }
   
-  // Create JSON payload
-  JsonDocument doc;
-  doc["uid"] = cardUid;
-  doc["eventId"] = activeEventId;
+  // Still joining: the stored roster answers taps until the link is up
+  if (!isLinkUp()) {
+    rosterSyncPending = true;
+    Serial.println("⚠️ WiFi not up - roster sync deferred (" + String(roster.size()) + " stored entries)");
+    return roster.size() > 0;
+  }
+  // Growing the roster reallocs its arrays: not while the heap is short
+  if (memoryDegraded()) {
+    rosterSyncPending = true;
+    Serial.println("⚠️ Memory low - roster sync deferred (" + String(roster.size()) + " stored entries)");
+    return roster.size() > 0;
+  }
+  rosterSyncPending = false;
   
-  String payload;
-  serializeJson(doc, payload);
+  unsigned long start = millis();
+  RosterSyncResult result;
+  {
+    ApiRosterServer server;
+    result = rosterSync.sync(server, eventId);
+  }
   
-  Serial.println("Sending: " + payload);
+  // Stopped part way as the heap ran short: what was read stays, without
+  // a version, and the sync runs again once the heap has recovered
+  if (result.stopped) {
+    rosterSyncPending = true;
+    Serial.println("⚠️ Memory low - roster sync stopped (" + String(roster.size()) + " entries), resumes later");
+    return roster.size() > 0;
+  }
   
-  int httpCode = http.POST(payload);
+  if (result.outcome == ROSTER_SYNC_CURRENT) {
+    Serial.println("✓ Roster up to date (v" + String(roster.version()) + ")");
+    return roster.size() > 0;
+  }
   
-  Serial.println("Response code: " + String(httpCode));
+  if (result.outcome == ROSTER_SYNC_FAILED) {
+    Serial.println("✗ Roster sync failed (" + String(result.httpCode) + ") - " +
+                   (roster.size() > 0 ? "using stored roster" : "server check-in only"));
+    return roster.size() > 0;
+  }
+  
+  saveRosterSnapshot(eventId);
+  
+  Serial.println(String(result.outcome == ROSTER_SYNC_UPDATED ? "✅" : "⚠️") + " Roster " +
+                 (result.delta ? "delta" : "full") + " sync to v" + String(roster.version()) +
+                 " (server v" + String(result.version) + ") in " + String(millis() - start) + "ms");
+  printRosterCounts();
+  if (result.skipped > 0) {
+    Serial.println("  ⚠️ " + String(result.skipped) + " entries skipped (full or out of memory)");
+  }
+  if (result.invalid > 0) {
+    Serial.println("  ⚠️ " + String(result.invalid) + " entries ignored (no usable UID)");
+  }
+  return roster.size() > 0;
+}
+
+// The sync the loop task asked for, on the network task: the snapshot of
+// a new event first (so it answers taps even offline), then the server.
+// Taps meanwhile go to the server. Returns true if it ran.
+static bool runRosterSync() {
+  if (!rosterSyncPending.exchange(false)) {
+    return false;
+  }
+  char eventId[CHECKIN_EVENT_ID_MAX + 1];
+  portENTER_CRITICAL(&rosterMux);
+  strcpy(eventId, rosterWantedId);
+  portEXIT_CRITICAL(&rosterMux);
+
+  // Loaded, but the link or heap are not there for the sync yet
+  // (syncDeferredRoster() wakes us when they are)
+  if (rosterEventId == eventId && eventId[0] != '\0' && (!isLinkUp() || memoryDegraded())) {
+    rosterSyncPending = true;
+    return false;
+  }
+
+  xSemaphoreTake(rosterLock, portMAX_DELAY);
+  if (eventId[0] == '\0') {
+    rosterEventId = "";
+    roster.clear();
+    LittleFS.remove(ROSTER_SNAPSHOT_PATH);
+  } else {
+    fetchRoster(eventId);
+  }
+  noteRosterMemory();
+  uint32_t version = roster.version();
+  xSemaphoreGive(rosterLock);
+
+  portENTER_CRITICAL(&rosterMux);
+  if (strcmp(rosterWantedId, eventId) == 0) {
+    rosterSavedVersion = version;
+  }
+  portEXIT_CRITICAL(&rosterMux);
+  return true;
+}
+
+// Loop task: have the network task load and sync the roster of eventId
+// ("" = drop it)
+static void askRosterSync(const char* eventId) {
+  portENTER_CRITICAL(&rosterMux);
+  if (strcmp(rosterWantedId, eventId) != 0) {
+    snprintf(rosterWantedId, sizeof(rosterWantedId), "%s", eventId);
+    rosterSavedVersion = 0;
+  }
+  portEXIT_CRITICAL(&rosterMux);
+  rosterSyncPending = true;
+  if (netTaskHandle) {
+    xTaskNotifyGive(netTaskHandle);
+  }
+}
+
+// Asked by RosterSync between items. The loop task keeps sampling while
+// the sync runs on the network task.
+static bool rosterHeapOk() {
+  return !memoryDegraded();
+}
+
+// The roster counts its own arrays (they may be in PSRAM, out of the
+// sampled heap)
+static void noteRosterMemory() {
+  memoryWatch().setHeld(MEM_TAG_ROSTER, roster.memoryBytes());
+}
+
+static void printRosterCounts() {
+  Serial.println("Roster:");
+  Serial.println("  Entries: " + String(roster.size()) + " (max " + String(ROSTER_MAX_ENTRIES) + ")");
+  Serial.println("  Memory: " + String((unsigned int)roster.memoryBytes()) + " bytes (" +
+                 String((unsigned int)(roster.size() * sizeof(RosterEntry))) + " entries, " +
+                 String((unsigned int)roster.nameBytes()) + " names)");
+  Serial.println("  Free heap: " + String(ESP.getFreeHeap()) + ", free PSRAM: " + String(ESP.getFreePsram()));
+}
+
+void printRosterStats() {
+  if (!rosterLock || xSemaphoreTake(rosterLock, 0) != pdTRUE) {
+    Serial.println("Roster: sync in progress");
+    return;
+  }
+  printRosterCounts();
+  xSemaphoreGive(rosterLock);
+}
+
+// Unix time once NTP has synced, 0 before that (server then uses receive time)
+static uint32_t currentTimestamp() {
+  time_t now = time(nullptr);
+  return now > 1700000000 ? (uint32_t)now : 0;
+}
+
+static CardUidText formatUid(const CheckinRecord& rec) {
+  uint32_t start = micros();
+  CardUidText text = CardUid(rec.uid, rec.uidLen).text();
+  recordStage(STAGE_UID_FORMAT, micros() - start);
+  return text;
+}
+
+// Per-request log lines build and free a String each, between TLS
+// records: the first thing shed while the heap is short
+static bool logRequests() {
+  return !memoryDegraded();
+}
+
+// POST one journaled check-in. Runs on the network task.
+// Returns HTTP status (negative on transport error). The Idempotency-Key
+// (device, event, seq) makes retries idempotent: a replay of an already
+// stored check-in is answered with 409 rather than creating a second row.
+static int postCheckIn(const CheckinRecord& rec, char* studentName, size_t nameSize) {
+  uint32_t handle = wireHandleFor(&rec, 1);
+  if (handle != 0) {
+    CheckinItemResult result = { -1, "" };
+    int httpCode = postFrame(&rec, 1, handle, &result);
+    if (!frameRefused(httpCode) && httpCode != CHECKIN_BATCH_TOO_LARGE) {
+      snprintf(studentName, nameSize, "%s", result.studentName);
+      return httpCode == 200 || httpCode == 207 ? result.status : httpCode;
+    }
+  }
   
-  // Store status for error handling
-  lastCheckInStatus = httpCode;
+  ApiRequest req(ENDPOINT_CHECK_IN);
+  
+  if (logRequests()) {
+    Serial.println("POST " + String(ENDPOINT_CHECK_IN));
+  }
+  
+  req.addHeader("Content-Type", "application/json");
+  req.addHeader("Idempotency-Key", String(DEVICE_ID) + "-" + rec.eventId + "-" + String(rec.seq));
+  
+  // Create JSON payload
+  size_t len;
+  {
+    JsonDocument doc(&netJsonArena);
+    doc["uid"] = formatUid(rec).c_str();
+    doc["eventId"] = rec.eventId;
+    doc["deviceId"] = DEVICE_ID;
+    doc["seq"] = rec.seq;
+    doc["door"] = getDoorName(rec.reader);
+    if (rec.timestamp != 0) {
+      doc["timestamp"] = rec.timestamp;
+    }
+    len = serializeJson(doc, netPayload, JSON_PAYLOAD_MAX);
+  }
   
-  if (httpCode == 409) {
-    // Already checked in
-    Serial.println("⚠️ Already checked in!");
-    http.end();
-    return false; // Return false to show error message
+  if (logRequests()) {
+    Serial.print("Sending: ");
+    Serial.println(netPayload);
   }
   
+  int httpCode = req.POST((const uint8_t*)netPayload, len);
+  
+  if (logRequests()) {
+    Serial.println("Response code: " + String(httpCode));
+  }
+  
+  studentName[0] = '\0';
   if (httpCode == 200) {
-    String response = http.getString();
-    Serial.println("Response: " + response);
-    
-    JsonDocument responseDoc;
-    DeserializationError error = deserializeJson(responseDoc, response);
+    uint32_t start = micros();
+    DeserializationError error = apiJson.readCheckin(req.body(), &netJsonArena, studentName, nameSize);
+    recordStage(STAGE_RESPONSE_PARSE, micros() - start);
     
     if (error) {
+      // Check-in was stored; only the name for the welcome screen is missing
       Serial.println("✗ JSON parse error: " + String(error.c_str()));
-      http.end();
-      return false;
     }
-    String studentName = responseDoc["studentName"].as<String>();
-    
-    Serial.println("✅ CHECK-IN SUCCESS!");
-    Serial.println("  Student: " + studentName);
-    
-    // Store student name for display
-    lastCheckedInStudent = studentName;
-    
-    http.end();
-    return true;
   }
   
-  http.end();
-  return false;
+  return httpCode;
 }
 
-// ==========================================
-// STATE MANAGEMENT
-// ==========================================
+// Per-item results of a batch POST, matched back to recs by seq
+static void readBatchResults(Stream& body, const CheckinRecord* recs, size_t count, CheckinItemResult* results) {
+  uint32_t start = micros();
+  DeserializationError error = apiJson.readBatchResults(body, &netJsonArena, recs, count, results);
+  recordStage(STAGE_RESPONSE_PARSE, micros() - start);
+  
+  if (error) {
+    Serial.println("✗ JSON parse error: " + String(error.c_str()));
+  }
+}
 
-void clearActiveEvent() {
-  activeEventId = "";
-  activeEventName = "";
-  Serial.println("Event cleared from memory");
+// Frames were not taken: 415, or no batch endpoint to take them at all
+static bool frameRefused(int httpCode) {
+  return httpCode == 415 || httpCode == 404 || httpCode == 405;
 }
 
-String getActiveEventId() {
-  return activeEventId;
+// POST check-ins as one compact frame (checkin_wire.h) to the batch
+// endpoint. The answer is a result frame, or the JSON results if the
+// server prefers. A refusal turns frames off and is returned so the
+// caller resends as JSON.
+static int postFrame(const CheckinRecord* recs, size_t count, uint32_t handle, CheckinItemResult* results) {
+  static const char* responseHeaders[] = { "Content-Type" };
+  uint8_t* frame = (uint8_t*)netPayload;
+
+  size_t len = encodeCheckinFrame(DEVICE_ID, handle, recs, count, frame, sizeof(netPayload));
+  if (len == 0) {
+    Serial.println("✗ Batch does not fit the frame buffer");
+    return CHECKIN_BATCH_TOO_LARGE;
+  }
+
+  ApiRequest req(ENDPOINT_CHECK_IN_BATCH);
+  req.addHeader("Content-Type", CHECKIN_WIRE_TYPE);
+  req.addHeader("Accept", CHECKIN_WIRE_TYPE ", application/json");
+  req.collectHeaders(responseHeaders, 1);
+
+  if (logRequests()) {
+    Serial.println("POST " + String(ENDPOINT_CHECK_IN_BATCH) + " (" + String((unsigned int)count) +
+                   " check-ins, " + String((unsigned int)len) + "-byte frame)");
+  }
+
+  int httpCode = req.POST(frame, len);
+
+  if (logRequests()) {
+    Serial.println("Response code: " + String(httpCode));
+  }
+
+  if (frameRefused(httpCode)) {
+    Serial.println("⚠️ Server does not take binary check-ins - using JSON");
+    disableWireBinary(httpCode != 415);
+    return httpCode;
+  }
+  if (httpCode != 200 && httpCode != 207) {
+    return httpCode;
+  }
+
+  if (!req.http().header("Content-Type").startsWith(CHECKIN_WIRE_TYPE)) {
+    readBatchResults(req.body(), recs, count, results);
+    return httpCode;
+  }
+
+  // Result frame: read whole (it is small), then decode in place
+  Stream& body = req.body();
+  size_t got = 0;
+  int c;
+  while (got < sizeof(netPayload) && (c = body.read()) >= 0) {
+    frame[got++] = (uint8_t)c;
+  }
+  uint32_t start = micros();
+  if (!decodeResultFrame(frame, got, recs, count, results)) {
+    Serial.println("✗ Malformed result frame (" + String((unsigned int)got) + " bytes)");
+  }
+  recordStage(STAGE_RESPONSE_PARSE, micros() - start);
+  return httpCode;
 }
 
-String getActiveEventName() {
-  return activeEventName;
+// POST several journaled check-ins as one request:
+//   {"deviceId": "...", "checkIns": [{"uid", "eventId", "ts", "seq"}, ...]}
+// The server answers per item, matched back by seq:
+//   {"results": [{"seq": 12, "status": 200, "studentName": "..."}, ...]}
+// Items missing from the response stay at -1 and are retried. Records that
+// do not fit a frame or the JSON arena come back as CHECKIN_BATCH_TOO_LARGE
+// and the dispatcher sends fewer at a time.
+static int postCheckInBatch(const CheckinRecord* recs, size_t count, CheckinItemResult* results) {
+  uint32_t handle = wireHandleFor(recs, count);
+  if (handle != 0) {
+    int httpCode = postFrame(recs, count, handle, results);
+    if (!frameRefused(httpCode)) {
+      return httpCode;
+    }
+  }
+  
+  size_t len = apiJson.writeBatch(&netJsonArena, DEVICE_ID, recs, count, getDoorName, netPayload, sizeof(netPayload));
+  if (len == 0) {
+    Serial.println("✗ Batch does not fit the JSON arena or payload buffer");
+    return CHECKIN_BATCH_TOO_LARGE;
+  }
+  
+  ApiRequest req(ENDPOINT_CHECK_IN_BATCH);
+  
+  if (logRequests()) {
+    Serial.println("POST " + String(ENDPOINT_CHECK_IN_BATCH) + " (" + String((unsigned int)count) + " check-ins)");
+  }
+  
+  req.addHeader("Content-Type", "application/json");
+  
+  int httpCode = req.POST((const uint8_t*)netPayload, len);
+  
+  if (logRequests()) {
+    Serial.println("Response code: " + String(httpCode));
+  }
+  
+  if (httpCode == 200 || httpCode == 207) {
+    readBatchResults(req.body(), recs, count, results);
+  }
+  
+  return httpCode;
+}
+
+static bool isLinkUp() {
+  return wifiLinkUp();
 }
 
 // ==========================================
-// DISPLAY FUNCTIONS
+// CONTROLLER BACKEND
 // ==========================================
 
-void displayNoEvent(Adafruit_SSD1306& display) {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 10);
-  display.println("No event found");
-  display.println("");
-  display.println("Press button to");
-  display.println("fetch event");
-  display.display();
-}
-
-void displayFetchingEvent(Adafruit_SSD1306& display) {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 20);
-  display.println("Fetching event");
-  display.println("from server...");
-  display.display();
-}
-
-void displayAttendanceReady(Adafruit_SSD1306& display, String eventName) {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 0);
-  display.println("Ready:");
-  display.println("");
-  display.setTextSize(2);
-  
-  // Truncate long event names
-  String displayName = eventName;
-  if (eventName.length() > 10) {
-    displayName = eventName.substring(0, 10) + "...";
-  }
-  
-  display.println(displayName);
-  display.setTextSize(1);
-  display.println("");
-  display.println("Tap card to check in");
-  display.display();
-}
-
-void displayCheckingIn(Adafruit_SSD1306& display, String uid) {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 10);
-  display.println("Card detected!");
-  display.println("");
-  display.println("UID:");
-  display.println(uid.substring(0, 17));
-  display.println("");
-  display.println("Checking in...");
-  display.display();
-}
-
-void displayWelcome(Adafruit_SSD1306& display, String studentName) {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 10);
-  display.println("Welcome!");
-  display.println("");
-  display.setTextSize(2);
-  
-  // Truncate long names
-  String displayName = studentName;
-  if (studentName.length() > 10) {
-    displayName = studentName.substring(0, 10);
-  }
-  
-  display.println(displayName);
-  display.display();
-}
-
-void displayAttendanceError(Adafruit_SSD1306& display, String error) {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 20);
-  display.println("Error:");
-  display.println(error);
-  display.display();
+// What the attendance state machine needs from the board: the API, flash
+// and the network task
+class EspAttendanceBackend : public AttendanceBackend {
+public:
+  bool fetchActiveEvent(char* id, size_t idSize, char* name, size_t nameSize) override {
+    return ::fetchActiveEvent(id, idSize, name, nameSize);
+  }
+  bool takeEventChange(ActiveEvent& event) override {
+    return eventPoller.takeChange(event);
+  }
+  void refreshEvent() override {
+    eventPoller.refresh();
+    if (netTaskHandle) {
+      xTaskNotifyGive(netTaskHandle);
+    }
+  }
+  void syncRoster(const char* eventId) override {
+    askRosterSync(eventId);
+  }
+  void eventCleared() override {
+    setWireEvent("", 0);
+    askRosterSync("");
+  }
+  bool acquireRoster(const char* eventId) override {
+    if (!rosterLock || xSemaphoreTake(rosterLock, 0) != pdTRUE) {
+      return false;
+    }
+    if (rosterEventId == eventId) {
+      return true;
+    }
+    xSemaphoreGive(rosterLock);
+    return false;
+  }
+  void releaseRoster() override {
+    xSemaphoreGive(rosterLock);
+  }
+  bool journalReady() override {
+    return checkinLogReady;
+  }
+  void tapSubmitted() override {
+    xTaskNotifyGive(netTaskHandle);
+  }
+  uint32_t timestamp() override {
+    return currentTimestamp();
+  }
+};
+
+static EspAttendanceBackend backend;
+
+AttendanceController& attendanceController(HalDisplay& display, HalClock& clock,
+                                           UiScheduler& ui, HalLog& log) {
+  static AttendanceController controller(dispatcher, roster, backend, display, clock, ui, log);
+  return controller;
+}
+
+void syncDeferredRoster() {
+  if (rosterSyncPending && netTaskHandle) {
+    xTaskNotifyGive(netTaskHandle);
+  }
+}
+
+uint32_t rosterVersion() {
+  portENTER_CRITICAL(&rosterMux);
+  uint32_t version = rosterSavedVersion;
+  portEXIT_CRITICAL(&rosterMux);
+  return version;
+}
+
+// Read from the loop task while the network task appends: tail first,
+// so the pair never has tail > next
+void journalCursor(uint32_t& next, uint32_t& tail) {
+  tail = checkinLog.tailSequence();
+  next = checkinLog.nextSequence();
+}
+
+const char* getDoorName(uint8_t reader) {
+  return reader < RC522_READER_COUNT ? doorNames[reader] : "?";
 }
@@ -0,0 +1,41 @@
+#include "batch_policy.h"
+
+BatchFlushPolicy::BatchFlushPolicy(uint16_t maxItems, uint32_t deadlineMs, uint32_t idleMs)
+  : maxItems(maxItems > 0 ? maxItems : 1), deadlineMs(deadlineMs), idleMs(idleMs),
+    waiting(false), firstEnqueueAt(0), lastEnqueueAt(0) {}
+
+void BatchFlushPolicy::onEnqueue(uint32_t nowMs) {
+  if (!waiting) {
+    firstEnqueueAt = nowMs;
+    waiting = true;
+  }
+  lastEnqueueAt = nowMs;
+}
+
+void BatchFlushPolicy::onFlush() {
+  waiting = false;
+}
+
+bool BatchFlushPolicy::shouldFlush(uint32_t nowMs, uint32_t queued) const {
+  if (queued == 0) {
+    return false;
+  }
+  if (queued >= maxItems || !waiting) {
+    return true; // Full batch, or only backlog left - nothing to wait for
+  }
+  return nowMs - firstEnqueueAt >= deadlineMs || nowMs - lastEnqueueAt >= idleMs;
+}
+
+uint32_t BatchFlushPolicy::msUntilFlush(uint32_t nowMs, uint32_t maxWaitMs) const {
+  if (!waiting) {
+    return maxWaitMs;
+  }
+
+  uint32_t sinceFirst = nowMs - firstEnqueueAt;
+  uint32_t sinceLast = nowMs - lastEnqueueAt;
+  uint32_t toDeadline = sinceFirst >= deadlineMs ? 0 : deadlineMs - sinceFirst;
+  uint32_t toIdle = sinceLast >= idleMs ? 0 : idleMs - sinceLast;
+
+  uint32_t wait = toDeadline < toIdle ? toDeadline : toIdle;
+  return wait < maxWaitMs ? wait : maxWaitMs;
+}
@@ -0,0 +1,40 @@
+#include "boot_timeline.h"
+
+BootTimeline::BootTimeline() : count(0), readyUs(0) {}
+
+void BootTimeline::mark(const char* step, uint32_t nowUs) {
+  if (count < BOOT_STEPS_MAX) {
+    names[count] = step;
+    endUs[count] = nowUs;
+    count++;
+  }
+}
+
+void BootTimeline::cardReady(uint32_t nowUs) {
+  if (readyUs == 0) {
+    readyUs = nowUs > 0 ? nowUs : 1;
+  }
+}
+
+void BootTimeline::print(HalLog& out, uint32_t budgetMs) const {
+  uint32_t totalUs = readyUs ? readyUs : (count ? endUs[count - 1] : 0);
+
+  out.printf("Boot timeline (ms since app start, budget %lu ms):\n", (unsigned long)budgetMs);
+  out.printf("  %-16s %8s %8s %6s\n", "step", "end", "took", "share");
+  uint32_t startUs = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t took = endUs[i] - startUs;
+    out.printf("  %-16s %8lu %8lu %5lu%%\n", names[i], (unsigned long)(endUs[i] / 1000),
+               (unsigned long)(took / 1000), (unsigned long)(totalUs ? (uint64_t)took * 100 / totalUs : 0));
+    startUs = endUs[i];
+  }
+  if (!readyUs) {
+    out.println("  (not card-ready yet)");
+    return;
+  }
+  uint32_t took = readyUs - startUs;
+  out.printf("  %-16s %8lu %8lu %5lu%%\n", "loop start", (unsigned long)(readyUs / 1000),
+             (unsigned long)(took / 1000), (unsigned long)(totalUs ? (uint64_t)took * 100 / totalUs : 0));
+  out.printf("%s Card-ready %lu ms after start (budget %lu ms)\n",
+             readyUs / 1000 <= budgetMs ? "✓" : "⚠️", (unsigned long)(readyUs / 1000), (unsigned long)budgetMs);
+}
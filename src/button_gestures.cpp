@@ -0,0 +1,149 @@
+#include "button_gestures.h"
+#include <string.h>
+
+ButtonGestures::ButtonGestures(uint32_t debounceMs, uint32_t longMs, uint32_t doubleGapMs)
+  : debounceMs(debounceMs), longMs(longMs), doubleGapMs(doubleGapMs), head(0), count(0) {
+  memset(buttons, 0, sizeof(buttons));
+  memset(&st, 0, sizeof(st));
+}
+
+void ButtonGestures::enableDoubleTap(HalButton button, bool on) {
+  buttons[button].doubleTap = on;
+}
+
+// ==========================================
+// DEBOUNCE
+// ==========================================
+
+void ButtonGestures::onEdge(const ButtonEdge& edge) {
+  Button& b = buttons[edge.button];
+  st.edges++;
+  // A burst that went quiet before this edge has settled
+  settle(edge.button, edge.ms);
+
+  if (edge.down == b.raw) {
+    return;
+  }
+  b.raw = edge.down;
+  if (!b.settling) {
+    b.settling = true;
+    b.burstStart = edge.ms;
+  }
+  b.lastEdge = edge.ms;
+}
+
+void ButtonGestures::settle(HalButton button, uint32_t upToMs) {
+  Button& b = buttons[button];
+  if (!b.settling || (int32_t)(upToMs - b.lastEdge) < (int32_t)debounceMs) {
+    return;
+  }
+  b.settling = false;
+  if (b.raw == b.stable) {
+    st.glitches++;
+    return;
+  }
+  b.stable = b.raw;
+  timers(button, b.burstStart);
+  if (b.stable) {
+    pressed(button, b.burstStart);
+  } else {
+    released(button, b.burstStart);
+  }
+}
+
+// ==========================================
+// GESTURES
+// ==========================================
+
+void ButtonGestures::pressed(HalButton button, uint32_t atMs) {
+  Button& b = buttons[button];
+  st.presses++;
+  b.second = b.phase == PHASE_GAP;
+  b.phase = PHASE_DOWN;
+  b.phaseStart = atMs;
+  b.longSent = false;
+}
+
+void ButtonGestures::released(HalButton button, uint32_t atMs) {
+  Button& b = buttons[button];
+  if (b.phase != PHASE_DOWN) {
+    return;
+  }
+  b.phase = PHASE_IDLE;
+  if (b.longSent) {
+    return;
+  }
+  if (atMs - b.phaseStart >= longMs) {
+    emit(button, GESTURE_LONG, atMs);   // Nothing polled while it was held
+  } else if (b.second) {
+    emit(button, GESTURE_DOUBLE, atMs);
+  } else if (b.doubleTap) {
+    b.phase = PHASE_GAP;
+    b.phaseStart = atMs;
+  } else {
+    emit(button, GESTURE_SHORT, atMs);
+  }
+}
+
+// Long press and double-tap gap deadlines, up to upToMs
+void ButtonGestures::timers(HalButton button, uint32_t upToMs) {
+  Button& b = buttons[button];
+  if (b.phase == PHASE_DOWN && !b.longSent && upToMs - b.phaseStart >= longMs) {
+    b.longSent = true;
+    emit(button, GESTURE_LONG, b.phaseStart + longMs);
+  } else if (b.phase == PHASE_GAP && upToMs - b.phaseStart > doubleGapMs) {
+    b.phase = PHASE_IDLE;
+    emit(button, GESTURE_SHORT, b.phaseStart);
+  }
+}
+
+void ButtonGestures::emit(HalButton button, GestureType type, uint32_t atMs) {
+  if (count == GESTURE_QUEUE) {
+    return;
+  }
+  ButtonGesture& g = queue[(head + count) % GESTURE_QUEUE];
+  g.button = button;
+  g.type = type;
+  g.atMs = atMs;
+  count++;
+}
+
+bool ButtonGestures::poll(uint32_t nowMs, ButtonGesture& out) {
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    HalButton button = (HalButton)i;
+    Button& b = buttons[i];
+    settle(button, nowMs);
+    // While a burst settles the level is unknown from its first edge on
+    timers(button, b.settling ? b.burstStart : nowMs);
+  }
+
+  if (count == 0) {
+    return false;
+  }
+  out = queue[head];
+  head = (head + 1) % GESTURE_QUEUE;
+  count--;
+  return true;
+}
+
+uint32_t ButtonGestures::msUntilNext(uint32_t nowMs, uint32_t maxWaitMs) const {
+  if (count > 0) {
+    return 0;
+  }
+  int32_t wait = (int32_t)maxWaitMs;
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    const Button& b = buttons[i];
+    int32_t due = wait;
+    if (b.settling) {
+      due = (int32_t)(b.lastEdge + debounceMs - nowMs);
+    } else if (b.phase == PHASE_DOWN && !b.longSent) {
+      due = (int32_t)(b.phaseStart + longMs - nowMs);
+    } else if (b.phase == PHASE_GAP) {
+      due = (int32_t)(b.phaseStart + doubleGapMs + 1 - nowMs);
+    }
+    if (due < wait) {
+      wait = due;
+    }
+  }
+  return wait > 0 ? (uint32_t)wait : 0;
+}
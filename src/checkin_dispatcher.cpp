@@ -0,0 +1,236 @@
+#include "checkin_dispatcher.h"
+#include <string.h>
+
+CheckinDispatcher::CheckinDispatcher(CheckinLog& journal, CheckinSendFn send,
+                                     CheckinBatchSendFn sendBatch, CheckinLinkFn linkUp)
+  : journal(journal), send(send), sendBatch(sendBatch), linkUp(linkUp),
+    policy(sendBatch ? CHECKIN_BATCH_MAX : 1, CHECKIN_BATCH_DEADLINE, CHECKIN_BATCH_IDLE),
+    waitingCount(0), batchShrunk(false), fitStreak(0), wasLinkUp(false), nextReplayAt(0), replayBackoff(CHECKIN_RETRY_MIN),
+    droppedTaps(0), droppedResults(0), sentBatches(0), sentRecords(0) {}
+
+bool CheckinDispatcher::submit(const TapRequest& tap) {
+  if (!taps.push(tap)) {
+    droppedTaps++;
+    return false;
+  }
+  return true;
+}
+
+bool CheckinDispatcher::takeResult(TapResult& out) {
+  return results.pop(out);
+}
+
+bool CheckinDispatcher::runOnce(uint32_t nowMs) {
+  TapRequest tap;
+  while (taps.pop(tap)) {
+    acceptTap(tap, nowMs);
+  }
+
+  // Link back (reconnect, roam): the backlog goes out now, not when a
+  // backoff earned while it was down runs out
+  bool link = linkUp();
+  if (link && !wasLinkUp) {
+    nextReplayAt = nowMs;
+    replayBackoff = CHECKIN_RETRY_MIN;
+  }
+  wasLinkUp = link;
+
+  if (!link || backingOff(nowMs)) {
+    // Nothing will go out soon - confirm waiting taps as queued right away
+    releaseWaiting(CHECKIN_QUEUED);
+    return false;
+  }
+
+  if (!policy.shouldFlush(nowMs, journal.pendingCount())) {
+    return false;
+  }
+  return flush(nowMs);
+}
+
+uint32_t CheckinDispatcher::idleWaitMs(uint32_t nowMs) const {
+  return policy.msUntilFlush(nowMs, NET_TASK_IDLE_WAIT);
+}
+
+void CheckinDispatcher::acceptTap(const TapRequest& tap, uint32_t nowMs) {
+  // Write-ahead: journal first, so the tap survives any network failure
+  CheckinRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.timestamp = tap.timestamp;
+  rec.uidLen = tap.uid.size();
+  memcpy(rec.uid, tap.uid.data(), rec.uidLen);
+  rec.reader = tap.reader;
+  memcpy(rec.eventId, tap.eventId, sizeof(rec.eventId));
+
+  if (!journal.append(rec)) {
+    postResult(CHECKIN_FAILED, 0, tap.tag, tap.tappedUs, "");
+    return;
+  }
+
+  if (waitingCount == CHECKIN_TAP_QUEUE_SIZE) {
+    postResult(CHECKIN_QUEUED, rec.seq, tap.tag, tap.tappedUs, "");
+    return;
+  }
+
+  waiting[waitingCount].seq = rec.seq;
+  waiting[waitingCount].tag = tap.tag;
+  waiting[waitingCount].tappedUs = tap.tappedUs;
+  waitingCount++;
+  policy.onEnqueue(nowMs);
+}
+
+bool CheckinDispatcher::flush(uint32_t nowMs) {
+  // Oldest pending records first, so a backlog drains in tap order
+  size_t limit = policy.batchSize();
+  size_t count = 0;
+  for (uint32_t seq = journal.oldestSequence();
+       seq != journal.nextSequence() && count < limit; seq++) {
+    if (journal.readPending(seq, batch[count])) {
+      batchResults[count].status = -1;
+      batchResults[count].studentName[0] = '\0';
+      count++;
+    }
+  }
+
+  if (count == 0) {
+    releaseWaiting(CHECKIN_QUEUED);
+    policy.onFlush();
+    return false;
+  }
+
+  if (limit > 1) {
+    int httpCode = sendBatch(batch, count, batchResults);
+
+    if (httpCode == 404 || httpCode == 405) {
+      // Server has no batch endpoint - fall back to one request per tap
+      policy.setBatchSize(1);
+      batchShrunk = false;
+      return true;
+    }
+    if (httpCode == CHECKIN_BATCH_TOO_LARGE) {
+      // Nothing was sent; retrying as is would fail the same way forever.
+      // Halve the batch until it fits, down to one request per tap.
+      policy.setBatchSize((uint16_t)(count / 2));
+      batchShrunk = true;
+      fitStreak = 0;
+      return true;
+    }
+    if (httpCode != 200 && httpCode != 207) {
+      noteFailure(nowMs);
+      releaseWaiting(CHECKIN_QUEUED);
+      return false;
+    }
+  } else {
+    batchResults[0].status = send(batch[0], batchResults[0].studentName,
+                                  sizeof(batchResults[0].studentName));
+  }
+
+  sentBatches++;
+  sentRecords += count;
+
+  bool allDelivered = true;
+  for (size_t i = 0; i < count; i++) {
+    const CheckinItemResult& item = batchResults[i];
+    if (isCheckinDelivered(item.status)) {
+      journal.ack(batch[i].seq);
+      routeResult(batch[i].seq, item.status, item.studentName);
+    } else {
+      allDelivered = false;
+    }
+  }
+
+  if (!allDelivered) {
+    noteFailure(nowMs);
+    releaseWaiting(CHECKIN_QUEUED);
+    return false;
+  }
+
+  // Taps still waiting sit behind a backlog this batch did not reach;
+  // if they are next in line (per-tap mode, or more than one batch of
+  // fresh taps), their answer comes with the next request
+  replayBackoff = CHECKIN_RETRY_MIN;
+  regrowBatch();
+  if (!waitingNext()) {
+    releaseWaiting(CHECKIN_QUEUED);
+  }
+  return true;
+}
+
+bool CheckinDispatcher::waitingNext() {
+  uint32_t oldest = journal.oldestSequence();
+  for (uint32_t i = 0; i < waitingCount; i++) {
+    if (waiting[i].seq - oldest < policy.batchSize()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Memory is usually short only for a while (a handshake, a roster sync):
+// a batch halved for it doubles again after CHECKIN_BATCH_REGROW good
+// flushes, back up to CHECKIN_BATCH_MAX. Still too large, it halves again.
+void CheckinDispatcher::regrowBatch() {
+  if (!batchShrunk || ++fitStreak < CHECKIN_BATCH_REGROW) {
+    return;
+  }
+  fitStreak = 0;
+  uint32_t size = (uint32_t)policy.batchSize() * 2;
+  if (size >= CHECKIN_BATCH_MAX) {
+    size = CHECKIN_BATCH_MAX;
+    batchShrunk = false;
+  }
+  policy.setBatchSize((uint16_t)size);
+}
+
+bool CheckinDispatcher::backingOff(uint32_t nowMs) const {
+  return (int32_t)(nowMs - nextReplayAt) < 0;
+}
+
+void CheckinDispatcher::noteFailure(uint32_t nowMs) {
+  // Server unreachable - back off before trying again
+  nextReplayAt = nowMs + replayBackoff;
+  replayBackoff = replayBackoff * 2 > CHECKIN_RETRY_MAX ? CHECKIN_RETRY_MAX : replayBackoff * 2;
+}
+
+void CheckinDispatcher::postResult(CheckInResult result, uint32_t seq, uint8_t tag,
+                                   uint32_t tappedUs, const char* studentName) {
+  TapResult res;
+  memset(&res, 0, sizeof(res));
+  res.result = result;
+  res.tag = tag;
+  res.tappedUs = tappedUs;
+  res.seq = seq;
+  res.pending = journal.pendingCount();
+  strncpy(res.studentName, studentName, CHECKIN_NAME_MAX);
+
+  if (!results.push(res)) {
+    droppedResults++;
+  }
+}
+
+void CheckinDispatcher::routeResult(uint32_t seq, int status, const char* studentName) {
+  // Replayed backlog records have nobody waiting on them
+  for (uint32_t i = 0; i < waitingCount; i++) {
+    if (waiting[i].seq != seq) {
+      continue;
+    }
+    WaitingTap tap = waiting[i];
+    waiting[i] = waiting[--waitingCount];
+
+    CheckInResult result = CHECKIN_FAILED;
+    if (status == 409) {
+      result = CHECKIN_DUPLICATE;
+    } else if (status == 200 || status == 201) {
+      result = CHECKIN_OK;
+    }
+    postResult(result, seq, tap.tag, tap.tappedUs, studentName);
+    return;
+  }
+}
+
+void CheckinDispatcher::releaseWaiting(CheckInResult result) {
+  for (uint32_t i = 0; i < waitingCount; i++) {
+    postResult(result, waiting[i].seq, waiting[i].tag, waiting[i].tappedUs, "");
+  }
+  waitingCount = 0;
+  policy.onFlush();
+}
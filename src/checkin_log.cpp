@@ -0,0 +1,273 @@
+#include "checkin_log.h"
+#include "crc32.h"
+#include <string.h>
+
+// ==========================================
+// SLOT LAYOUT (64 bytes, little-endian)
+// ==========================================
+//
+//   0..3   seq
+//   4..7   timestamp
+//   8      uidLen
+//   9..18  uid
+//   19     eventIdLen
+//   20..57 eventId
+//   58     reader      - door the card was tapped at (0 in older logs)
+//   59     state       - outside the CRC so it can be flipped in place
+//   60..63 crc32 over bytes 0..58
+//
+// A fresh slot is written with STATE_PENDING in one write. Acknowledging
+// only rewrites the state byte, clearing bits (0xFF -> 0x00) so the update
+// is also safe on raw NOR flash.
+
+#define OFF_SEQ       0
+#define OFF_TIMESTAMP 4
+#define OFF_UID_LEN   8
+#define OFF_UID       9
+#define OFF_EVENT_LEN 19
+#define OFF_EVENT     20
+#define OFF_READER    58
+#define OFF_STATE     59
+#define OFF_CRC       60
+
+#define STATE_PENDING 0xFF
+#define STATE_ACKED   0x00
+
+// ==========================================
+// HELPERS
+// ==========================================
+
+static void putU32(uint8_t* p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+         ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ==========================================
+// CHECKIN LOG
+// ==========================================
+
+CheckinLog::CheckinLog()
+  : storage(nullptr), slotCount(0), nextSeq(1), tailSeq(1), scanned(0) {}
+
+bool CheckinLog::begin(CheckinLogStorage* store, uint32_t nextHint, uint32_t tailHint) {
+  storage = store;
+  slotCount = store ? store->size() / CHECKIN_SLOT_SIZE : 0;
+  nextSeq = 1;
+  tailSeq = 1;
+  scanned = 0;
+
+  if (slotCount == 0) {
+    return false;
+  }
+
+  if (nextHint > 0 && tailHint > 0 && tailHint <= nextHint && resumeFrom(nextHint, tailHint)) {
+    return true;
+  }
+  scanned = slotCount;
+
+  // Recovery: the newest valid slot gives the head, the oldest pending
+  // slot gives the tail. Torn or erased slots fail the CRC and are skipped.
+  uint32_t maxSeq = 0;
+  uint32_t minPending = 0;
+  bool havePending = false;
+
+  for (uint32_t slot = 0; slot < slotCount; slot++) {
+    CheckinRecord rec;
+    uint8_t state;
+    if (!readSlot(slot, rec, state)) {
+      continue;
+    }
+    if (rec.seq > maxSeq) {
+      maxSeq = rec.seq;
+    }
+    if (state != STATE_ACKED && (!havePending || rec.seq < minPending)) {
+      minPending = rec.seq;
+      havePending = true;
+    }
+  }
+
+  // The cursor still bounds the head from below: with the slots erased or
+  // the file recreated, numbering goes on after the last seq handed out
+  // rather than at 1, so the server never sees a seq twice. Unless pending
+  // records a ring's length behind it say the cursor is not ours.
+  nextSeq = maxSeq + 1;
+  if (nextHint > nextSeq && (!havePending || nextHint - minPending <= slotCount)) {
+    nextSeq = nextHint;
+  }
+  tailSeq = havePending ? minPending : nextSeq;
+  return true;
+}
+
+// Roll a saved cursor forward over the appends made after it was saved.
+// The record just before the cursor must still be there, and the roll
+// must end on a slot holding an older (or no) record; anything else means
+// the cursor is stale or belongs to other storage.
+bool CheckinLog::resumeFrom(uint32_t nextHint, uint32_t tailHint) {
+  CheckinRecord rec;
+  uint8_t state;
+
+  if (nextHint > 1) {
+    scanned++;
+    if (!readSlot((nextHint - 1) % slotCount, rec, state) || rec.seq != nextHint - 1) {
+      return false;
+    }
+  }
+
+  uint32_t seq = nextHint;
+  for (;;) {
+    if (seq - nextHint == slotCount) {
+      return false;   // Wrapped all the way round since the cursor was saved
+    }
+    scanned++;
+    if (!readSlot(seq % slotCount, rec, state)) {
+      // A torn append is the last one; a newer record behind it is not
+      scanned++;
+      if (readSlot((seq + 1) % slotCount, rec, state) && rec.seq > seq) {
+        return false;
+      }
+      break;
+    }
+    if (rec.seq < seq) {
+      break;
+    }
+    if (rec.seq > seq) {
+      return false;
+    }
+    seq++;
+  }
+
+  nextSeq = seq;
+  tailSeq = nextSeq - tailHint > slotCount ? nextSeq - slotCount : tailHint;
+  advanceTail();
+  return true;
+}
+
+bool CheckinLog::readSlot(uint32_t slot, CheckinRecord& out, uint8_t& state) {
+  uint8_t buf[CHECKIN_SLOT_SIZE];
+  if (!storage->read((size_t)slot * CHECKIN_SLOT_SIZE, buf, sizeof(buf))) {
+    return false;
+  }
+
+  if (getU32(buf + OFF_CRC) != crc32(buf, OFF_STATE)) {
+    return false;
+  }
+
+  out.seq = getU32(buf + OFF_SEQ);
+  out.timestamp = getU32(buf + OFF_TIMESTAMP);
+  out.uidLen = buf[OFF_UID_LEN];
+  uint8_t eventLen = buf[OFF_EVENT_LEN];
+
+  // Reject slots that pass the CRC but cannot belong here
+  if (out.seq == 0 || out.seq % slotCount != slot ||
+      out.uidLen > CHECKIN_UID_MAX || eventLen > CHECKIN_EVENT_ID_MAX) {
+    return false;
+  }
+
+  memcpy(out.uid, buf + OFF_UID, CHECKIN_UID_MAX);
+  memcpy(out.eventId, buf + OFF_EVENT, eventLen);
+  out.eventId[eventLen] = '\0';
+  out.reader = buf[OFF_READER];
+  state = buf[OFF_STATE];
+  return true;
+}
+
+bool CheckinLog::append(CheckinRecord& rec) {
+  if (slotCount == 0) {
+    return false;
+  }
+
+  advanceTail();
+  if (pendingCount() >= slotCount) {
+    return false; // Full: never overwrite an undelivered check-in
+  }
+
+  size_t eventLen = strnlen(rec.eventId, CHECKIN_EVENT_ID_MAX + 1);
+  if (rec.uidLen > CHECKIN_UID_MAX || eventLen > CHECKIN_EVENT_ID_MAX) {
+    return false;
+  }
+
+  uint8_t buf[CHECKIN_SLOT_SIZE];
+  memset(buf, 0, sizeof(buf));
+  putU32(buf + OFF_SEQ, nextSeq);
+  putU32(buf + OFF_TIMESTAMP, rec.timestamp);
+  buf[OFF_UID_LEN] = rec.uidLen;
+  memcpy(buf + OFF_UID, rec.uid, rec.uidLen);
+  buf[OFF_EVENT_LEN] = (uint8_t)eventLen;
+  memcpy(buf + OFF_EVENT, rec.eventId, eventLen);
+  buf[OFF_READER] = rec.reader;
+  buf[OFF_STATE] = STATE_PENDING;
+  putU32(buf + OFF_CRC, crc32(buf, OFF_STATE));
+
+  uint32_t slot = nextSeq % slotCount;
+  if (!storage->write((size_t)slot * CHECKIN_SLOT_SIZE, buf, sizeof(buf))) {
+    return false;
+  }
+
+  rec.seq = nextSeq++;
+  return true;
+}
+
+bool CheckinLog::peek(CheckinRecord& out) {
+  if (slotCount == 0) {
+    return false;
+  }
+
+  advanceTail();
+  if (tailSeq == nextSeq) {
+    return false;
+  }
+
+  uint8_t state;
+  return readSlot(tailSeq % slotCount, out, state);
+}
+
+bool CheckinLog::readPending(uint32_t seq, CheckinRecord& out) {
+  if (slotCount == 0 || seq < tailSeq || seq >= nextSeq) {
+    return false;
+  }
+
+  uint8_t state;
+  return readSlot(seq % slotCount, out, state) && out.seq == seq && state != STATE_ACKED;
+}
+
+uint32_t CheckinLog::oldestSequence() {
+  if (slotCount != 0) {
+    advanceTail();
+  }
+  return tailSeq;
+}
+
+bool CheckinLog::ack(uint32_t seq) {
+  if (slotCount == 0 || seq < tailSeq || seq >= nextSeq) {
+    return false;
+  }
+
+  uint8_t state = STATE_ACKED;
+  size_t offset = (size_t)(seq % slotCount) * CHECKIN_SLOT_SIZE + OFF_STATE;
+  if (!storage->write(offset, &state, 1)) {
+    return false;
+  }
+
+  advanceTail();
+  return true;
+}
+
+void CheckinLog::advanceTail() {
+  // Skip over delivered or unreadable slots until the oldest pending record
+  while (tailSeq != nextSeq) {
+    CheckinRecord rec;
+    uint8_t state;
+    if (readSlot(tailSeq % slotCount, rec, state) &&
+        rec.seq == tailSeq && state != STATE_ACKED) {
+      return;
+    }
+    tailSeq++;
+  }
+}
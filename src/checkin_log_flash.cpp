@@ -0,0 +1,54 @@
+#include "checkin_log_flash.h"
+#include <LittleFS.h>
+
+bool LittleFsLogStorage::begin(const char* path, size_t bytes) {
+  fileSize = 0;
+
+  if (LittleFS.exists(path)) {
+    file = LittleFS.open(path, "r+");
+    if (file && file.size() == bytes) {
+      fileSize = bytes;
+      return true;
+    }
+    // Size changed (config update) - start a fresh journal
+    if (file) file.close();
+    LittleFS.remove(path);
+  }
+
+  file = LittleFS.open(path, "w+");
+  if (!file) {
+    return false;
+  }
+
+  uint8_t erased[64];
+  memset(erased, 0xFF, sizeof(erased));
+  for (size_t written = 0; written < bytes; written += sizeof(erased)) {
+    size_t chunk = min(sizeof(erased), bytes - written);
+    if (file.write(erased, chunk) != chunk) {
+      file.close();
+      return false;
+    }
+  }
+  file.flush();
+
+  fileSize = bytes;
+  return true;
+}
+
+bool LittleFsLogStorage::read(size_t offset, uint8_t* data, size_t len) {
+  if (!file || offset + len > fileSize || !file.seek(offset)) {
+    return false;
+  }
+  return file.read(data, len) == len;
+}
+
+bool LittleFsLogStorage::write(size_t offset, const uint8_t* data, size_t len) {
+  if (!file || offset + len > fileSize || !file.seek(offset)) {
+    return false;
+  }
+  if (file.write(data, len) != len) {
+    return false;
+  }
+  file.flush();
+  return true;
+}
@@ -0,0 +1,166 @@
+#include "checkin_wire.h"
+#include <string.h>
+
+#define HEADER_BYTES 8
+#define RESULT_HEADER_BYTES 4
+
+static void putU16(uint8_t* p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = (v >> 24) & 0xFF;
+}
+
+static uint16_t getU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+         ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool validUidLen(uint8_t len) {
+  return len >= 1 && len <= CHECKIN_UID_MAX;
+}
+
+// ==========================================
+// CHECK-IN FRAMES
+// ==========================================
+
+size_t encodeCheckinFrame(const char* deviceId, uint32_t eventHandle, const CheckinRecord* recs,
+                          size_t count, uint8_t* out, size_t outSize) {
+  size_t idLen = strnlen(deviceId, CHECKIN_WIRE_DEVICE_MAX);
+  if (count == 0 || count > 255 || outSize < HEADER_BYTES + idLen) {
+    return 0;
+  }
+
+  out[0] = CHECKIN_WIRE_REQUEST;
+  out[1] = CHECKIN_WIRE_VERSION;
+  out[2] = (uint8_t)count;
+  out[3] = (uint8_t)idLen;
+  putU32(out + 4, eventHandle);
+  memcpy(out + HEADER_BYTES, deviceId, idLen);
+  size_t pos = HEADER_BYTES + idLen;
+
+  for (size_t i = 0; i < count; i++) {
+    const CheckinRecord& rec = recs[i];
+    if (!validUidLen(rec.uidLen) || pos + 10 + rec.uidLen > outSize) {
+      return 0;
+    }
+    putU32(out + pos, rec.seq);
+    putU32(out + pos + 4, rec.timestamp);
+    out[pos + 8] = rec.reader;
+    out[pos + 9] = rec.uidLen;
+    memcpy(out + pos + 10, rec.uid, rec.uidLen);
+    pos += 10 + rec.uidLen;
+  }
+  return pos;
+}
+
+bool decodeCheckinFrame(const uint8_t* frame, size_t len, char* deviceId, uint32_t& eventHandle,
+                        CheckinRecord* recs, size_t maxRecs, size_t& count) {
+  if (len < HEADER_BYTES || frame[0] != CHECKIN_WIRE_REQUEST || frame[1] != CHECKIN_WIRE_VERSION) {
+    return false;
+  }
+  size_t n = frame[2];
+  size_t idLen = frame[3];
+  if (n == 0 || n > maxRecs || idLen > CHECKIN_WIRE_DEVICE_MAX || HEADER_BYTES + idLen > len) {
+    return false;
+  }
+
+  size_t pos = HEADER_BYTES + idLen;
+  for (size_t i = 0; i < n; i++) {
+    if (pos + 10 > len || !validUidLen(frame[pos + 9]) || pos + 10 + frame[pos + 9] > len) {
+      return false;
+    }
+    CheckinRecord& rec = recs[i];
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = getU32(frame + pos);
+    rec.timestamp = getU32(frame + pos + 4);
+    rec.reader = frame[pos + 8];
+    rec.uidLen = frame[pos + 9];
+    memcpy(rec.uid, frame + pos + 10, rec.uidLen);
+    pos += 10 + rec.uidLen;
+  }
+  if (pos != len) {
+    return false;   // Trailing bytes: not a frame we wrote
+  }
+
+  memcpy(deviceId, frame + HEADER_BYTES, idLen);
+  deviceId[idLen] = '\0';
+  eventHandle = getU32(frame + 4);
+  count = n;
+  return true;
+}
+
+// ==========================================
+// RESULT FRAMES
+// ==========================================
+
+size_t encodeResultFrame(const CheckinRecord* recs, const CheckinItemResult* results, size_t count,
+                         uint8_t* out, size_t outSize) {
+  if (count > 255 || outSize < RESULT_HEADER_BYTES) {
+    return 0;
+  }
+  out[0] = CHECKIN_WIRE_RESULT;
+  out[1] = CHECKIN_WIRE_VERSION;
+  out[2] = (uint8_t)count;
+  out[3] = 0;
+  size_t pos = RESULT_HEADER_BYTES;
+
+  for (size_t i = 0; i < count; i++) {
+    size_t nameLen = strnlen(results[i].studentName, CHECKIN_NAME_MAX);
+    if (pos + 7 + nameLen > outSize) {
+      return 0;
+    }
+    putU32(out + pos, recs[i].seq);
+    putU16(out + pos + 4, (uint16_t)results[i].status);
+    out[pos + 6] = (uint8_t)nameLen;
+    memcpy(out + pos + 7, results[i].studentName, nameLen);
+    pos += 7 + nameLen;
+  }
+  return pos;
+}
+
+bool decodeResultFrame(const uint8_t* frame, size_t len, const CheckinRecord* recs, size_t count,
+                       CheckinItemResult* results) {
+  if (len < RESULT_HEADER_BYTES || frame[0] != CHECKIN_WIRE_RESULT || frame[1] != CHECKIN_WIRE_VERSION) {
+    return false;
+  }
+  size_t n = frame[2];
+
+  // Validate everything before touching results
+  size_t pos = RESULT_HEADER_BYTES;
+  for (size_t i = 0; i < n; i++) {
+    if (pos + 7 > len || frame[pos + 6] > CHECKIN_NAME_MAX || pos + 7 + frame[pos + 6] > len) {
+      return false;
+    }
+    pos += 7 + frame[pos + 6];
+  }
+  if (pos != len) {
+    return false;
+  }
+
+  pos = RESULT_HEADER_BYTES;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t seq = getU32(frame + pos);
+    uint8_t nameLen = frame[pos + 6];
+    for (size_t r = 0; r < count; r++) {
+      if (recs[r].seq != seq) {
+        continue;
+      }
+      results[r].status = getU16(frame + pos + 4);
+      memcpy(results[r].studentName, frame + pos + 7, nameLen);
+      results[r].studentName[nameLen] = '\0';
+      break;
+    }
+    pos += 7 + nameLen;
+  }
+  return true;
+}
@@ -0,0 +1,220 @@
+#include "device_controller.h"
+#include "screens.h"
+#include "config.h"
+
+// Single short beep on every tap
+static const uint16_t tapBeep[] = { BUZZER_DURATION };
+
+DeviceController::DeviceController(AttendanceController& attendance, CardRegisterFn registerCard,
+                                   HalDisplay& display, HalClock& clock, HalButtons& buttons,
+                                   UiScheduler& ui, HalLog& log)
+  : attendance(attendance), registerCard(registerCard), display(display), clock(clock),
+    buttons(buttons), ui(ui), log(log), currentMode(MODE_REGISTRATION), cardSentWait(false),
+    gestures(BUTTON_DEBOUNCE, BUTTON_LONG_PRESS, BUTTON_DOUBLE_TAP), recent(CARD_COOLDOWN), modeChanges(0) {}
+
+void DeviceController::begin() {
+  currentMode = MODE_REGISTRATION;
+  displayReady(display);
+}
+
+void DeviceController::resume(const SessionState& session) {
+  if (!session.attendanceMode) {
+    begin();
+    return;
+  }
+
+  currentMode = MODE_ATTENDANCE;
+  if (session.eventId[0] != '\0') {
+    attendance.resume(session.eventId, session.eventName);
+  } else {
+    attendance.begin();
+    displayNoEvent(display);
+  }
+  log.println("Resumed in attendance mode");
+}
+
+void DeviceController::poll() {
+  // Timed screens and buzzer first
+  if (ui.poll(clock.millis())) {
+    onScreenTimeout();
+  }
+
+  pollButtons();
+
+  // Show check-in results coming back from the network task, then
+  // follow the server onto a new event
+  if (currentMode == MODE_ATTENDANCE) {
+    attendance.pollResults();
+    if (attendance.pollEventChange()) {
+      recent.clear();
+    }
+  }
+}
+
+uint32_t DeviceController::msUntilNext(uint32_t maxWaitMs) {
+  uint32_t now = clock.millis();
+  return gestures.msUntilNext(now, ui.msUntilNext(now, maxWaitMs));
+}
+
+void DeviceController::onScreenTimeout() {
+  if (currentMode == MODE_ATTENDANCE) {
+    attendance.onScreenTimeout();
+    return;
+  }
+  // Registration: back to ready (admin activates a sent card in the browser)
+  cardSentWait = false;
+  displayReady(display);
+}
+
+// ==========================================
+// CARD HANDLING
+// ==========================================
+
+bool DeviceController::dropRepeat(const CardTap& tap) {
+  if (!recent.seenRecently(tap.uid, clock.millis())) {
+    return false;
+  }
+  log.printf("Repeat of %s ignored\n", tap.uid.text().c_str());
+  return true;
+}
+
+void DeviceController::onTap(const CardTap& tap) {
+  uint32_t tappedUs = clock.micros();
+
+  // Registration holds off the next card while the sent one is activated
+  if (currentMode == MODE_REGISTRATION && cardSentWait) {
+    log.println("Card ignored - waiting for activation of the last one");
+    recent.forget(tap.uid);
+    return;
+  }
+
+  // Beep buzzer for feedback (switched off again by the scheduler)
+  ui.playBuzzer(clock.millis(), tapBeep, sizeof(tapBeep) / sizeof(tapBeep[0]));
+
+  // Handle card based on current mode
+  if (currentMode == MODE_REGISTRATION) {
+    handleRegistration(tap.uid);
+  } else {
+    // Turned away (busy): the same card presented again is a retry, not a repeat
+    if (!attendance.onTap(tap.uid, tap.reader, tappedUs)) {
+      recent.forget(tap.uid);
+    }
+  }
+}
+
+void DeviceController::handleRegistration(const CardUid& uid) {
+  // Step 1: Send card to API
+  displaySending(display, uid);
+  int httpCode = registerCard(uid);
+  uint32_t now = clock.millis();
+
+  if (httpCode == 409) {
+    // Card already activated
+    displayError(display, "Card already", "activated");
+    ui.holdScreen(now, CARD_ERROR_DISPLAY);
+    return;
+  }
+
+  if (httpCode != 200) {
+    displayError(display, "API Error", "Check connection");
+    ui.holdScreen(now, CARD_ERROR_DISPLAY);
+    return;
+  }
+
+  // Step 2: Card sent successfully, hold the next one for a while
+  displayWaiting(display);
+  cardSentWait = true;
+  ui.holdScreen(now, CARD_SENT_WAIT_TIME);
+
+  // Step 3: Back to ready on timeout (admin activates in browser)
+}
+
+// ==========================================
+// BUTTON HANDLING
+// ==========================================
+
+void DeviceController::pollButtons() {
+  ButtonEdge edge;
+  while (buttons.nextEdge(edge)) {
+    gestures.onEdge(edge);
+  }
+
+  ButtonGesture gesture;
+  while (gestures.poll(clock.millis(), gesture)) {
+    onGesture(gesture);
+  }
+
+  // Refresh only means something with an event loaded
+  bool refresh = currentMode == MODE_ATTENDANCE && attendance.eventId()[0] != '\0';
+  gestures.enableDoubleTap(BUTTON_FETCH, refresh);
+}
+
+void DeviceController::onGesture(const ButtonGesture& gesture) {
+  static const char* const names[] = { "short", "long", "double" };
+  log.printf("%s button %s press\n", gesture.button == BUTTON_FETCH ? "Fetch" : "Clear",
+             names[gesture.type]);
+
+  if (gesture.button == BUTTON_FETCH) {
+    onFetchGesture(gesture.type);
+  } else {
+    onClearGesture();
+  }
+}
+
+void DeviceController::onFetchGesture(GestureType type) {
+  // Check for long press (mode switch)
+  if (type == GESTURE_LONG) {
+    log.println("Long press detected (>= 5s) - switching mode");
+    switchMode();
+    return;
+  }
+
+  if (currentMode != MODE_ATTENDANCE) {
+    log.println("Press in registration mode - ignored");
+    return;
+  }
+
+  if (type == GESTURE_DOUBLE) {
+    log.println("Double press in attendance mode - refreshing event");
+    attendance.onRefreshButton();
+  } else {
+    log.println("Short press in attendance mode - fetching event");
+    attendance.onFetchButton();
+  }
+  recent.clear();
+}
+
+void DeviceController::onClearGesture() {
+  // Only handle in attendance mode (a long press clears too)
+  if (currentMode == MODE_ATTENDANCE) {
+    log.println("Clear button - clearing event");
+    attendance.onClearButton();
+    recent.clear();
+  } else {
+    log.println("Clear button in registration mode - ignored");
+  }
+}
+
+void DeviceController::switchMode() {
+  ui.releaseScreen();
+  cardSentWait = false;
+  recent.clear();
+  modeChanges++;
+
+  if (currentMode == MODE_REGISTRATION) {
+    currentMode = MODE_ATTENDANCE;
+    attendance.begin();
+    displayNoEvent(display);
+
+    log.println("\n========================================");
+    log.println("SWITCHED TO: ATTENDANCE MODE");
+    log.println("========================================\n");
+  } else {
+    currentMode = MODE_REGISTRATION;
+    displayReady(display);
+
+    log.println("\n========================================");
+    log.println("SWITCHED TO: REGISTRATION MODE");
+    log.println("========================================\n");
+  }
+}
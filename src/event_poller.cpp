@@ -0,0 +1,113 @@
+#include "event_poller.h"
+#include <string.h>
+
+EventPoller::EventPoller(EventFetchFn fetch, EventLinkFn linkUp, uint32_t seed)
+  : fetch(fetch), linkUp(linkUp), refreshAsked(false), knownNone(false), forceNext(false), waitingLink(false),
+    nextPollMs(0), failStreak(0), rng(seed ? seed : 1) {
+  etag[0] = '\0';
+  knownId[0] = '\0';
+  memset(&scratch, 0, sizeof(scratch));
+  memset(&st, 0, sizeof(st));
+}
+
+// The first call polls at once: the event is fetched as soon as the
+// link is up, before anyone asks for it
+bool EventPoller::runOnce(uint32_t nowMs) {
+  bool asked = refreshAsked.load(std::memory_order_acquire);
+  if (!asked && (int32_t)(nowMs - nextPollMs) < 0) {
+    return false;
+  }
+  if (!linkUp()) {
+    waitingLink = true;
+    nextPollMs = nowMs + EVENT_POLL_RETRY;
+    return false;
+  }
+  waitingLink = false;
+
+  bool force = forceNext || refreshAsked.exchange(false, std::memory_order_acq_rel);
+  forceNext = false;
+  if (force) {
+    etag[0] = '\0';   // Full answer, whatever we had
+  }
+
+  st.polls++;
+  EventFetchResult result = fetch(etag, sizeof(etag), scratch);
+  switch (result) {
+    case EVENT_FETCH_UNCHANGED:
+      st.notModified++;
+      break;
+
+    case EVENT_FETCH_CHANGED:
+      if (!force && strcmp(scratch.id, knownId) == 0) {
+        break;   // New etag, same event (renamed, roster changed)
+      }
+      if (changed.push(scratch)) {
+        st.changes++;
+        strcpy(knownId, scratch.id);
+        knownNone = false;
+      } else {
+        etag[0] = '\0';   // Loop task behind: ask again next time
+      }
+      break;
+
+    case EVENT_FETCH_NONE:
+      // Once per stretch without an event; whatever comes next counts
+      // as a change
+      knownId[0] = '\0';
+      etag[0] = '\0';
+      if (!knownNone || force) {
+        memset(&scratch, 0, sizeof(scratch));
+        if (changed.push(scratch)) {
+          st.changes++;
+          knownNone = true;
+        }
+      }
+      break;
+
+    case EVENT_FETCH_FAILED:
+      st.failures++;
+      forceNext = force;
+      break;
+  }
+
+  schedule(nowMs, result == EVENT_FETCH_FAILED);
+  return true;
+}
+
+uint32_t EventPoller::idleWaitMs(uint32_t nowMs) const {
+  if (refreshAsked.load(std::memory_order_acquire) && !waitingLink) {
+    return 0;
+  }
+  int32_t left = (int32_t)(nextPollMs - nowMs);
+  return left > 0 ? (uint32_t)left : 0;
+}
+
+// Next poll: the interval +-25% after an answer; after a failure
+// EVENT_POLL_RETRY, doubling per failure up to the interval
+void EventPoller::schedule(uint32_t nowMs, bool failed) {
+  uint32_t delay;
+  if (failed) {
+    delay = EVENT_POLL_RETRY;
+    for (uint8_t i = 0; i < failStreak && delay < EVENT_POLL_INTERVAL; i++) {
+      delay *= 2;
+    }
+    if (delay > EVENT_POLL_INTERVAL) {
+      delay = EVENT_POLL_INTERVAL;
+    }
+    if (failStreak < 255) {
+      failStreak++;
+    }
+  } else {
+    failStreak = 0;
+    delay = EVENT_POLL_INTERVAL * 3 / 4 + nextRandom() % (EVENT_POLL_INTERVAL / 2 + 1);
+  }
+  nextPollMs = nowMs + delay;
+}
+
+// xorshift32
+uint32_t EventPoller::nextRandom() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
@@ -0,0 +1,63 @@
+#include "frame_diff.h"
+#include <string.h>
+
+// Per I2C write: address byte + control byte (0x00 command / 0x40 data)
+#define WRITE_OVERHEAD 2
+// Column window (0x21 a b) + page window (0x22 a b)
+#define WINDOW_COMMAND_BYTES 6
+
+uint8_t diffFrame(const uint8_t* frame, uint8_t* shadow, DirtySpan* spans) {
+  uint8_t count = 0;
+  for (uint8_t page = 0; page < FRAME_PAGES; page++) {
+    const uint8_t* next = frame + page * FRAME_COLUMNS;
+    uint8_t* shown = shadow + page * FRAME_COLUMNS;
+
+    int first = 0;
+    while (first < FRAME_COLUMNS && next[first] == shown[first]) {
+      first++;
+    }
+    if (first == FRAME_COLUMNS) {
+      continue;
+    }
+    int last = FRAME_COLUMNS - 1;
+    while (next[last] == shown[last]) {
+      last--;
+    }
+
+    memcpy(shown + first, next + first, last - first + 1);
+    spans[count].page = page;
+    spans[count].first = (uint8_t)first;
+    spans[count].last = (uint8_t)last;
+    count++;
+  }
+  return count;
+}
+
+size_t spanDataBytes(const DirtySpan* spans, uint8_t count) {
+  size_t bytes = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    bytes += spans[i].last - spans[i].first + 1;
+  }
+  return bytes;
+}
+
+static size_t windowWireBytes(size_t dataBytes) {
+  size_t writes = (dataBytes + FRAME_I2C_CHUNK - 1) / FRAME_I2C_CHUNK;
+  return WRITE_OVERHEAD + WINDOW_COMMAND_BYTES + dataBytes + writes * WRITE_OVERHEAD;
+}
+
+size_t spanWireBytes(const DirtySpan* spans, uint8_t count) {
+  size_t bytes = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    bytes += windowWireBytes(spans[i].last - spans[i].first + 1);
+  }
+  return bytes;
+}
+
+size_t fullFrameWireBytes() {
+  return windowWireBytes(FRAME_BYTES);
+}
+
+uint32_t wireTimeUs(size_t wireBytes, uint32_t clockHz) {
+  return (uint32_t)((uint64_t)wireBytes * 9 * 1000000 / clockHz);
+}
@@ -0,0 +1,26 @@
+#include "hal.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// ==========================================
+// SHARED HELPERS
+// ==========================================
+
+void HalDisplay::print(const char* text) {
+  write(text, strlen(text));
+}
+
+void HalDisplay::println(const char* text) {
+  write(text, strlen(text));
+  write("\n", 1);
+}
+
+void HalLog::printf(const char* format, ...) {
+  char line[160];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  write(line);
+}
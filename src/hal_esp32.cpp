@@ -0,0 +1,80 @@
+#include "hal_esp32.h"
+
+static TaskHandle_t wakeTask = NULL;
+
+// ==========================================
+// BUTTONS
+// ==========================================
+
+GpioButtons::GpioButtons(uint8_t fetchPin, uint8_t clearPin) : droppedEdges(0) {
+  lines[BUTTON_FETCH].button = BUTTON_FETCH;
+  lines[BUTTON_FETCH].pin = fetchPin;
+  lines[BUTTON_CLEAR].button = BUTTON_CLEAR;
+  lines[BUTTON_CLEAR].pin = clearPin;
+  for (Line& line : lines) {
+    line.owner = this;
+    line.overflow = false;
+    line.hasNext = false;
+  }
+}
+
+void GpioButtons::setWakeTask(TaskHandle_t task) {
+  wakeTask = task;
+}
+
+void GpioButtons::begin() {
+  for (Line& line : lines) {
+    attachInterruptArg(line.pin, onEdge, &line, CHANGE);
+  }
+}
+
+// Each pin has its own ISR and queue: one producer per queue
+void IRAM_ATTR GpioButtons::onEdge(void* arg) {
+  Line* line = (Line*)arg;
+  ButtonEdge edge;
+  edge.button = line->button;
+  edge.down = digitalRead(line->pin) == LOW; // Active low (INPUT_PULLUP)
+  edge.ms = millis();
+  if (!line->edges.push(edge)) {
+    line->overflow = true;
+    line->owner->droppedEdges++;
+  }
+
+  if (wakeTask) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(wakeTask, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+bool GpioButtons::peek(Line& line) {
+  if (line.hasNext) {
+    return true;
+  }
+  if (line.edges.pop(line.next)) {
+    line.hasNext = true;
+  } else if (line.overflow) {
+    // Edges were lost: resynchronise on the level as it is now
+    line.overflow = false;
+    line.next.button = line.button;
+    line.next.down = digitalRead(line.pin) == LOW;
+    line.next.ms = millis();
+    line.hasNext = true;
+  }
+  return line.hasNext;
+}
+
+bool GpioButtons::nextEdge(ButtonEdge& edge) {
+  bool fetch = peek(lines[BUTTON_FETCH]);
+  bool clear = peek(lines[BUTTON_CLEAR]);
+  if (!fetch && !clear) {
+    return false;
+  }
+  Line* line = &lines[fetch ? BUTTON_FETCH : BUTTON_CLEAR];
+  if (fetch && clear && (int32_t)(lines[BUTTON_CLEAR].next.ms - lines[BUTTON_FETCH].next.ms) < 0) {
+    line = &lines[BUTTON_CLEAR];
+  }
+  edge = line->next;
+  line->hasNext = false;
+  return true;
+}
@@ -0,0 +1,72 @@
+#include "latency_histogram.h"
+
+static const uint32_t bucketBounds[LATENCY_BUCKETS] = {
+  50, 100, 250, 500,
+  1000, 2500, 5000, 10000, 25000, 50000,
+  100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+LatencyHistogram::LatencyHistogram() {
+  reset();
+}
+
+void LatencyHistogram::reset() {
+  for (size_t i = 0; i <= LATENCY_BUCKETS; i++) {
+    buckets[i].store(0, std::memory_order_relaxed);
+  }
+  total.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+  peak.store(0, std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::bucketBoundUs(size_t i) {
+  return bucketBounds[i];
+}
+
+void LatencyHistogram::record(uint32_t us) {
+  size_t i = 0;
+  while (i < LATENCY_BUCKETS && us > bucketBounds[i]) {
+    i++;
+  }
+  buckets[i].fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(1, std::memory_order_relaxed);
+  sum.fetch_add(us, std::memory_order_relaxed);
+
+  uint32_t seen = peak.load(std::memory_order_relaxed);
+  while (us > seen && !peak.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {
+  }
+}
+
+uint32_t LatencyHistogram::percentileUs(float fraction) const {
+  uint32_t n = count();
+  if (n == 0) {
+    return 0;
+  }
+
+  // Rank of the wanted sample, then the bucket it falls in
+  float rank = fraction * n;
+  uint32_t below = 0;
+  for (size_t i = 0; i <= LATENCY_BUCKETS; i++) {
+    uint32_t inBucket = bucketCount(i);
+    if (inBucket == 0 || below + inBucket < rank) {
+      below += inBucket;
+      continue;
+    }
+    // Overflow bucket has no upper bound - the largest sample is the best answer
+    if (i == LATENCY_BUCKETS) {
+      return maxUs();
+    }
+    uint32_t lower = i == 0 ? 0 : bucketBounds[i - 1];
+    uint32_t upper = bucketBounds[i];
+    uint32_t max = maxUs();
+    if (max < upper) {
+      upper = max;   // Never report beyond what was actually seen
+    }
+    if (upper <= lower) {
+      return upper;
+    }
+    float within = (rank - below) / inBucket;
+    return lower + (uint32_t)(within * (upper - lower));
+  }
+  return maxUs();
+}
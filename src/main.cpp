@@ -5,42 +5,62 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include <WiFi.h>
-#include <WiFiManager.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include "config.h"
 #include "attendance_mode.h"
+#include "api_client.h"
+#include "card_uid.h"
+#include "reader_array.h"
+#include "rc522_reader.h"
+#include "json_arena.h"
+#include "hal_esp32.h"
+#include "screens.h"
+#include "device_controller.h"
+#include "tap_metrics.h"
+#include "metrics_server.h"
+#include "memory_monitor.h"
+#include "session_store.h"
+#include "boot_timeline.h"
+#include "wifi_link.h"
 
 // ==========================================
-// MODE DEFINITIONS
+// GLOBAL OBJECTS
 // ==========================================
 
-enum DeviceMode {
-  MODE_REGISTRATION,    // Phase 2: Card registration mode
-  MODE_ATTENDANCE       // Phase 3: Event attendance mode
-};
+static const uint8_t readerSsPins[RC522_READER_COUNT] = RC522_SS_PINS;
+static const int readerIrqPins[RC522_READER_COUNT] = RC522_IRQ_PINS;
+Rc522CardReader cardReaders[RC522_READER_COUNT];
+ReaderArray readers;
+Adafruit_SSD1306 display(OLED_WIDTH, OLED_HEIGHT, &Wire, OLED_RESET, OLED_I2C_CLOCK, OLED_I2C_CLOCK);
+OledRenderer oledRenderer(display, Wire, OLED_I2C_ADDR);
 
 // ==========================================
-// GLOBAL OBJECTS
+// HAL + STATE MACHINES
 // ==========================================
 
-MFRC522 rfid(RC522_SS_PIN, RC522_RST_PIN);
-Adafruit_SSD1306 display(OLED_WIDTH, OLED_HEIGHT, &Wire, OLED_RESET);
-WiFiManager wifiManager;
+EspClock halClock;
+Ssd1306Display oled(display, oledRenderer);
+GpioBuzzer buzzer(BUZZER_PIN);
+GpioButtons buttons(BUTTON_PIN, BUTTON_CLEAR_PIN);
+SerialLog halLog;
+UiScheduler ui(buzzer);
+
+int sendCardToAPI(const CardUid& cardUid);
+
+AttendanceController& attendance = attendanceController(oled, halClock, ui, halLog);
+DeviceController device(attendance, sendCardToAPI, oled, halClock, buttons, ui, halLog);
 
 // ==========================================
-// STATE VARIABLES
+// SESSION + BOOT
 // ==========================================
 
-DeviceMode currentMode = MODE_REGISTRATION;
-String lastCardUid = "";
-unsigned long lastCardTime = 0;
-
-// Button state tracking
-unsigned long buttonPressStart = 0;
-unsigned long buttonClearPressStart = 0;
-bool buttonPressed = false;
-bool buttonClearPressed = false;
+SessionState session;                     // As stored at boot
+static uint32_t savedSessionChanges = UINT32_MAX;   // Forces a save on the first pass
+static uint32_t savedJournalNext = 0;
+static uint32_t savedRosterVersion = 0;
+BootTimeline bootTimeline;
+static bool metricsStarted = false;       // Waits for the link (port 80 is the setup portal's until then)
 
 // ==========================================
 // FUNCTION DECLARATIONS
@@ -49,21 +69,14 @@ bool buttonClearPressed = false;
 void initSerial();
 void initButton();
 void initBuzzer();
-void buzzCard();
 void initRFID();
+void waitForCard();
 void initOLED();
-void initWiFi();
-String readCardUID();
-void displayOnOLED(String line1, String line2, String line3);
-void handleCardDetected(String cardUid);
-int sendCardToAPI(String cardUid);
-void displaySending(String uid);
-void displayWaiting();
-void displayError(String line1, String line2);
-void displayReady();
-void checkFetchButton();
-void checkClearButton();
-void switchMode();
+void onLinkUp();
+void checkSerialCommands();
+void printReaderStats();
+void printDisplayStats();
+void persistSession();
 
 // ==========================================
 // SETUP
@@ -78,70 +91,91 @@ void setup() {
   Serial.println("========================================\n");
 
   initSerial();
+  bootTimeline.mark("serial", micros());
+  if (loadSession(session)) {
+    Serial.println("✓ Stored session: " + String(session.attendanceMode ? "attendance" : "registration") +
+                   " mode" + (session.eventId[0] ? ", event " + String(session.eventName) : String("")));
+  }
+  bootTimeline.mark("session load", micros());
+  
+  // Association and the flash work run on core 0 while this core brings
+  // up the panel and readers; nothing below waits for the network
+  startWiFi();
+  bootTimeline.mark("wifi start", micros());
+  startCheckinQueue(session);
+  bootTimeline.mark("journal start", micros());
   initButton();
   initBuzzer();
+  bootTimeline.mark("gpio", micros());
   initOLED();
+  bootTimeline.mark("oled", micros());
   initRFID();
-  initWiFi();
+  bootTimeline.mark("rc522", micros());
+  initApiClient();
+  
+  // Timestamps for journaled check-ins (syncs once the link is up)
+  configTime(0, 0, NTP_SERVER);
+  bootTimeline.mark("services", micros());
+  waitCheckinQueue();
+  bootTimeline.mark("journal + roster", micros());
   
   Serial.println("\n✓ All systems initialized!");
   Serial.println("========================================");
-  Serial.println("Mode: Registration (Hold button 5s to switch)");
+  Serial.println(session.attendanceMode ? "Mode: Attendance (resumed)"
+                                        : "Mode: Registration (Hold button 5s to switch)");
   Serial.println("========================================\n");
   
-  displayReady();
+  // Straight back to the stored event after a reboot
+  device.resume(session);
+  bootTimeline.mark("resume", micros());
 }
 
 void loop() {
-  // Check buttons first
-  checkFetchButton();
-  checkClearButton();
+  if (!bootTimeline.isCardReady()) {
+    bootTimeline.cardReady(micros());
+    bootTimeline.print(halLog, BOOT_BUDGET_MS);
+  }
   
-  // Check for new cards
-  if (!rfid.PICC_IsNewCardPresent()) {
-    return;
+  // Buttons first, then check-in results coming back from the network task
+  device.poll();
+  if (pollWiFi(oled, ui)) {
+    onLinkUp();
+  }
+  checkSerialCommands();
+  pollMetricsServer();
+  persistSession();
+  // Roster syncs held back while the heap was short
+  if (pollMemoryMonitor() && !memoryDegraded() && wifiLinkUp()) {
+    syncDeferredRoster();
   }
   
-  // Select one of the cards
-  if (!rfid.PICC_ReadCardSerial()) {
+  // Check every door for a new card
+  CardTap tap;
+  if (!readers.poll(tap)) {
+    waitForCard();
     return;
   }
-  
-  // Card detected!
-  String cardUid = readCardUID();
-  
-  // Cooldown check
-  if (cardUid == lastCardUid && (millis() - lastCardTime < CARD_COOLDOWN)) {
-    rfid.PICC_HaltA();
-    rfid.PCD_StopCrypto1();
+
+  // Same card again within the cooldown (any door) - nothing to do
+  if (device.dropRepeat(tap)) {
     return;
   }
   
-  lastCardUid = cardUid;
-  lastCardTime = millis();
+  const CardUid& cardUid = tap.uid;
   
   Serial.println("\n========================================");
   Serial.println("✓ CARD DETECTED!");
   Serial.println("========================================");
-  Serial.println("Card UID: " + cardUid);
-  Serial.println("Card Type: " + String(rfid.PICC_GetTypeName(rfid.PICC_GetType(rfid.uid.sak))));
+  Serial.print("Card UID: ");
+  Serial.println(cardUid.text().c_str());
+  // SAK only: the library's type-name lookup is not worth it on the tap path
+  Serial.printf("Card SAK: 0x%02X\n", cardReaders[tap.reader].sak());
+  Serial.print("Door: ");
+  Serial.println(getDoorName(tap.reader));
   Serial.println("========================================\n");
   
-  // Beep buzzer for feedback
-  buzzCard();
-  
-  // Handle card based on current mode
-  if (currentMode == MODE_REGISTRATION) {
-    handleCardDetected(cardUid);
-  } else {
-    runAttendanceMode(display, cardUid);
-  }
-  
-  // Halt PICC
-  rfid.PICC_HaltA();
-  rfid.PCD_StopCrypto1();
-  
-  delay(100);
+  // Beep, then registration or attendance depending on the mode
+  device.onTap(tap);
 }
 
 // ==========================================
@@ -150,13 +184,15 @@ void loop() {
 
 void initSerial() {
   Serial.begin(SERIAL_BAUD);
-  delay(100);
   Serial.println("✓ Serial initialized");
 }
 
 void initButton() {
   pinMode(BUTTON_PIN, INPUT_PULLUP);
   pinMode(BUTTON_CLEAR_PIN, INPUT_PULLUP);
+  // Edges are timestamped in the ISR and wake the loop task
+  GpioButtons::setWakeTask(xTaskGetCurrentTaskHandle());
+  buttons.begin();
   Serial.println("✓ Buttons initialized");
   Serial.println("  GPIO" + String(BUTTON_PIN) + " - Fetch/Mode switch");
   Serial.println("  GPIO" + String(BUTTON_CLEAR_PIN) + " - Clear event");
@@ -169,13 +205,8 @@ void initBuzzer() {
   Serial.println("  GPIO" + String(BUZZER_PIN) + " - Card detection feedback");
 }
 
-void buzzCard() {
-  digitalWrite(BUZZER_PIN, HIGH);
-  delay(BUZZER_DURATION);
-  digitalWrite(BUZZER_PIN, LOW);
-}
-
 void initOLED() {
+  MemScope heap(memoryWatch(), MEM_TAG_DISPLAY);
   Serial.println("\nInitializing OLED display...");
   Wire.begin(OLED_SDA_PIN, OLED_SCL_PIN);
   
@@ -194,354 +225,212 @@ void initOLED() {
   display.setCursor(0, 0);
   display.println("OLED OK!");
   display.display();
-  delay(1000);
+  
+  // From here on frames go out from the display task, changed pages only
+  if (oledRenderer.begin()) {
+    Serial.println("✓ Display task started (" + String(OLED_I2C_CLOCK / 1000) + " kHz I2C)");
+  } else {
+    Serial.println("✗ Display task creation failed - drawing synchronously");
+  }
 }
 
 void initRFID() {
-  Serial.println("\nInitializing RC522 NFC reader...");
+  Serial.println("\nInitializing RC522 NFC readers...");
   SPI.begin();
-  rfid.PCD_Init();
   
-  byte version = rfid.PCD_ReadRegister(rfid.VersionReg);
-  
-  if (version == 0x00 || version == 0xFF) {
-    Serial.println("✗ RC522 communication failed!");
-    Serial.println("  Version read: 0x" + String(version, HEX));
-    Serial.println("  Check wiring and power (connect RC522 3.3V to ESP32 VIN)");
-    displayOnOLED("RC522 FAIL", "Check wiring", "");
-    while (1) delay(1000);
+  // Deselect every reader before talking to any of them on the shared bus
+  for (uint8_t i = 0; i < RC522_READER_COUNT; i++) {
+    pinMode(readerSsPins[i], OUTPUT);
+    digitalWrite(readerSsPins[i], HIGH);
   }
   
-  Serial.println("✓ RC522 initialized");
-  Serial.println("  Firmware: 0x" + String(version, HEX));
-  rfid.PCD_DumpVersionToSerial();
-}
-
-void initWiFi() {
-  Serial.println("\nInitializing WiFi...");
-  
-  // Check if we have saved WiFi credentials
-  WiFi.begin(); // Try to connect with saved credentials
-  delay(100);
+#if CARD_DETECT_IRQ
+  // Reader IRQs wake this (the loop) task
+  Rc522CardReader::setWakeTask(xTaskGetCurrentTaskHandle());
+#endif
   
-  if (WiFi.SSID() != "") {
-    // We have saved credentials, try to connect
-    displayOnOLED("WiFi", "Connecting to:", WiFi.SSID());
-    Serial.println("Found saved WiFi: " + WiFi.SSID());
+  for (uint8_t i = 0; i < RC522_READER_COUNT; i++) {
+    MFRC522& rfid = cardReaders[i].rfid;
+    byte version = cardReaders[i].begin(readerSsPins[i], RC522_RST_PIN,
+                                        CARD_DETECT_IRQ ? readerIrqPins[i] : -1);
     
-    // Wait up to 15 seconds for connection
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-      delay(500);
-      Serial.print(".");
-      attempts++;
+    if (version == 0x00 || version == 0xFF) {
+      // A missing door reader must not take the others down
+      Serial.println("✗ RC522 #" + String(i) + " (" + getDoorName(i) + ", SS GPIO" +
+                     String(readerSsPins[i]) + ") communication failed!");
+      Serial.println("  Version read: 0x" + String(version, HEX));
+      continue;
     }
-    Serial.println();
     
-    if (WiFi.status() == WL_CONNECTED) {
-      // Successfully connected!
-      Serial.println("✓ WiFi connected!");
-      Serial.println("  SSID: " + WiFi.SSID());
-      Serial.println("  IP: " + WiFi.localIP().toString());
-      Serial.println("  Signal: " + String(WiFi.RSSI()) + " dBm");
-      
-      displayOnOLED("WiFi OK!", WiFi.localIP().toString(), "Ready!");
-      delay(2000);
-      return;
-    }
+    readers.add(&cardReaders[i], i);
     
-    // Failed to connect with saved credentials
-    Serial.println("✗ Saved WiFi failed, starting setup...");
+    Serial.println("✓ RC522 #" + String(i) + " initialized (" + getDoorName(i) + ", " +
+                   (cardReaders[i].irqMode() ? "IRQ GPIO" + String(readerIrqPins[i]) : String("polling")) + ")");
+    Serial.println("  Firmware: 0x" + String(version, HEX));
+    rfid.PCD_DumpVersionToSerial();
   }
   
-  // No saved credentials OR connection failed - start config portal
-  displayOnOLED("WiFi Setup", "Connect to:", "ESP32-AATCC");
-  delay(1000);
-  
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 0);
-  display.println("WiFi Setup Mode");
-  display.println("");
-  display.println("1. Connect phone to:");
-  display.setTextSize(2);
-  display.println("ESP32-AATCC");
-  display.setTextSize(1);
-  display.println("");
-  display.println("2. Follow popup to");
-  display.println("   select your WiFi");
-  display.display();
-  
-  Serial.println("----------------------------------------");
-  Serial.println("WiFi Setup Mode Active");
-  Serial.println("1. Connect your phone/laptop to WiFi:");
-  Serial.println("   Network: ESP32-AATCC");
-  Serial.println("   (No password needed)");
-  Serial.println("2. A popup will appear automatically");
-  Serial.println("3. Select your WiFi and enter password");
-  Serial.println("4. ESP32 will connect and save settings");
-  Serial.println("----------------------------------------");
-  
-  // Set WiFiManager timeout
-  wifiManager.setConfigPortalTimeout(180); // 3 minutes
-  wifiManager.setConnectTimeout(30); // 30 seconds to connect
-  
-  if (!wifiManager.autoConnect("ESP32-AATCC")) {
-    Serial.println("✗ WiFi setup timeout!");
-    displayOnOLED("WiFi Failed", "Restarting...", "Try again");
-    delay(3000);
-    ESP.restart();
+  if (readers.size() == 0) {
+    Serial.println("✗ No RC522 reader responded!");
+    Serial.println("  Check wiring and power (connect RC522 3.3V to ESP32 VIN)");
+    displayOnOLED(oled, "RC522 FAIL", "Check wiring", "");
+    while (1) delay(1000);
   }
-  
-  Serial.println("✓ WiFi connected!");
-  Serial.println("  SSID: " + WiFi.SSID());
-  Serial.println("  IP: " + WiFi.localIP().toString());
-  Serial.println("  Signal: " + String(WiFi.RSSI()) + " dBm");
-  
-  displayOnOLED("WiFi OK!", WiFi.localIP().toString(), "Connected!");
-  delay(2000);
 }
 
-// ==========================================
-// RFID FUNCTIONS
-// ==========================================
-
-String readCardUID() {
-  String uid = "";
-  
-  for (byte i = 0; i < rfid.uid.size; i++) {
-    if (rfid.uid.uidByte[i] < 0x10) {
-      uid += "0";
-    }
-    uid += String(rfid.uid.uidByte[i], HEX);
-    
-    if (i < rfid.uid.size - 1) {
-      uid += ":";
+// Nothing tapped this pass. Polling mode goes straight round the loop
+// again; IRQ mode runs the probe schedule and sleeps until a reader or
+// button IRQ, the next probe, the next screen/buzzer/button deadline, or
+// CARD_IRQ_IDLE_WAIT for results.
+void waitForCard() {
+#if CARD_DETECT_IRQ
+  // Wake in time for the next screen/buzzer deadline too
+  uint32_t waitMs = device.msUntilNext(CARD_IRQ_IDLE_WAIT);
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < RC522_READER_COUNT; i++) {
+    uint32_t readerWait = cardReaders[i].sense(now);
+    if (readerWait < waitMs) {
+      waitMs = readerWait;
     }
   }
-  
-  uid.toUpperCase();
-  return uid;
+  if (waitMs > 0) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+  }
+#endif
+}
+
+// The link came up (first time, or back after a drop)
+void onLinkUp() {
+  if (!metricsStarted) {
+    initMetricsServer();
+    metricsStarted = true;
+  }
+  syncDeferredRoster();
 }
 
 // ==========================================
 // API CLIENT FUNCTIONS
 // ==========================================
 
-void handleCardDetected(String cardUid) {
-  // Step 1: Send card to API
-  displaySending(cardUid);
-  int httpCode = sendCardToAPI(cardUid);
-  
-  if (httpCode == 409) {
-    // Card already activated
-    displayError("Card already", "activated");
-    delay(3000);
-    displayReady();
-    return;
-  }
-  
-  if (httpCode != 200) {
-    displayError("API Error", "Check connection");
-    delay(3000);
-    displayReady();
-    return;
-  }
-  
-  // Step 2: Card sent successfully, wait 5 seconds
-  displayWaiting();
-  delay(5000);
-  
-  // Step 3: Return to ready (admin activates in browser)
-  displayReady();
-}
-
-int sendCardToAPI(String cardUid) {
-  if (WiFi.status() != WL_CONNECTED) {
+int sendCardToAPI(const CardUid& cardUid) {
+  if (!wifiLinkUp()) {
     Serial.println("✗ WiFi not connected!");
     return -1;
   }
   
-  HTTPClient http;
-  String url = String(API_URL) + String(ENDPOINT_CARDS_DETECTED);
+  ApiRequest req(ENDPOINT_CARDS_DETECTED, API_LOOP_WAIT);
   
-  Serial.println("POST " + url);
+  Serial.println("POST " + String(ENDPOINT_CARDS_DETECTED));
   
-  http.begin(url);
-  http.addHeader("Content-Type", "application/json");
-  http.addHeader("x-device-api-key", DEVICE_API_KEY);
-  http.setTimeout(API_TIMEOUT);
+  req.addHeader("Content-Type", "application/json");
   
   // Create JSON: { "uid": "AA:BB:CC:...", "deviceId": "device-001" }
-  JsonDocument doc;
-  doc["uid"] = cardUid;
+  static JsonArena<JSON_DOC_CAPACITY> arena;
+  JsonDocument doc(&arena);
+  doc["uid"] = cardUid.text().c_str();
   doc["deviceId"] = DEVICE_ID;
   
-  String requestBody;
-  serializeJson(doc, requestBody);
+  char requestBody[JSON_PAYLOAD_MAX];
+  size_t len = serializeJson(doc, requestBody, sizeof(requestBody));
   
-  Serial.println("Sending: " + requestBody);
+  Serial.print("Sending: ");
+  Serial.println(requestBody);
   
-  int httpCode = http.POST(requestBody);
+  int httpCode = req.POST((const uint8_t*)requestBody, len);
   
   Serial.println("Response code: " + String(httpCode));
   
-  http.end();
-  
   return httpCode;
 }
 
 // ==========================================
-// DISPLAY FUNCTIONS
+// SERIAL DIAGNOSTICS
 // ==========================================
 
-void displayReady() {
-  display.clearDisplay();
-  display.setTextSize(2);
-  display.setCursor(0, 0);
-  display.println("Ready");
-  
-  display.setTextSize(1);
-  display.setCursor(0, 24);
-  display.println("Tap card to");
-  display.setCursor(0, 40);
-  display.println("register...");
-  
-  display.display();
-}
-
-void displaySending(String uid) {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 0);
-  display.println("Card Detected!");
-  display.println("");
-  display.println("UID:");
-  display.println(uid.substring(0, 17));
-  display.println("");
-  display.println("Sending...");
-  display.display();
-}
-
-void displayWaiting() {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 10);
-  display.println("Card sent!");
-  display.println("");
-  display.println("Admin: activate");
-  display.println("in browser");
-  display.display();
-}
-
-void displayError(String line1, String line2) {
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setCursor(0, 20);
-  display.println(line1);
-  display.println(line2);
-  display.display();
-}
-
-void displayOnOLED(String line1, String line2, String line3) {
-  display.clearDisplay();
-  display.setTextSize(2);
-  display.setCursor(0, 0);
-  display.println(line1);
-  
-  display.setTextSize(1);
-  display.setCursor(0, 24);
-  display.println(line2);
-  
-  display.setCursor(0, 40);
-  display.println(line3);
-  
-  display.display();
-}
-// ==========================================
-// BUTTON HANDLING
-// ==========================================
-
-void checkFetchButton() {
-  bool buttonState = digitalRead(BUTTON_PIN) == LOW; // Active low (INPUT_PULLUP)
-  
-  if (buttonState && !buttonPressed) {
-    // Button just pressed
-    buttonPressed = true;
-    buttonPressStart = millis();
-    Serial.println("Fetch button pressed");
+// Single-letter diagnostics over the serial monitor
+void checkSerialCommands() {
+  if (!Serial.available()) {
+    return;
   }
   
-  if (!buttonState && buttonPressed) {
-    // Button just released
-    buttonPressed = false;
-    unsigned long pressDuration = millis() - buttonPressStart;
-    
-    Serial.println("Fetch button released - duration: " + String(pressDuration) + "ms");
-    
-    // Check for long press (mode switch)
-    if (pressDuration >= BUTTON_LONG_PRESS) {
-      Serial.println("Long press detected (>= 5s) - switching mode");
-      switchMode();
-      return;
-    }
-    
-    // Short press - handle based on mode
-    if (currentMode == MODE_ATTENDANCE) {
-      Serial.println("Short press in attendance mode - fetching event");
-      handleFetchButton(display, false);
-    } else {
-      Serial.println("Short press in registration mode - ignored");
-    }
-    
-    delay(BUTTON_DEBOUNCE);
+  switch (Serial.read()) {
+    case 's':
+      printApiStats();
+      printRosterStats();
+      printEventPollerStats();
+      printReaderStats();
+      printDisplayStats();
+      printWifiStats();
+      printTapMetrics(halLog);
+      printMemoryStats(halLog);
+      break;
+    case 'b':
+      bootTimeline.print(halLog, BOOT_BUDGET_MS);
+      break;
+    default:
+      break;
   }
 }
 
-void checkClearButton() {
-  bool buttonState = digitalRead(BUTTON_CLEAR_PIN) == LOW; // Active low (INPUT_PULLUP)
-  
-  if (buttonState && !buttonClearPressed) {
-    // Button just pressed
-    buttonClearPressed = true;
-    buttonClearPressStart = millis();
-    Serial.println("Clear button pressed");
+// Save the session when the mode or event changed, a roster sync stored
+// a new version, or the journal moved on SESSION_CURSOR_STRIDE records
+// since the last save. Unchanged state is not rewritten (saveSession()
+// compares).
+void persistSession() {
+  uint32_t next, tail;
+  journalCursor(next, tail);
+  uint32_t changes = device.sessionChanges();
+  uint32_t version = rosterVersion();
+  if (changes == savedSessionChanges && version == savedRosterVersion &&
+      next - savedJournalNext < SESSION_CURSOR_STRIDE) {
+    return;
   }
   
-  if (!buttonState && buttonClearPressed) {
-    // Button just released
-    buttonClearPressed = false;
-    unsigned long pressDuration = millis() - buttonClearPressStart;
-    
-    Serial.println("Clear button released - duration: " + String(pressDuration) + "ms");
-    
-    // Only handle in attendance mode
-    if (currentMode == MODE_ATTENDANCE) {
-      Serial.println("Clear button - clearing event");
-      handleClearButton(display);
-    } else {
-      Serial.println("Clear button in registration mode - ignored");
+  SessionState state = {};
+  state.attendanceMode = device.mode() == MODE_ATTENDANCE;
+  snprintf(state.eventId, sizeof(state.eventId), "%s", attendance.eventId());
+  snprintf(state.eventName, sizeof(state.eventName), "%s", attendance.eventName());
+  state.rosterVersion = version;
+  state.journalNext = next;
+  state.journalTail = tail;
+  saveSession(state);
+  
+  savedSessionChanges = changes;
+  savedRosterVersion = version;
+  savedJournalNext = next;
+}
+
+void printReaderStats() {
+  Serial.println("Reader stats (" + String(CARD_DETECT_IRQ ? "IRQ" : "polling") + " mode):");
+  uint32_t uptimeMs = millis();
+  for (uint8_t i = 0; i < readers.size(); i++) {
+    const ReaderStats& st = readers.stats(i);
+    const Rc522Stats& hw = cardReaders[readers.id(i)].stats();
+    Serial.println("  " + String(getDoorName(readers.id(i))) + ": " + String(st.taps) + " taps, " +
+                   String(st.polls) + " polls");
+    // SPI busy time per second of uptime: the cost of waiting for cards
+    Serial.println("    Probes: " + String(hw.probes) + ", IRQs: " + String(hw.irqs) +
+                   ", SPI busy: " + String((uint32_t)(hw.busyUs / 1000)) + "ms (" +
+                   String(uptimeMs ? (uint32_t)(hw.busyUs / uptimeMs) : 0) + "us/ms)");
+    const Rc522BusStats& spi = cardReaders[readers.id(i)].spiStats();
+    Serial.println("    SPI: " + String(spi.transactions) + " transactions, " + String(spi.bytes) +
+                   " bytes at " + String(RC522_SPI_CLOCK / 1000000) + " MHz");
+    if (hw.irqs > 0) {
+      Serial.println("    IRQ to UID: " + String(hw.lastDetectUs) + "us (max " + String(hw.maxDetectUs) + "us)");
     }
-    
-    delay(BUTTON_DEBOUNCE);
   }
+  const UidCache& recent = device.recentCards();
+  Serial.println("  Repeats dropped: " + String(recent.hits()) + " of " +
+                 String(recent.hits() + recent.misses()) + " cards (" + String(recent.size()) + " remembered)");
 }
 
-void switchMode() {
-  if (currentMode == MODE_REGISTRATION) {
-    currentMode = MODE_ATTENDANCE;
-    initAttendanceMode();
-    displayNoEvent(display);
-    
-    Serial.println("\n========================================");
-    Serial.println("SWITCHED TO: ATTENDANCE MODE");
-    Serial.println("========================================\n");
-  } else {
-    currentMode = MODE_REGISTRATION;
-    displayReady();
-    
-    Serial.println("\n========================================");
-    Serial.println("SWITCHED TO: REGISTRATION MODE");
-    Serial.println("========================================\n");
+void printDisplayStats() {
+  OledStats st = oledRenderer.stats();
+  Serial.println("Display: " + String(st.submitted) + " frames, " + String(st.sent) + " sent, " +
+                 String(st.superseded) + " superseded");
+  if (st.sent > 0) {
+    Serial.println("  I2C: " + String((uint32_t)(st.wireBytes / st.sent)) + " bytes/frame avg (full frame " +
+                   String((unsigned int)fullFrameWireBytes()) + "), flush " + String(st.lastFlushUs) +
+                   "us (max " + String(st.maxFlushUs) + "us)");
   }
 }
@@ -0,0 +1,114 @@
+#include "memory_monitor.h"
+#include "config.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+// mbedTLS and the Wi-Fi driver allocate from internal RAM; PSRAM (if
+// any) does not help a handshake
+#define MEM_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+// ==========================================
+// PROBE (ESP32 heap + FreeRTOS tasks)
+// ==========================================
+
+class EspMemoryProbe : public MemoryProbe {
+public:
+  EspMemoryProbe() {
+    memset(handles, 0, sizeof(handles));
+  }
+  uint32_t freeHeap() override {
+    return heap_caps_get_free_size(MEM_CAPS);
+  }
+  uint32_t largestBlock() override {
+    return heap_caps_get_largest_free_block(MEM_CAPS);
+  }
+  uint32_t minFreeHeap() override {
+    return heap_caps_get_minimum_free_size(MEM_CAPS);
+  }
+  bool stack(MemTask task, uint32_t& size, uint32_t& unused) override {
+    static const char* const names[MEM_TASK_COUNT] = { "loopTask", "net", "wifi", "oled" };
+    static const uint32_t sizes[MEM_TASK_COUNT] = {
+      CONFIG_ARDUINO_LOOP_STACK_SIZE, NET_TASK_STACK, WIFI_TASK_STACK, OLED_TASK_STACK
+    };
+    // Tasks start at different times during setup; look each up until found
+    if (!handles[task]) {
+      handles[task] = xTaskGetHandle(names[task]);
+      if (!handles[task]) {
+        return false;
+      }
+    }
+    size = sizes[task];
+    unused = uxTaskGetStackHighWaterMark(handles[task]);   // Bytes on ESP-IDF
+    return true;
+  }
+
+private:
+  TaskHandle_t handles[MEM_TASK_COUNT];
+};
+
+static EspMemoryProbe probe;
+static MemoryWatch watch(probe, MEM_TLS_BLOCK, MEM_TLS_HEAP);
+static uint32_t lastSampleMs = 0;
+static bool sampled = false;
+
+MemoryWatch& memoryWatch() {
+  return watch;
+}
+
+bool memoryDegraded() {
+  return watch.degraded();
+}
+
+// malloc puts blocks this large in PSRAM when there is any
+bool bulkBlockFits(size_t bytes) {
+  if (psramFound()) {
+    return heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) >= bytes;
+  }
+  return probe.largestBlock() >= bytes &&
+         probe.freeHeap() >= bytes + MEM_TLS_HEAP + MEM_LOW_MARGIN;
+}
+
+// ==========================================
+// SAMPLING
+// ==========================================
+
+bool pollMemoryMonitor() {
+  uint32_t now = millis();
+  if (sampled && now - lastSampleMs < MEM_SAMPLE_INTERVAL) {
+    return false;
+  }
+  sampled = true;
+  lastSampleMs = now;
+
+  if (!watch.update(now)) {
+    return false;
+  }
+  switch (watch.level()) {
+    case MEMORY_OK:
+      Serial.printf("✓ Memory recovered: %lu free, largest block %lu\n",
+                    (unsigned long)watch.lastFree(), (unsigned long)watch.lastLargest());
+      break;
+    case MEMORY_LOW:
+      Serial.printf("⚠️ Memory low: %lu free, largest block %lu - request logging off, roster syncs deferred\n",
+                    (unsigned long)watch.lastFree(), (unsigned long)watch.lastLargest());
+      break;
+    case MEMORY_CRITICAL:
+      Serial.printf("✗ Memory critical: largest block %lu < %lu - no new TLS connections\n",
+                    (unsigned long)watch.lastLargest(), (unsigned long)MEM_TLS_BLOCK);
+      break;
+  }
+  return true;
+}
+
+// ==========================================
+// REPORTS
+// ==========================================
+
+// Last sample (at most MEM_SAMPLE_INTERVAL old)
+void printMemoryStats(HalLog& out) {
+  watch.print(out);
+}
+
+void writeMemoryMetrics(HalLog& out) {
+  watch.writePrometheus(out);
+}
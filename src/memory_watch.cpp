@@ -0,0 +1,246 @@
+#include "memory_watch.h"
+#include <string.h>
+
+static const char* const levelNames[] = { "ok", "low", "critical" };
+static const char* const tagNames[MEM_TAG_COUNT] = { "network", "json", "display", "roster" };
+static const char* const taskNames[MEM_TASK_COUNT] = { "loop", "net", "wifi", "oled" };
+
+MemoryWatch::MemoryWatch(MemoryProbe& probe, uint32_t tlsBlock, uint32_t tlsHeap)
+  : probe(probe), tlsBlock(tlsBlock), tlsHeap(tlsHeap), lvl(MEMORY_OK), sessionBytes(0), sampledAt(0),
+    heapFree(0), heapLargest(0), heapMinFree(0) {
+  for (uint8_t i = 0; i < MEM_TAG_COUNT; i++) {
+    tags[i].held.store(0);
+    tags[i].peak.store(0);
+    tags[i].charges.store(0);
+  }
+  memset(stacks, 0, sizeof(stacks));
+  st.samples.store(0);
+  st.lowEntered.store(0);
+  st.criticalEntered.store(0);
+  st.degradedMs.store(0);
+  st.tlsRefused.store(0);
+  st.tlsOpened.store(0);
+  st.tlsLastBytes.store(0);
+  st.tlsMaxBytes.store(0);
+  st.lowestFree.store(UINT32_MAX);
+  st.lowestLargest.store(UINT32_MAX);
+}
+
+const char* MemoryWatch::levelName(MemoryLevel level) {
+  return levelNames[level];
+}
+
+const char* MemoryWatch::tagName(MemTag tag) {
+  return tagNames[tag];
+}
+
+const char* MemoryWatch::taskName(MemTask task) {
+  return taskNames[task];
+}
+
+// ==========================================
+// LEVEL
+// ==========================================
+
+// Thresholds of the current level and better are raised by the recovery
+// margin: the heap has to clear them by that much to move up. An open
+// session's buffers count as free, but only the LOW test asks for a
+// block besides them.
+MemoryLevel MemoryWatch::levelFor(uint32_t freeBytes, uint32_t largestBytes, MemoryLevel current) const {
+  uint32_t session = sessionBytes.load(std::memory_order_relaxed);
+  uint32_t reusable = session > 0 ? freeBytes + session : freeBytes;
+  bool ownBlock = session > 0;
+
+  uint32_t criticalSlack = current == MEMORY_CRITICAL ? MEM_RECOVER_MARGIN : 0;
+  if ((!ownBlock && largestBytes < tlsBlock + criticalSlack) || reusable < tlsHeap + criticalSlack) {
+    return MEMORY_CRITICAL;
+  }
+  uint32_t lowSlack = MEM_LOW_MARGIN + (current != MEMORY_OK ? MEM_RECOVER_MARGIN : 0);
+  if (largestBytes < tlsBlock + lowSlack || reusable < tlsHeap + lowSlack) {
+    return MEMORY_LOW;
+  }
+  return MEMORY_OK;
+}
+
+bool MemoryWatch::update(uint32_t nowMs) {
+  heapFree = probe.freeHeap();
+  heapLargest = probe.largestBlock();
+  heapMinFree = probe.minFreeHeap();
+  for (uint8_t i = 0; i < MEM_TASK_COUNT; i++) {
+    TaskStack& s = stacks[i];
+    s.running = probe.stack((MemTask)i, s.size, s.unused);
+  }
+
+  // Only this task writes the sampled counters; other tasks read them
+  if (st.samples.load(std::memory_order_relaxed) > 0 && degraded()) {
+    st.degradedMs.fetch_add(nowMs - sampledAt, std::memory_order_relaxed);
+  }
+  sampledAt = nowMs;
+  st.samples.fetch_add(1, std::memory_order_relaxed);
+  if (heapFree < st.lowestFree.load(std::memory_order_relaxed)) {
+    st.lowestFree.store(heapFree, std::memory_order_relaxed);
+  }
+  if (heapLargest < st.lowestLargest.load(std::memory_order_relaxed)) {
+    st.lowestLargest.store(heapLargest, std::memory_order_relaxed);
+  }
+
+  MemoryLevel was = level();
+  MemoryLevel now = levelFor(heapFree, heapLargest, was);
+  if (now == was) {
+    return false;
+  }
+
+  if (was == MEMORY_OK) {
+    st.lowEntered.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (now == MEMORY_CRITICAL) {
+    st.criticalEntered.fetch_add(1, std::memory_order_relaxed);
+  }
+  lvl.store(now, std::memory_order_release);
+  return true;
+}
+
+bool MemoryWatch::tlsFits() {
+  if (probe.largestBlock() >= tlsBlock && probe.freeHeap() >= tlsHeap) {
+    return true;
+  }
+  st.tlsRefused.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+template <typename T>
+static void raisePeak(std::atomic<T>& peak, T value) {
+  T seen = peak.load(std::memory_order_relaxed);
+  while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+  }
+}
+
+void MemoryWatch::tlsOpened(int32_t heapBytes) {
+  st.tlsOpened.fetch_add(1, std::memory_order_relaxed);
+  // Zero or less: something else freed more meanwhile, keep the last reading
+  if (heapBytes > 0) {
+    st.tlsLastBytes.store((uint32_t)heapBytes, std::memory_order_relaxed);
+    raisePeak(st.tlsMaxBytes, (uint32_t)heapBytes);
+  }
+  sessionBytes.store(st.tlsLastBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+MemoryStats MemoryWatch::stats() const {
+  MemoryStats out;
+  out.samples = st.samples.load(std::memory_order_relaxed);
+  out.lowEntered = st.lowEntered.load(std::memory_order_relaxed);
+  out.criticalEntered = st.criticalEntered.load(std::memory_order_relaxed);
+  out.degradedMs = st.degradedMs.load(std::memory_order_relaxed);
+  out.tlsRefused = st.tlsRefused.load(std::memory_order_relaxed);
+  out.tlsOpened = st.tlsOpened.load(std::memory_order_relaxed);
+  out.tlsLastBytes = st.tlsLastBytes.load(std::memory_order_relaxed);
+  out.tlsMaxBytes = st.tlsMaxBytes.load(std::memory_order_relaxed);
+  out.lowestFree = st.lowestFree.load(std::memory_order_relaxed);
+  out.lowestLargest = st.lowestLargest.load(std::memory_order_relaxed);
+  return out;
+}
+
+// ==========================================
+// TAGS
+// ==========================================
+
+void MemoryWatch::charge(MemTag tag, int32_t bytes) {
+  Tag& t = tags[tag];
+  int32_t held = t.held.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  t.charges.fetch_add(1, std::memory_order_relaxed);
+  raisePeak(t.peak, held);
+}
+
+void MemoryWatch::setHeld(MemTag tag, uint32_t bytes) {
+  Tag& t = tags[tag];
+  t.held.store((int32_t)bytes, std::memory_order_relaxed);
+  raisePeak(t.peak, (int32_t)bytes);
+}
+
+MemTagStats MemoryWatch::tagStats(MemTag tag) const {
+  const Tag& t = tags[tag];
+  MemTagStats out;
+  out.held = t.held.load(std::memory_order_relaxed);
+  out.peak = t.peak.load(std::memory_order_relaxed);
+  out.charges = t.charges.load(std::memory_order_relaxed);
+  return out;
+}
+
+// ==========================================
+// REPORTS
+// ==========================================
+
+void MemoryWatch::print(HalLog& out) const {
+  MemoryStats st = stats();
+  out.printf("Memory (%s):\n", levelName(level()));
+  out.printf("  Heap: %lu free, largest block %lu, min ever %lu\n", (unsigned long)heapFree,
+             (unsigned long)heapLargest, (unsigned long)heapMinFree);
+  out.printf("  TLS needs: block %lu, heap %lu (last session took %lu, max %lu)\n",
+             (unsigned long)tlsBlock, (unsigned long)tlsHeap, (unsigned long)st.tlsLastBytes,
+             (unsigned long)st.tlsMaxBytes);
+  out.printf("  Lowest sampled: %lu free, largest block %lu\n", (unsigned long)st.lowestFree,
+             (unsigned long)st.lowestLargest);
+  out.printf("  Degraded: %lu times, critical %lu times, %lus in all; %lu connections refused\n",
+             (unsigned long)st.lowEntered, (unsigned long)st.criticalEntered,
+             (unsigned long)(st.degradedMs / 1000), (unsigned long)st.tlsRefused);
+
+  out.println("  Tags (heap held / peak):");
+  for (uint8_t i = 0; i < MEM_TAG_COUNT; i++) {
+    MemTagStats t = tagStats((MemTag)i);
+    out.printf("    %-8s %7ld / %7ld (%lu charges)\n", tagNames[i], (long)t.held, (long)t.peak,
+               (unsigned long)t.charges);
+  }
+
+  out.println("  Stacks (high-water unused / size):");
+  for (uint8_t i = 0; i < MEM_TASK_COUNT; i++) {
+    const TaskStack& s = stacks[i];
+    if (!s.running) {
+      out.printf("    %-8s not running\n", taskNames[i]);
+      continue;
+    }
+    out.printf("    %-8s %5lu / %5lu%s\n", taskNames[i], (unsigned long)s.unused, (unsigned long)s.size,
+               s.unused < MEM_STACK_WARN ? "  ⚠️ near overflow" : "");
+  }
+}
+
+void MemoryWatch::writePrometheus(HalLog& out) const {
+  MemoryStats st = stats();
+  out.println("# HELP memory_heap_free_bytes Free internal heap at the last sample");
+  out.println("# TYPE memory_heap_free_bytes gauge");
+  out.printf("memory_heap_free_bytes %lu\n", (unsigned long)heapFree);
+  out.println("# HELP memory_heap_largest_block_bytes Largest free heap block at the last sample");
+  out.println("# TYPE memory_heap_largest_block_bytes gauge");
+  out.printf("memory_heap_largest_block_bytes %lu\n", (unsigned long)heapLargest);
+  out.println("# HELP memory_heap_min_free_bytes Lowest free heap since boot");
+  out.println("# TYPE memory_heap_min_free_bytes gauge");
+  out.printf("memory_heap_min_free_bytes %lu\n", (unsigned long)heapMinFree);
+
+  out.println("# HELP memory_level Heap level: 0 ok, 1 low (degraded), 2 critical (no new TLS)");
+  out.println("# TYPE memory_level gauge");
+  out.printf("memory_level %d\n", (int)level());
+  out.println("# HELP memory_degraded_total Times the heap went from ok to low or worse");
+  out.println("# TYPE memory_degraded_total counter");
+  out.printf("memory_degraded_total %lu\n", (unsigned long)st.lowEntered);
+  out.println("# HELP memory_tls_refused_total Connections not attempted because the handshake would not fit");
+  out.println("# TYPE memory_tls_refused_total counter");
+  out.printf("memory_tls_refused_total %lu\n", (unsigned long)st.tlsRefused);
+
+  out.println("# HELP memory_tag_held_bytes Heap held per subsystem (approximate)");
+  out.println("# TYPE memory_tag_held_bytes gauge");
+  for (uint8_t i = 0; i < MEM_TAG_COUNT; i++) {
+    out.printf("memory_tag_held_bytes{tag=\"%s\"} %ld\n", tagNames[i], (long)tagStats((MemTag)i).held);
+  }
+  out.println("# HELP memory_tag_peak_bytes Most heap held per subsystem");
+  out.println("# TYPE memory_tag_peak_bytes gauge");
+  for (uint8_t i = 0; i < MEM_TAG_COUNT; i++) {
+    out.printf("memory_tag_peak_bytes{tag=\"%s\"} %ld\n", tagNames[i], (long)tagStats((MemTag)i).peak);
+  }
+
+  out.println("# HELP memory_stack_unused_bytes Stack never used by the task (high-water mark)");
+  out.println("# TYPE memory_stack_unused_bytes gauge");
+  for (uint8_t i = 0; i < MEM_TASK_COUNT; i++) {
+    if (stacks[i].running) {
+      out.printf("memory_stack_unused_bytes{task=\"%s\"} %lu\n", taskNames[i], (unsigned long)stacks[i].unused);
+    }
+  }
+}
@@ -0,0 +1,60 @@
+#include "metrics_server.h"
+#include "tap_metrics.h"
+#include "memory_monitor.h"
+#include "hal.h"
+#include <WiFi.h>
+#include <WebServer.h>
+
+static WebServer metricsServer(METRICS_PORT);
+
+// Collects the report into a small buffer and sends it as HTTP chunks,
+// so the response needs neither a String nor one TCP segment per line
+class ChunkedResponse : public HalLog {
+public:
+  ChunkedResponse() : len(0) {}
+  void write(const char* text) override {
+    size_t n = strlen(text);
+    if (len + n > sizeof(buf)) {
+      flush();
+    }
+    if (n > sizeof(buf)) {
+      metricsServer.sendContent(text, n);
+      return;
+    }
+    memcpy(buf + len, text, n);
+    len += n;
+  }
+  void flush() {
+    if (len > 0) {
+      metricsServer.sendContent(buf, len);
+      len = 0;
+    }
+  }
+
+private:
+  char buf[METRICS_CHUNK_SIZE];
+  size_t len;
+};
+
+static void handleMetrics() {
+  metricsServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  metricsServer.send(200, "text/plain; version=0.0.4", "");
+  ChunkedResponse out;
+  writePrometheusMetrics(out);
+  writeMemoryMetrics(out);
+  out.flush();
+  metricsServer.sendContent("", 0); // End of chunked body
+}
+
+void initMetricsServer() {
+  metricsServer.on("/metrics", HTTP_GET, handleMetrics);
+  metricsServer.onNotFound([]() {
+    metricsServer.send(404, "text/plain", "Not found");
+  });
+  metricsServer.begin();
+  Serial.println("✓ Metrics: http://" + WiFi.localIP().toString() + ":" + String(METRICS_PORT) + "/metrics");
+}
+
+void pollMetricsServer() {
+  metricsServer.handleClient();
+}
@@ -0,0 +1,124 @@
+#include "oled_renderer.h"
+#include "tap_metrics.h"
+
+// SSD1306 control bytes
+#define OLED_CONTROL_COMMAND 0x00
+#define OLED_CONTROL_DATA    0x40
+
+OledRenderer::OledRenderer(Adafruit_SSD1306& oled, TwoWire& wire, uint8_t i2cAddr)
+  : oled(oled), wire(wire), addr(i2cAddr), pending(frames[0]), sending(frames[1]),
+    hasPending(false), task(NULL) {
+  lock = portMUX_INITIALIZER_UNLOCKED;
+  memset(&st, 0, sizeof(st));
+}
+
+bool OledRenderer::begin() {
+  memcpy(shadow, oled.getBuffer(), FRAME_BYTES);
+  wire.setClock(OLED_I2C_CLOCK);
+
+  if (xTaskCreatePinnedToCore(taskEntry, "oled", OLED_TASK_STACK, this,
+                              OLED_TASK_PRIORITY, &task, OLED_TASK_CORE) != pdPASS) {
+    task = NULL;
+    return false;
+  }
+  return true;
+}
+
+void OledRenderer::submit() {
+  if (!task) {
+    oled.display();
+    return;
+  }
+
+  portENTER_CRITICAL(&lock);
+  if (hasPending) {
+    st.superseded++;
+  }
+  memcpy(pending, oled.getBuffer(), FRAME_BYTES);
+  hasPending = true;
+  st.submitted++;
+  portEXIT_CRITICAL(&lock);
+
+  xTaskNotifyGive(task);
+}
+
+OledStats OledRenderer::stats() {
+  portENTER_CRITICAL(&lock);
+  OledStats copy = st;
+  portEXIT_CRITICAL(&lock);
+  return copy;
+}
+
+// ==========================================
+// DISPLAY TASK
+// ==========================================
+
+void OledRenderer::taskEntry(void* param) {
+  ((OledRenderer*)param)->run();
+}
+
+void OledRenderer::run() {
+  DirtySpan spans[FRAME_PAGES];
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    // Take the newest frame; the draw side keeps the other buffer
+    portENTER_CRITICAL(&lock);
+    if (!hasPending) {
+      portEXIT_CRITICAL(&lock);
+      continue;
+    }
+    uint8_t* frame = pending;
+    pending = sending;
+    sending = frame;
+    hasPending = false;
+    portEXIT_CRITICAL(&lock);
+
+    uint32_t start = micros();
+    uint8_t count = diffFrame(sending, shadow, spans);
+    if (count == 0) {
+      continue;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      sendSpan(spans[i], sending);
+    }
+    uint32_t flushUs = micros() - start;
+    recordStage(STAGE_OLED_FLUSH, flushUs);
+
+    portENTER_CRITICAL(&lock);
+    st.sent++;
+    st.wireBytes += spanWireBytes(spans, count);
+    st.lastFlushUs = flushUs;
+    if (flushUs > st.maxFlushUs) {
+      st.maxFlushUs = flushUs;
+    }
+    portEXIT_CRITICAL(&lock);
+  }
+}
+
+// Window the panel's RAM pointer onto the span, then stream its bytes
+// (horizontal addressing mode advances through the window by itself)
+void OledRenderer::sendSpan(const DirtySpan& span, const uint8_t* frame) {
+  wire.beginTransmission(addr);
+  wire.write(OLED_CONTROL_COMMAND);
+  wire.write(SSD1306_COLUMNADDR);
+  wire.write(span.first);
+  wire.write(span.last);
+  wire.write(SSD1306_PAGEADDR);
+  wire.write(span.page);
+  wire.write(span.page);
+  wire.endTransmission();
+
+  const uint8_t* data = frame + span.page * FRAME_COLUMNS + span.first;
+  size_t left = span.last - span.first + 1;
+  while (left > 0) {
+    size_t n = left < FRAME_I2C_CHUNK ? left : FRAME_I2C_CHUNK;
+    wire.beginTransmission(addr);
+    wire.write(OLED_CONTROL_DATA);
+    wire.write(data, n);
+    wire.endTransmission();
+    data += n;
+    left -= n;
+  }
+}
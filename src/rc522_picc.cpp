@@ -0,0 +1,265 @@
+#include "rc522_picc.h"
+#include <string.h>
+
+// ComIrqReg
+#define IRQ_RX            0x20
+#define IRQ_TIMER         0x01
+#define IRQ_CLEAR_ALL     0x7F
+// ErrorReg
+#define ERR_COLLISION     0x08
+#define ERR_FRAME         0x13   // BufferOvfl | ParityErr | ProtocolErr
+// Status2Reg ModemState
+#define MODEM_MASK        0x07
+#define MODEM_TX_WAIT     0x02
+#define MODEM_TRANSMIT    0x03
+#define MODEM_RECEIVING   0x06
+// BitFramingReg / FIFOLevelReg / TxControlReg
+#define START_SEND        0x80
+#define FIFO_FLUSH        0x80
+#define ANTENNA_ON        0x03
+
+// ISO 14443A commands
+#define PICC_REQA         0x26
+#define PICC_HLTA         0x50
+#define PICC_CASCADE_TAG  0x88
+#define PICC_NVB_ANTICOLL 0x20
+#define PICC_NVB_SELECT   0x70
+#define SAK_UID_INCOMPLETE 0x04
+
+// Timing at 106 kbit/s: a bit is 128/fc = 9.44 us; a byte is 9 bits with
+// parity, plus start and end of frame. The card answers 86 us (1172/fc)
+// after our frame ends.
+#define FRAME_DELAY_US    86
+#define ANSWER_SLACK_US   100    // Past the due time with nothing on the air: no answer
+#define POLL_US           50     // Status reads while an answer is still coming in
+#define RX_TIMEOUT_US     1000   // Chip timer backstop (25 us ticks, library prescaler)
+
+static const uint8_t selectCodes[] = { 0x93, 0x95, 0x97 };
+
+// One transaction: ComIrq, Error, FIFOLevel, Control, Status2
+static const uint8_t statusRegs[] = {
+  RC522_REG_COM_IRQ, RC522_REG_ERROR, RC522_REG_FIFO_LEVEL, RC522_REG_CONTROL, RC522_REG_STATUS2
+};
+enum { ST_IRQ, ST_ERROR, ST_LEVEL, ST_CONTROL, ST_STATUS2, ST_COUNT };
+
+static uint32_t frameUs(size_t bytes) {
+  return (uint32_t)((bytes * 9 + 2) * 944 / 100);
+}
+
+uint16_t rc522CrcA(const uint8_t* data, size_t len) {
+  uint16_t crc = 0x6363;
+  for (size_t i = 0; i < len; i++) {
+    uint8_t b = data[i] ^ (uint8_t)crc;
+    b ^= b << 4;
+    crc = (crc >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+  }
+  return crc;
+}
+
+// ==========================================
+// SETUP
+// ==========================================
+
+Rc522Picc::Rc522Picc(Rc522Bus& bus)
+  : bus(bus), chip(CHIP_IDLE), fifoEmpty(false), txControl(0) {
+  memset(&st, 0, sizeof(st));
+}
+
+void Rc522Picc::begin() {
+  // ISO 14443A at 106 kbit/s, no hardware CRC, clear bits after a collision
+  writeReg(RC522_REG_TX_MODE, 0x00);
+  writeReg(RC522_REG_RX_MODE, 0x00);
+  writeReg(RC522_REG_MOD_WIDTH, 0x26);
+  writeReg(RC522_REG_COLL, 0x00);
+  writeReg(RC522_REG_T_RELOAD_H, 0);
+  writeReg(RC522_REG_T_RELOAD_L, RX_TIMEOUT_US / 25);
+
+  uint8_t reg = RC522_REG_TX_CONTROL;
+  read(&reg, &txControl, 1);
+  chip = CHIP_BUSY;
+  fifoEmpty = false;
+}
+
+// ==========================================
+// BUS
+// ==========================================
+
+void Rc522Picc::write(uint8_t reg, const uint8_t* data, size_t len) {
+  bus.write(reg, data, len);
+  st.transactions++;
+  st.bytes += len + 1;
+}
+
+void Rc522Picc::read(const uint8_t* regs, uint8_t* out, size_t len) {
+  bus.read(regs, out, len);
+  st.transactions++;
+  st.bytes += len + 1;
+}
+
+void Rc522Picc::writeReg(uint8_t reg, uint8_t value) {
+  write(reg, &value, 1);
+}
+
+void Rc522Picc::antenna(bool on) {
+  uint8_t value = on ? (txControl | ANTENNA_ON) : (txControl & ~ANTENNA_ON);
+  if (value != txControl) {
+    writeReg(RC522_REG_TX_CONTROL, value);
+    txControl = value;
+  }
+}
+
+void Rc522Picc::idle() {
+  writeReg(RC522_REG_COMMAND, RC522_CMD_IDLE);
+  writeReg(RC522_REG_COM_IRQ, IRQ_CLEAR_ALL);
+  chip = CHIP_IDLE;
+}
+
+// ==========================================
+// TRANSCEIVE
+// ==========================================
+
+void Rc522Picc::startTransceive(const uint8_t* data, size_t len, uint8_t lastBits) {
+  if (chip == CHIP_BUSY) {
+    writeReg(RC522_REG_COMMAND, RC522_CMD_IDLE);
+    chip = CHIP_IDLE;
+  }
+  writeReg(RC522_REG_COM_IRQ, IRQ_CLEAR_ALL);
+  if (!fifoEmpty) {
+    writeReg(RC522_REG_FIFO_LEVEL, FIFO_FLUSH);
+  }
+  write(RC522_REG_FIFO_DATA, data, len);
+  if (chip == CHIP_IDLE) {
+    writeReg(RC522_REG_COMMAND, RC522_CMD_TRANSCEIVE);
+  }
+  writeReg(RC522_REG_BIT_FRAMING, START_SEND | lastBits);
+
+  chip = CHIP_BUSY;
+  fifoEmpty = false;
+}
+
+// Wait until the answer is due, then read the status once (more often
+// only while it is still on the air). The answer stays in the FIFO
+// unless back has room for it.
+Rc522Picc::Result Rc522Picc::finishTransceive(uint8_t* back, size_t backMax, size_t& backLen,
+                                              uint32_t dueUs) {
+  uint8_t status[ST_COUNT];
+  uint32_t waited = dueUs;
+  bus.waitUs(dueUs);
+  for (;;) {
+    read(statusRegs, status, ST_COUNT);
+    if (status[ST_IRQ] & IRQ_RX) {
+      break;
+    }
+    uint8_t modem = status[ST_STATUS2] & MODEM_MASK;
+    bool onAir = modem == MODEM_TX_WAIT || modem == MODEM_TRANSMIT || modem == MODEM_RECEIVING;
+    if ((status[ST_IRQ] & IRQ_TIMER) || (!onAir && waited >= dueUs + ANSWER_SLACK_US) ||
+        waited >= dueUs + RX_TIMEOUT_US) {
+      return RESULT_TIMEOUT;
+    }
+    bus.waitUs(POLL_US);
+    waited += POLL_US;
+  }
+
+  chip = CHIP_READY;
+  backLen = status[ST_LEVEL] & 0x7F;
+  if (status[ST_ERROR] & ERR_FRAME) {
+    return RESULT_ERROR;
+  }
+  if (status[ST_ERROR] & ERR_COLLISION) {
+    return RESULT_COLLISION;
+  }
+  if (backMax == 0) {
+    return RESULT_OK;
+  }
+  if (backLen > backMax || (status[ST_CONTROL] & 0x07) != 0) {
+    return RESULT_ERROR;   // Longer than expected, or not whole bytes
+  }
+
+  uint8_t fifo[RC522_FIFO_SIZE];
+  memset(fifo, RC522_REG_FIFO_DATA, backLen);
+  read(fifo, back, backLen);
+  fifoEmpty = true;
+  return RESULT_OK;
+}
+
+Rc522Picc::Result Rc522Picc::transceive(const uint8_t* data, size_t len, uint8_t* back, size_t backMax,
+                                        size_t& backLen) {
+  startTransceive(data, len, 0);
+  return finishTransceive(back, backMax, backLen, frameUs(len) + FRAME_DELAY_US + frameUs(backMax));
+}
+
+// ==========================================
+// CARD COMMANDS
+// ==========================================
+
+void Rc522Picc::startRequestA() {
+  uint8_t cmd = PICC_REQA;
+  startTransceive(&cmd, 1, 7);   // Short frame: 7 bits
+}
+
+void Rc522Picc::probeAnswered() {
+  chip = CHIP_READY;
+}
+
+// ATQA only needs to be there (two bytes); it is not read out
+bool Rc522Picc::requestA() {
+  startRequestA();
+  size_t len = 0;
+  Result result = finishTransceive(NULL, 0, len, frameUs(1) + FRAME_DELAY_US + frameUs(2));
+  return result == RESULT_OK && len == 2;
+}
+
+bool Rc522Picc::select(CardUid& uid, uint8_t& sak) {
+  uint8_t bytes[CARD_UID_MAX];
+  size_t count = 0;
+
+  for (uint8_t level = 0; level < sizeof(selectCodes); level++) {
+    // Anticollision: the card sends its UID part (4 bytes) + BCC
+    uint8_t frame[9] = { selectCodes[level], PICC_NVB_ANTICOLL };
+    uint8_t part[5];
+    size_t len = 0;
+    if (transceive(frame, 2, part, sizeof(part), len) != RESULT_OK || len != 5 ||
+        (part[0] ^ part[1] ^ part[2] ^ part[3]) != part[4]) {
+      return false;
+    }
+
+    // Select that part; the card answers SAK + CRC_A
+    frame[1] = PICC_NVB_SELECT;
+    memcpy(frame + 2, part, 5);
+    uint16_t crc = rc522CrcA(frame, 7);
+    frame[7] = (uint8_t)crc;
+    frame[8] = (uint8_t)(crc >> 8);
+    uint8_t answer[3];
+    if (transceive(frame, sizeof(frame), answer, sizeof(answer), len) != RESULT_OK || len != 3 ||
+        rc522CrcA(answer, 1) != (uint16_t)(answer[1] | (answer[2] << 8))) {
+      return false;
+    }
+
+    // A cascade tag means the UID continues at the next level
+    bool more = (answer[0] & SAK_UID_INCOMPLETE) != 0;
+    const uint8_t* from = part[0] == PICC_CASCADE_TAG && more ? part + 1 : part;
+    size_t n = part + 4 - from;
+    if (count + n > sizeof(bytes)) {
+      return false;
+    }
+    memcpy(bytes + count, from, n);
+    count += n;
+
+    if (!more) {
+      uid = CardUid(bytes, count);
+      sak = answer[0];
+      return true;
+    }
+  }
+  return false;
+}
+
+// A halted card never answers HLTA; wait only for the frame to go out
+void Rc522Picc::haltA() {
+  uint8_t frame[4] = { PICC_HLTA, 0x00 };
+  uint16_t crc = rc522CrcA(frame, 2);
+  frame[2] = (uint8_t)crc;
+  frame[3] = (uint8_t)(crc >> 8);
+  startTransceive(frame, sizeof(frame), 0);
+  bus.waitUs(frameUs(sizeof(frame)));
+}
@@ -0,0 +1,191 @@
+#include "rc522_reader.h"
+#include "tap_metrics.h"
+
+// ComIEnReg: IRqInv (IRQ pin active low) | RxIEn (card answered)
+#define RC522_COM_IEN     0xA0
+// DivIEnReg: IRQPushPull (no external pull-up needed)
+#define RC522_DIV_IEN     0x80
+
+static TaskHandle_t wakeTask = NULL;
+
+// ==========================================
+// SPI TRANSPORT
+// ==========================================
+
+// Address byte: bit 7 = read, register in bits 6..1. A write sends data
+// bytes to one register; a read clocks out the next address while the
+// previous register comes back, so any mix of registers is one transfer.
+void Rc522SpiBus::write(uint8_t reg, const uint8_t* data, size_t len) {
+  SPI.beginTransaction(settings);
+  digitalWrite(ssPin, LOW);
+  SPI.transfer((reg << 1) & 0x7E);
+  SPI.writeBytes(data, len);
+  digitalWrite(ssPin, HIGH);
+  SPI.endTransaction();
+}
+
+void Rc522SpiBus::read(const uint8_t* regs, uint8_t* out, size_t len) {
+  uint8_t tx[RC522_FIFO_SIZE + 1];
+  uint8_t rx[RC522_FIFO_SIZE + 1];
+  for (size_t i = 0; i < len; i++) {
+    tx[i] = 0x80 | ((regs[i] << 1) & 0x7E);
+  }
+  tx[len] = 0;
+
+  SPI.beginTransaction(settings);
+  digitalWrite(ssPin, LOW);
+  SPI.transferBytes(tx, rx, len + 1);
+  digitalWrite(ssPin, HIGH);
+  SPI.endTransaction();
+  memcpy(out, rx + 1, len);
+}
+
+// ==========================================
+// SETUP
+// ==========================================
+
+Rc522CardReader::Rc522CardReader()
+  : picc(bus), irqPin(-1), lastSak(0), irqPending(false), irqAtUs(0), probing(false), nextSenseMs(0) {
+  memset(&st, 0, sizeof(st));
+}
+
+void Rc522CardReader::setWakeTask(TaskHandle_t task) {
+  wakeTask = task;
+}
+
+byte Rc522CardReader::begin(uint8_t ssPin, uint8_t rstPin, int irq) {
+  rfid.PCD_Init(ssPin, rstPin);
+
+  byte version = rfid.PCD_ReadRegister(rfid.VersionReg);
+  if (version == 0x00 || version == 0xFF) {
+    return version;
+  }
+  bus.begin(ssPin);
+  picc.begin();
+  if (irq < 0) {
+    return version;
+  }
+
+  irqPin = irq;
+  rfid.PCD_WriteRegister(rfid.DivIEnReg, RC522_DIV_IEN);
+  rfid.PCD_WriteRegister(rfid.ComIEnReg, RC522_COM_IEN);
+  picc.idle();
+  picc.antenna(false);
+
+  pinMode(irqPin, INPUT);
+  attachInterruptArg(irqPin, onIrq, this, FALLING);
+  return version;
+}
+
+void IRAM_ATTR Rc522CardReader::onIrq(void* arg) {
+  Rc522CardReader* reader = (Rc522CardReader*)arg;
+  reader->irqAtUs = micros();
+  reader->irqPending = true;
+
+  if (wakeTask) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(wakeTask, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+// ==========================================
+// PROBING (IRQ MODE)
+// ==========================================
+
+uint32_t Rc522CardReader::sense(uint32_t nowMs) {
+  if (!irqMode()) {
+    return 0xFFFFFFFF;
+  }
+  if (irqPending) {
+    return 0; // readCard() picks it up
+  }
+  if ((int32_t)(nowMs - nextSenseMs) >= 0) {
+    if (probing) {
+      endProbe(nowMs);
+    } else {
+      startProbe(nowMs);
+    }
+  }
+  return nextSenseMs - nowMs;
+}
+
+// Field on, then REQA: a card in the field answers with ATQA -> RxIRq
+void Rc522CardReader::startProbe(uint32_t nowMs) {
+  uint32_t start = micros();
+  irqPending = false;
+  picc.antenna(true);
+  picc.startRequestA();
+  st.busyUs += micros() - start;
+  st.probes++;
+
+  probing = true;
+  nextSenseMs = nowMs + CARD_SENSE_WINDOW;
+}
+
+// No answer in the window (or the card was handled) - field off until the next probe
+void Rc522CardReader::endProbe(uint32_t nowMs) {
+  uint32_t start = micros();
+  picc.idle();
+  picc.antenna(false);
+  st.busyUs += micros() - start;
+
+  probing = false;
+  nextSenseMs = nowMs + CARD_SENSE_INTERVAL - CARD_SENSE_WINDOW;
+}
+
+// ==========================================
+// CARD READER
+// ==========================================
+
+// Anticollision + select; timed as the first stage of the tap path
+bool Rc522CardReader::readSerial(CardUid& uid) {
+  uint32_t start = micros();
+  if (!picc.select(uid, lastSak)) {
+    return false;
+  }
+  recordStage(STAGE_PICC_SELECT, micros() - start);
+  return true;
+}
+
+bool Rc522CardReader::readCard(CardUid& uid) {
+  uint32_t start = micros();
+  bool found;
+
+  if (!irqMode()) {
+    st.probes++;
+    found = picc.requestA() && readSerial(uid);
+  } else {
+    if (!irqPending) {
+      return false;
+    }
+    st.irqs++;
+    // The card is READY after answering the probe - go straight to select
+    picc.probeAnswered();
+    found = readSerial(uid);
+    // Select traffic raises RxIRq too; those edges are not new cards
+    irqPending = false;
+
+    if (found) {
+      st.lastDetectUs = micros() - irqAtUs;
+      if (st.lastDetectUs > st.maxDetectUs) {
+        st.maxDetectUs = st.lastDetectUs;
+      }
+    } else {
+      endProbe(millis());
+    }
+  }
+
+  st.busyUs += micros() - start;
+  return found;
+}
+
+void Rc522CardReader::release() {
+  uint32_t start = micros();
+  picc.haltA();
+  st.busyUs += micros() - start;
+
+  if (irqMode()) {
+    endProbe(millis());
+  }
+}
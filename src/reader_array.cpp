@@ -0,0 +1,39 @@
+#include "reader_array.h"
+
+// ==========================================
+// READER ARRAY
+// ==========================================
+
+ReaderArray::ReaderArray() : slots(), count(0), next(0) {}
+
+bool ReaderArray::add(CardReader* reader, uint8_t id) {
+  if (!reader || count == READER_MAX) {
+    return false;
+  }
+  slots[count] = Slot();
+  slots[count].reader = reader;
+  slots[count].id = id;
+  count++;
+  return true;
+}
+
+bool ReaderArray::poll(CardTap& tap) {
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t index = (next + i) % count;
+    Slot& slot = slots[index];
+    slot.stats.polls++;
+
+    CardUid uid;
+    if (!slot.reader->readCard(uid)) {
+      continue;
+    }
+    slot.reader->release();
+    slot.stats.taps++;
+
+    tap.uid = uid;
+    tap.reader = slot.id;
+    next = (index + 1) % count;
+    return true;
+  }
+  return false;
+}
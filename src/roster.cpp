@@ -0,0 +1,382 @@
+#include "roster.h"
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#define BUCKET_COUNT (1u << ROSTER_INDEX_BITS)
+
+static bool entryLess(const RosterEntry& a, const RosterEntry& b) {
+  return a.hash < b.hash;
+}
+
+static uint32_t bucketOf(uint32_t hash) {
+  return hash >> (32 - ROSTER_INDEX_BITS);
+}
+
+// ==========================================
+// ROSTER
+// ==========================================
+
+Roster::Roster()
+  : entries(NULL), count(0), sortedCount(0), capacity(0), rosterVersion(0),
+    names(NULL), namesUsed(0), namesCapacity(0), sorted(false), growFits(NULL) {
+  memset(index, 0, sizeof(index));
+}
+
+Roster::~Roster() {
+  free(entries);
+  free(names);
+}
+
+void Roster::clear() {
+  free(entries);
+  free(names);
+  entries = NULL;
+  names = NULL;
+  count = sortedCount = capacity = 0;
+  rosterVersion = 0;
+  namesUsed = namesCapacity = 0;
+  memset(index, 0, sizeof(index));
+  sorted = false;
+}
+
+// FNV-1a: cheap, and spreads sequential UIDs evenly over the buckets
+uint32_t Roster::hashUid(const uint8_t* uid, uint8_t uidLen) {
+  uint32_t hash = 2166136261u;
+  for (uint8_t i = 0; i < uidLen; i++) {
+    hash ^= uid[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool Roster::reserveEntries(uint32_t wanted) {
+  if (wanted <= capacity) {
+    return true;
+  }
+  if (wanted > ROSTER_MAX_ENTRIES) {
+    return false;
+  }
+
+  uint32_t newCapacity = capacity ? capacity * 2 : 256;
+  if (newCapacity < wanted) newCapacity = wanted;
+  if (newCapacity > ROSTER_MAX_ENTRIES) newCapacity = ROSTER_MAX_ENTRIES;
+
+  // Doubling near the limit: grow by a step instead, or not at all
+  if (growFits && !growFits(newCapacity * sizeof(RosterEntry))) {
+    newCapacity = wanted + ROSTER_GROW_STEP;
+    if (newCapacity > ROSTER_MAX_ENTRIES) newCapacity = ROSTER_MAX_ENTRIES;
+    if (!growFits(newCapacity * sizeof(RosterEntry))) {
+      return false;
+    }
+  }
+
+  RosterEntry* grown = (RosterEntry*)realloc(entries, newCapacity * sizeof(RosterEntry));
+  if (!grown) {
+    return false;
+  }
+  entries = grown;
+  capacity = newCapacity;
+  return true;
+}
+
+bool Roster::reserveNames(uint32_t wanted) {
+  if (wanted <= namesCapacity) {
+    return true;
+  }
+
+  uint32_t newCapacity = namesCapacity ? namesCapacity * 2 : 4096;
+  if (newCapacity < wanted) newCapacity = wanted;
+
+  if (growFits && !growFits(newCapacity)) {
+    newCapacity = wanted + ROSTER_GROW_STEP * 8;
+    if (!growFits(newCapacity)) {
+      return false;
+    }
+  }
+
+  char* grown = (char*)realloc(names, newCapacity);
+  if (!grown) {
+    return false;
+  }
+  names = grown;
+  namesCapacity = newCapacity;
+  return true;
+}
+
+bool Roster::add(const uint8_t* uid, uint8_t uidLen, const char* name, uint8_t flags) {
+  if (uidLen == 0 || uidLen > CHECKIN_UID_MAX) {
+    return false;
+  }
+
+  size_t nameLen = strlen(name);
+  if (nameLen > ROSTER_NAME_MAX) {
+    nameLen = ROSTER_NAME_MAX;
+  }
+
+  if (!reserveEntries(count + 1) || !reserveNames(namesUsed + nameLen + 1)) {
+    return false;
+  }
+
+  RosterEntry& entry = entries[count++];
+  memset(&entry, 0, sizeof(entry));
+  entry.hash = hashUid(uid, uidLen);
+  entry.nameOffset = namesUsed;
+  entry.flags = flags;
+  entry.uidLen = uidLen;
+  memcpy(entry.uid, uid, uidLen);
+
+  memcpy(names + namesUsed, name, nameLen);
+  names[namesUsed + nameLen] = '\0';
+  namesUsed += nameLen + 1;
+
+  sorted = false;
+  return true;
+}
+
+// ==========================================
+// SNAPSHOTS
+// ==========================================
+//
+//   magic "RST1" | version | count | namesUsed | eventId[CHECKIN_EVENT_ID_MAX + 1]
+//   entries[count] | names[namesUsed]
+//
+// The device writes snapshots to a temp file and renames it, so a torn
+// write never replaces a good snapshot.
+
+#define SNAPSHOT_MAGIC 0x31545352 // "RST1"
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t namesUsed;
+  char eventId[CHECKIN_EVENT_ID_MAX + 1];
+};
+
+bool Roster::save(RosterSink& sink, const char* eventId) const {
+  if (!sorted) {
+    return false;
+  }
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = SNAPSHOT_MAGIC;
+  header.version = rosterVersion;
+  header.count = count;
+  header.namesUsed = namesUsed;
+  strncpy(header.eventId, eventId, CHECKIN_EVENT_ID_MAX);
+
+  return sink.write(&header, sizeof(header)) &&
+         (count == 0 || sink.write(entries, count * sizeof(RosterEntry))) &&
+         (namesUsed == 0 || sink.write(names, namesUsed));
+}
+
+bool Roster::load(RosterSource& source, const char* eventId) {
+  clear();
+
+  SnapshotHeader header;
+  if (!source.read(&header, sizeof(header)) || header.magic != SNAPSHOT_MAGIC ||
+      strncmp(header.eventId, eventId, CHECKIN_EVENT_ID_MAX) != 0 ||
+      header.count > ROSTER_MAX_ENTRIES) {
+    return false;
+  }
+
+  if (!reserveEntries(header.count) || !reserveNames(header.namesUsed)) {
+    clear();
+    return false;
+  }
+
+  if ((header.count > 0 && !source.read(entries, header.count * sizeof(RosterEntry))) ||
+      (header.namesUsed > 0 && !source.read(names, header.namesUsed))) {
+    clear();
+    return false;
+  }
+
+  count = header.count;
+  namesUsed = header.namesUsed;
+
+  // A snapshot that points outside its own name pool is corrupt
+  if (namesUsed > 0 && names[namesUsed - 1] != '\0') {
+    clear();
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (entries[i].nameOffset >= namesUsed || entries[i].uidLen > CHECKIN_UID_MAX) {
+      clear();
+      return false;
+    }
+  }
+
+  rosterVersion = header.version;
+  finalize();
+  return true;
+}
+
+void Roster::finalize() {
+  // Drop tombstones left by remove()
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (!(entries[i].flags & ROSTER_REMOVED)) {
+      entries[kept++] = entries[i];
+    }
+  }
+  count = kept;
+
+  // Give back the slack left by doubling while loading
+  if (count > 0 && count < capacity) {
+    RosterEntry* shrunk = (RosterEntry*)realloc(entries, count * sizeof(RosterEntry));
+    if (shrunk) {
+      entries = shrunk;
+      capacity = count;
+    }
+  }
+  if (namesUsed > 0 && namesUsed < namesCapacity) {
+    char* shrunk = (char*)realloc(names, namesUsed);
+    if (shrunk) {
+      names = shrunk;
+      namesCapacity = namesUsed;
+    }
+  }
+
+  std::sort(entries, entries + count, entryLess);
+
+  // index[b] = first entry whose bucket is >= b
+  uint32_t pos = 0;
+  for (uint32_t b = 0; b < BUCKET_COUNT; b++) {
+    while (pos < count && bucketOf(entries[pos].hash) < b) {
+      pos++;
+    }
+    index[b] = pos;
+  }
+  index[BUCKET_COUNT] = count;
+
+  sortedCount = count;
+  sorted = true;
+}
+
+RosterEntry* Roster::find(const uint8_t* uid, uint8_t uidLen) {
+  if (count == 0) {
+    return NULL;
+  }
+
+  uint32_t hash = hashUid(uid, uidLen);
+
+  // Entries added since the last finalize() (a delta in progress)
+  for (uint32_t i = sortedCount; i < count; i++) {
+    RosterEntry& staged = entries[i];
+    if (staged.hash == hash && staged.uidLen == uidLen &&
+        memcmp(staged.uid, uid, uidLen) == 0 && !(staged.flags & ROSTER_REMOVED)) {
+      return &staged;
+    }
+  }
+
+  return findSorted(hash, uid, uidLen);
+}
+
+RosterEntry* Roster::findSorted(uint32_t hash, const uint8_t* uid, uint8_t uidLen) {
+  if (sortedCount == 0) {
+    return NULL;
+  }
+
+  uint32_t bucket = bucketOf(hash);
+  RosterEntry* first = entries + index[bucket];
+  RosterEntry* last = entries + index[bucket + 1];
+
+  RosterEntry key;
+  key.hash = hash;
+  RosterEntry* it = std::lower_bound(first, last, key, entryLess);
+
+  // Equal hashes are rare but possible - compare the actual UID
+  for (; it != last && it->hash == hash; ++it) {
+    if (it->uidLen == uidLen && memcmp(it->uid, uid, uidLen) == 0 &&
+        !(it->flags & ROSTER_REMOVED)) {
+      return it;
+    }
+  }
+  return NULL;
+}
+
+bool Roster::upsert(const uint8_t* uid, uint8_t uidLen, const char* name, uint8_t flags) {
+  RosterEntry* existing = find(uid, uidLen);
+  if (!existing) {
+    return add(uid, uidLen, name, flags);
+  }
+
+  // Keep a check-in made on this device until the server reports it too
+  existing->flags = flags | (existing->flags & ROSTER_CHECKED_IN);
+  return rename(existing, name);
+}
+
+// Renamed: append the new name, the old one stays until the next load
+bool Roster::rename(RosterEntry* entry, const char* name) {
+  if (strncmp(nameOf(*entry), name, ROSTER_NAME_MAX) == 0) {
+    return true;
+  }
+  size_t nameLen = strlen(name);
+  if (nameLen > ROSTER_NAME_MAX) {
+    nameLen = ROSTER_NAME_MAX;
+  }
+  if (!reserveNames(namesUsed + nameLen + 1)) {
+    return false;
+  }
+  entry->nameOffset = namesUsed;
+  memcpy(names + namesUsed, name, nameLen);
+  names[namesUsed + nameLen] = '\0';
+  namesUsed += nameLen + 1;
+  return true;
+}
+
+bool Roster::remove(const uint8_t* uid, uint8_t uidLen) {
+  RosterEntry* existing = find(uid, uidLen);
+  if (!existing) {
+    return false;
+  }
+  existing->flags |= ROSTER_REMOVED;
+  return true;
+}
+
+// ==========================================
+// FULL RELOAD
+// ==========================================
+//
+// Entries already in the sorted list are updated where they are (found by
+// the index, not the staged scan, so a 20k reload into an empty roster
+// stays linear); new ones are staged. Local check-ins are kept as in
+// upsert().
+
+void Roster::beginReload() {
+  for (uint32_t i = 0; i < count; i++) {
+    entries[i].flags &= ~ROSTER_SEEN;
+  }
+}
+
+bool Roster::reload(const uint8_t* uid, uint8_t uidLen, const char* name, uint8_t flags) {
+  if (uidLen == 0 || uidLen > CHECKIN_UID_MAX) {
+    return false;
+  }
+  RosterEntry* existing = findSorted(hashUid(uid, uidLen), uid, uidLen);
+  if (!existing) {
+    return add(uid, uidLen, name, flags | ROSTER_SEEN);
+  }
+  existing->flags = flags | ROSTER_SEEN | (existing->flags & ROSTER_CHECKED_IN);
+  return rename(existing, name);
+}
+
+void Roster::endReload(bool complete) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (complete && !(entries[i].flags & ROSTER_SEEN)) {
+      entries[i].flags |= ROSTER_REMOVED;
+    }
+    entries[i].flags &= ~ROSTER_SEEN;
+  }
+}
+
+const char* Roster::nameOf(const RosterEntry& entry) const {
+  return names + entry.nameOffset;
+}
+
+size_t Roster::memoryBytes() const {
+  return capacity * sizeof(RosterEntry) + namesCapacity + sizeof(index);
+}
@@ -0,0 +1,263 @@
+#include "roster_sync.h"
+#include "card_uid.h"
+#include <string.h>
+
+// The body as an ArduinoJson reader, with one byte of pushback so the
+// list structure around the items can be looked at before it is parsed.
+// deserializeJson() stops right after the value it reads.
+class BodyReader {
+public:
+  explicit BodyReader(RosterInput& in) : in(in), pushed(-1) {}
+
+  int read() {
+    if (pushed >= 0) {
+      int c = pushed;
+      pushed = -1;
+      return c;
+    }
+    return in.read();
+  }
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    int c;
+    while (n < length && (c = read()) >= 0) {
+      buffer[n++] = (char)c;
+    }
+    return n;
+  }
+
+  // Next byte that is not whitespace, left unread (-1 at the end)
+  int peekToken() {
+    int c;
+    do {
+      c = read();
+    } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+    pushed = c;
+    return c;
+  }
+
+  // Past the '[' of "key": [, wherever it is. A "key" that turns out to
+  // be a value or a key of something else is skipped.
+  bool findArray(const char* key) {
+    size_t keyLen = strlen(key);
+    for (;;) {
+      // "key" with its quotes
+      size_t matched = 0;
+      while (matched < keyLen + 2) {
+        int c = read();
+        if (c < 0) {
+          return false;
+        }
+        char want = (matched == 0 || matched == keyLen + 1) ? '"' : key[matched - 1];
+        if (c == want) {
+          matched++;
+        } else {
+          matched = c == '"' ? 1 : 0;
+        }
+      }
+      if (peekToken() != ':') {
+        continue;
+      }
+      read();
+      if (peekToken() == '[') {
+        read();
+        return true;
+      }
+    }
+  }
+
+private:
+  RosterInput& in;
+  int pushed;
+};
+
+static CardUid readItem(JsonVariantConst item, uint8_t& flags) {
+  flags = 0;
+  if (item["allowed"] | true) flags |= ROSTER_ALLOWED;
+  if (item["checkedIn"] | false) flags |= ROSTER_CHECKED_IN;
+  return CardUid::parse(item["uid"] | "");
+}
+
+// A UID the roster can hold: some bytes, and no more text than a
+// CARD_UID_MAX one takes (parse() would cut a longer one short)
+static bool usableUid(JsonVariantConst item, const CardUid& uid) {
+  return !uid.empty() && strlen(item["uid"] | "") < CARD_UID_TEXT_SIZE;
+}
+
+RosterSync::RosterSync(Roster& roster, HalLog& log, ArduinoJson::Allocator* itemAllocator)
+  : roster(roster), log(log), itemAllocator(itemAllocator), memoryOk(NULL) {}
+
+void RosterSync::begin() {
+  itemFilter["uid"] = true;
+  itemFilter["name"] = true;
+  itemFilter["allowed"] = true;
+  itemFilter["checkedIn"] = true;
+
+  deltaFilter["adds"].add(itemFilter);
+  deltaFilter["removes"] = true;
+}
+
+// ==========================================
+// SYNC
+// ==========================================
+
+RosterSyncResult RosterSync::sync(RosterServer& server, const char* eventId) {
+  RosterSyncResult result;
+  memset(&result, 0, sizeof(result));
+  result.outcome = ROSTER_SYNC_FAILED;
+
+  RosterReply reply;
+  memset(&reply, 0, sizeof(reply));
+  uint32_t since = roster.version();
+  result.httpCode = server.get(eventId, since, false, reply);
+  result.requests++;
+
+  // A delta needs the version it was made against. Without one (a server
+  // that lost track, or ours was dropped meanwhile) ask for the full list.
+  if (result.httpCode == 200 && reply.delta && since == 0) {
+    log.println("⚠️ Roster delta without a base version - asking for the full list");
+    result.httpCode = server.get(eventId, 0, true, reply);
+    result.requests++;
+    if (result.httpCode == 200 && reply.delta) {
+      log.println("✗ Roster server sent a delta again - keeping the stored roster");
+      result.delta = true;
+      result.version = reply.version;
+      return result;
+    }
+  }
+
+  if (result.httpCode == 304) {
+    result.outcome = ROSTER_SYNC_CURRENT;
+    return result;
+  }
+  if (result.httpCode != 200) {
+    return result;
+  }
+
+  result.delta = reply.delta;
+  result.version = reply.version;
+
+  result.outcome = reply.delta ? readDelta(*reply.body, result) : readFull(*reply.body, result);
+  if (result.outcome == ROSTER_SYNC_FAILED) {
+    return result;
+  }
+
+  roster.finalize();
+
+  // Anything missed for want of room means we cannot claim this version -
+  // next sync is full
+  if (result.skipped > 0) {
+    result.outcome = ROSTER_SYNC_PARTIAL;
+  }
+  roster.setVersion(result.outcome == ROSTER_SYNC_UPDATED ? result.version : 0);
+  return result;
+}
+
+// ==========================================
+// FULL LIST
+// ==========================================
+
+// Reloaded over the current roster, so taps checked in here but not yet
+// on the server stay checked in. UPDATED once the list was read to its ']'.
+RosterSyncOutcome RosterSync::readFull(RosterInput& body, RosterSyncResult& result) {
+  BodyReader reader(body);
+  if (!reader.findArray("roster")) {
+    log.println("✗ Roster response has no roster array");
+    return ROSTER_SYNC_FAILED;
+  }
+
+  roster.beginReload();
+  JsonDocument item(itemAllocator);
+  bool complete = false;
+
+  if (reader.peekToken() == ']') {
+    complete = true;   // Empty list
+  }
+  while (!complete) {
+    if (memoryOk && !memoryOk()) {
+      log.printf("⚠️ Roster sync stopped after %lu items - memory low\n",
+                 (unsigned long)(result.applied + result.skipped + result.invalid));
+      result.stopped = true;
+      break;
+    }
+    DeserializationError error = deserializeJson(item, reader, DeserializationOption::Filter(itemFilter));
+    if (error) {
+      log.printf("✗ Roster item %lu: %s\n", (unsigned long)(result.applied + result.skipped + result.invalid),
+                 error.c_str());
+      break;
+    }
+
+    uint8_t flags;
+    CardUid uid = readItem(item, flags);
+    if (!usableUid(item, uid)) {
+      if (result.invalid == 0) {   // The first one; the caller reports the count
+        log.printf("⚠️ Roster item %lu: bad uid \"%s\"\n",
+                   (unsigned long)(result.applied + result.skipped), item["uid"] | "");
+      }
+      result.invalid++;
+    } else if (roster.reload(uid.data(), uid.size(), item["name"] | "", flags)) {
+      result.applied++;
+    } else {
+      result.skipped++;
+    }
+
+    int next = reader.peekToken();
+    reader.read();
+    if (next == ']') {
+      complete = true;
+    } else if (next != ',') {
+      log.println("✗ Roster list cut short");
+      break;
+    }
+  }
+
+  roster.endReload(complete);
+  return complete ? ROSTER_SYNC_UPDATED : ROSTER_SYNC_PARTIAL;
+}
+
+// ==========================================
+// DELTA
+// ==========================================
+
+// Its size depends on how much changed, so this one document stays on
+// the heap. Applied whole or not at all.
+RosterSyncOutcome RosterSync::readDelta(RosterInput& body, RosterSyncResult& result) {
+  if (memoryOk && !memoryOk()) {
+    log.println("⚠️ Roster delta not read - memory low");
+    result.stopped = true;
+    return ROSTER_SYNC_FAILED;
+  }
+  BodyReader reader(body);
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, reader, DeserializationOption::Filter(deltaFilter));
+  if (error) {
+    log.printf("✗ Roster delta parse error: %s\n", error.c_str());
+    return ROSTER_SYNC_FAILED;
+  }
+
+  for (JsonVariantConst removed : doc["removes"].as<JsonArrayConst>()) {
+    CardUid uid = CardUid::parse(removed | "");
+    if (roster.remove(uid.data(), uid.size())) {
+      result.applied++;
+    }
+  }
+
+  uint8_t flags;
+  for (JsonVariantConst item : doc["adds"].as<JsonArrayConst>()) {
+    CardUid uid = readItem(item, flags);
+    if (!usableUid(item, uid)) {
+      if (result.invalid == 0) {
+        log.printf("⚠️ Roster delta: bad uid \"%s\"\n", item["uid"] | "");
+      }
+      result.invalid++;
+    } else if (roster.upsert(uid.data(), uid.size(), item["name"] | "", flags)) {
+      result.applied++;
+    } else {
+      result.skipped++;
+    }
+  }
+
+  log.printf("  Delta: +%u / -%u\n", (unsigned)doc["adds"].size(), (unsigned)doc["removes"].size());
+  return ROSTER_SYNC_UPDATED;
+}
@@ -0,0 +1,137 @@
+#include "screen_template.h"
+#include <string.h>
+
+// ==========================================
+// TEXT FITTING
+// ==========================================
+
+size_t fitText(const char* text, size_t columns, FitMode mode, uint32_t step, char* out, size_t outSize) {
+  if (columns > outSize - 1) {
+    columns = outSize - 1;
+  }
+  size_t len = strlen(text);
+
+  if (len <= columns) {
+    memcpy(out, text, len);
+    out[len] = '\0';
+    return len;
+  }
+
+  if (mode == FIT_SCROLL) {
+    // Window over "text   text   ...", resting at the start of each pass
+    size_t cycle = len + SCREEN_SCROLL_GAP;
+    uint32_t pos = step % (cycle + SCREEN_SCROLL_PAUSE);
+    size_t offset = pos < SCREEN_SCROLL_PAUSE ? 0 : pos - SCREEN_SCROLL_PAUSE;
+    for (size_t i = 0; i < columns; i++) {
+      size_t at = (offset + i) % cycle;
+      out[i] = at < len ? text[at] : ' ';
+    }
+    out[columns] = '\0';
+    return columns;
+  }
+
+  if (mode == FIT_CLIP || columns <= 3) {
+    memcpy(out, text, columns);
+    out[columns] = '\0';
+    return columns;
+  }
+
+  // Ellipsis; don't leave a space dangling in front of the dots
+  size_t keep = columns - 3;
+  while (keep > 1 && text[keep - 1] == ' ') {
+    keep--;
+  }
+  memcpy(out, text, keep);
+  memcpy(out + keep, "...", 4);
+  return keep + 3;
+}
+
+// ==========================================
+// STATIC LAYER CACHE
+// ==========================================
+//
+// Frames with only the static text drawn, least recently used replaced.
+// Only for displays that expose their framebuffer; the rest draw the text
+// every time.
+
+struct CachedLayer {
+  const ScreenTemplate* screen;
+  uint32_t lastUsed;
+};
+
+static CachedLayer layers[SCREEN_CACHE_SLOTS];
+static uint8_t layerPixels[SCREEN_CACHE_SLOTS][FRAME_BYTES];
+static uint32_t layerClock = 0;
+
+static void renderStatic(HalDisplay& display, const ScreenTemplate& screen) {
+  display.clearDisplay();
+  for (size_t i = 0; i < screen.textCount; i++) {
+    const StaticText& t = screen.texts[i];
+    display.setTextSize(t.size);
+    display.setCursor(t.x, t.y);
+    display.print(t.text);
+  }
+}
+
+static void drawStatic(HalDisplay& display, const ScreenTemplate& screen) {
+  uint8_t* frame = display.buffer();
+  if (!frame || screen.textCount == 0) {
+    renderStatic(display, screen);
+    return;
+  }
+
+  layerClock++;
+  size_t victim = 0;
+  for (size_t i = 0; i < SCREEN_CACHE_SLOTS; i++) {
+    if (layers[i].screen == &screen) {
+      layers[i].lastUsed = layerClock;
+      memcpy(frame, layerPixels[i], FRAME_BYTES);
+      return;
+    }
+    if (layers[i].lastUsed < layers[victim].lastUsed) {
+      victim = i;
+    }
+  }
+
+  renderStatic(display, screen);
+  memcpy(layerPixels[victim], frame, FRAME_BYTES);
+  layers[victim].screen = &screen;
+  layers[victim].lastUsed = layerClock;
+}
+
+// ==========================================
+// DRAWING
+// ==========================================
+
+bool drawScreen(HalDisplay& display, const ScreenTemplate& screen, const char* const* values, uint32_t step) {
+  drawStatic(display, screen);
+
+  bool scrolling = false;
+  char fitted[SCREEN_FIELD_MAX + 1];
+  for (size_t f = 0; f < screen.fieldCount; f++) {
+    const TextField& field = screen.fields[f];
+    const char* value = values[f] ? values[f] : "";
+    uint8_t size = field.size;
+    FitMode mode = field.fit;
+
+    size_t columns = fieldColumns(field.x, size);
+    if (mode == FIT_SHRINK) {
+      mode = FIT_ELLIPSIS;
+      if (strlen(value) > columns && size > 1) {
+        size = 1;
+        columns = fieldColumns(field.x, size);
+      }
+    }
+    if (mode == FIT_SCROLL && strlen(value) > columns) {
+      scrolling = true;
+    }
+
+    size_t len = fitText(value, columns, mode, step, fitted, sizeof(fitted));
+    display.setTextSize(size);
+    display.setCursor(field.x, field.y);
+    display.write(fitted, len);
+  }
+
+  display.display();
+  return scrolling;
+}
@@ -0,0 +1,201 @@
+#include "screens.h"
+#include "screen_template.h"
+#include <stdio.h>
+
+// Layouts are the positions the old println() sequences ended up at:
+// size 1 lines are 8 px apart, size 2 lines 16 px.
+
+// ==========================================
+// BOOT / STATUS
+// ==========================================
+
+static constexpr TextField statusFields[] = {
+  { 0, 0, 2, FIT_SHRINK },
+  { 0, 24, 1, FIT_ELLIPSIS },
+  { 0, 40, 1, FIT_ELLIPSIS }
+};
+static constexpr ScreenTemplate statusScreen = fieldsOnly(statusFields);
+static_assert(templateFits(statusScreen), "statusScreen does not fit the panel");
+
+void displayOnOLED(HalDisplay& display, const char* line1, const char* line2, const char* line3) {
+  const char* values[] = { line1, line2, line3 };
+  drawScreen(display, statusScreen, values);
+}
+
+static constexpr StaticText wifiSetupText[] = {
+  { 0, 0, 1, "WiFi Setup Mode" },
+  { 0, 16, 1, "1. Connect phone to:" },
+  { 0, 48, 1, "2. Follow popup to" },
+  { 0, 56, 1, "   select your WiFi" }
+};
+static constexpr TextField wifiSetupFields[] = {
+  { 0, 24, 2, FIT_SHRINK }
+};
+static constexpr ScreenTemplate wifiSetupScreen = screenTemplate(wifiSetupText, wifiSetupFields);
+static_assert(templateFits(wifiSetupScreen), "wifiSetupScreen does not fit the panel");
+
+void displayWifiSetup(HalDisplay& display, const char* apName) {
+  drawScreen(display, wifiSetupScreen, &apName);
+}
+
+// ==========================================
+// REGISTRATION MODE
+// ==========================================
+
+static constexpr StaticText readyText[] = {
+  { 0, 0, 2, "Ready" },
+  { 0, 24, 1, "Tap card to" },
+  { 0, 40, 1, "register..." }
+};
+static constexpr ScreenTemplate readyScreen = screenTemplate(readyText);
+static_assert(templateFits(readyScreen), "readyScreen does not fit the panel");
+
+void displayReady(HalDisplay& display) {
+  drawScreen(display, readyScreen);
+}
+
+static constexpr StaticText sendingText[] = {
+  { 0, 0, 1, "Card Detected!" },
+  { 0, 16, 1, "UID:" },
+  { 0, 40, 1, "Sending..." }
+};
+static constexpr TextField uidAt24[] = {
+  { 0, 24, 1, FIT_ELLIPSIS }
+};
+static constexpr ScreenTemplate sendingScreen = screenTemplate(sendingText, uidAt24);
+static_assert(templateFits(sendingScreen), "sendingScreen does not fit the panel");
+
+void displaySending(HalDisplay& display, const CardUid& uid) {
+  char uidText[CARD_UID_TEXT_SIZE];
+  uid.format(uidText, sizeof(uidText));
+  const char* values[] = { uidText };
+  drawScreen(display, sendingScreen, values);
+}
+
+static constexpr StaticText waitingText[] = {
+  { 0, 10, 1, "Card sent!" },
+  { 0, 26, 1, "Admin: activate" },
+  { 0, 34, 1, "in browser" }
+};
+static constexpr ScreenTemplate waitingScreen = screenTemplate(waitingText);
+static_assert(templateFits(waitingScreen), "waitingScreen does not fit the panel");
+
+void displayWaiting(HalDisplay& display) {
+  drawScreen(display, waitingScreen);
+}
+
+static constexpr TextField errorFields[] = {
+  { 0, 20, 1, FIT_ELLIPSIS },
+  { 0, 28, 1, FIT_ELLIPSIS }
+};
+static constexpr ScreenTemplate errorScreen = fieldsOnly(errorFields);
+static_assert(templateFits(errorScreen), "errorScreen does not fit the panel");
+
+void displayError(HalDisplay& display, const char* line1, const char* line2) {
+  const char* values[] = { line1, line2 };
+  drawScreen(display, errorScreen, values);
+}
+
+// ==========================================
+// ATTENDANCE MODE
+// ==========================================
+
+static constexpr StaticText noEventText[] = {
+  { 0, 10, 1, "No event found" },
+  { 0, 26, 1, "Press button to" },
+  { 0, 34, 1, "fetch event" }
+};
+static constexpr ScreenTemplate noEventScreen = screenTemplate(noEventText);
+static_assert(templateFits(noEventScreen), "noEventScreen does not fit the panel");
+
+void displayNoEvent(HalDisplay& display) {
+  drawScreen(display, noEventScreen);
+}
+
+static constexpr StaticText fetchingText[] = {
+  { 0, 20, 1, "Fetching event" },
+  { 0, 28, 1, "from server..." }
+};
+static constexpr ScreenTemplate fetchingScreen = screenTemplate(fetchingText);
+static_assert(templateFits(fetchingScreen), "fetchingScreen does not fit the panel");
+
+void displayFetchingEvent(HalDisplay& display) {
+  drawScreen(display, fetchingScreen);
+}
+
+static constexpr StaticText attendanceReadyText[] = {
+  { 0, 0, 1, "Ready:" },
+  { 0, 40, 1, "Tap card to check in" }
+};
+static constexpr TextField attendanceReadyFields[] = {
+  { 0, 16, 2, FIT_SCROLL }
+};
+static constexpr ScreenTemplate attendanceReadyScreen = screenTemplate(attendanceReadyText, attendanceReadyFields);
+static_assert(templateFits(attendanceReadyScreen), "attendanceReadyScreen does not fit the panel");
+
+bool displayAttendanceReady(HalDisplay& display, const char* eventName, uint32_t scrollStep) {
+  return drawScreen(display, attendanceReadyScreen, &eventName, scrollStep);
+}
+
+static constexpr StaticText checkingInText[] = {
+  { 0, 10, 1, "Card detected!" },
+  { 0, 26, 1, "UID:" },
+  { 0, 50, 1, "Checking in..." }
+};
+static constexpr TextField uidAt34[] = {
+  { 0, 34, 1, FIT_ELLIPSIS }
+};
+static constexpr ScreenTemplate checkingInScreen = screenTemplate(checkingInText, uidAt34);
+static_assert(templateFits(checkingInScreen), "checkingInScreen does not fit the panel");
+
+void displayCheckingIn(HalDisplay& display, const CardUid& uid) {
+  char uidText[CARD_UID_TEXT_SIZE];
+  uid.format(uidText, sizeof(uidText));
+  const char* values[] = { uidText };
+  drawScreen(display, checkingInScreen, values);
+}
+
+static constexpr StaticText welcomeText[] = {
+  { 0, 10, 1, "Welcome!" }
+};
+static constexpr TextField welcomeFields[] = {
+  { 0, 26, 2, FIT_SHRINK }
+};
+static constexpr ScreenTemplate welcomeScreen = screenTemplate(welcomeText, welcomeFields);
+static_assert(templateFits(welcomeScreen), "welcomeScreen does not fit the panel");
+
+void displayWelcome(HalDisplay& display, const char* studentName) {
+  drawScreen(display, welcomeScreen, &studentName);
+}
+
+static constexpr StaticText savedOfflineText[] = {
+  { 0, 10, 1, "Checked in!" },
+  { 0, 26, 1, "Saved offline," },
+  { 0, 34, 1, "will sync later" },
+  { 0, 50, 1, "Pending:" }
+};
+static constexpr TextField savedOfflineFields[] = {
+  { 54, 50, 1, FIT_CLIP }
+};
+static constexpr ScreenTemplate savedOfflineScreen = screenTemplate(savedOfflineText, savedOfflineFields);
+static_assert(templateFits(savedOfflineScreen), "savedOfflineScreen does not fit the panel");
+
+void displaySavedOffline(HalDisplay& display, uint32_t pending) {
+  char count[12];
+  snprintf(count, sizeof(count), "%u", (unsigned)pending);
+  const char* values[] = { count };
+  drawScreen(display, savedOfflineScreen, values);
+}
+
+static constexpr StaticText attendanceErrorText[] = {
+  { 0, 20, 1, "Error:" }
+};
+static constexpr TextField attendanceErrorFields[] = {
+  { 0, 28, 1, FIT_ELLIPSIS }
+};
+static constexpr ScreenTemplate attendanceErrorScreen = screenTemplate(attendanceErrorText, attendanceErrorFields);
+static_assert(templateFits(attendanceErrorScreen), "attendanceErrorScreen does not fit the panel");
+
+void displayAttendanceError(HalDisplay& display, const char* error) {
+  drawScreen(display, attendanceErrorScreen, &error);
+}
@@ -0,0 +1,97 @@
+#include "session_state.h"
+#include "crc32.h"
+#include <string.h>
+
+// ==========================================
+// BLOB LAYOUT (little-endian)
+// ==========================================
+//
+//   0..3    magic
+//   4       layout version
+//   5       flags       - bit 0: attendance mode
+//   6       eventIdLen
+//   7       eventNameLen
+//   8..11   rosterVersion
+//   12..15  journalNext
+//   16..19  journalTail
+//   20..    eventId, then eventName (no NULs)
+//   last 4  crc32 over everything before
+
+#define OFF_MAGIC      0
+#define OFF_LAYOUT     4
+#define OFF_FLAGS      5
+#define OFF_ID_LEN     6
+#define OFF_NAME_LEN   7
+#define OFF_ROSTER     8
+#define OFF_NEXT       12
+#define OFF_TAIL       16
+#define OFF_STRINGS    20
+
+#define FLAG_ATTENDANCE 0x01
+
+static void putU32(uint8_t* p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+         ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t encodeSession(const SessionState& state, uint8_t* out) {
+  size_t idLen = strnlen(state.eventId, CHECKIN_EVENT_ID_MAX);
+  size_t nameLen = strnlen(state.eventName, ATT_EVENT_NAME_MAX);
+
+  putU32(out + OFF_MAGIC, SESSION_MAGIC);
+  out[OFF_LAYOUT] = SESSION_LAYOUT;
+  out[OFF_FLAGS] = state.attendanceMode ? FLAG_ATTENDANCE : 0;
+  out[OFF_ID_LEN] = (uint8_t)idLen;
+  out[OFF_NAME_LEN] = (uint8_t)nameLen;
+  putU32(out + OFF_ROSTER, state.rosterVersion);
+  putU32(out + OFF_NEXT, state.journalNext);
+  putU32(out + OFF_TAIL, state.journalTail);
+  memcpy(out + OFF_STRINGS, state.eventId, idLen);
+  memcpy(out + OFF_STRINGS + idLen, state.eventName, nameLen);
+
+  size_t len = OFF_STRINGS + idLen + nameLen;
+  putU32(out + len, crc32(out, len));
+  return len + 4;
+}
+
+bool decodeSession(const uint8_t* blob, size_t len, SessionState& state) {
+  if (len < OFF_STRINGS + 4 || len > SESSION_BLOB_MAX) {
+    return false;
+  }
+  if (getU32(blob + OFF_MAGIC) != SESSION_MAGIC || blob[OFF_LAYOUT] != SESSION_LAYOUT) {
+    return false;
+  }
+
+  size_t idLen = blob[OFF_ID_LEN];
+  size_t nameLen = blob[OFF_NAME_LEN];
+  if (idLen > CHECKIN_EVENT_ID_MAX || nameLen > ATT_EVENT_NAME_MAX ||
+      OFF_STRINGS + idLen + nameLen + 4 != len) {
+    return false;
+  }
+  if (getU32(blob + len - 4) != crc32(blob, len - 4)) {
+    return false;
+  }
+
+  uint32_t next = getU32(blob + OFF_NEXT);
+  uint32_t tail = getU32(blob + OFF_TAIL);
+  if ((blob[OFF_FLAGS] & ~FLAG_ATTENDANCE) != 0 || tail > next) {
+    return false;
+  }
+
+  state.attendanceMode = (blob[OFF_FLAGS] & FLAG_ATTENDANCE) != 0;
+  memcpy(state.eventId, blob + OFF_STRINGS, idLen);
+  state.eventId[idLen] = '\0';
+  memcpy(state.eventName, blob + OFF_STRINGS + idLen, nameLen);
+  state.eventName[nameLen] = '\0';
+  state.rosterVersion = getU32(blob + OFF_ROSTER);
+  state.journalNext = next;
+  state.journalTail = tail;
+  return true;
+}
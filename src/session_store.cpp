@@ -0,0 +1,52 @@
+#include "session_store.h"
+#include "config.h"
+#include <Arduino.h>
+#include <Preferences.h>
+
+static uint8_t savedBlob[SESSION_BLOB_MAX];
+static size_t savedLen = 0;
+
+bool loadSession(SessionState& state) {
+  memset(&state, 0, sizeof(state));
+
+  Preferences prefs;
+  if (!prefs.begin(SESSION_NVS_NAMESPACE, true)) {
+    return false;   // Namespace not created yet: first boot
+  }
+  size_t len = prefs.getBytesLength(SESSION_NVS_KEY);
+  if (len == 0 || len > sizeof(savedBlob)) {
+    prefs.end();
+    return false;
+  }
+  prefs.getBytes(SESSION_NVS_KEY, savedBlob, len);
+  prefs.end();
+
+  if (!decodeSession(savedBlob, len, state)) {
+    Serial.println("✗ Stored session failed integrity check - starting fresh");
+    memset(&state, 0, sizeof(state));
+    return false;
+  }
+  savedLen = len;
+  return true;
+}
+
+void saveSession(const SessionState& state) {
+  uint8_t blob[SESSION_BLOB_MAX];
+  size_t len = encodeSession(state, blob);
+  if (len == savedLen && memcmp(blob, savedBlob, len) == 0) {
+    return;
+  }
+
+  Preferences prefs;
+  if (!prefs.begin(SESSION_NVS_NAMESPACE, false)) {
+    Serial.println("✗ NVS unavailable - session not saved");
+    return;
+  }
+  if (prefs.putBytes(SESSION_NVS_KEY, blob, len) == len) {
+    memcpy(savedBlob, blob, len);
+    savedLen = len;
+  } else {
+    Serial.println("✗ Session save failed");
+  }
+  prefs.end();
+}
@@ -0,0 +1,549 @@
+// ==========================================
+// NATIVE SIMULATOR
+// ==========================================
+//
+// Runs the real state machines (DeviceController, AttendanceController,
+// CheckinDispatcher, ReaderArray, Roster) on Linux against simulated
+// hardware and a fake server, on a virtual clock. Build and run with:
+//
+//   pio run -e native
+//   .pio/build/native/program < script.txt
+//
+// The exit status is non-zero when an "expect" line failed or a command
+// was not understood; CI runs the scripts in test/sim this way.
+//
+// Script commands, one per line ('#' starts a comment):
+//
+//   tap <door> <uid>       card enters the field, e.g. "tap 0 04:A1:B2:C3"
+//   press fetch|clear <ms> hold a button for <ms>
+//   wait <ms>              let virtual time pass
+//   offline / online       drop or restore the link to the server (a roster
+//                          sync asked for while offline runs on "online")
+//   latency <ms>           server response time per request
+//   expect <what> ...      check, counted in the exit status: "expect
+//                          tap_to_screen p95 300" (ms), "expect pending 0",
+//                          "expect missed 0" (last burst)
+//   burst <count> <gap>    <count> new cards, one every <gap> ms, alternating
+//                          doors; reports taps read, missed and answered/s
+//   loadtest [devices] [taps/min] [uniform|burst|ramp] [minutes]
+//                          soak of the check-in path (test/fakes/load_model.h):
+//                          every device runs its own journal +
+//                          CheckinDispatcher against a mock batch endpoint
+//                          (binary frames); throughput, latency percentiles,
+//                          retries and journal depth over time, PASS if
+//                          every tap is stored once
+//   loadserver <workers> <ms> <ms/record> [error %]
+//                          mock server for loadtest (default 4 40 2 0)
+//   loadoutage <start s> <seconds> [wifi|server]
+//                          one outage in the next loadtest (0 s = none)
+//   serverevent <n>        the server makes event n active (0 = none); the
+//                          device follows on its next event poll
+//
+// Every frame pushed to the OLED is printed with its virtual time and the
+// time since the last tap, so tap-to-screen latency can be read directly;
+// the tap_to_screen histogram is printed at the end.
+
+// pio test builds src/ into every test binary; the suites bring their own
+// main() and their own fakes
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "config.h"
+#include "hal.h"
+#include "card_uid.h"
+#include "checkin_log.h"
+#include "checkin_dispatcher.h"
+#include "roster.h"
+#include "reader_array.h"
+#include "attendance_controller.h"
+#include "device_controller.h"
+#include "ui_scheduler.h"
+#include "tap_metrics.h"
+#include "event_poller.h"
+#include "../../test/fakes/sim_hal.h"
+#include "../../test/fakes/ram_log_storage.h"
+#include "../../test/fakes/load_model.h"
+
+#define SIM_TICK 10            // Main loop granularity (ms)
+#define SIM_DOORS 2
+#define SIM_STUDENTS 4
+
+// ==========================================
+// SIMULATED HARDWARE
+// ==========================================
+
+static SimClock simClock;
+static uint32_t lastTapAt = 0;
+static bool tapSeen = false;
+
+// Every frame is printed with its virtual time and the time since the tap
+class ConsoleDisplay : public TextDisplay {
+public:
+  void display() override {
+    TextDisplay::display();
+    if (tapSeen) {
+      printf("[%6u ms] OLED (+%u ms since tap)\n", (unsigned)simClock.millis(),
+             (unsigned)(simClock.millis() - lastTapAt));
+    } else {
+      printf("[%6u ms] OLED\n", (unsigned)simClock.millis());
+    }
+    int last = TEXT_DISPLAY_ROWS - 1;
+    while (last >= 0 && line(last).empty()) {
+      last--;
+    }
+    for (int r = 0; r <= last; r++) {
+      printf("  | %s\n", line(r).c_str());
+    }
+  }
+};
+
+class ConsoleLog : public HalLog {
+public:
+  void write(const char* text) override { fputs(text, stdout); }
+};
+
+// ==========================================
+// FAKE SERVER
+// ==========================================
+
+struct SimStudent {
+  const char* uid;
+  const char* name;
+  bool inRoster;     // Sent with the roster (else only the server knows them)
+  bool checkedIn;
+};
+
+static SimStudent students[SIM_STUDENTS] = {
+  { "04:A1:B2:C3", "Alice", true, false },
+  { "04:D4:E5:F6", "Bob", true, false },
+  { "04:11:22:33", "Chandra", false, false },
+  { "04:44:55:66", "Dana", false, false },
+};
+
+static bool linkUp = true;
+static bool rosterSyncPending = false;   // As on the device: synced once the link is back
+static uint32_t serverLatency = 120;
+static bool netBusy = false;
+
+// Failed checks and expectations; the exit status, so a script run is a
+// regression gate (test/sim/*.txt in CI)
+static uint32_t simFailures = 0;
+
+static void tick();
+
+static SimStudent* findStudent(const uint8_t* uid, uint8_t uidLen) {
+  for (size_t i = 0; i < SIM_STUDENTS; i++) {
+    CardUid known = CardUid::parse(students[i].uid);
+    if (known == CardUid(uid, uidLen)) {
+      return &students[i];
+    }
+  }
+  return NULL;
+}
+
+static int serverCheckIn(const CheckinRecord& rec, char* studentName, size_t nameSize) {
+  SimStudent* student = findStudent(rec.uid, rec.uidLen);
+  if (!student) {
+    // Cards nobody scripted (burst) are walk-ins the server accepts
+    snprintf(studentName, nameSize, "%s", "Visitor");
+    return 200;
+  }
+  if (student->checkedIn) {
+    return 409;
+  }
+  student->checkedIn = true;
+  snprintf(studentName, nameSize, "%s", student->name);
+  return 200;
+}
+
+// Check-ins go out on the network task, so the loop keeps running while
+// the server is thinking
+static void serverDelay() {
+  uint32_t end = simClock.millis() + serverLatency;
+  netBusy = true;
+  while ((int32_t)(end - simClock.millis()) > 0) {
+    simClock.delay(SIM_TICK);
+    tick();
+  }
+  netBusy = false;
+}
+
+static int simSend(const CheckinRecord& rec, char* studentName, size_t nameSize) {
+  if (!linkUp) {
+    return -1;
+  }
+  serverDelay();
+  return serverCheckIn(rec, studentName, nameSize);
+}
+
+static int simSendBatch(const CheckinRecord* recs, size_t count, CheckinItemResult* results) {
+  if (!linkUp) {
+    return -1;
+  }
+  serverDelay();
+  for (size_t i = 0; i < count; i++) {
+    results[i].status = serverCheckIn(recs[i], results[i].studentName, sizeof(results[i].studentName));
+  }
+  return 200;
+}
+
+static bool simLinkUp() {
+  return linkUp;
+}
+
+static int simRegisterCard(const CardUid&) {
+  if (!linkUp) {
+    return -1;
+  }
+  simClock.delay(serverLatency);
+  return 200;
+}
+
+// The server's active event: 0 = none, else event n. Its ETag changes
+// with it.
+static uint32_t serverEvent = 1;
+
+static void fillServerEvent(uint32_t n, ActiveEvent& event) {
+  snprintf(event.id, sizeof(event.id), "00000000-0000-0000-0000-%012u", (unsigned)n);
+  if (n == 1) {
+    snprintf(event.name, sizeof(event.name), "%s", "Demo Event");
+  } else {
+    snprintf(event.name, sizeof(event.name), "Event %u", (unsigned)n);
+  }
+  event.handle = 0;
+}
+
+static EventFetchResult simPollEvent(char* etag, size_t etagSize, ActiveEvent& event) {
+  if (!linkUp) {
+    return EVENT_FETCH_FAILED;
+  }
+  serverDelay();
+  if (serverEvent == 0) {
+    return EVENT_FETCH_NONE;
+  }
+  char current[16];
+  snprintf(current, sizeof(current), "\"ev%u\"", (unsigned)serverEvent);
+  if (strcmp(etag, current) == 0) {
+    return EVENT_FETCH_UNCHANGED;
+  }
+  fillServerEvent(serverEvent, event);
+  snprintf(etag, etagSize, "%s", current);
+  return EVENT_FETCH_CHANGED;
+}
+
+static RamLogStorage journalStorage(CHECKIN_LOG_CAPACITY);
+static CheckinLog journal;
+static CheckinDispatcher dispatcher(journal, simSend, simSendBatch, simLinkUp);
+static Roster roster;
+static EventPoller eventPoller(simPollEvent, simLinkUp, 1);
+
+class SimBackend : public AttendanceBackend {
+public:
+  bool fetchActiveEvent(char* id, size_t idSize, char* name, size_t nameSize) override {
+    if (!linkUp || serverEvent == 0) {
+      return false;
+    }
+    simClock.delay(serverLatency);
+    ActiveEvent event;
+    fillServerEvent(serverEvent, event);
+    snprintf(id, idSize, "%s", event.id);
+    snprintf(name, nameSize, "%s", event.name);
+    return true;
+  }
+  bool takeEventChange(ActiveEvent& event) override { return eventPoller.takeChange(event); }
+  void refreshEvent() override { eventPoller.refresh(); }
+  void syncRoster(const char*) override {
+    if (!linkUp) {
+      rosterSyncPending = true;
+      return;
+    }
+    rosterSyncPending = false;
+    simClock.delay(serverLatency);
+    roster.clear();
+    for (size_t i = 0; i < SIM_STUDENTS; i++) {
+      if (!students[i].inRoster) {
+        continue;
+      }
+      CardUid uid = CardUid::parse(students[i].uid);
+      roster.add(uid.data(), uid.size(), students[i].name,
+                 ROSTER_ALLOWED | (students[i].checkedIn ? ROSTER_CHECKED_IN : 0));
+    }
+    roster.finalize();
+  }
+  void eventCleared() override {
+    rosterSyncPending = false;
+    roster.clear();
+  }
+  bool acquireRoster(const char*) override { return true; }
+  void releaseRoster() override {}
+  bool journalReady() override { return true; }
+  void tapSubmitted() override {}
+  uint32_t timestamp() override { return 1700000000 + simClock.millis() / 1000; }
+};
+
+// ==========================================
+// MAIN LOOP
+// ==========================================
+
+static ConsoleDisplay oled;
+static ConsoleLog simLog;
+static SimBuzzer buzzer;
+static UiScheduler ui(buzzer);
+static SimButtons buttons(simClock);
+static SimBackend backend;
+static ScriptedReader doors[SIM_DOORS];
+static ReaderArray readers;
+static AttendanceController attendance(dispatcher, roster, backend, oled, simClock, ui, simLog);
+static DeviceController device(attendance, simRegisterCard, oled, simClock, buttons, ui, simLog);
+
+// One pass of the firmware loop, plus the network task's share of work
+static void tick() {
+  if (!netBusy) {
+    while (dispatcher.runOnce(simClock.millis())) {
+    }
+    eventPoller.runOnce(simClock.millis());
+  }
+  device.poll();
+
+  CardTap tap;
+  if (readers.poll(tap) && !device.dropRepeat(tap)) {
+    lastTapAt = simClock.millis();
+    tapSeen = true;
+    printf("[%6u ms] tap %s at door %u\n", (unsigned)lastTapAt, tap.uid.text().c_str(), tap.reader);
+    device.onTap(tap);
+  }
+}
+
+static void runFor(uint32_t ms) {
+  uint32_t end = simClock.millis() + ms;
+  while ((int32_t)(end - simClock.millis()) > 0) {
+    simClock.delay(SIM_TICK);
+    tick();
+  }
+}
+
+// Sustained load: a new card every gapMs. A card still unread when the
+// next one arrives at its door was missed (the loop was busy).
+static uint32_t burstMissed = 0;   // Of the last burst
+
+static void runBurst(uint32_t count, uint32_t gapMs) {
+  uint32_t start = simClock.millis();
+  uint32_t answeredBefore = stageHistogram(STAGE_TAP_TO_SCREEN).count();
+  uint32_t missed = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint8_t bytes[4] = { 0x05, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i };
+    if (!doors[i % SIM_DOORS].present(CardUid(bytes, sizeof(bytes)))) {
+      missed++;
+    }
+    runFor(gapMs);
+  }
+  // Cards still sitting unread were missed too
+  for (uint8_t d = 0; d < SIM_DOORS; d++) {
+    if (doors[d].withdraw()) {
+      missed++;
+    }
+  }
+  runFor(CHECKIN_SUCCESS_DISPLAY);
+
+  burstMissed = missed;
+  uint32_t elapsed = simClock.millis() - start;
+  uint32_t answered = stageHistogram(STAGE_TAP_TO_SCREEN).count() - answeredBefore;
+  printf("[%6u ms] burst: %u cards every %u ms, %u missed, %u answered in %u ms (%u.%02u taps/s)\n",
+         (unsigned)simClock.millis(), (unsigned)count, (unsigned)gapMs, (unsigned)missed,
+         (unsigned)answered, (unsigned)elapsed,
+         (unsigned)(answered * 1000 / elapsed), (unsigned)(answered * 100000 / elapsed % 100));
+}
+
+// ==========================================
+// LOAD TEST
+// ==========================================
+
+static void runLoadTest(const LoadParams& params) {
+  printf("Load test: %u devices, %.1f taps/min each, %s, %u min; server %u workers, %u ms + %u ms/record, "
+         "%u%% errors",
+         (unsigned)params.devices, params.tapsPerMin, loadDistNames[params.dist], (unsigned)params.minutes,
+         (unsigned)std::max(loadServer.workers, (uint32_t)1), (unsigned)loadServer.baseMs,
+         (unsigned)loadServer.perRecordMs, (unsigned)loadServer.errorPct);
+  if (loadOutage.lenMs > 0) {
+    printf("; %s outage %u-%u s", loadOutage.wifi ? "Wi-Fi" : "server", (unsigned)(loadOutage.startMs / 1000),
+           (unsigned)((loadOutage.startMs + loadOutage.lenMs) / 1000));
+  }
+  printf("\n");
+
+  auto start = std::chrono::steady_clock::now();
+  LoadReport* reportPtr = new LoadReport();
+  LoadReport& report = *reportPtr;
+  runLoadModel(params, report);
+  double hostMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  LoadRun& run = report.run;
+
+  char line[160];
+  loadTimelineHeader(line, sizeof(line));
+  printf("  %s\n", line);
+  for (size_t i = 0; i < loadWindows(report); i++) {
+    loadTimelineRow(report, i, line, sizeof(line));
+    printf("  %s\n", line);
+  }
+
+  uint32_t journalFull = run.results[CHECKIN_FAILED];
+  double spanS = report.spanMs / 1000.0;
+  printf("  Taps: %u offered, %u dropped (tap queue full), %u refused (journal full)\n", (unsigned)report.offered,
+         (unsigned)run.dropped, (unsigned)journalFull);
+  printf("  Stored: %u records, %.1f/s over %.0f s; %u requests (%.1f records each), %.1f KB on the wire\n",
+         (unsigned)report.delivered, report.delivered / spanS, spanS, (unsigned)report.requests,
+         report.batches ? (double)report.delivered / report.batches : 0.0, run.wireBytes / 1024.0);
+  printf("  Server: %.0f%% busy; %u x 503, %u transport errors, %u timeouts, %u replays answered 409\n",
+         100.0 * run.busyMs / ((double)report.spanMs * run.workerFree.size()), (unsigned)run.serverErrors,
+         (unsigned)run.transportErrors, (unsigned)run.timeouts, (unsigned)run.serverDuplicates);
+  printf("  Retries: %u records posted again after a failed request\n",
+         (unsigned)(run.recordsPosted - report.delivered));
+  printf("  On screen: %u welcome, %u duplicate, %u saved offline, %u failed\n",
+         (unsigned)run.results[CHECKIN_OK], (unsigned)run.results[CHECKIN_DUPLICATE],
+         (unsigned)run.results[CHECKIN_QUEUED], (unsigned)run.results[CHECKIN_FAILED]);
+  printf("  Tap to result (ms):  p50 %u  p95 %u  p99 %u  max %u\n", (unsigned)loadPercentile(run.resultMs, 0.5),
+         (unsigned)loadPercentile(run.resultMs, 0.95), (unsigned)loadPercentile(run.resultMs, 0.99),
+         (unsigned)loadPercentile(run.resultMs, 1.0));
+  printf("  Tap to stored (ms):  p50 %u  p95 %u  p99 %u  max %u\n", (unsigned)loadPercentile(run.deliveryMs, 0.5),
+         (unsigned)loadPercentile(run.deliveryMs, 0.95), (unsigned)loadPercentile(run.deliveryMs, 0.99),
+         (unsigned)loadPercentile(run.deliveryMs, 1.0));
+
+  // Replays answered 409 are fine (the seq makes them idempotent); a
+  // tap that never reached the server is not
+  bool ok = run.dropped == 0 && journalFull == 0 && report.pendingEnd == 0 && report.delivered == report.offered;
+  printf("  %s: %u of %u taps stored exactly once, %u left in journals (%.0f ms host time)\n",
+         ok ? "PASS" : "FAIL", (unsigned)report.delivered, (unsigned)report.offered, (unsigned)report.pendingEnd,
+         hostMs);
+  simFailures += !ok;
+  delete reportPtr;
+}
+
+// expect <stage> p<NN> <ms>   NN-th percentile of a tap stage at most <ms>
+// expect pending <n>         at most <n> check-ins left in the journal
+// expect missed <n>          the last burst missed at most <n> cards
+static void runExpect(const char* what, const char* arg, const char* limit) {
+  uint32_t got = 0;
+  uint32_t max = (uint32_t)atoi(limit ? limit : arg);
+  bool known = true;
+
+  if (strcmp(what, "pending") == 0) {
+    got = journal.pendingCount();
+  } else if (strcmp(what, "missed") == 0) {
+    got = burstMissed;
+  } else {
+    known = false;
+    for (int s = 0; s < STAGE_COUNT; s++) {
+      const LatencyHistogram& h = stageHistogram((TapStage)s);
+      if (strcmp(what, stageName((TapStage)s)) == 0 && arg[0] == 'p' && limit && h.count() > 0) {
+        got = (h.percentileUs(atoi(arg + 1) / 100.0f) + 999) / 1000;
+        known = true;
+      }
+    }
+  }
+
+  bool ok = known && got <= max;
+  printf("[%6u ms] expect %s %s%s%s: %s (%u)\n", (unsigned)simClock.millis(), what, arg,
+         limit ? " " : "", limit ? limit : "", ok ? "pass" : "FAIL", (unsigned)got);
+  simFailures += !ok;
+}
+
+static void runCommand(char* line) {
+  char* hash = strchr(line, '#');
+  if (hash) {
+    *hash = '\0';
+  }
+  char* cmd = strtok(line, " \t\r\n");
+  if (!cmd) {
+    return;
+  }
+  char* arg1 = strtok(NULL, " \t\r\n");
+  char* arg2 = strtok(NULL, " \t\r\n");
+  char* arg3 = strtok(NULL, " \t\r\n");
+  char* arg4 = strtok(NULL, " \t\r\n");
+
+  if (strcmp(cmd, "tap") == 0 && arg1 && arg2) {
+    unsigned door = (unsigned)atoi(arg1);
+    CardUid uid = CardUid::parse(arg2);
+    if (door >= SIM_DOORS || uid.empty()) {
+      printf("? bad tap: %s %s\n", arg1, arg2);
+      return;
+    }
+    doors[door].present(uid);
+    tick();
+  } else if (strcmp(cmd, "press") == 0 && arg1 && arg2) {
+    HalButton button = strcmp(arg1, "clear") == 0 ? BUTTON_CLEAR : BUTTON_FETCH;
+    buttons.down[button] = true;
+    runFor((uint32_t)atoi(arg2));
+    buttons.down[button] = false;
+    tick();
+  } else if (strcmp(cmd, "wait") == 0 && arg1) {
+    runFor((uint32_t)atoi(arg1));
+  } else if (strcmp(cmd, "offline") == 0) {
+    linkUp = false;
+  } else if (strcmp(cmd, "online") == 0) {
+    linkUp = true;
+    if (rosterSyncPending) {
+      backend.syncRoster(attendance.eventId());
+      printf("[%6u ms] link up: deferred roster sync, %u entries\n", (unsigned)simClock.millis(),
+             (unsigned)roster.size());
+    }
+  } else if (strcmp(cmd, "latency") == 0 && arg1) {
+    serverLatency = (uint32_t)atoi(arg1);
+  } else if (strcmp(cmd, "expect") == 0 && arg1 && arg2) {
+    runExpect(arg1, arg2, arg3);
+  } else if (strcmp(cmd, "loadtest") == 0) {
+    LoadDistribution dist = LOAD_UNIFORM;
+    if (arg3 && strcmp(arg3, "burst") == 0) {
+      dist = LOAD_BURST;
+    } else if (arg3 && strcmp(arg3, "ramp") == 0) {
+      dist = LOAD_RAMP;
+    }
+    LoadParams params = { arg1 ? (uint32_t)atoi(arg1) : 50, arg2 ? atof(arg2) : 6.0, dist,
+                          arg4 ? (uint32_t)atoi(arg4) : 10 };
+    runLoadTest(params);
+  } else if (strcmp(cmd, "loadserver") == 0 && arg1 && arg2 && arg3) {
+    loadServer.workers = (uint32_t)atoi(arg1);
+    loadServer.baseMs = (uint32_t)atoi(arg2);
+    loadServer.perRecordMs = (uint32_t)atoi(arg3);
+    loadServer.errorPct = arg4 ? (uint32_t)atoi(arg4) : 0;
+  } else if (strcmp(cmd, "loadoutage") == 0 && arg1 && arg2) {
+    loadOutage.startMs = (uint32_t)atoi(arg1) * 1000;
+    loadOutage.lenMs = (uint32_t)atoi(arg2) * 1000;
+    loadOutage.wifi = arg3 && strcmp(arg3, "wifi") == 0;
+  } else if (strcmp(cmd, "serverevent") == 0 && arg1) {
+    serverEvent = (uint32_t)atoi(arg1);
+  } else if (strcmp(cmd, "burst") == 0 && arg1 && arg2) {
+    runBurst((uint32_t)atoi(arg1), (uint32_t)atoi(arg2));
+  } else {
+    printf("? unknown command: %s\n", cmd);
+    simFailures++;
+  }
+}
+
+int main() {
+  journal.begin(&journalStorage);
+  for (uint8_t i = 0; i < SIM_DOORS; i++) {
+    readers.add(&doors[i], i);
+  }
+  device.begin();
+
+  char line[128];
+  while (fgets(line, sizeof(line), stdin)) {
+    runCommand(line);
+  }
+
+  // Let outstanding check-ins finish before reporting
+  runFor(1000);
+  printf("\nJournal: %u pending, %u batches / %u records sent, %u taps dropped\n",
+         (unsigned)journal.pendingCount(), (unsigned)dispatcher.batchesSent(),
+         (unsigned)dispatcher.recordsSent(), (unsigned)dispatcher.tapsDropped());
+  printTapMetrics(simLog);
+  if (simFailures > 0) {
+    printf("%u failed checks\n", (unsigned)simFailures);
+  }
+  return simFailures > 0 ? 1 : 0;
+}
+#endif // PIO_UNIT_TESTING
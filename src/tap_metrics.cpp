@@ -0,0 +1,98 @@
+#include "tap_metrics.h"
+#include <stdio.h>
+
+static LatencyHistogram histograms[STAGE_COUNT];
+
+static const char* const stageNames[STAGE_COUNT] = {
+  "picc_select",
+  "uid_format",
+  "http_connect",
+  "tls_connect",
+  "http_request",
+  "response_parse",
+  "oled_flush",
+  "tap_to_screen"
+};
+
+static const float quantiles[] = { 0.5f, 0.95f, 0.99f };
+
+void recordStage(TapStage stage, uint32_t us) {
+  histograms[stage].record(us);
+}
+
+const LatencyHistogram& stageHistogram(TapStage stage) {
+  return histograms[stage];
+}
+
+const char* stageName(TapStage stage) {
+  return stageNames[stage];
+}
+
+void resetTapMetrics() {
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    histograms[i].reset();
+  }
+}
+
+// ==========================================
+// REPORTS
+// ==========================================
+
+// Seconds with microsecond precision, without floating point formatting
+static void formatSeconds(char* out, size_t size, uint64_t us) {
+  snprintf(out, size, "%lu.%06lu", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+}
+
+void writePrometheusMetrics(HalLog& out) {
+  char value[24];
+
+  out.println("# HELP tap_stage_latency_seconds Time spent in each stage of the tap path");
+  out.println("# TYPE tap_stage_latency_seconds histogram");
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    const LatencyHistogram& h = histograms[s];
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+      cumulative += h.bucketCount(i);
+      formatSeconds(value, sizeof(value), LatencyHistogram::bucketBoundUs(i));
+      out.printf("tap_stage_latency_seconds_bucket{stage=\"%s\",le=\"%s\"} %lu\n",
+                 stageNames[s], value, (unsigned long)cumulative);
+    }
+    out.printf("tap_stage_latency_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n",
+               stageNames[s], (unsigned long)h.count());
+    formatSeconds(value, sizeof(value), h.sumUs());
+    out.printf("tap_stage_latency_seconds_sum{stage=\"%s\"} %s\n", stageNames[s], value);
+    out.printf("tap_stage_latency_seconds_count{stage=\"%s\"} %lu\n", stageNames[s], (unsigned long)h.count());
+  }
+
+  // Device-side estimates, so a plain curl shows the tail without PromQL
+  out.println("# HELP tap_stage_latency_quantile_seconds Percentile estimated from the histogram buckets");
+  out.println("# TYPE tap_stage_latency_quantile_seconds gauge");
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    for (float q : quantiles) {
+      formatSeconds(value, sizeof(value), histograms[s].percentileUs(q));
+      out.printf("tap_stage_latency_quantile_seconds{stage=\"%s\",quantile=\"%g\"} %s\n",
+                 stageNames[s], (double)q, value);
+    }
+  }
+
+  out.println("# HELP tap_stage_latency_max_seconds Slowest sample seen");
+  out.println("# TYPE tap_stage_latency_max_seconds gauge");
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    formatSeconds(value, sizeof(value), histograms[s].maxUs());
+    out.printf("tap_stage_latency_max_seconds{stage=\"%s\"} %s\n", stageNames[s], value);
+  }
+}
+
+void printTapMetrics(HalLog& out) {
+  out.println("Tap latency (us):");
+  out.printf("  %-15s %7s %9s %9s %9s %9s\n", "stage", "count", "p50", "p95", "p99", "max");
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    const LatencyHistogram& h = histograms[s];
+    if (h.count() == 0) {
+      continue;
+    }
+    out.printf("  %-15s %7lu %9lu %9lu %9lu %9lu\n", stageNames[s], (unsigned long)h.count(),
+               (unsigned long)h.percentileUs(0.5f), (unsigned long)h.percentileUs(0.95f),
+               (unsigned long)h.percentileUs(0.99f), (unsigned long)h.maxUs());
+  }
+}
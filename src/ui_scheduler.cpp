@@ -0,0 +1,86 @@
+#include "ui_scheduler.h"
+
+UiScheduler::UiScheduler(HalBuzzer& buzzer)
+  : buzzer(buzzer), holding(false), heldSince(0), screenDeadline(0),
+    patternSteps(0), patternStep(0), stepDeadline(0) {}
+
+// ==========================================
+// SCREENS
+// ==========================================
+
+void UiScheduler::holdScreen(uint32_t nowMs, uint32_t ms) {
+  holding = true;
+  heldSince = nowMs;
+  screenDeadline = nowMs + ms;
+}
+
+void UiScheduler::releaseScreen() {
+  holding = false;
+}
+
+// ==========================================
+// BUZZER
+// ==========================================
+
+void UiScheduler::playBuzzer(uint32_t nowMs, const uint16_t* steps, uint8_t count) {
+  if (count > UI_PATTERN_MAX) {
+    count = UI_PATTERN_MAX;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    pattern[i] = steps[i];
+  }
+  patternSteps = count;
+  patternStep = 0;
+  if (count == 0) {
+    buzzer.set(false);
+    return;
+  }
+  buzzer.set(true);
+  stepDeadline = nowMs + pattern[0];
+}
+
+// ==========================================
+// SCHEDULING
+// ==========================================
+
+bool UiScheduler::poll(uint32_t nowMs) {
+  // Catch up on every buzzer step that is due (a long loop pass may skip some)
+  while (patternStep < patternSteps && (int32_t)(nowMs - stepDeadline) >= 0) {
+    patternStep++;
+    if (patternStep < patternSteps) {
+      buzzer.set(patternStep % 2 == 0);
+      stepDeadline += pattern[patternStep];
+    } else {
+      buzzer.set(false);
+    }
+  }
+
+  if (holding && (int32_t)(nowMs - screenDeadline) >= 0) {
+    holding = false;
+    return true;
+  }
+  return false;
+}
+
+uint32_t UiScheduler::msUntilNext(uint32_t nowMs, uint32_t maxWaitMs) const {
+  uint32_t wait = maxWaitMs;
+  if (patternStep < patternSteps) {
+    int32_t left = (int32_t)(stepDeadline - nowMs);
+    if (left <= 0) {
+      return 0;
+    }
+    if ((uint32_t)left < wait) {
+      wait = left;
+    }
+  }
+  if (holding) {
+    int32_t left = (int32_t)(screenDeadline - nowMs);
+    if (left <= 0) {
+      return 0;
+    }
+    if ((uint32_t)left < wait) {
+      wait = left;
+    }
+  }
+  return wait;
+}
@@ -0,0 +1,109 @@
+#include "uid_cache.h"
+#include <string.h>
+
+#define BUCKET_MASK (UID_CACHE_BUCKETS - 1)
+
+UidCache::UidCache(uint32_t windowMs) : windowMs(windowMs), hitCount(0), missCount(0) {
+  clear();
+}
+
+void UidCache::clear() {
+  for (size_t i = 0; i < UID_CACHE_ENTRIES; i++) {
+    ring[i].live = false;
+  }
+  memset(buckets, 0, sizeof(buckets));
+  head = 0;
+}
+
+uint8_t UidCache::size() const {
+  uint8_t n = 0;
+  for (size_t i = 0; i < UID_CACHE_ENTRIES; i++) {
+    n += ring[i].live ? 1 : 0;
+  }
+  return n;
+}
+
+// FNV-1a over the UID bytes
+uint8_t UidCache::hash(const CardUid& uid) {
+  uint32_t h = 2166136261u;
+  for (uint8_t i = 0; i < uid.size(); i++) {
+    h = (h ^ uid.data()[i]) * 16777619u;
+  }
+  return (uint8_t)((h ^ (h >> 16)) & BUCKET_MASK);
+}
+
+int UidCache::find(const CardUid& uid, uint8_t home) const {
+  // Never more than UID_CACHE_ENTRIES occupied, so an empty bucket ends the probe
+  for (size_t b = home; buckets[b] != 0; b = (b + 1) & BUCKET_MASK) {
+    if (ring[buckets[b] - 1].uid == uid) {
+      return (int)b;
+    }
+  }
+  return -1;
+}
+
+// Backward-shift deletion: pull later entries of the probe run into the
+// hole unless that would move them before their home bucket
+void UidCache::removeBucket(size_t hole) {
+  size_t b = hole;
+  for (;;) {
+    b = (b + 1) & BUCKET_MASK;
+    if (buckets[b] == 0) {
+      break;
+    }
+    size_t home = ring[buckets[b] - 1].home;
+    bool homeInRun = hole <= b ? (hole < home && home <= b) : (hole < home || home <= b);
+    if (!homeInRun) {
+      buckets[hole] = buckets[b];
+      hole = b;
+    }
+  }
+  buckets[hole] = 0;
+}
+
+void UidCache::append(const CardUid& uid, uint8_t home, uint32_t nowMs) {
+  Entry& slot = ring[head];
+  if (slot.live) {
+    // Oldest card falls out
+    removeBucket((size_t)find(slot.uid, slot.home));
+  }
+  slot.uid = uid;
+  slot.seenMs = nowMs;
+  slot.home = home;
+  slot.live = true;
+
+  size_t b = home;
+  while (buckets[b] != 0) {
+    b = (b + 1) & BUCKET_MASK;
+  }
+  buckets[b] = (uint8_t)(head + 1);
+  head = (uint8_t)((head + 1) % UID_CACHE_ENTRIES);
+}
+
+void UidCache::forget(const CardUid& uid) {
+  int b = find(uid, hash(uid));
+  if (b >= 0) {
+    ring[buckets[b] - 1].live = false;
+    removeBucket((size_t)b);
+  }
+}
+
+bool UidCache::seenRecently(const CardUid& uid, uint32_t nowMs) {
+  uint8_t home = hash(uid);
+  int b = find(uid, home);
+
+  if (b >= 0) {
+    Entry& entry = ring[buckets[b] - 1];
+    if (nowMs - entry.seenMs < windowMs) {
+      hitCount++;
+      return true;
+    }
+    // Seen before but long enough ago: move it to the newest end
+    entry.live = false;
+    removeBucket((size_t)b);
+  }
+
+  missCount++;
+  append(uid, home, nowMs);
+  return false;
+}
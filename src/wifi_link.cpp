@@ -0,0 +1,311 @@
+#include "wifi_link.h"
+#include "wifi_supervisor.h"
+#include "attendance_mode.h"
+#include "spsc_queue.h"
+#include "config.h"
+#include "screens.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiManager.h>
+#include <Preferences.h>
+#include <esp_wifi.h>
+
+#define WIFI_NVS_KEY "ap"
+#define WIFI_PORTAL_POLL 10   // ms between WiFiManager::process() calls while the portal is open
+
+// ==========================================
+// DRIVER (Arduino WiFi)
+// ==========================================
+
+class EspWifiDriver : public WifiDriver {
+public:
+  void connect(const WifiNetwork& net, const WifiAp* ap) override {
+    if (ap) {
+      WiFi.begin(net.ssid, net.pass, ap->channel, ap->bssid);
+    } else {
+      WiFi.begin(net.ssid, net.pass);
+    }
+  }
+  void disconnect() override {
+    WiFi.disconnect();
+  }
+  bool startScan() override {
+    return WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING;
+  }
+  size_t scanResults(WifiAp* out, size_t max) override {
+    int16_t found = WiFi.scanComplete();
+    size_t n = 0;
+    for (int16_t i = 0; i < found && n < max; i++, n++) {
+      snprintf(out[n].ssid, sizeof(out[n].ssid), "%s", WiFi.SSID(i).c_str());
+      memcpy(out[n].bssid, WiFi.BSSID(i), sizeof(out[n].bssid));
+      out[n].channel = (uint8_t)WiFi.channel(i);
+      out[n].rssi = (int8_t)WiFi.RSSI(i);
+    }
+    WiFi.scanDelete();
+    return n;
+  }
+  bool currentAp(WifiAp& out) override {
+    if (WiFi.status() != WL_CONNECTED) {
+      return false;
+    }
+    snprintf(out.ssid, sizeof(out.ssid), "%s", WiFi.SSID().c_str());
+    memcpy(out.bssid, WiFi.BSSID(), sizeof(out.bssid));
+    out.channel = (uint8_t)WiFi.channel();
+    out.rssi = (int8_t)WiFi.RSSI();
+    return true;
+  }
+};
+
+static EspWifiDriver driver;
+static WifiSupervisor supervisor(driver, 1);   // Seeded in startWiFi()
+static WiFiManager wifiManager;
+static const WifiNetwork extraNetworks[] = WIFI_EXTRA_NETWORKS;
+
+// Wi-Fi event task -> supervisor task
+static SpscQueue<LinkEvent, 8> linkEvents;
+static TaskHandle_t wifiTaskHandle = NULL;
+
+// Supervisor task state
+static WifiAp cachedAp;                 // As in NVS
+static bool portalOpened = false;       // Once per boot
+static bool portalOpen = false;
+static uint32_t startMs = 0;
+static uint32_t savedJoins = 0;
+
+// Loop task state
+static std::atomic<bool> setupScreenDue(false);
+static bool setupShown = false;         // Setup screen held on the panel
+static bool loopLinkUp = false;
+
+// ==========================================
+// CACHED AP + NETWORKS (NVS)
+// ==========================================
+
+static bool sameAp(const WifiAp& a, const WifiAp& b) {
+  return a.channel == b.channel && memcmp(a.bssid, b.bssid, sizeof(a.bssid)) == 0 &&
+         strcmp(a.ssid, b.ssid) == 0;
+}
+
+static bool loadCachedAp() {
+  Preferences prefs;
+  if (!prefs.begin(WIFI_NVS_NAMESPACE, true)) {
+    return false;
+  }
+  bool ok = prefs.getBytes(WIFI_NVS_KEY, &cachedAp, sizeof(cachedAp)) == sizeof(cachedAp);
+  prefs.end();
+  return ok && cachedAp.channel != 0;
+}
+
+static void saveCachedAp(const WifiAp& ap) {
+  if (sameAp(ap, cachedAp)) {
+    return;
+  }
+  Preferences prefs;
+  if (!prefs.begin(WIFI_NVS_NAMESPACE, false)) {
+    return;
+  }
+  if (prefs.putBytes(WIFI_NVS_KEY, &ap, sizeof(ap)) == sizeof(ap)) {
+    cachedAp = ap;
+  }
+  prefs.end();
+}
+
+// The network the setup portal stored (read from the driver; WiFi.SSID()
+// is only filled in once connected), then WIFI_EXTRA_NETWORKS
+static void loadNetworks() {
+  wifi_config_t conf = {};
+  esp_wifi_get_config(WIFI_IF_STA, &conf);
+  char ssid[WIFI_SSID_MAX + 1];
+  char pass[WIFI_PASS_MAX + 1];
+  snprintf(ssid, sizeof(ssid), "%.32s", (const char*)conf.sta.ssid);
+  snprintf(pass, sizeof(pass), "%.64s", (const char*)conf.sta.password);
+
+  supervisor.clearNetworks();
+  supervisor.addNetwork(ssid, pass);
+  for (size_t i = 0; i < sizeof(extraNetworks) / sizeof(extraNetworks[0]); i++) {
+    supervisor.addNetwork(extraNetworks[i].ssid, extraNetworks[i].pass);
+  }
+}
+
+// ==========================================
+// SUPERVISOR TASK
+// ==========================================
+
+static void onWifiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  bool queued = false;
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      queued = linkEvents.push(LINK_EV_UP);
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      queued = linkEvents.push(LINK_EV_DOWN);
+      break;
+    case ARDUINO_EVENT_WIFI_SCAN_DONE:
+      queued = linkEvents.push(LINK_EV_SCAN_DONE);
+      break;
+    default:
+      break;
+  }
+  if (queued && wifiTaskHandle) {
+    xTaskNotifyGive(wifiTaskHandle);
+  }
+}
+
+static void openPortal() {
+  portalOpened = true;
+  portalOpen = true;
+  supervisor.pause();
+  setupScreenDue = true;
+
+  Serial.println("----------------------------------------");
+  Serial.println("WiFi Setup Mode Active (cards still accepted offline)");
+  Serial.println("1. Connect your phone/laptop to WiFi:");
+  Serial.println("   Network: " WIFI_SETUP_AP);
+  Serial.println("   (No password needed)");
+  Serial.println("2. A popup will appear automatically");
+  Serial.println("3. Select your WiFi and enter password");
+  Serial.println("4. ESP32 will connect and save settings");
+  Serial.println("----------------------------------------");
+
+  wifiManager.setConfigPortalBlocking(false);
+  wifiManager.setConfigPortalTimeout(WIFI_PORTAL_TIMEOUT);
+  wifiManager.startConfigPortal(WIFI_SETUP_AP);
+}
+
+// With no network stored, or none joined within WIFI_CONNECT_TIMEOUT of
+// reset, the portal opens; the supervisor takes over again once it closes
+static void checkPortal(uint32_t nowMs) {
+  if (!portalOpened && supervisor.stats().joins == 0 &&
+      (supervisor.networkCount() == 0 || nowMs - startMs >= WIFI_CONNECT_TIMEOUT)) {
+    if (supervisor.networkCount() > 0) {
+      Serial.println("✗ Saved WiFi failed, starting setup...");
+    }
+    openPortal();
+  }
+  if (!portalOpen) {
+    return;
+  }
+
+  wifiManager.process();
+  if (wifiManager.getConfigPortalActive() && !supervisor.linkUp()) {
+    return;
+  }
+  // Saved, timed out, or the link came up on its own
+  if (wifiManager.getConfigPortalActive()) {
+    wifiManager.stopConfigPortal();
+  }
+  portalOpen = false;
+  loadNetworks();
+  supervisor.begin(nowMs, NULL);
+}
+
+static void wifiTask(void* param) {
+  for (;;) {
+    LinkEvent event;
+    while (linkEvents.pop(event)) {
+      supervisor.onEvent(event, millis());
+    }
+
+    // Remember each AP joined for the next boot's scan-free join
+    if (supervisor.linkUp() && supervisor.stats().joins != savedJoins) {
+      savedJoins = supervisor.stats().joins;
+      saveCachedAp(supervisor.ap());
+    }
+
+    checkPortal(millis());
+    uint32_t waitMs = supervisor.poll(millis());
+    if (portalOpen && waitMs > WIFI_PORTAL_POLL) {
+      waitMs = WIFI_PORTAL_POLL;
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs > 0 ? waitMs : 1));
+  }
+}
+
+void startWiFi() {
+  startMs = millis();
+  WiFi.onEvent(onWifiEvent);
+  WiFi.persistent(false);          // Only the portal writes credentials
+  WiFi.setAutoReconnect(false);    // The supervisor reconnects
+  WiFi.mode(WIFI_STA);
+  // esp_random() is only random with the radio on; before this it is
+  // the same on every device powered on together
+  supervisor.seed(esp_random());
+  seedEventPoller(esp_random());
+#ifdef WIFI_STATIC_IP
+  WiFi.config(IPAddress(WIFI_STATIC_IP), IPAddress(WIFI_GATEWAY), IPAddress(WIFI_SUBNET), IPAddress(WIFI_DNS));
+#endif
+
+  loadNetworks();
+  if (supervisor.networkCount() == 0) {
+    Serial.println("⚠️ No saved WiFi - setup portal opens once running");
+  } else if (loadCachedAp()) {
+    Serial.println("✓ WiFi joining " + String(cachedAp.ssid) + " (cached AP, channel " +
+                   String(cachedAp.channel) + ")");
+  } else {
+    Serial.println("✓ WiFi scanning for " + String(supervisor.networkCount()) + " known network(s)");
+  }
+  supervisor.begin(startMs, cachedAp.channel != 0 ? &cachedAp : NULL);
+
+  if (xTaskCreatePinnedToCore(wifiTask, "wifi", WIFI_TASK_STACK, NULL,
+                              WIFI_TASK_PRIORITY, &wifiTaskHandle, WIFI_TASK_CORE) != pdPASS) {
+    Serial.println("✗ WiFi supervisor task creation failed - no reconnects");
+  }
+}
+
+// ==========================================
+// LOOP SIDE
+// ==========================================
+
+bool wifiLinkUp() {
+  return supervisor.linkUp();
+}
+
+bool pollWiFi(HalDisplay& display, UiScheduler& ui) {
+  if (setupScreenDue.exchange(false)) {
+    displayWifiSetup(display, WIFI_SETUP_AP);
+    ui.holdScreen(millis(), WIFI_PORTAL_TIMEOUT * 1000UL);
+    setupShown = true;
+  }
+
+  bool up = supervisor.linkUp();
+  if (up == loopLinkUp) {
+    return false;
+  }
+  loopLinkUp = up;
+  if (!up) {
+    Serial.println("✗ WiFi link lost - check-ins are journaled until it is back");
+    return false;
+  }
+
+  const WifiStats& st = supervisor.stats();
+  if (st.joins == 1) {
+    Serial.println("✓ WiFi connected " + String(millis() - startMs) + "ms after start");
+  } else {
+    Serial.println("✓ WiFi back (" + String(st.drops) + " drops, " + String(st.roams) + " roams so far)");
+  }
+  Serial.println("  SSID: " + WiFi.SSID());
+  Serial.println("  IP: " + WiFi.localIP().toString());
+  Serial.println("  Signal: " + String(WiFi.RSSI()) + " dBm");
+
+  // Setup screen down; the mode screen comes back on the next poll
+  if (setupShown && ui.screenHeld()) {
+    ui.holdScreen(millis(), 0);
+  }
+  setupShown = false;
+  return true;
+}
+
+void printWifiStats() {
+  static const char* const stateNames[] = { "idle", "scanning", "joining", "online", "backoff" };
+  const WifiStats& st = supervisor.stats();
+  const WifiAp& ap = supervisor.ap();
+  Serial.println("WiFi: " + String(stateNames[supervisor.state()]) + (portalOpen ? " (setup portal open)" : ""));
+  if (supervisor.linkUp()) {
+    Serial.printf("  AP: %s %02X:%02X:%02X:%02X:%02X:%02X ch %u, %d dBm\n", ap.ssid, ap.bssid[0], ap.bssid[1],
+                  ap.bssid[2], ap.bssid[3], ap.bssid[4], ap.bssid[5], ap.channel, WiFi.RSSI());
+  }
+  Serial.println("  Joins: " + String(st.joins) + ", drops: " + String(st.drops) + ", roams: " + String(st.roams) +
+                 ", attempts: " + String(st.attempts) + " (" + String(st.failures) + " failed), scans: " + String(st.scans));
+  Serial.println("  Offline after first join: " + String(st.downMs / 1000) + "s, last backoff " +
+                 String(st.lastBackoffMs) + "ms");
+}
@@ -0,0 +1,267 @@
+#include "wifi_supervisor.h"
+#include <stdio.h>
+#include <string.h>
+
+WifiSupervisor::WifiSupervisor(WifiDriver& driver, uint32_t seed)
+  : driver(driver), count(0), nextBlind(0), current(LINK_IDLE), up(false), everUp(false),
+    roamScan(false), dropExpected(false), deadline(0), lastRoamScan(0), downSince(0),
+    failStreak(0), rng(seed ? seed : 1) {
+  memset(&joined, 0, sizeof(joined));
+  memset(&st, 0, sizeof(st));
+}
+
+// ==========================================
+// NETWORKS
+// ==========================================
+
+bool WifiSupervisor::addNetwork(const char* ssid, const char* pass) {
+  if (count == WIFI_NETWORKS_MAX || !ssid || ssid[0] == '\0') {
+    return false;
+  }
+  snprintf(networks[count].ssid, sizeof(networks[count].ssid), "%s", ssid);
+  snprintf(networks[count].pass, sizeof(networks[count].pass), "%s", pass ? pass : "");
+  count++;
+  return true;
+}
+
+void WifiSupervisor::clearNetworks() {
+  count = 0;
+  nextBlind = 0;
+}
+
+int WifiSupervisor::networkOf(const char* ssid) const {
+  for (uint8_t i = 0; i < count; i++) {
+    if (strcmp(networks[i].ssid, ssid) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// ==========================================
+// CONTROL
+// ==========================================
+
+void WifiSupervisor::begin(uint32_t nowMs, const WifiAp* hint) {
+  failStreak = 0;
+  roamScan = false;
+  if (current == LINK_ONLINE) {
+    return;   // Came up while paused
+  }
+  if (count == 0) {
+    current = LINK_IDLE;
+    return;
+  }
+  if (hint && hint->channel != 0 && networkOf(hint->ssid) >= 0) {
+    join(nowMs, *hint, WIFI_FAST_CONNECT_TIMEOUT);
+  } else {
+    scan(nowMs);
+  }
+}
+
+void WifiSupervisor::pause() {
+  current = LINK_IDLE;
+  roamScan = false;
+}
+
+void WifiSupervisor::join(uint32_t nowMs, const WifiAp& target, uint32_t timeoutMs) {
+  int n = networkOf(target.ssid);
+  if (n < 0) {
+    failed(nowMs);
+    return;
+  }
+
+  // Leaving a live link for another AP: its drop is ours, not a failure
+  dropExpected = linkUp();
+  setUp(false, nowMs);
+
+  joined = target;
+  st.attempts++;
+  driver.connect(networks[n], target.channel != 0 ? &target : NULL);
+  current = LINK_JOINING;
+  deadline = nowMs + timeoutMs;
+}
+
+void WifiSupervisor::scan(uint32_t nowMs) {
+  roamScan = false;
+  if (!driver.startScan()) {
+    // No scan results to go by: the networks in turn, by name
+    WifiAp blind;
+    memset(&blind, 0, sizeof(blind));
+    snprintf(blind.ssid, sizeof(blind.ssid), "%s", networks[nextBlind % count].ssid);
+    nextBlind++;
+    join(nowMs, blind, WIFI_ATTEMPT_TIMEOUT);
+    return;
+  }
+  st.scans++;
+  current = LINK_SCANNING;
+  deadline = nowMs + WIFI_ATTEMPT_TIMEOUT;
+}
+
+void WifiSupervisor::failed(uint32_t nowMs) {
+  st.failures++;
+  if (failStreak < 31) {
+    failStreak++;
+  }
+  driver.disconnect();
+  st.lastBackoffMs = backoffMs();
+  current = LINK_BACKOFF;
+  deadline = nowMs + st.lastBackoffMs;
+}
+
+void WifiSupervisor::setUp(bool linkIsUp, uint32_t nowMs) {
+  if (linkIsUp == linkUp()) {
+    return;
+  }
+  if (linkIsUp) {
+    if (everUp) {
+      st.downMs += nowMs - downSince;
+    }
+    everUp = true;
+    st.joins++;
+  } else {
+    downSince = nowMs;
+  }
+  up.store(linkIsUp, std::memory_order_release);
+}
+
+// ==========================================
+// EVENTS + TIMERS
+// ==========================================
+
+void WifiSupervisor::onEvent(LinkEvent event, uint32_t nowMs) {
+  switch (event) {
+    case LINK_EV_UP:
+      driver.currentAp(joined);
+      failStreak = 0;
+      roamScan = false;
+      dropExpected = false;
+      current = LINK_ONLINE;
+      setUp(true, nowMs);
+      deadline = nowMs + WIFI_RSSI_CHECK;
+      break;
+
+    case LINK_EV_DOWN:
+      if (current == LINK_JOINING && dropExpected) {
+        dropExpected = false;
+      } else if (current == LINK_ONLINE) {
+        // Straight back to the AP we just had, no scan
+        st.drops++;
+        setUp(false, nowMs);
+        join(nowMs, joined, WIFI_FAST_CONNECT_TIMEOUT);
+      } else if (current == LINK_JOINING) {
+        failed(nowMs);
+      } else {
+        setUp(false, nowMs);
+      }
+      break;
+
+    case LINK_EV_SCAN_DONE:
+      onScanDone(nowMs);
+      break;
+  }
+}
+
+void WifiSupervisor::onScanDone(uint32_t nowMs) {
+  WifiAp best;
+  bool found = strongestKnown(best);
+
+  if (current == LINK_SCANNING) {
+    if (found) {
+      join(nowMs, best, WIFI_ATTEMPT_TIMEOUT);
+    } else {
+      failed(nowMs);
+    }
+    return;
+  }
+
+  if (current != LINK_ONLINE || !roamScan) {
+    return;
+  }
+  roamScan = false;
+  if (found && memcmp(best.bssid, joined.bssid, sizeof(best.bssid)) != 0 &&
+      best.rssi >= joined.rssi + WIFI_ROAM_HYSTERESIS) {
+    st.roams++;
+    join(nowMs, best, WIFI_ATTEMPT_TIMEOUT);
+  }
+}
+
+bool WifiSupervisor::strongestKnown(WifiAp& out) {
+  WifiAp heard[WIFI_SCAN_MAX];
+  size_t n = driver.scanResults(heard, WIFI_SCAN_MAX);
+
+  int best = -1;
+  for (size_t i = 0; i < n; i++) {
+    if (networkOf(heard[i].ssid) >= 0 && (best < 0 || heard[i].rssi > heard[best].rssi)) {
+      best = (int)i;
+    }
+  }
+  if (best < 0) {
+    return false;
+  }
+  out = heard[best];
+  return true;
+}
+
+uint32_t WifiSupervisor::poll(uint32_t nowMs) {
+  if (current == LINK_IDLE) {
+    return WIFI_RSSI_CHECK;
+  }
+
+  if ((int32_t)(nowMs - deadline) >= 0) {
+    switch (current) {
+      case LINK_SCANNING:
+      case LINK_JOINING:
+        failed(nowMs);
+        break;
+
+      case LINK_BACKOFF:
+        scan(nowMs);
+        break;
+
+      case LINK_ONLINE: {
+        deadline = nowMs + WIFI_RSSI_CHECK;
+        if (roamScan && nowMs - lastRoamScan >= WIFI_ATTEMPT_TIMEOUT) {
+          roamScan = false;   // Scan never finished
+        }
+        // Weak signal: look around, at most every WIFI_ROAM_SCAN_INTERVAL
+        WifiAp cur;
+        if (!roamScan && driver.currentAp(cur) && cur.rssi < WIFI_ROAM_RSSI &&
+            nowMs - lastRoamScan >= WIFI_ROAM_SCAN_INTERVAL) {
+          joined.rssi = cur.rssi;
+          lastRoamScan = nowMs;
+          roamScan = driver.startScan();
+          st.scans += roamScan ? 1 : 0;
+        }
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  int32_t left = (int32_t)(deadline - nowMs);
+  return left > 0 ? (uint32_t)left : 0;
+}
+
+// Exponential from WIFI_BACKOFF_MIN, capped at WIFI_BACKOFF_MAX; half of
+// it fixed, half random ("equal jitter")
+uint32_t WifiSupervisor::backoffMs() {
+  uint32_t ceiling = WIFI_BACKOFF_MIN;
+  for (uint8_t i = 1; i < failStreak && ceiling < WIFI_BACKOFF_MAX; i++) {
+    ceiling *= 2;
+  }
+  if (ceiling > WIFI_BACKOFF_MAX) {
+    ceiling = WIFI_BACKOFF_MAX;
+  }
+  return ceiling / 2 + nextRandom() % (ceiling / 2 + 1);
+}
+
+// xorshift32
+uint32_t WifiSupervisor::nextRandom() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
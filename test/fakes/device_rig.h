@@ -0,0 +1,193 @@
+#ifndef DEVICE_RIG_H
+#define DEVICE_RIG_H
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "config.h"
+#include "checkin_log.h"
+#include "checkin_dispatcher.h"
+#include "roster.h"
+#include "attendance_controller.h"
+#include "device_controller.h"
+#include "ui_scheduler.h"
+#include "reader_array.h"
+#include "sim_hal.h"
+#include "ram_log_storage.h"
+
+// The firmware loop on sim_hal.h devices: DeviceController over an
+// AttendanceController, a journal in RAM, per-tap check-ins to a fake
+// server and two scripted doors. tick() is one loop pass plus the network
+// task's share of work, as in main.cpp; nothing else moves the clock.
+//
+// The rig is large (roster, journal, queues): keep it static.
+
+#define RIG_TICK 10
+#define RIG_DOORS 2
+
+// What the fake server answers; shared by every rig in a test binary
+struct RigServer {
+  bool linkUp;
+  int status;              // Answer to a check-in or a card registration
+  const char* studentName;
+  uint32_t checkIns;       // Requests received
+  uint32_t registrations;
+};
+
+static RigServer rigServer = { true, 200, "Student", 0, 0 };
+
+static int rigSend(const CheckinRecord&, char* studentName, size_t nameSize) {
+  if (!rigServer.linkUp) {
+    return -1;
+  }
+  rigServer.checkIns++;
+  snprintf(studentName, nameSize, "%s", rigServer.studentName);
+  return rigServer.status;
+}
+
+static bool rigLinkUp() {
+  return rigServer.linkUp;
+}
+
+static int rigRegister(const CardUid&) {
+  if (!rigServer.linkUp) {
+    return -1;
+  }
+  rigServer.registrations++;
+  return rigServer.status;
+}
+
+// One event and its roster; taps always journal
+class RigBackend : public AttendanceBackend {
+public:
+  explicit RigBackend(Roster& roster) : roster(roster), eventSet(false), journalUp(true), syncs(0) {
+    snprintf(id, sizeof(id), "%s", "evt-1");
+    snprintf(name, sizeof(name), "%s", "Demo Event");
+  }
+
+  // A roster entry the next sync loads
+  void student(const char* uid, const char* studentName, uint8_t flags) {
+    Student s;
+    s.uid = CardUid::parse(uid);
+    snprintf(s.name, sizeof(s.name), "%s", studentName);
+    s.flags = flags;
+    students.push_back(s);
+  }
+
+  bool fetchActiveEvent(char* outId, size_t idSize, char* outName, size_t nameSize) override {
+    if (!eventSet || !rigServer.linkUp) {
+      return false;
+    }
+    snprintf(outId, idSize, "%s", id);
+    snprintf(outName, nameSize, "%s", name);
+    return true;
+  }
+  bool takeEventChange(ActiveEvent&) override { return false; }
+  void refreshEvent() override {}
+  void syncRoster(const char*) override {
+    syncs++;
+    roster.clear();
+    for (const Student& s : students) {
+      roster.add(s.uid.data(), s.uid.size(), s.name, s.flags);
+    }
+    roster.finalize();
+  }
+  void eventCleared() override { roster.clear(); }
+  bool acquireRoster(const char*) override { return true; }
+  void releaseRoster() override {}
+  bool journalReady() override { return journalUp; }
+  void tapSubmitted() override {}
+  uint32_t timestamp() override { return 0; }
+
+  Roster& roster;
+  char id[CHECKIN_EVENT_ID_MAX + 1];
+  char name[ATT_EVENT_NAME_MAX + 1];
+  bool eventSet;
+  bool journalUp;
+  uint32_t syncs;
+
+private:
+  struct Student {
+    CardUid uid;
+    char name[ROSTER_NAME_MAX + 1];
+    uint8_t flags;
+  };
+  std::vector<Student> students;
+};
+
+class DeviceRig {
+public:
+  DeviceRig()
+    : buttons(clock), ui(buzzer), storage(CHECKIN_LOG_CAPACITY), dispatcher(journal, rigSend, NULL, rigLinkUp),
+      backend(roster), attendance(dispatcher, roster, backend, display, clock, ui, log),
+      device(attendance, rigRegister, display, clock, buttons, ui, log), netPaused(false), tapsSeen(0),
+      tapsDropped(0) {
+    rigServer = { true, 200, "Student", 0, 0 };
+    journal.begin(&storage);
+    for (uint8_t i = 0; i < RIG_DOORS; i++) {
+      readers.add(&doors[i], i);
+    }
+    device.begin();
+  }
+
+  // Attendance mode with the backend's event loaded and its roster synced
+  void startAttendance() {
+    backend.eventSet = true;
+    device.switchMode();
+    attendance.onFetchButton();
+  }
+
+  // One loop pass
+  void tick() {
+    if (!netPaused) {
+      while (dispatcher.runOnce(clock.millis())) {
+      }
+    }
+    device.poll();
+    CardTap tap;
+    if (readers.poll(tap)) {
+      tapsSeen++;
+      if (device.dropRepeat(tap)) {
+        tapsDropped++;
+      } else {
+        device.onTap(tap);
+      }
+    }
+  }
+
+  void runFor(uint32_t ms) {
+    uint32_t end = clock.millis() + ms;
+    while ((int32_t)(end - clock.millis()) > 0) {
+      clock.delay(RIG_TICK);
+      tick();
+    }
+  }
+
+  // Card at a door, read on the next pass
+  void tap(uint8_t door, const char* uid) {
+    doors[door].present(CardUid::parse(uid));
+    tick();
+  }
+
+  SimClock clock;
+  TextDisplay display;
+  MemoryLog log;
+  SimBuzzer buzzer;
+  SimButtons buttons;
+  UiScheduler ui;
+  RamLogStorage storage;
+  CheckinLog journal;
+  CheckinDispatcher dispatcher;
+  Roster roster;
+  RigBackend backend;
+  AttendanceController attendance;
+  DeviceController device;
+  ScriptedReader doors[RIG_DOORS];
+  ReaderArray readers;
+
+  bool netPaused;          // Network task stalled: taps queue, nothing is sent
+  uint32_t tapsSeen;       // Reads that reached the loop
+  uint32_t tapsDropped;    // Of those, dropped as repeats
+};
+
+#endif // DEVICE_RIG_H
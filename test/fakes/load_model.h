@@ -0,0 +1,464 @@
+#ifndef LOAD_MODEL_H
+#define LOAD_MODEL_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "config.h"
+#include "card_uid.h"
+#include "checkin_log.h"
+#include "checkin_dispatcher.h"
+#include "checkin_wire.h"
+#include "ram_log_storage.h"
+
+// The check-in path under load, shared by test_checkin_load and the
+// simulator's loadtest command: a room of devices, each with its own
+// journal and CheckinDispatcher (the code the network task runs), sending
+// binary frames (checkin_wire.h) to a mock /api/check-in/batch.
+//
+// Each device runs on its own clock; the one furthest behind always goes
+// next, so requests reach the server in time order. The server is a FIFO
+// queue in front of a fixed number of workers. Besides the totals, a run
+// keeps a timeline in windows of sampleMs: taps offered and stored,
+// requests, failures, retries, result latency and journal depth.
+
+#define LOAD_RTT_MS 30              // Request + response on a warm keep-alive connection
+#define LOAD_CONNECT_FAIL_MS 1000   // Transport error while the server is down
+#define LOAD_EVENT_HANDLE 7
+#define LOAD_DRAIN_MAX 600000       // After the last tap, journals get this long to drain (ms)
+#define LOAD_BURST_CYCLE 300000     // Burst: taps come in the first minute of every 5
+#define LOAD_BURST_WINDOW 60000
+#define LOAD_SAMPLE_MIN 10000       // Shortest timeline window (ms)
+#define LOAD_WINDOWS 12             // Timeline windows over the taps, drain not counted
+
+struct LoadServerConfig {
+  uint32_t workers;
+  uint32_t baseMs;            // Per request
+  uint32_t perRecordMs;
+  uint32_t errorPct;          // Requests answered 503
+};
+
+struct LoadOutage {
+  uint32_t startMs;
+  uint32_t lenMs;             // 0 = none
+  bool wifi;                  // Devices offline (else the server is down)
+};
+
+// Set before a run; the simulator's loadserver and loadoutage commands
+// change them
+static LoadServerConfig loadServer = { 4, 40, 2, 0 };
+static LoadOutage loadOutage = { 0, 0, false };
+
+enum LoadDistribution {
+  LOAD_UNIFORM,               // Poisson arrivals at the given rate
+  LOAD_BURST,                 // Same average, all of it in the first minute of every 5
+  LOAD_RAMP                   // Rate rising from 0 to twice the given rate
+};
+
+static const char* const loadDistNames[] = { "uniform", "burst", "ramp" };
+
+struct LoadParams {
+  uint32_t devices;
+  double tapsPerMin;          // Per device
+  LoadDistribution dist;
+  uint32_t minutes;
+};
+
+struct LoadDevice {
+  LoadDevice() : storage(CHECKIN_LOG_CAPACITY) {}
+
+  RamLogStorage storage;
+  CheckinLog journal;
+  CheckinDispatcher* dispatcher;
+  uint32_t index;
+  char id[16];
+  uint32_t now;
+  std::vector<uint32_t> taps;
+  size_t nextTap;
+  std::vector<bool> posted;       // Server side, by seq: seen in any request
+  std::vector<bool> delivered;    // Server side, by seq: stored
+  uint32_t deliveredCount;
+};
+
+struct LoadRun {
+  std::vector<LoadDevice*> devices;
+  std::vector<uint32_t> workerFree;
+  uint32_t rng;
+  uint32_t sampleMs;
+
+  // Per window
+  std::vector<uint32_t> offered;
+  std::vector<uint32_t> deliveredAt;
+  std::vector<uint32_t> requests;
+  std::vector<uint32_t> failedRequests;
+  std::vector<uint32_t> retried;      // Records posted again
+  std::vector<std::vector<uint32_t> > resultAt;   // Tap to result, by when it was shown
+  std::vector<uint32_t> pendingSum;   // Journal records, all devices, at the window start
+  std::vector<uint32_t> pendingMax;   // Deepest single journal then
+
+  std::vector<uint32_t> resultMs;     // Tap to result on the device (what the student sees)
+  std::vector<uint32_t> deliveryMs;   // Tap to stored on the server (offline replay included)
+  uint32_t results[4];                // By CheckInResult
+  uint32_t dropped;                   // Tap queue full
+  uint32_t recordsPosted;
+  uint32_t serverDuplicates;
+  uint32_t transportErrors;
+  uint32_t timeouts;
+  uint32_t serverErrors;
+  uint32_t offlineRequests;           // Made while the device's Wi-Fi was down
+  uint32_t peakPending;               // Largest pendingSum
+  uint64_t busyMs;
+  uint64_t wireBytes;
+};
+
+// What a run ends with
+struct LoadReport {
+  uint32_t offered;
+  uint32_t delivered;                 // Stored on the server, once each
+  uint32_t pendingEnd;                // Left in journals
+  uint32_t lost;                      // Neither stored nor in a journal
+  uint32_t requests;
+  uint32_t batches;
+  uint32_t spanMs;
+  LoadRun run;
+};
+
+static LoadRun* loadRun = NULL;
+static LoadDevice* loadDevice = NULL;
+
+static uint32_t loadRandom(uint32_t& rng) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// (0, 1]
+static double loadUniform(uint32_t& rng) {
+  return ((loadRandom(rng) >> 8) + 1) / 16777216.0;
+}
+
+static void loadCount(std::vector<uint32_t>& window, uint32_t atMs, uint32_t n = 1) {
+  size_t i = atMs / loadRun->sampleMs;
+  if (window.size() <= i) {
+    window.resize(i + 1, 0);
+  }
+  window[i] += n;
+}
+
+static bool loadOutageAt(uint32_t t, bool wifi) {
+  return loadOutage.lenMs > 0 && loadOutage.wifi == wifi && t >= loadOutage.startMs &&
+         t - loadOutage.startMs < loadOutage.lenMs;
+}
+
+static bool loadLinkUp() {
+  return !loadOutageAt(loadDevice->now, true);
+}
+
+static bool loadMark(std::vector<bool>& bySeq, uint32_t seq) {
+  if (bySeq.size() <= seq) {
+    bySeq.resize(seq + 1, false);
+  }
+  bool was = bySeq[seq];
+  bySeq[seq] = true;
+  return was;
+}
+
+// One request from the current device, through the wire codec both ways.
+// Moves the device's clock on to when the answer is back.
+static int loadServe(const CheckinRecord* recs, size_t count, CheckinItemResult* results) {
+  LoadRun& run = *loadRun;
+  LoadDevice& d = *loadDevice;
+  uint32_t t = d.now;
+  loadCount(run.requests, t);
+  run.recordsPosted += count;
+  run.offlineRequests += loadOutageAt(t, true);
+  for (size_t i = 0; i < count; i++) {
+    if (loadMark(d.posted, recs[i].seq)) {
+      loadCount(run.retried, t);
+    }
+  }
+
+  if (loadOutageAt(t, false)) {
+    run.transportErrors++;
+    loadCount(run.failedRequests, t);
+    d.now = t + LOAD_CONNECT_FAIL_MS;
+    return -1;
+  }
+
+  uint8_t frame[CHECKIN_WIRE_DEVICE_MAX + 8 + CHECKIN_BATCH_MAX * CHECKIN_WIRE_RECORD_MAX];
+  size_t len = encodeCheckinFrame(d.id, LOAD_EVENT_HANDLE, recs, count, frame, sizeof(frame));
+  char deviceId[CHECKIN_WIRE_DEVICE_MAX + 1];
+  uint32_t handle = 0;
+  CheckinRecord got[CHECKIN_BATCH_MAX];
+  size_t n = 0;
+  if (len == 0 || !decodeCheckinFrame(frame, len, deviceId, handle, got, CHECKIN_BATCH_MAX, n)) {
+    d.now = t + LOAD_RTT_MS;
+    return 400;
+  }
+  run.wireBytes += len;
+
+  // First free worker; requests queue in arrival order
+  size_t w = std::min_element(run.workerFree.begin(), run.workerFree.end()) - run.workerFree.begin();
+  uint32_t arrive = t + LOAD_RTT_MS / 2;
+  uint32_t start = std::max(arrive, run.workerFree[w]);
+  uint32_t service = (loadServer.baseMs + loadServer.perRecordMs * (uint32_t)n) *
+                     (75 + loadRandom(run.rng) % 51) / 100;
+  run.workerFree[w] = start + service;
+  run.busyMs += service;
+  uint32_t done = start + service + LOAD_RTT_MS / 2;
+  d.now = done;
+
+  // The device gives up after API_TIMEOUT; the server still stores what
+  // it got, so the replay is answered 409
+  bool timedOut = done - t > API_TIMEOUT;
+  if (timedOut) {
+    run.timeouts++;
+    loadCount(run.failedRequests, t);
+    d.now = t + API_TIMEOUT;
+  } else if (loadRandom(run.rng) % 100 < loadServer.errorPct) {
+    run.serverErrors++;
+    loadCount(run.failedRequests, t);
+    return 503;
+  }
+
+  CheckinItemResult served[CHECKIN_BATCH_MAX];
+  for (size_t i = 0; i < n; i++) {
+    uint32_t seq = got[i].seq;
+    if (loadMark(d.delivered, seq)) {
+      served[i].status = 409;
+      run.serverDuplicates++;
+    } else {
+      d.deliveredCount++;
+      served[i].status = 200;
+      loadCount(run.deliveredAt, done);
+      run.deliveryMs.push_back(done - got[i].timestamp);   // timestamp carries the tap time (ms)
+    }
+    snprintf(served[i].studentName, sizeof(served[i].studentName), "Student %u", (unsigned)seq);
+  }
+  if (timedOut) {
+    return -1;
+  }
+
+  uint8_t reply[4 + CHECKIN_BATCH_MAX * CHECKIN_WIRE_ITEM_MAX];
+  size_t replyLen = encodeResultFrame(got, served, n, reply, sizeof(reply));
+  run.wireBytes += replyLen;
+  if (!decodeResultFrame(reply, replyLen, recs, count, results)) {
+    return 502;
+  }
+  return 200;
+}
+
+static int loadSendOne(const CheckinRecord& rec, char* studentName, size_t nameSize) {
+  CheckinItemResult result = { -1, "" };
+  int code = loadServe(&rec, 1, &result);
+  if (code != 200) {
+    return code;
+  }
+  snprintf(studentName, nameSize, "%s", result.studentName);
+  return result.status;
+}
+
+static void loadTaps(std::vector<uint32_t>& taps, LoadDistribution dist, double perMin,
+                     uint32_t durationMs, uint32_t& rng) {
+  double rate = perMin / 60000.0;   // Per ms
+  if (rate <= 0) {
+    return;
+  }
+  if (dist == LOAD_BURST) {
+    // Poisson over the active minutes only, at the rate that keeps the average
+    double activeMs = (double)durationMs * LOAD_BURST_WINDOW / LOAD_BURST_CYCLE;
+    double burstRate = rate * LOAD_BURST_CYCLE / LOAD_BURST_WINDOW;
+    for (double a = -log(loadUniform(rng)) / burstRate; a < activeMs;
+         a += -log(loadUniform(rng)) / burstRate) {
+      uint32_t active = (uint32_t)a;
+      taps.push_back(active / LOAD_BURST_WINDOW * LOAD_BURST_CYCLE + active % LOAD_BURST_WINDOW);
+    }
+    return;
+  }
+
+  double peak = dist == LOAD_RAMP ? rate * 2 : rate;
+  for (double t = -log(loadUniform(rng)) / peak; t < durationMs; t += -log(loadUniform(rng)) / peak) {
+    // Ramp: thinning, kept with probability t / duration
+    if (dist == LOAD_RAMP && loadUniform(rng) > t / durationMs) {
+      continue;
+    }
+    taps.push_back((uint32_t)t);
+  }
+}
+
+static uint32_t loadPercentile(std::vector<uint32_t>& samples, double fraction) {
+  if (samples.empty()) {
+    return 0;
+  }
+  size_t i = (size_t)(fraction * (samples.size() - 1) + 0.5);
+  std::nth_element(samples.begin(), samples.begin() + i, samples.end());
+  return samples[i];
+}
+
+// One pass of one device's network task: taps made since the last pass
+// go into the dispatcher (a full tap queue drops them, as on the board),
+// then one runOnce() and its results
+static void loadStep(LoadDevice& d) {
+  LoadRun& run = *loadRun;
+  loadDevice = &d;
+  while (d.nextTap < d.taps.size() && d.taps[d.nextTap] <= d.now) {
+    uint32_t at = d.taps[d.nextTap];
+    uint32_t n = (uint32_t)d.nextTap++;
+    uint8_t uid[7] = { 0x08, (uint8_t)(d.index >> 8), (uint8_t)d.index,
+                       (uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n, 0x01 };
+    TapRequest tap = TapRequest();
+    tap.timestamp = at;
+    tap.tappedUs = at * 1000;
+    tap.uid = CardUid(uid, sizeof(uid));
+    snprintf(tap.eventId, sizeof(tap.eventId), "%s", "00000000-0000-0000-0000-00000000load");
+    loadCount(run.offered, at);
+    if (!d.dispatcher->submit(tap)) {
+      run.dropped++;
+    }
+  }
+
+  bool worked = d.dispatcher->runOnce(d.now);
+  TapResult result;
+  while (d.dispatcher->takeResult(result)) {
+    uint32_t ms = (d.now * 1000 - result.tappedUs) / 1000;
+    size_t i = d.now / run.sampleMs;
+    if (run.resultAt.size() <= i) {
+      run.resultAt.resize(i + 1);
+    }
+    run.resultAt[i].push_back(ms);
+    run.resultMs.push_back(ms);
+    run.results[result.result]++;
+  }
+  if (worked) {
+    return;
+  }
+  uint32_t wait = d.dispatcher->idleWaitMs(d.now);
+  if (d.nextTap < d.taps.size() && d.taps[d.nextTap] - d.now < wait) {
+    wait = d.taps[d.nextTap] - d.now;
+  }
+  d.now += wait > 0 ? wait : 1;
+}
+
+// Journal depth at the start of the window holding atMs
+static void loadSample(LoadRun& run, uint32_t atMs) {
+  uint32_t sum = 0;
+  uint32_t peak = 0;
+  for (LoadDevice* d : run.devices) {
+    sum += d->journal.pendingCount();
+    peak = std::max(peak, d->journal.pendingCount());
+  }
+  size_t i = atMs / run.sampleMs;
+  run.pendingSum.resize(std::max(run.pendingSum.size(), i + 1), 0);
+  run.pendingMax.resize(std::max(run.pendingMax.size(), i + 1), 0);
+  run.pendingSum[i] = sum;
+  run.pendingMax[i] = peak;
+  run.peakPending = std::max(run.peakPending, sum);
+}
+
+static bool loadDrained(const LoadRun& run) {
+  for (const LoadDevice* d : run.devices) {
+    if (d->nextTap < d->taps.size() || d->journal.pendingCount() > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void runLoadModel(const LoadParams& params, LoadReport& report) {
+  uint32_t durationMs = params.minutes * 60000;
+  report = LoadReport();
+  LoadRun& run = report.run;
+  loadRun = &run;
+  run.rng = 12345;
+  run.sampleMs = std::max((uint32_t)LOAD_SAMPLE_MIN, durationMs / LOAD_WINDOWS);
+  run.workerFree.assign(loadServer.workers > 0 ? loadServer.workers : 1, 0);
+
+  for (uint32_t i = 0; i < params.devices; i++) {
+    LoadDevice* d = new LoadDevice();
+    d->journal.begin(&d->storage);
+    d->dispatcher = new CheckinDispatcher(d->journal, loadSendOne, loadServe, loadLinkUp);
+    d->index = i;
+    snprintf(d->id, sizeof(d->id), "load-%03u", (unsigned)i);
+    d->now = 0;
+    d->nextTap = 0;
+    d->deliveredCount = 0;
+    uint32_t rng = 0x9E3779B9u ^ (i * 2654435761u);
+    loadTaps(d->taps, params.dist, params.tapsPerMin, durationMs, rng);
+    report.offered += d->taps.size();
+    run.devices.push_back(d);
+  }
+
+  typedef std::pair<uint32_t, uint32_t> Slot;   // (clock, device)
+  std::priority_queue<Slot, std::vector<Slot>, std::greater<Slot> > order;
+  for (uint32_t i = 0; i < params.devices; i++) {
+    order.push(Slot(0, i));
+  }
+  uint32_t nextSample = 0;
+  report.spanMs = durationMs;
+  while (!order.empty()) {
+    Slot slot = order.top();
+    order.pop();
+    while (slot.first >= nextSample) {
+      loadSample(run, nextSample);
+      nextSample += run.sampleMs;
+    }
+    if (slot.first >= durationMs && (loadDrained(run) || slot.first > durationMs + LOAD_DRAIN_MAX)) {
+      report.spanMs = slot.first;
+      break;
+    }
+    LoadDevice& d = *run.devices[slot.second];
+    loadStep(d);
+    order.push(Slot(d.now, slot.second));
+  }
+
+  for (LoadDevice* d : run.devices) {
+    report.delivered += d->deliveredCount;
+    report.pendingEnd += d->journal.pendingCount();
+    uint32_t missing = (uint32_t)d->taps.size() - d->deliveredCount;
+    report.lost += missing > d->journal.pendingCount() ? missing - d->journal.pendingCount() : 0;
+    report.batches += d->dispatcher->batchesSent();
+    delete d->dispatcher;
+    delete d;
+  }
+  for (uint32_t r : run.requests) {
+    report.requests += r;
+  }
+  run.devices.clear();
+  loadRun = NULL;
+}
+
+// ==========================================
+// TIMELINE
+// ==========================================
+
+static size_t loadWindows(const LoadReport& report) {
+  const LoadRun& run = report.run;
+  return std::max(std::max(run.pendingSum.size(), run.offered.size()),
+                  std::max(run.deliveredAt.size(), run.resultAt.size()));
+}
+
+static void loadTimelineHeader(char* line, size_t size) {
+  snprintf(line, size, "%7s %10s %9s %7s %6s %7s %6s %6s %15s", "t (s)", "offered/s", "stored/s", "req/s",
+           "failed", "retried", "p50", "p99", "journal sum/max");
+}
+
+// Window i: rates per second over the window, result latency (ms) of the
+// taps answered in it, journal depth at its start
+static void loadTimelineRow(LoadReport& report, size_t i, char* line, size_t size) {
+  LoadRun& run = report.run;
+  auto at = [i](const std::vector<uint32_t>& v) { return i < v.size() ? v[i] : 0; };
+  double windowS = run.sampleMs / 1000.0;
+  std::vector<uint32_t> none;
+  std::vector<uint32_t>& shown = i < run.resultAt.size() ? run.resultAt[i] : none;
+  snprintf(line, size, "%7u %10.2f %9.2f %7.2f %6u %7u %6u %6u %9u/%u", (unsigned)(i * run.sampleMs / 1000),
+           at(run.offered) / windowS, at(run.deliveredAt) / windowS, at(run.requests) / windowS,
+           (unsigned)at(run.failedRequests), (unsigned)at(run.retried), (unsigned)loadPercentile(shown, 0.5),
+           (unsigned)loadPercentile(shown, 0.99), (unsigned)at(run.pendingSum), (unsigned)at(run.pendingMax));
+}
+
+#endif // LOAD_MODEL_H
@@ -0,0 +1,44 @@
+#ifndef RAM_LOG_STORAGE_H
+#define RAM_LOG_STORAGE_H
+
+#include <string.h>
+#include <vector>
+#include "checkin_log.h"
+
+// Journal storage in RAM, erased (0xFF) like fresh flash. tearNextWrite()
+// makes the next write stop after a few bytes, as power loss would; the
+// write still reports success because the firmware never sees it return.
+class RamLogStorage : public CheckinLogStorage {
+public:
+  explicit RamLogStorage(size_t slots) : bytes(slots * CHECKIN_SLOT_SIZE, 0xFF), tearAt(-1) {}
+
+  size_t size() const override { return bytes.size(); }
+
+  bool read(size_t offset, uint8_t* data, size_t len) override {
+    reads++;
+    memcpy(data, bytes.data() + offset, len);
+    return true;
+  }
+
+  bool write(size_t offset, const uint8_t* data, size_t len) override {
+    size_t n = len;
+    if (tearAt >= 0) {
+      n = (size_t)tearAt < len ? (size_t)tearAt : len;
+      tearAt = -1;
+    }
+    memcpy(bytes.data() + offset, data, n);
+    writes++;
+    return true;
+  }
+
+  void tearNextWrite(int keepBytes) { tearAt = keepBytes; }
+
+  std::vector<uint8_t> bytes;
+  uint32_t reads = 0;
+  uint32_t writes = 0;
+
+private:
+  int tearAt;
+};
+
+#endif // RAM_LOG_STORAGE_H
@@ -0,0 +1,82 @@
+#ifndef RASTER_DISPLAY_H
+#define RASTER_DISPLAY_H
+
+#include <string.h>
+#include "hal.h"
+#include "frame_diff.h"
+
+// ==========================================
+// SSD1306 FRAMEBUFFER ON THE HOST
+// ==========================================
+//
+// Lays text out the way Adafruit GFX does with the built-in font (6x8
+// cells scaled by text size, wrap at the right edge, println to the next
+// line) into an SSD1306 page buffer. Glyph shapes are stand-ins derived
+// from the character code; the cell layout is what decides which bytes
+// change between screens, so the diff sizes match the real panel closely.
+
+class RasterDisplay : public HalDisplay {
+public:
+  RasterDisplay() : size(1), x(0), y(0), frames(0) { memset(frame, 0, sizeof(frame)); }
+
+  void clearDisplay() override { memset(frame, 0, sizeof(frame)); }
+  void setTextSize(uint8_t s) override { size = s > 0 ? s : 1; }
+  void setCursor(int16_t cx, int16_t cy) override { x = cx; y = cy; }
+  void write(const char* text, size_t len) override {
+    for (size_t i = 0; i < len; i++) {
+      putChar(text[i]);
+    }
+  }
+  void display() override { frames++; }
+
+  uint8_t* buffer() override { return frame; }
+  uint32_t frameCount() const { return frames; }
+
+private:
+  void putChar(char c) {
+    if (c == '\n') {
+      x = 0;
+      y += 8 * size;
+      return;
+    }
+    if (c == '\r') {
+      return;
+    }
+    if (x + 6 * size > FRAME_COLUMNS) {
+      x = 0;
+      y += 8 * size;
+    }
+    for (int col = 0; col < 5; col++) {
+      uint8_t bits = c == ' ' ? 0 : (uint8_t)(((uint8_t)c * 37 + col * 11) | 0x41) & 0x7F;
+      for (int row = 0; row < 8; row++) {
+        if (bits & (1 << row)) {
+          fillBlock(x + col * size, y + row * size);
+        }
+      }
+    }
+    x += 6 * size;
+  }
+
+  void fillBlock(int px, int py) {
+    for (int dx = 0; dx < size; dx++) {
+      for (int dy = 0; dy < size; dy++) {
+        setPixel(px + dx, py + dy);
+      }
+    }
+  }
+
+  void setPixel(int px, int py) {
+    if (px < 0 || px >= FRAME_COLUMNS || py < 0 || py >= FRAME_PAGES * 8) {
+      return;
+    }
+    frame[(py / 8) * FRAME_COLUMNS + px] |= (uint8_t)(1 << (py & 7));
+  }
+
+  uint8_t frame[FRAME_BYTES];
+  int size;
+  int x;
+  int y;
+  uint32_t frames;
+};
+
+#endif // RASTER_DISPLAY_H
@@ -0,0 +1,164 @@
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include "hal.h"
+#include "card_uid.h"
+#include "reader_array.h"
+
+// HAL devices on a virtual millisecond clock, for the native suites and
+// the simulator (src/sim/sim_main.cpp). Time only moves when delay() is
+// called, so a test decides exactly when every deadline comes due.
+
+class SimClock : public HalClock {
+public:
+  SimClock() : now(0) {}
+  uint32_t millis() override { return now; }
+  uint32_t micros() override { return now * 1000; }
+  void delay(uint32_t ms) override { now += ms; }
+
+  uint32_t now;
+};
+
+// Text cells at the positions the panel would show them (one cell per
+// character whatever the text size, size 2 lines take two rows)
+#define TEXT_DISPLAY_ROWS 8
+#define TEXT_DISPLAY_COLS 22
+
+class TextDisplay : public HalDisplay {
+public:
+  TextDisplay() : frames(0), size(1), row(0), col(0) { clearDisplay(); }
+  void clearDisplay() override {
+    memset(cells, ' ', sizeof(cells));
+    row = 0;
+    col = 0;
+  }
+  void setTextSize(uint8_t s) override { size = s > 0 ? s : 1; }
+  void setCursor(int16_t x, int16_t y) override {
+    col = x / 6;
+    row = y / 8;
+  }
+  void write(const char* text, size_t n) override {
+    for (size_t i = 0; i < n; i++) {
+      if (text[i] == '\n') {
+        row += size;
+        col = 0;
+      } else if (row < TEXT_DISPLAY_ROWS && col < TEXT_DISPLAY_COLS) {
+        cells[row][col++] = text[i];
+      }
+    }
+  }
+  void display() override { frames++; }
+
+  // Row r without trailing blanks
+  std::string line(int r) const {
+    int n = TEXT_DISPLAY_COLS;
+    while (n > 0 && cells[r][n - 1] == ' ') {
+      n--;
+    }
+    return std::string(cells[r], n);
+  }
+
+  // True if any row holds text
+  bool shows(const char* text) const {
+    for (int r = 0; r < TEXT_DISPLAY_ROWS; r++) {
+      if (line(r).find(text) != std::string::npos) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  uint32_t frames;   // display() calls
+
+private:
+  char cells[TEXT_DISPLAY_ROWS][TEXT_DISPLAY_COLS];
+  int size;
+  int row;
+  int col;
+};
+
+// Keeps everything logged, for tests to search; the simulator prints instead
+class MemoryLog : public HalLog {
+public:
+  void write(const char* text) override { logged += text; }
+  bool contains(const char* text) const { return logged.find(text) != std::string::npos; }
+  void clear() { logged.clear(); }
+
+private:
+  std::string logged;
+};
+
+class SimBuzzer : public HalBuzzer {
+public:
+  SimBuzzer() : on(false), switches(0) {}
+  void set(bool value) override {
+    switches += value != on;
+    on = value;
+  }
+
+  bool on;
+  uint32_t switches;   // Level changes
+};
+
+// Level changes made by a script come out as clean edges at the time
+// of the next nextEdge()
+class SimButtons : public HalButtons {
+public:
+  explicit SimButtons(HalClock& clock) : clock(clock) { down[0] = down[1] = reported[0] = reported[1] = false; }
+  bool nextEdge(ButtonEdge& edge) override {
+    for (uint8_t i = 0; i < 2; i++) {
+      if (down[i] != reported[i]) {
+        reported[i] = down[i];
+        edge.button = (HalButton)i;
+        edge.down = down[i];
+        edge.ms = clock.millis();
+        return true;
+      }
+    }
+    return false;
+  }
+  bool down[2];
+
+private:
+  HalClock& clock;
+  bool reported[2];
+};
+
+// Hands out one scripted card per tap
+class ScriptedReader : public CardReader {
+public:
+  ScriptedReader() : pending(false) {}
+  bool readCard(CardUid& uid) override {
+    if (!pending) {
+      return false;
+    }
+    pending = false;
+    uid = card;
+    return true;
+  }
+  void release() override {}
+
+  // Returns false if the previous card was never read (it left the field)
+  bool present(const CardUid& uid) {
+    bool missed = pending;
+    card = uid;
+    pending = true;
+    return !missed;
+  }
+
+  // Card taken away before it was read; true if it was still waiting
+  bool withdraw() {
+    bool missed = pending;
+    pending = false;
+    return missed;
+  }
+
+private:
+  CardUid card;
+  bool pending;
+};
+
+#endif // SIM_HAL_H
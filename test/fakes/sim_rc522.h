@@ -0,0 +1,277 @@
+#ifndef SIM_RC522_H
+#define SIM_RC522_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "rc522_picc.h"
+
+// A register-level RC522 with one card in (or out of) its field, on a
+// virtual microsecond clock. Each SPI transaction costs SIM_SPI_SETUP_US
+// (beginTransaction + chip select on the ESP32) plus 8 clocks per byte.
+// The card answers REQA, anticollision, select and HLTA per ISO 14443-3.
+// Every transaction is recorded, so a path's trace can be printed and
+// counted. irqRaised() is the IRQ pin (RxIRq, as enabled in ComIEnReg) and
+// antennaOnUs() how long the field has been on.
+
+#define SIM_SPI_SETUP_US 5.0
+
+struct SpiOp {
+  bool write;
+  uint8_t reg;
+  uint8_t len;
+};
+
+class SimRc522 : public Rc522Bus {
+public:
+  SimRc522(uint32_t clockHz) : clockHz(clockHz), now(0), cmd(RC522_CMD_IDLE), exchange(false), cardState(CARD_OFF),
+                               uidLen(0), level(0), antennaSince(0), antennaUs(0) {
+    // As left by the library's PCD_Init: 25 ms timer, antenna on
+    memset(regs, 0, sizeof(regs));
+    regs[RC522_REG_T_MODE] = 0x80;
+    regs[RC522_REG_T_PRESCALER] = 0xA9;
+    regs[RC522_REG_T_RELOAD_H] = 0x03;
+    regs[RC522_REG_T_RELOAD_L] = 0xE8;
+    regs[RC522_REG_TX_CONTROL] = 0x83;
+  }
+
+  // Card in the field (uidLen 0 = none)
+  void card(const uint8_t* uid, uint8_t len) {
+    memcpy(cardUid, uid, len);
+    uidLen = len;
+    cardState = len ? CARD_IDLE : CARD_OFF;
+  }
+
+  void write(uint8_t reg, const uint8_t* data, size_t len) override {
+    spend(len);
+    ops.push_back({ true, reg, (uint8_t)len });
+    sync();
+    switch (reg) {
+      case RC522_REG_COMMAND:
+        cmd = data[0] & 0x0F;
+        exchange = false;
+        if (cmd == RC522_CMD_CALC_CRC) {
+          uint16_t crc = rc522CrcA(fifo.data(), fifo.size());
+          fifo.clear();
+          regs[RC522_REG_CRC_RESULT_L] = (uint8_t)crc;
+          regs[RC522_REG_CRC_RESULT_H] = (uint8_t)(crc >> 8);
+          regs[RC522_REG_DIV_IRQ] |= 0x04;
+        }
+        break;
+      case RC522_REG_COM_IRQ:
+      case RC522_REG_DIV_IRQ:
+        if (data[0] & 0x80) {
+          regs[reg] |= data[0] & 0x7F;
+        } else {
+          regs[reg] &= ~data[0];
+        }
+        break;
+      case RC522_REG_FIFO_LEVEL:
+        if (data[0] & 0x80) {
+          fifo.clear();
+        }
+        break;
+      case RC522_REG_FIFO_DATA:
+        fifo.insert(fifo.end(), data, data + len);
+        break;
+      case RC522_REG_BIT_FRAMING:
+        regs[reg] = data[0] & 0x7F;
+        if ((data[0] & 0x80) && cmd == RC522_CMD_TRANSCEIVE) {
+          send(data[0] & 0x07);
+        }
+        break;
+      case RC522_REG_TX_CONTROL:
+        if (antennaOn()) {
+          antennaUs += now - antennaSince;
+        }
+        antennaSince = now;
+        regs[reg] = data[0];
+        if ((data[0] & 0x03) == 0 && cardState != CARD_OFF) {
+          cardState = CARD_IDLE;   // Field off: the card loses power
+        }
+        break;
+      default:
+        regs[reg] = data[0];
+        break;
+    }
+  }
+
+  void read(const uint8_t* r, uint8_t* out, size_t len) override {
+    spend(len);
+    ops.push_back({ false, r[0], (uint8_t)len });
+    sync();
+    for (size_t i = 0; i < len; i++) {
+      if (r[i] == RC522_REG_FIFO_DATA) {
+        out[i] = fifo.empty() ? 0 : fifo.front();
+        if (!fifo.empty()) {
+          fifo.erase(fifo.begin());
+        }
+      } else if (r[i] == RC522_REG_FIFO_LEVEL) {
+        out[i] = (uint8_t)fifo.size();
+      } else if (r[i] == RC522_REG_STATUS2) {
+        out[i] = modemState();
+      } else {
+        out[i] = regs[r[i]];
+      }
+    }
+  }
+
+  void waitUs(uint32_t us) override {
+    now += us;
+  }
+
+  // Poll loops that do not wait still let time pass
+  double nowUs() const { return now; }
+
+  bool irqRaised() {
+    sync();
+    return (regs[RC522_REG_COM_IRQ] & 0x20) != 0;
+  }
+
+  bool antennaOn() const { return (regs[RC522_REG_TX_CONTROL] & 0x03) != 0; }
+  double antennaOnUs() const { return antennaUs + (antennaOn() ? now - antennaSince : 0); }
+
+  void resetTrace() {
+    ops.clear();
+  }
+
+  std::vector<SpiOp> ops;
+
+private:
+  enum CardState { CARD_OFF, CARD_IDLE, CARD_READY, CARD_ACTIVE, CARD_HALT };
+
+  void spend(size_t len) {
+    now += SIM_SPI_SETUP_US + (len + 1) * 8 * 1e6 / clockHz;
+  }
+
+  static double airUs(size_t bytes) {
+    return (bytes * 9 + 2) * 9.44;
+  }
+
+  // Frame from the FIFO goes out; the card's answer (if any) lands in the
+  // FIFO once it has been received
+  void send(uint8_t lastBits) {
+    std::vector<uint8_t> frame(fifo);
+    fifo.clear();
+    answer.clear();
+    cardAnswer(frame, lastBits);
+    txEnd = now + airUs(frame.size());
+    rxStart = txEnd + 86;
+    rxEnd = rxStart + airUs(answer.size());
+    uint32_t reload = (regs[RC522_REG_T_RELOAD_H] << 8) | regs[RC522_REG_T_RELOAD_L];
+    timerEnd = txEnd + reload * 25.0;
+    exchange = true;
+  }
+
+  void sync() {
+    if (!exchange) {
+      return;
+    }
+    if (!answer.empty() && now >= rxEnd) {
+      fifo.insert(fifo.end(), answer.begin(), answer.end());
+      regs[RC522_REG_COM_IRQ] |= 0x60;   // TxIRq | RxIRq
+      regs[RC522_REG_CONTROL] = 0;
+      exchange = false;
+    } else if (answer.empty() && now >= timerEnd) {
+      regs[RC522_REG_COM_IRQ] |= 0x41;   // TxIRq | TimerIRq
+    }
+  }
+
+  uint8_t modemState() const {
+    if (!exchange) {
+      return cmd == RC522_CMD_TRANSCEIVE ? 0x01 : 0x00;
+    }
+    if (now < txEnd) {
+      return 0x03;
+    }
+    return !answer.empty() && now >= rxStart ? 0x06 : 0x04;
+  }
+
+  void put(const uint8_t* data, size_t len, bool withCrc) {
+    answer.assign(data, data + len);
+    if (withCrc) {
+      uint16_t crc = rc522CrcA(data, len);
+      answer.push_back((uint8_t)crc);
+      answer.push_back((uint8_t)(crc >> 8));
+    }
+  }
+
+  // UID part for a cascade level: 4 bytes, cascade tag first when the UID goes on
+  void part(uint8_t lvl, uint8_t* out) {
+    bool more = uidLen > 4 + lvl * 3;
+    const uint8_t* src = cardUid + lvl * 3;
+    if (more) {
+      out[0] = 0x88;
+      memcpy(out + 1, src, 3);
+    } else {
+      memcpy(out, src, 4);
+    }
+    out[4] = out[0] ^ out[1] ^ out[2] ^ out[3];
+  }
+
+  void cardAnswer(const std::vector<uint8_t>& f, uint8_t lastBits) {
+    static const uint8_t sel[] = { 0x93, 0x95, 0x97 };
+    if (cardState == CARD_OFF || f.empty()) {
+      return;
+    }
+    if (lastBits == 7 && f.size() == 1 && (f[0] == 0x26 || (f[0] == 0x52 && cardState == CARD_HALT))) {
+      if (cardState == CARD_IDLE || f[0] == 0x52) {
+        uint8_t atqa[2] = { (uint8_t)(uidLen == 4 ? 0x04 : 0x44), 0x00 };
+        put(atqa, 2, false);
+        cardState = CARD_READY;
+        level = 0;
+      } else if (cardState != CARD_HALT) {
+        cardState = CARD_IDLE;
+      }
+      return;
+    }
+    if (cardState == CARD_READY && f.size() == 2 && f[0] == sel[level] && f[1] == 0x20) {
+      uint8_t p[5];
+      part(level, p);
+      put(p, 5, false);
+      return;
+    }
+    if (cardState == CARD_READY && f.size() == 9 && f[0] == sel[level] && f[1] == 0x70 &&
+        rc522CrcA(f.data(), 7) == (uint16_t)(f[7] | (f[8] << 8))) {
+      uint8_t p[5];
+      part(level, p);
+      if (memcmp(p, &f[2], 5) != 0) {
+        cardState = CARD_IDLE;
+        return;
+      }
+      bool more = p[0] == 0x88;
+      uint8_t sak = more ? 0x04 : (uidLen == 4 ? 0x08 : 0x00);
+      put(&sak, 1, true);
+      if (more) {
+        level++;
+      } else {
+        cardState = CARD_ACTIVE;
+      }
+      return;
+    }
+    if (cardState == CARD_ACTIVE && f.size() == 4 && f[0] == 0x50 && f[1] == 0x00) {
+      cardState = CARD_HALT;
+      return;
+    }
+    if (cardState != CARD_HALT) {
+      cardState = CARD_IDLE;
+    }
+  }
+
+  uint32_t clockHz;
+  double now;
+  uint8_t regs[64];
+  std::vector<uint8_t> fifo;
+  uint8_t cmd;
+  bool exchange;
+  std::vector<uint8_t> answer;
+  double txEnd, rxStart, rxEnd, timerEnd;
+  CardState cardState;
+  uint8_t cardUid[10];
+  uint8_t uidLen;
+  uint8_t level;
+  double antennaSince;
+  double antennaUs;
+};
+
+#endif // SIM_RC522_H
@@ -0,0 +1,268 @@
+// ApiConnection against a local stand-in for the TLS API server: each
+// handshake costs HANDSHAKE_MS of virtual time, the server drops a
+// kept-alive connection after IDLE_CLOSE_MS without a request, and it
+// may or may not tell the client (FIN) before the next request goes out.
+
+#include <unity.h>
+#include <stdio.h>
+#include "api_connection.h"
+#include "tap_metrics.h"
+
+#define HANDSHAKE_MS 900
+#define REQUEST_MS 40
+#define IDLE_CLOSE_MS 5000
+
+class VirtualClock : public HalClock {
+public:
+  uint32_t millis() override { return us / 1000; }
+  uint32_t micros() override { return us; }
+  void delay(uint32_t ms) override { us += ms * 1000; }
+  uint32_t us = 0;
+};
+
+class QuietLog : public HalLog {
+public:
+  void write(const char*) override {}
+};
+
+// Client socket + server in one
+class FakeTlsServer : public ApiTransport {
+public:
+  explicit FakeTlsServer(VirtualClock& clock) : clock(clock) {}
+
+  bool connected() override {
+    if (clientOpen && !serverOpen && closeNotified) {
+      clientOpen = false;   // FIN seen: the client knows
+    }
+    return clientOpen;
+  }
+
+  bool connect() override {
+    connects++;
+    clock.delay(HANDSHAKE_MS);
+    if (!up) {
+      return false;
+    }
+    clientOpen = serverOpen = true;
+    lastRequestMs = clock.millis();
+    return true;
+  }
+
+  void close() override {
+    clientOpen = false;
+  }
+
+  // Time passes on the server: it closes an idle connection
+  void idle(uint32_t ms) {
+    clock.delay(ms);
+    if (serverOpen && clock.millis() - lastRequestMs >= IDLE_CLOSE_MS) {
+      serverOpen = false;
+    }
+  }
+
+  int request() {
+    exchanges++;
+    clock.delay(REQUEST_MS);
+    if (!clientOpen || !serverOpen || failing > 0) {
+      failing = failing > 0 ? failing - 1 : 0;
+      return API_ERROR_NOT_CONNECTED;
+    }
+    lastRequestMs = clock.millis();
+    handled++;
+    if (slow > 0) {
+      slow--;
+      return API_ERROR_READ_TIMEOUT;   // Acted on, answer not in time
+    }
+    return 200;
+  }
+
+  VirtualClock& clock;
+  bool up = true;
+  bool closeNotified = false;   // Server close visible to connected()
+  uint32_t failing = 0;          // Requests to fail from now on
+  uint32_t slow = 0;             // Requests handled but answered too late
+  bool clientOpen = false;
+  bool serverOpen = false;
+  uint32_t lastRequestMs = 0;
+  uint32_t connects = 0;
+  uint32_t exchanges = 0;
+  uint32_t handled = 0;          // Requests the server acted on
+};
+
+static VirtualClock virtualClock;
+static QuietLog quiet;
+static FakeTlsServer* server;
+static ApiConnection* connection;
+static bool linkIsUp = true;
+
+static bool fakeLink() {
+  return linkIsUp;
+}
+
+static int exchange(void* request) {
+  return ((FakeTlsServer*)request)->request();
+}
+
+static int send() {
+  return connection->send(exchange, server);
+}
+
+void setUp() {
+  virtualClock.us = 0;
+  linkIsUp = true;
+  resetTapMetrics();
+  server = new FakeTlsServer(virtualClock);
+  connection = new ApiConnection(*server, virtualClock, quiet, fakeLink);
+  connection->begin(true);
+}
+
+void tearDown() {
+  delete connection;
+  delete server;
+}
+
+void test_keep_alive_reuses_one_handshake() {
+  for (int i = 0; i < 20; i++) {
+    TEST_ASSERT_EQUAL(200, send());
+    server->idle(1000);
+  }
+  const ApiStats& st = connection->stats();
+  TEST_ASSERT_EQUAL_UINT32(1, st.handshakes);
+  TEST_ASSERT_EQUAL_UINT32(20, st.requests);
+  TEST_ASSERT_EQUAL_UINT32(0, st.failures);
+  TEST_ASSERT_EQUAL_UINT32(0, st.staleRetries);
+  TEST_ASSERT_EQUAL_UINT32(HANDSHAKE_MS, st.lastHandshakeMs);
+  TEST_ASSERT_EQUAL_UINT32(REQUEST_MS, st.lastRequestMs);
+  TEST_ASSERT_EQUAL_UINT32(1, stageHistogram(STAGE_TLS_CONNECT).count());
+  TEST_ASSERT_EQUAL_UINT32(0, stageHistogram(STAGE_HTTP_CONNECT).count());
+  TEST_ASSERT_EQUAL_UINT32(20, stageHistogram(STAGE_HTTP_REQUEST).count());
+}
+
+void test_silent_server_close_resends_once_on_a_new_connection() {
+  TEST_ASSERT_EQUAL(200, send());
+  server->idle(IDLE_CLOSE_MS + 1000);   // Closed, client not told
+
+  TEST_ASSERT_EQUAL(200, send());
+  const ApiStats& st = connection->stats();
+  TEST_ASSERT_EQUAL_UINT32(2, st.handshakes);
+  TEST_ASSERT_EQUAL_UINT32(1, st.staleRetries);
+  TEST_ASSERT_EQUAL_UINT32(2, st.requests);
+  TEST_ASSERT_EQUAL_UINT32(0, st.failures);
+  TEST_ASSERT_EQUAL_UINT32(3, server->exchanges);
+
+  // And the new connection is kept
+  TEST_ASSERT_EQUAL(200, send());
+  TEST_ASSERT_EQUAL_UINT32(2, connection->stats().handshakes);
+}
+
+void test_announced_server_close_reconnects_without_a_retry() {
+  server->closeNotified = true;
+  TEST_ASSERT_EQUAL(200, send());
+  server->idle(IDLE_CLOSE_MS + 1000);
+
+  TEST_ASSERT_EQUAL(200, send());
+  const ApiStats& st = connection->stats();
+  TEST_ASSERT_EQUAL_UINT32(2, st.handshakes);
+  TEST_ASSERT_EQUAL_UINT32(0, st.staleRetries);
+  TEST_ASSERT_EQUAL_UINT32(2, server->exchanges);
+}
+
+void test_failure_on_a_fresh_connection_is_not_resent() {
+  server->failing = 1;
+  TEST_ASSERT_LESS_THAN(0, send());
+  const ApiStats& st = connection->stats();
+  TEST_ASSERT_EQUAL_UINT32(1, server->exchanges);
+  TEST_ASSERT_EQUAL_UINT32(1, st.failures);
+  TEST_ASSERT_EQUAL_UINT32(0, st.staleRetries);
+  TEST_ASSERT_FALSE(server->clientOpen);   // Closed, next request handshakes
+
+  TEST_ASSERT_EQUAL(200, send());
+  TEST_ASSERT_EQUAL_UINT32(2, connection->stats().handshakes);
+}
+
+void test_stale_retry_is_resent_only_once() {
+  TEST_ASSERT_EQUAL(200, send());
+  server->idle(IDLE_CLOSE_MS + 1000);
+  server->failing = 5;                    // The fresh connection fails too
+
+  TEST_ASSERT_LESS_THAN(0, send());
+  const ApiStats& st = connection->stats();
+  TEST_ASSERT_EQUAL_UINT32(1, st.staleRetries);
+  TEST_ASSERT_EQUAL_UINT32(1, st.failures);
+  TEST_ASSERT_EQUAL_UINT32(3, server->exchanges);
+  TEST_ASSERT_EQUAL_UINT32(2, server->connects);
+}
+
+// The request reached the server: resending it could store a check-in
+// twice, and would double the wait
+void test_read_timeout_on_a_kept_alive_connection_is_not_resent() {
+  TEST_ASSERT_EQUAL(200, send());
+  server->idle(1000);
+  server->slow = 1;
+
+  TEST_ASSERT_EQUAL(API_ERROR_READ_TIMEOUT, send());
+  const ApiStats& st = connection->stats();
+  TEST_ASSERT_EQUAL_UINT32(0, st.staleRetries);
+  TEST_ASSERT_EQUAL_UINT32(1, st.failures);
+  TEST_ASSERT_EQUAL_UINT32(2, server->exchanges);
+  TEST_ASSERT_EQUAL_UINT32(2, server->handled);
+}
+
+void test_stale_connection_with_the_server_gone() {
+  TEST_ASSERT_EQUAL(200, send());
+  server->idle(IDLE_CLOSE_MS + 1000);
+  server->up = false;
+
+  TEST_ASSERT_LESS_THAN(0, send());
+  TEST_ASSERT_EQUAL_UINT32(1, connection->stats().staleRetries);
+  TEST_ASSERT_EQUAL_UINT32(1, connection->stats().failures);
+  TEST_ASSERT_EQUAL_UINT32(2, server->exchanges);
+  TEST_ASSERT_EQUAL_UINT32(2, server->connects);
+}
+
+void test_server_down_fails_without_a_request() {
+  server->up = false;
+  TEST_ASSERT_EQUAL(API_ERROR_CONNECTION_REFUSED, send());
+  TEST_ASSERT_EQUAL_UINT32(0, server->exchanges);
+  TEST_ASSERT_EQUAL_UINT32(1, connection->stats().failures);
+  TEST_ASSERT_EQUAL_UINT32(0, connection->stats().handshakes);
+}
+
+void test_link_down_skips_the_connect() {
+  linkIsUp = false;
+  TEST_ASSERT_EQUAL(API_ERROR_CONNECTION_REFUSED, send());
+  TEST_ASSERT_EQUAL_UINT32(0, server->connects);
+  TEST_ASSERT_EQUAL_UINT32(1, connection->stats().failures);
+}
+
+// What keep-alive saves over a connection per request, in virtual time
+void test_keep_alive_saves_the_handshakes() {
+  for (int i = 0; i < 50; i++) {
+    send();
+    server->idle(2000);
+  }
+  uint32_t warmMs = connection->stats().totalHandshakeMs + connection->stats().totalRequestMs;
+  uint32_t coldMs = 50 * (HANDSHAKE_MS + REQUEST_MS);
+
+  char line[96];
+  snprintf(line, sizeof(line), "50 requests: %u ms kept alive, %u ms one connection each",
+           (unsigned)warmMs, (unsigned)coldMs);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_UINT32(1, connection->stats().handshakes);
+  TEST_ASSERT_LESS_THAN(coldMs / 10, warmMs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_keep_alive_reuses_one_handshake);
+  RUN_TEST(test_silent_server_close_resends_once_on_a_new_connection);
+  RUN_TEST(test_announced_server_close_reconnects_without_a_retry);
+  RUN_TEST(test_failure_on_a_fresh_connection_is_not_resent);
+  RUN_TEST(test_stale_retry_is_resent_only_once);
+  RUN_TEST(test_read_timeout_on_a_kept_alive_connection_is_not_resent);
+  RUN_TEST(test_stale_connection_with_the_server_gone);
+  RUN_TEST(test_server_down_fails_without_a_request);
+  RUN_TEST(test_link_down_skips_the_connect);
+  RUN_TEST(test_keep_alive_saves_the_handshakes);
+  return UNITY_END();
+}
@@ -0,0 +1,362 @@
+// API responses parsed in place with filters into the task arenas
+// (api_json.h, json_arena.h): multi-KB bodies, what the parse takes from
+// the arena, that nothing comes from the heap, and how long it takes
+// against an unfiltered heap document. Also the batch check-in body built
+// in the same arena, and what happens when it does not fit.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+#include <new>
+#include "api_json.h"
+#include "json_arena.h"
+#include "config.h"
+
+#define BENCH_PARSES 2000
+
+// Variant slots hold pointers, so a document takes up to twice the arena
+// on a 64-bit host that it takes on the ESP32
+#define HOST_ARENA(bytes) ((bytes) * sizeof(void*) / 4)
+
+// ==========================================
+// HEAP COUNTERS
+// ==========================================
+
+// Every C++ heap allocation in the test, counted while 'counting' is set
+static bool counting = false;
+static uint32_t heapNews = 0;
+
+void* operator new(size_t size) {
+  if (counting) {
+    heapNews++;
+  }
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+// Passes document allocations on to another allocator (or the heap) and
+// counts them
+class CountingAllocator : public ArduinoJson::Allocator {
+public:
+  explicit CountingAllocator(ArduinoJson::Allocator* inner = NULL) : inner(inner) {}
+
+  void* allocate(size_t size) override {
+    calls++;
+    void* ptr = inner ? inner->allocate(size) : malloc(size);
+    if (ptr) {
+      live++;
+      bytes += size;
+    } else {
+      refused++;
+    }
+    return ptr;
+  }
+  void deallocate(void* ptr) override {
+    if (ptr) {
+      live--;
+    }
+    if (inner) {
+      inner->deallocate(ptr);
+    } else {
+      free(ptr);
+    }
+  }
+  void* reallocate(void* ptr, size_t size) override {
+    calls++;
+    void* moved = inner ? inner->reallocate(ptr, size) : realloc(ptr, size);
+    if (!moved) {
+      refused++;
+    }
+    return moved;
+  }
+
+  ArduinoJson::Allocator* inner;
+  uint32_t calls = 0;
+  uint32_t refused = 0;
+  int32_t live = 0;
+  size_t bytes = 0;
+};
+
+// ==========================================
+// BODIES
+// ==========================================
+
+// Response body as read off a socket, a few bytes at a time
+class ChunkedBody {
+public:
+  explicit ChunkedBody(const std::string& text) : text(text), pos(0) {}
+  int read() {
+    return pos < text.size() ? (uint8_t)text[pos++] : -1;
+  }
+  size_t readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length && n < 16 && pos < text.size()) {
+      buffer[n++] = text[pos++];
+    }
+    return n;
+  }
+  const std::string& text;
+  size_t pos;
+};
+
+// The event, with everything else the server sends about it (~5 KB)
+static std::string bigEventBody() {
+  std::string body = "{\"event\": {\"id\": \"evt-2041\", \"name\": \"Distributed Systems\", \"handle\": 7, "
+                     "\"description\": \"";
+  body += std::string(2000, 'x');
+  body += "\", \"sessions\": [";
+  for (int i = 0; i < 40; i++) {
+    char item[128];
+    snprintf(item, sizeof(item), "%s{\"room\": \"B-%03d\", \"start\": \"2026-10-16T09:%02d:00Z\", \"capacity\": %d}",
+             i ? ", " : "", i, i % 60, 100 + i);
+    body += item;
+  }
+  body += "]}, \"server\": {\"version\": \"4.2.1\", \"region\": \"eu\"}}";
+  return body;
+}
+
+// 207 answer for a full batch, with fields the device does not read
+static std::string batchResultsBody(size_t count) {
+  std::string body = "{\"results\": [";
+  for (size_t i = 0; i < count; i++) {
+    char item[256];
+    snprintf(item, sizeof(item),
+             "%s{\"seq\": %u, \"status\": %d, \"studentName\": \"Student Number %u\", "
+             "\"studentId\": \"S%08u\", \"program\": \"Computer Science and Engineering\", \"year\": 3}",
+             i ? ", " : "", (unsigned)(100 + i), i % 5 == 4 ? 409 : 200, (unsigned)i, (unsigned)(2026000 + i));
+    body += item;
+  }
+  body += "], \"received\": " + std::to_string(count) + "}";
+  return body;
+}
+
+static const char* doorName(uint8_t reader) {
+  return reader == 0 ? "Main" : "Side";
+}
+
+// A full batch at its largest: 10-byte UIDs, UUID event IDs, timestamps
+static void fullBatch(CheckinRecord* recs, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    memset(&recs[i], 0, sizeof(recs[i]));
+    recs[i].uidLen = CARD_UID_MAX;
+    for (uint8_t b = 0; b < CARD_UID_MAX; b++) {
+      recs[i].uid[b] = (uint8_t)(0xA0 + i + b);
+    }
+    strcpy(recs[i].eventId, "6f1c2a9e-4b7d-4e21-9c3a-0d5e8f7b1a2c");
+    recs[i].seq = (uint32_t)(4000000000u + i);
+    recs[i].timestamp = 1792108800u + (uint32_t)i;
+    recs[i].reader = (uint8_t)(i & 1);
+  }
+}
+
+static ApiJson apiJson;
+
+void setUp() {}
+void tearDown() {
+  counting = false;
+}
+
+// ==========================================
+// TESTS
+// ==========================================
+
+void test_event_parse_takes_nothing_from_the_heap() {
+  static JsonArena<HOST_ARENA(JSON_DOC_CAPACITY)> arena;
+  CountingAllocator counted(&arena);
+  std::string text = bigEventBody();
+  ChunkedBody body(text);
+  ActiveEvent event;
+
+  heapNews = 0;
+  counting = true;
+  DeserializationError error = apiJson.readActiveEvent(body, &counted, event);
+  counting = false;
+
+  TEST_ASSERT_FALSE(error);
+  TEST_ASSERT_EQUAL_STRING("evt-2041", event.id);
+  TEST_ASSERT_EQUAL_STRING("Distributed Systems", event.name);
+  TEST_ASSERT_EQUAL_UINT32(7, event.handle);
+
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, heapNews, "parse allocated on the heap");
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, counted.refused, "arena too small");
+  TEST_ASSERT_GREATER_THAN(0, counted.calls);
+  TEST_ASSERT_EQUAL_INT32(0, counted.live);          // Document gave it all back
+  TEST_ASSERT_EQUAL_UINT32(0, arena.usedBytes());    // Arena rewound
+  TEST_ASSERT_LESS_OR_EQUAL(HOST_ARENA(JSON_DOC_CAPACITY), arena.peakBytes());
+
+  char line[96];
+  snprintf(line, sizeof(line), "%u-byte event body: %u arena bytes at peak",
+           (unsigned)text.size(), (unsigned)arena.peakBytes());
+  TEST_MESSAGE(line);
+}
+
+void test_batch_results_take_nothing_from_the_heap() {
+  static JsonArena<HOST_ARENA(JSON_BATCH_DOC_CAPACITY)> arena;
+  CountingAllocator counted(&arena);
+  std::string text = batchResultsBody(CHECKIN_BATCH_MAX);
+  ChunkedBody body(text);
+
+  CheckinRecord recs[CHECKIN_BATCH_MAX] = {};
+  CheckinItemResult results[CHECKIN_BATCH_MAX];
+  for (size_t i = 0; i < CHECKIN_BATCH_MAX; i++) {
+    recs[i].seq = (uint32_t)(100 + CHECKIN_BATCH_MAX - 1 - i);   // Matched by seq, not position
+    results[i].status = -1;
+  }
+
+  heapNews = 0;
+  counting = true;
+  DeserializationError error = apiJson.readBatchResults(body, &counted, recs, CHECKIN_BATCH_MAX, results);
+  counting = false;
+
+  TEST_ASSERT_FALSE(error);
+  TEST_ASSERT_EQUAL_UINT32(0, heapNews);
+  TEST_ASSERT_EQUAL_UINT32(0, counted.refused);
+  TEST_ASSERT_EQUAL_INT32(0, counted.live);
+  for (size_t i = 0; i < CHECKIN_BATCH_MAX; i++) {
+    uint32_t n = recs[i].seq - 100;
+    char name[32];
+    snprintf(name, sizeof(name), "Student Number %u", (unsigned)n);
+    TEST_ASSERT_EQUAL(n % 5 == 4 ? 409 : 200, results[i].status);
+    TEST_ASSERT_EQUAL_STRING(name, results[i].studentName);
+  }
+
+  char line[96];
+  snprintf(line, sizeof(line), "%u-byte batch answer: %u arena bytes at peak",
+           (unsigned)text.size(), (unsigned)arena.peakBytes());
+  TEST_MESSAGE(line);
+}
+
+void test_check_in_name_is_truncated_to_the_buffer() {
+  static JsonArena<HOST_ARENA(JSON_DOC_CAPACITY)> arena;
+  std::string text = "{\"ok\": true, \"studentName\": \"A Rather Long Student Name\"}";
+  ChunkedBody body(text);
+  char name[8];
+  TEST_ASSERT_FALSE(apiJson.readCheckin(body, &arena, name, sizeof(name)));
+  TEST_ASSERT_EQUAL_STRING("A Rathe", name);
+}
+
+void test_broken_body_reports_the_error() {
+  static JsonArena<HOST_ARENA(JSON_DOC_CAPACITY)> arena;
+  std::string text = bigEventBody().substr(0, 1500);   // Connection dropped
+  ChunkedBody body(text);
+  ActiveEvent event;
+  TEST_ASSERT_TRUE(apiJson.readActiveEvent(body, &arena, event) == DeserializationError::IncompleteInput);
+  TEST_ASSERT_EQUAL_UINT32(0, arena.usedBytes());
+}
+
+void test_batch_body_is_built_in_the_arena() {
+  static JsonArena<HOST_ARENA(JSON_BATCH_DOC_CAPACITY)> arena;
+  static char payload[JSON_BATCH_PAYLOAD_MAX];
+  CountingAllocator counted(&arena);
+  CheckinRecord recs[CHECKIN_BATCH_MAX];
+  fullBatch(recs, CHECKIN_BATCH_MAX);
+
+  heapNews = 0;
+  counting = true;
+  size_t len = apiJson.writeBatch(&counted, "door-01", recs, CHECKIN_BATCH_MAX, doorName, payload, sizeof(payload));
+  counting = false;
+
+  TEST_ASSERT_GREATER_THAN_MESSAGE(0, len, "full batch did not fit");
+  TEST_ASSERT_EQUAL(strlen(payload), len);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, heapNews, "batch body allocated on the heap");
+  TEST_ASSERT_EQUAL_UINT32(0, counted.refused);
+  TEST_ASSERT_EQUAL_INT32(0, counted.live);
+  TEST_ASSERT_EQUAL_UINT32(0, arena.usedBytes());
+
+  // What the server gets back out of it
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, payload, len));
+  TEST_ASSERT_EQUAL_STRING("door-01", doc["deviceId"] | "");
+  JsonArray items = doc["checkIns"].as<JsonArray>();
+  TEST_ASSERT_EQUAL(CHECKIN_BATCH_MAX, items.size());
+  JsonObject last = items[CHECKIN_BATCH_MAX - 1];
+  TEST_ASSERT_EQUAL_STRING("AF:B0:B1:B2:B3:B4:B5:B6:B7:B8", last["uid"] | "");
+  TEST_ASSERT_EQUAL_STRING("Side", last["door"] | "");
+  TEST_ASSERT_EQUAL_UINT32(4000000000u + CHECKIN_BATCH_MAX - 1, last["seq"] | 0u);
+  TEST_ASSERT_EQUAL_UINT32(1792108800u + CHECKIN_BATCH_MAX - 1, last["ts"] | 0u);
+
+  char line[112];
+  snprintf(line, sizeof(line), "%u-record batch: %u-byte body, %u arena bytes at peak, %u heap allocations",
+           (unsigned)CHECKIN_BATCH_MAX, (unsigned)len, (unsigned)arena.peakBytes(), (unsigned)heapNews);
+  TEST_MESSAGE(line);
+}
+
+// Too big for the arena or the payload buffer: 0, so the dispatcher
+// sends fewer records (CHECKIN_BATCH_TOO_LARGE)
+void test_batch_body_that_does_not_fit() {
+  static JsonArena<512> smallArena;
+  static JsonArena<HOST_ARENA(JSON_BATCH_DOC_CAPACITY)> arena;
+  static char payload[JSON_BATCH_PAYLOAD_MAX];
+  CheckinRecord recs[CHECKIN_BATCH_MAX];
+  fullBatch(recs, CHECKIN_BATCH_MAX);
+
+  TEST_ASSERT_EQUAL(0, apiJson.writeBatch(&smallArena, "door-01", recs, CHECKIN_BATCH_MAX, doorName,
+                                          payload, sizeof(payload)));
+  TEST_ASSERT_EQUAL_UINT32(0, smallArena.usedBytes());
+  TEST_ASSERT_EQUAL(0, apiJson.writeBatch(&arena, "door-01", recs, CHECKIN_BATCH_MAX, doorName, payload, 600));
+  TEST_ASSERT_GREATER_THAN(0, apiJson.writeBatch(&arena, "door-01", recs, 2, doorName, payload, 600));
+}
+
+// Filtered into the arena (the device path) against the whole body into
+// a heap document (what parsing a copied String amounted to)
+void test_filtered_parse_benchmark() {
+  static JsonArena<HOST_ARENA(JSON_DOC_CAPACITY)> arena;
+  std::string text = bigEventBody();
+  ActiveEvent event;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_PARSES; i++) {
+    ChunkedBody body(text);
+    TEST_ASSERT_FALSE(apiJson.readActiveEvent(body, &arena, event));
+  }
+  double filteredUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() /
+                      BENCH_PARSES;
+
+  CountingAllocator heap;
+  size_t heapPeak = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_PARSES; i++) {
+    ChunkedBody body(text);
+    JsonDocument doc(&heap);
+    heap.bytes = 0;
+    TEST_ASSERT_FALSE(deserializeJson(doc, body));
+    heapPeak = heap.bytes > heapPeak ? heap.bytes : heapPeak;
+  }
+  double wholeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() /
+                   BENCH_PARSES;
+
+  char line[160];
+  snprintf(line, sizeof(line), "%u-byte body: filtered %.1f us, %u arena bytes; whole %.1f us, %u heap bytes in %u calls",
+           (unsigned)text.size(), filteredUs, (unsigned)arena.peakBytes(), wholeUs, (unsigned)heapPeak,
+           (unsigned)(heap.calls / BENCH_PARSES));
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_LESS_THAN(heapPeak / 2, arena.peakBytes());
+}
+
+int main() {
+  apiJson.begin();
+  UNITY_BEGIN();
+  RUN_TEST(test_event_parse_takes_nothing_from_the_heap);
+  RUN_TEST(test_batch_results_take_nothing_from_the_heap);
+  RUN_TEST(test_check_in_name_is_truncated_to_the_buffer);
+  RUN_TEST(test_broken_body_reports_the_error);
+  RUN_TEST(test_batch_body_is_built_in_the_arena);
+  RUN_TEST(test_batch_body_that_does_not_fit);
+  RUN_TEST(test_filtered_parse_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,398 @@
+// Batched check-ins against a mock check-in server: per-item routing of a
+// 207 answer, the per-tap fallback when the batch endpoint is missing,
+// smaller batches when one does not fit in memory (and larger ones again
+// once it does), and batched vs per-tap cost for the same taps. One
+// thread, virtual clock: a request moves the clock on by its round trip.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include "checkin_dispatcher.h"
+#include "../fakes/ram_log_storage.h"
+
+#define RTT_MS 30            // Request + response on a warm connection
+#define PER_RECORD_MS 2      // Server time per record
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// MOCK SERVER
+// ==========================================
+
+struct MockServer {
+  int batchEndpoint;                 // 200 = served, else the code for every batch POST
+  size_t batchFits;                  // Larger batches never leave the device
+  std::map<uint32_t, int> itemStatus; // Tap index -> status to answer once (default 200)
+  std::map<uint32_t, int> stored;     // Tap index -> times stored
+  uint32_t batchRequests;
+  uint32_t singleRequests;
+  uint32_t tooLarge;                  // Batches refused before sending
+  size_t largestBatch;
+  uint32_t nowMs;                     // Virtual clock, moved on by each request
+};
+
+static MockServer server;
+
+static uint32_t tapIndex(const CheckinRecord& rec) {
+  return (uint32_t)rec.uid[2] << 8 | rec.uid[3];
+}
+
+static int serveItem(const CheckinRecord& rec, char* studentName, size_t nameSize) {
+  uint32_t tap = tapIndex(rec);
+  int status = 200;
+  auto it = server.itemStatus.find(tap);
+  if (it != server.itemStatus.end()) {
+    status = it->second;
+    server.itemStatus.erase(it);
+  }
+  if (status == 200) {
+    server.stored[tap]++;
+    snprintf(studentName, nameSize, "Student %u", (unsigned)tap);
+  }
+  return status;
+}
+
+static int mockSend(const CheckinRecord& rec, char* studentName, size_t nameSize) {
+  server.singleRequests++;
+  server.nowMs += RTT_MS + PER_RECORD_MS;
+  return serveItem(rec, studentName, nameSize);
+}
+
+static int mockSendBatch(const CheckinRecord* recs, size_t count, CheckinItemResult* results) {
+  if (count > server.batchFits) {
+    server.tooLarge++;
+    return CHECKIN_BATCH_TOO_LARGE;
+  }
+  server.batchRequests++;
+  server.largestBatch = count > server.largestBatch ? count : server.largestBatch;
+  server.nowMs += RTT_MS;
+  if (server.batchEndpoint != 200) {
+    return server.batchEndpoint;
+  }
+  bool partial = false;
+  for (size_t i = 0; i < count; i++) {
+    server.nowMs += PER_RECORD_MS;
+    results[i].status = serveItem(recs[i], results[i].studentName, sizeof(results[i].studentName));
+    partial |= results[i].status != 200;
+  }
+  return partial ? 207 : 200;
+}
+
+static bool mockLink() {
+  return true;
+}
+
+// ==========================================
+// DEVICE SIDE
+// ==========================================
+
+static RamLogStorage* storage;
+static CheckinLog* journal;
+static CheckinDispatcher* dispatcher;
+static std::map<uint32_t, std::vector<CheckInResult>> answers;   // Tap index -> results
+static std::map<uint32_t, uint32_t> tappedAt;
+static std::map<uint32_t, uint32_t> scheduled;   // Tap index -> when the card comes
+static uint32_t slowestAnswerMs;
+
+static void startDevice(bool batched, int batchEndpoint = 200) {
+  server = MockServer();
+  server.batchEndpoint = batchEndpoint;
+  server.batchFits = CHECKIN_BATCH_MAX;
+  answers.clear();
+  tappedAt.clear();
+  scheduled.clear();
+  slowestAnswerMs = 0;
+  storage = new RamLogStorage(CHECKIN_LOG_CAPACITY);
+  journal = new CheckinLog();
+  journal->begin(storage);
+  dispatcher = new CheckinDispatcher(*journal, mockSend, batched ? mockSendBatch : NULL, mockLink);
+}
+
+static void stopDevice() {
+  delete dispatcher;
+  delete journal;
+  delete storage;
+}
+
+static void tap(uint32_t index, uint32_t atMs) {
+  TapRequest req = {};
+  uint8_t uid[4] = { 0x04, 0x00, (uint8_t)(index >> 8), (uint8_t)index };
+  req.uid = CardUid(uid, sizeof(uid));
+  req.tag = (uint8_t)index;
+  req.tappedUs = index;
+  strcpy(req.eventId, "bench");
+  TEST_ASSERT_TRUE(dispatcher->submit(req));
+  tappedAt[index] = atMs;
+}
+
+static void tap(uint32_t index) {
+  tap(index, server.nowMs);
+}
+
+// Network task passes every ms of virtual time, results taken as the UI
+// would. Scheduled cards that came while a request was out are submitted
+// late, but keep their own tap time.
+static void takeResults() {
+  TapResult result;
+  while (dispatcher->takeResult(result)) {
+    answers[result.tappedUs].push_back(result.result);
+    uint32_t waited = server.nowMs - tappedAt[result.tappedUs];
+    slowestAnswerMs = waited > slowestAnswerMs ? waited : slowestAnswerMs;
+  }
+}
+
+static void submitDue() {
+  while (!scheduled.empty() && (int32_t)(server.nowMs - scheduled.begin()->second) >= 0) {
+    tap(scheduled.begin()->first, scheduled.begin()->second);
+    scheduled.erase(scheduled.begin());
+  }
+}
+
+static void runUntil(uint32_t untilMs) {
+  while ((int32_t)(untilMs - server.nowMs) > 0) {
+    bool sent;
+    do {
+      submitDue();
+      sent = dispatcher->runOnce(server.nowMs);
+      takeResults();
+    } while (sent);
+    server.nowMs++;
+  }
+}
+
+// Journaled straight to storage, as if the link had been down
+static void journalBacklog(uint32_t first, uint32_t count) {
+  for (uint32_t i = first; i < first + count; i++) {
+    CheckinRecord rec = {};
+    rec.uidLen = 4;
+    rec.uid[0] = 0x04;
+    rec.uid[2] = (uint8_t)(i >> 8);
+    rec.uid[3] = (uint8_t)i;
+    strcpy(rec.eventId, "bench");
+    TEST_ASSERT_TRUE(journal->append(rec));
+  }
+}
+
+static CheckInResult onlyAnswer(uint32_t index) {
+  TEST_ASSERT_EQUAL_UINT32(1, answers[index].size());
+  return answers[index][0];
+}
+
+// ==========================================
+// TESTS
+// ==========================================
+
+void test_partial_result_routes_per_item() {
+  startDevice(true);
+  server.itemStatus[1] = 409;    // Already checked in
+  server.itemStatus[2] = 503;    // Server could not store it this time
+  server.itemStatus[3] = 422;    // Rejected for good
+  server.itemStatus[4] = -1;     // Missing from the results
+  for (uint32_t i = 0; i < 6; i++) {
+    tap(i);
+  }
+  runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 10);
+
+  TEST_ASSERT_EQUAL_UINT32(1, server.batchRequests);
+  TEST_ASSERT_EQUAL(CHECKIN_OK, onlyAnswer(0));
+  TEST_ASSERT_EQUAL(CHECKIN_DUPLICATE, onlyAnswer(1));
+  TEST_ASSERT_EQUAL(CHECKIN_QUEUED, onlyAnswer(2));
+  TEST_ASSERT_EQUAL(CHECKIN_FAILED, onlyAnswer(3));
+  TEST_ASSERT_EQUAL(CHECKIN_QUEUED, onlyAnswer(4));
+  TEST_ASSERT_EQUAL(CHECKIN_OK, onlyAnswer(5));
+
+  // 409 and 422 are final; 503 and the missing one wait for the replay
+  CheckinRecord rec;
+  TEST_ASSERT_EQUAL_UINT32(3, journal->oldestSequence());   // Tap 2
+  TEST_ASSERT_FALSE(journal->readPending(4, rec));
+  TEST_ASSERT_TRUE(journal->readPending(5, rec));
+  TEST_ASSERT_FALSE(journal->readPending(6, rec));
+
+  // The replay (after the backoff) sends only those two, then nothing
+  runUntil(server.nowMs + CHECKIN_RETRY_MIN + 100);
+  TEST_ASSERT_EQUAL_UINT32(2, server.batchRequests);
+  TEST_ASSERT_EQUAL_UINT32(0, journal->pendingCount());
+  TEST_ASSERT_EQUAL(1, server.stored[2]);
+  TEST_ASSERT_EQUAL(1, server.stored[4]);
+  TEST_ASSERT_EQUAL(0, server.stored[3]);
+  TEST_ASSERT_EQUAL_UINT32(1, answers[2].size());   // Replays answer nobody
+  stopDevice();
+}
+
+static void checkFallback(int missingCode) {
+  startDevice(true, missingCode);
+  for (uint32_t i = 0; i < 5; i++) {
+    tap(i);
+  }
+  runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 500);
+
+  // One batch attempt, then one request per tap from then on
+  TEST_ASSERT_EQUAL_UINT32(1, server.batchRequests);
+  TEST_ASSERT_EQUAL_UINT32(5, server.singleRequests);
+  for (uint32_t i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL(1, server.stored[i]);
+    TEST_ASSERT_EQUAL(CHECKIN_OK, onlyAnswer(i));
+  }
+
+  tap(5);
+  runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 100);
+  TEST_ASSERT_EQUAL_UINT32(1, server.batchRequests);
+  TEST_ASSERT_EQUAL_UINT32(6, server.singleRequests);
+  TEST_ASSERT_EQUAL_UINT32(0, journal->pendingCount());
+  stopDevice();
+}
+
+void test_missing_batch_endpoint_404_falls_back_per_tap() {
+  checkFallback(404);
+}
+
+void test_missing_batch_endpoint_405_falls_back_per_tap() {
+  checkFallback(405);
+}
+
+// The batch payload holds 5 records: 16 and 8 are refused on the device,
+// then the backlog goes out 4 at a time, without a backoff in between
+void test_oversized_batch_is_halved_until_it_fits() {
+  startDevice(true);
+  server.batchFits = 5;
+  journalBacklog(0, 40);
+  uint32_t startMs = server.nowMs;
+  runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 1);
+  while (journal->pendingCount() > 0 && server.nowMs - startMs < CHECKIN_RETRY_MIN) {
+    runUntil(server.nowMs + 1);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(0, journal->pendingCount());
+  TEST_ASSERT_EQUAL_UINT32(2, server.tooLarge);
+  TEST_ASSERT_EQUAL(4, server.largestBatch);
+  TEST_ASSERT_EQUAL_UINT32(10, server.batchRequests);
+  TEST_ASSERT_EQUAL_UINT32(0, server.singleRequests);
+  for (uint32_t i = 0; i < 40; i++) {
+    TEST_ASSERT_EQUAL(1, server.stored[i]);
+  }
+
+  // Stays at the size that fitted
+  journalBacklog(100, 8);
+  runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 100);
+  TEST_ASSERT_EQUAL_UINT32(0, journal->pendingCount());
+  TEST_ASSERT_EQUAL_UINT32(2, server.tooLarge);
+  TEST_ASSERT_EQUAL_UINT32(12, server.batchRequests);
+  stopDevice();
+}
+
+// Once memory is back the batch doubles every CHECKIN_BATCH_REGROW good
+// flushes, up to CHECKIN_BATCH_MAX
+void test_halved_batch_grows_back() {
+  startDevice(true);
+  server.batchFits = 5;
+  journalBacklog(0, 8);
+  runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 100);
+  TEST_ASSERT_EQUAL_UINT32(0, journal->pendingCount());
+  TEST_ASSERT_EQUAL(4, server.largestBatch);
+  TEST_ASSERT_EQUAL_UINT32(1, server.tooLarge);
+
+  server.batchFits = CHECKIN_BATCH_MAX;
+  uint32_t index = 100;
+  for (uint32_t round = 0; round < 2 * CHECKIN_BATCH_REGROW && journal->pendingCount() == 0; round++) {
+    tap(index++);
+    runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 10);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, journal->pendingCount());
+  TEST_ASSERT_EQUAL_UINT32(1, server.tooLarge);
+
+  journalBacklog(1000, 3 * CHECKIN_BATCH_MAX);
+  runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 100);
+  TEST_ASSERT_EQUAL_UINT32(0, journal->pendingCount());
+  TEST_ASSERT_EQUAL(CHECKIN_BATCH_MAX, server.largestBatch);
+  TEST_ASSERT_EQUAL_UINT32(1, server.tooLarge);
+  stopDevice();
+}
+
+// Not even two records fit: one request per tap, as with no batch endpoint
+void test_batch_that_never_fits_goes_per_tap() {
+  startDevice(true);
+  server.batchFits = 1;
+  for (uint32_t i = 0; i < 3; i++) {
+    tap(i);
+  }
+  runUntil(server.nowMs + CHECKIN_BATCH_DEADLINE + 500);
+
+  TEST_ASSERT_EQUAL_UINT32(0, journal->pendingCount());
+  TEST_ASSERT_EQUAL_UINT32(0, server.batchRequests);
+  TEST_ASSERT_EQUAL_UINT32(3, server.singleRequests);
+  for (uint32_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(CHECKIN_OK, onlyAnswer(i));
+  }
+  stopDevice();
+}
+
+// A lecture start: 200 taps at two busy doors, one every 25 ms (faster
+// than a single request), then a backlog of 300 replayed after an outage.
+// Same taps batched and per tap.
+struct BenchResult {
+  uint32_t requests;
+  uint32_t slowestLiveMs;    // Longest a live tap waited for its answer
+  uint32_t backlogDrainMs;   // Backlog of 300 to an empty journal
+};
+
+static BenchResult runBench(bool batched) {
+  BenchResult r;
+  startDevice(batched);
+  for (uint32_t i = 0; i < 200; i++) {
+    scheduled[i] = i * 25;
+  }
+  while (answers.size() < 200) {
+    runUntil(server.nowMs + 1);
+  }
+  r.slowestLiveMs = slowestAnswerMs;
+
+  journalBacklog(1000, 300);
+  uint32_t backlogAt = server.nowMs;
+  while (journal->pendingCount() > 0) {
+    runUntil(server.nowMs + 1);
+  }
+  r.backlogDrainMs = server.nowMs - backlogAt;
+  r.requests = server.batchRequests + server.singleRequests;
+  TEST_ASSERT_EQUAL_UINT32(500, server.stored.size());
+  stopDevice();
+  return r;
+}
+
+void test_batched_vs_per_tap_benchmark() {
+  BenchResult single = runBench(false);
+  BenchResult batched = runBench(true);
+
+  char line[160];
+  snprintf(line, sizeof(line), "per tap: %u requests, slowest live answer %u ms, backlog %u ms",
+           (unsigned)single.requests, (unsigned)single.slowestLiveMs, (unsigned)single.backlogDrainMs);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "batched: %u requests, slowest live answer %u ms, backlog %u ms",
+           (unsigned)batched.requests, (unsigned)batched.slowestLiveMs, (unsigned)batched.backlogDrainMs);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_EQUAL_UINT32(500, single.requests);
+  // The backlog goes out CHECKIN_BATCH_MAX at a time
+  TEST_ASSERT_LESS_OR_EQUAL(single.requests / 2, batched.requests);
+  TEST_ASSERT_LESS_THAN(single.backlogDrainMs / 4, batched.backlogDrainMs);
+  // Per tap falls behind taps that come faster than a request; a batched
+  // tap waits at most for the request in flight, the batch deadline and
+  // its own request
+  TEST_ASSERT_LESS_THAN(single.slowestLiveMs, batched.slowestLiveMs);
+  TEST_ASSERT_LESS_OR_EQUAL(CHECKIN_BATCH_DEADLINE + 2 * (RTT_MS + CHECKIN_BATCH_MAX * PER_RECORD_MS),
+                            batched.slowestLiveMs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_partial_result_routes_per_item);
+  RUN_TEST(test_missing_batch_endpoint_404_falls_back_per_tap);
+  RUN_TEST(test_missing_batch_endpoint_405_falls_back_per_tap);
+  RUN_TEST(test_oversized_batch_is_halved_until_it_fits);
+  RUN_TEST(test_halved_batch_grows_back);
+  RUN_TEST(test_batch_that_never_fits_goes_per_tap);
+  RUN_TEST(test_batched_vs_per_tap_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,85 @@
+// BootTimeline (boot_timeline.h): steps marked from reset to the first
+// loop pass, and the report against the budget.
+
+#include <unity.h>
+#include "boot_timeline.h"
+#include "../fakes/sim_hal.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_card_ready_is_kept_from_the_first_pass() {
+  BootTimeline boot;
+  TEST_ASSERT_FALSE(boot.isCardReady());
+  boot.mark("oled", 120000);
+  boot.cardReady(480000);
+  boot.cardReady(900000);
+  TEST_ASSERT_TRUE(boot.isCardReady());
+  TEST_ASSERT_EQUAL_UINT32(480000, boot.cardReadyUs());
+
+  // A pass at 0 us still counts as ready
+  BootTimeline early;
+  early.cardReady(0);
+  TEST_ASSERT_TRUE(early.isCardReady());
+}
+
+// Each step takes the time since the one before; shares of the total
+void test_report_lists_steps_and_shares() {
+  BootTimeline boot;
+  boot.mark("session", 50000);
+  boot.mark("oled", 250000);
+  boot.mark("readers", 400000);
+  boot.cardReady(500000);
+
+  MemoryLog log;
+  boot.print(log, 1000);
+  TEST_ASSERT_TRUE(log.contains("budget 1000 ms"));
+  TEST_ASSERT_TRUE(log.contains("  session                50       50    10%"));
+  TEST_ASSERT_TRUE(log.contains("  oled                  250      200    40%"));
+  TEST_ASSERT_TRUE(log.contains("  readers               400      150    30%"));
+  TEST_ASSERT_TRUE(log.contains("  loop start            500      100    20%"));
+  TEST_ASSERT_TRUE(log.contains("✓ Card-ready 500 ms"));
+}
+
+void test_report_flags_an_overrun() {
+  BootTimeline boot;
+  boot.mark("wifi", 1800000);
+  boot.cardReady(2100000);
+  MemoryLog log;
+  boot.print(log, 1000);
+  TEST_ASSERT_TRUE(log.contains("⚠️ Card-ready 2100 ms after start (budget 1000 ms)"));
+}
+
+void test_report_before_the_first_pass() {
+  BootTimeline boot;
+  boot.mark("session", 50000);
+  MemoryLog log;
+  boot.print(log, 1000);
+  TEST_ASSERT_TRUE(log.contains("session"));
+  TEST_ASSERT_TRUE(log.contains("(not card-ready yet)"));
+  TEST_ASSERT_FALSE(log.contains("Card-ready"));
+}
+
+// Steps past BOOT_STEPS_MAX are dropped, not written past the arrays
+void test_steps_past_the_limit_are_dropped() {
+  static const char* const names[] = { "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8",
+                                       "s9", "s10", "s11", "s12", "s13", "s14", "s15", "s16" };
+  BootTimeline boot;
+  for (uint32_t i = 0; i <= BOOT_STEPS_MAX; i++) {
+    boot.mark(names[i], (i + 1) * 1000);
+  }
+  MemoryLog log;
+  boot.print(log, 1000);
+  TEST_ASSERT_TRUE(log.contains("s15"));
+  TEST_ASSERT_FALSE(log.contains("s16"));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_card_ready_is_kept_from_the_first_pass);
+  RUN_TEST(test_report_lists_steps_and_shares);
+  RUN_TEST(test_report_flags_an_overrun);
+  RUN_TEST(test_report_before_the_first_pass);
+  RUN_TEST(test_steps_past_the_limit_are_dropped);
+  return UNITY_END();
+}
@@ -0,0 +1,308 @@
+// ButtonGestures (button_gestures.h) on recorded-style edge traces:
+// contact bounce, EMI spikes, double taps, and a loop that does not poll
+// for a while. Each trace goes through the ISR queue path, polled every
+// LOOP_MS, and the gestures are checked with the time they complete at.
+// The same traces through the level polling DeviceController did before
+// show what it got wrong.
+
+#include <unity.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "button_gestures.h"
+
+#define LOOP_MS 10
+
+struct TraceEdge {
+  HalButton button;
+  bool down;
+  uint32_t ms;
+};
+
+struct ButtonTrace {
+  bool doubleTap;           // Fetch listens for double taps (event loaded)
+  uint32_t blockedUntil;    // Loop busy (no polls) until then
+  std::vector<TraceEdge> edges;
+};
+
+// A press from downMs to upMs, with contact bounce of bounceEdges extra
+// edge pairs (2 ms apart) after each transition
+static void press(ButtonTrace& trace, HalButton button, uint32_t downMs, uint32_t upMs, uint8_t bounceEdges) {
+  uint32_t at[2] = { downMs, upMs };
+  for (uint8_t t = 0; t < 2; t++) {
+    bool down = t == 0;
+    trace.edges.push_back({ button, down, at[t] });
+    for (uint8_t i = 1; i <= bounceEdges; i++) {
+      trace.edges.push_back({ button, !down, at[t] + 4 * i - 2 });
+      trace.edges.push_back({ button, down, at[t] + 4 * i });
+    }
+  }
+  std::stable_sort(trace.edges.begin(), trace.edges.end(),
+                   [](const TraceEdge& a, const TraceEdge& b) { return a.ms < b.ms; });
+}
+
+static uint32_t traceEnd(const ButtonTrace& trace) {
+  return trace.edges.back().ms + BUTTON_LONG_PRESS + 1000;
+}
+
+// Gestures in order, with and without the time each completed at
+struct Gestures {
+  std::string types;
+  std::string timed;
+};
+
+static void appendGesture(Gestures& out, HalButton button, GestureType type, uint32_t atMs) {
+  static const char* const names[2][3] = {
+    { "F:short", "F:long", "F:double" },
+    { "C:short", "C:long", "C:double" }
+  };
+  char text[32];
+  snprintf(text, sizeof(text), "%s%s@%u", out.timed.empty() ? "" : " ", names[button][type], (unsigned)atMs);
+  out.timed += text;
+  out.types += out.types.empty() ? "" : " ";
+  out.types += names[button][type];
+}
+
+// Edges through the ISR queue into ButtonGestures, polled every LOOP_MS
+// once the loop is free
+static Gestures replay(const ButtonTrace& trace, GestureStats* stats = NULL) {
+  ButtonGestures gestures(BUTTON_DEBOUNCE, BUTTON_LONG_PRESS, BUTTON_DOUBLE_TAP);
+  gestures.enableDoubleTap(BUTTON_FETCH, trace.doubleTap);
+  Gestures out;
+  size_t next = 0;
+  for (uint32_t t = 0; t <= traceEnd(trace); t += LOOP_MS) {
+    if (t < trace.blockedUntil) {
+      continue;
+    }
+    while (next < trace.edges.size() && trace.edges[next].ms <= t) {
+      const TraceEdge& e = trace.edges[next++];
+      gestures.onEdge({ e.button, e.down, e.ms });
+    }
+    ButtonGesture g;
+    while (gestures.poll(t, g)) {
+      appendGesture(out, g.button, g.type, g.atMs);
+    }
+  }
+  if (stats) {
+    *stats = gestures.stats();
+  }
+  return out;
+}
+
+// What DeviceController did before: sample the level every loop pass,
+// ignore changes within BUTTON_DEBOUNCE of the last one, act on release
+static Gestures replayLevelPolling(const ButtonTrace& trace) {
+  bool pressed[2] = { false, false };
+  uint32_t pressStart[2] = { 0, 0 };
+  uint32_t changedAt[2] = { 0, 0 };
+  Gestures out;
+  for (uint32_t t = 0; t <= traceEnd(trace); t += LOOP_MS) {
+    if (t < trace.blockedUntil) {
+      continue;
+    }
+    for (uint8_t b = 0; b < 2; b++) {
+      bool down = false;
+      for (const TraceEdge& e : trace.edges) {
+        if (e.button == b && e.ms <= t) {
+          down = e.down;
+        }
+      }
+      if (down == pressed[b] || t - changedAt[b] < BUTTON_DEBOUNCE) {
+        continue;
+      }
+      pressed[b] = down;
+      changedAt[b] = t;
+      if (down) {
+        pressStart[b] = t;
+      } else {
+        GestureType type = t - pressStart[b] >= BUTTON_LONG_PRESS ? GESTURE_LONG : GESTURE_SHORT;
+        appendGesture(out, (HalButton)b, type, t);
+      }
+    }
+  }
+  return out;
+}
+
+static void checkGestures(const ButtonTrace& trace, const char* expected) {
+  Gestures got = replay(trace);
+  TEST_ASSERT_EQUAL_STRING(expected, got.timed.c_str());
+}
+
+// The traces, as the level polling test replays them too
+static ButtonTrace cleanShort() {
+  ButtonTrace t = { false, 0, {} };
+  press(t, BUTTON_FETCH, 100, 220, 0);
+  return t;
+}
+
+static ButtonTrace bouncyShort() {
+  ButtonTrace t = { false, 0, {} };
+  press(t, BUTTON_FETCH, 101, 233, 3);
+  return t;
+}
+
+static ButtonTrace bouncyLong() {
+  ButtonTrace t = { false, 0, {} };
+  press(t, BUTTON_FETCH, 103, 5607, 4);
+  return t;
+}
+
+static ButtonTrace doubleTap(bool enabled) {
+  ButtonTrace t = { enabled, 0, {} };
+  press(t, BUTTON_FETCH, 101, 221, 2);
+  press(t, BUTTON_FETCH, 383, 497, 2);
+  return t;
+}
+
+static ButtonTrace twoSlowTaps() {
+  ButtonTrace t = { true, 0, {} };
+  press(t, BUTTON_FETCH, 101, 221, 2);
+  press(t, BUTTON_FETCH, 801, 925, 2);
+  return t;
+}
+
+static ButtonTrace emiSpikes() {
+  ButtonTrace t = { false, 0, {} };
+  t.edges = { { BUTTON_FETCH, true, 100 }, { BUTTON_FETCH, false, 103 },
+              { BUTTON_CLEAR, true, 400 }, { BUTTON_CLEAR, false, 401 },
+              { BUTTON_FETCH, true, 900 }, { BUTTON_FETCH, false, 920 } };
+  return t;
+}
+
+static ButtonTrace pressWhileBlocked() {
+  ButtonTrace t = { false, 3000, {} };
+  press(t, BUTTON_FETCH, 1201, 1337, 3);
+  return t;
+}
+
+static ButtonTrace doubleWhileBlocked() {
+  ButtonTrace t = { true, 3000, {} };
+  press(t, BUTTON_FETCH, 1201, 1322, 2);
+  press(t, BUTTON_FETCH, 1451, 1566, 2);
+  return t;
+}
+
+static ButtonTrace bothButtons() {
+  ButtonTrace t = { false, 0, {} };
+  press(t, BUTTON_FETCH, 101, 241, 2);
+  press(t, BUTTON_CLEAR, 151, 301, 2);
+  return t;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// PRESSES
+// ==========================================
+
+void test_clean_short_press() {
+  checkGestures(cleanShort(), "F:short@220");
+}
+
+// Bounce neither adds presses nor moves the release: it counts from the
+// first edge of the burst
+void test_bouncy_short_press() {
+  GestureStats stats;
+  Gestures got = replay(bouncyShort(), &stats);
+  TEST_ASSERT_EQUAL_STRING("F:short@233", got.timed.c_str());
+  TEST_ASSERT_EQUAL_UINT32(14, stats.edges);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.presses);
+}
+
+// Reported once held for BUTTON_LONG_PRESS, before the release
+void test_long_press_reported_while_held() {
+  checkGestures(bouncyLong(), "F:long@5103");
+}
+
+void test_both_buttons_at_once() {
+  checkGestures(bothButtons(), "F:short@241 C:short@301");
+}
+
+// Spikes shorter than the debounce time settle back: no press
+void test_emi_spikes_are_glitches() {
+  GestureStats stats;
+  Gestures got = replay(emiSpikes(), &stats);
+  TEST_ASSERT_EQUAL_STRING("", got.timed.c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, stats.presses);
+  TEST_ASSERT_EQUAL_UINT32(3, stats.glitches);
+}
+
+// ==========================================
+// DOUBLE TAPS
+// ==========================================
+
+void test_double_tap() {
+  checkGestures(doubleTap(true), "F:double@497");
+}
+
+// Double taps off: two short presses, the first not held back
+void test_double_tap_disabled() {
+  checkGestures(doubleTap(false), "F:short@221 F:short@497");
+}
+
+// A second tap after the gap: two short presses, the first reported from
+// its release
+void test_two_slow_taps() {
+  checkGestures(twoSlowTaps(), "F:short@221 F:short@925");
+}
+
+// ==========================================
+// A BUSY LOOP
+// ==========================================
+
+// The loop polls again only at 3000 ms: the press is still there, with
+// its real length, and so is a double tap
+void test_press_while_blocked() {
+  checkGestures(pressWhileBlocked(), "F:short@1337");
+}
+
+void test_double_tap_while_blocked() {
+  checkGestures(doubleWhileBlocked(), "F:double@1566");
+}
+
+// The level polling this replaced: bounce delays it, spikes become
+// presses, a double tap is two presses, and a busy loop loses them all
+void test_level_polling_got_four_traces_wrong() {
+  struct Case {
+    const char* name;
+    ButtonTrace trace;
+  } cases[] = {
+    { "clean short", cleanShort() },          { "bouncy short", bouncyShort() },
+    { "bouncy long", bouncyLong() },          { "double tap", doubleTap(true) },
+    { "two slow taps", twoSlowTaps() },       { "tap, double off", doubleTap(false) },
+    { "EMI spikes", emiSpikes() },            { "press while blocked", pressWhileBlocked() },
+    { "double while blocked", doubleWhileBlocked() }, { "both buttons", bothButtons() },
+  };
+  uint32_t wrong = 0;
+  for (const Case& c : cases) {
+    Gestures now = replay(c.trace);
+    Gestures before = replayLevelPolling(c.trace);
+    bool same = now.types == before.types;
+    wrong += !same;
+    char line[160];
+    snprintf(line, sizeof(line), "%-20s gestures: %-24s level polling: %s%s", c.name,
+             now.timed.empty() ? "-" : now.timed.c_str(), before.timed.empty() ? "-" : before.timed.c_str(),
+             same ? "" : " (wrong)");
+    TEST_MESSAGE(line);
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, wrong);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_short_press);
+  RUN_TEST(test_bouncy_short_press);
+  RUN_TEST(test_long_press_reported_while_held);
+  RUN_TEST(test_both_buttons_at_once);
+  RUN_TEST(test_emi_spikes_are_glitches);
+  RUN_TEST(test_double_tap);
+  RUN_TEST(test_double_tap_disabled);
+  RUN_TEST(test_two_slow_taps);
+  RUN_TEST(test_press_while_blocked);
+  RUN_TEST(test_double_tap_while_blocked);
+  RUN_TEST(test_level_polling_got_four_traces_wrong);
+  return UNITY_END();
+}
@@ -0,0 +1,233 @@
+// Card detection, polling against IRQ (CARD_DETECT_IRQ), on a simulated
+// RC522 (test/fakes/sim_rc522.h) driven through Rc522Picc as
+// Rc522CardReader drives it. The same cards come and go in both modes:
+// how long a card waits to be read, how long the field is on, and how
+// much SPI traffic the reader makes.
+
+#include <unity.h>
+#include <stdio.h>
+#include "config.h"
+#include "rc522_picc.h"
+#include "../fakes/sim_rc522.h"
+
+#define LOOP_US 300          // Card loop pass besides the reader (buttons, results, screen)
+#define IRQ_STEP_US 50       // Sleep resolution while waiting for the IRQ pin
+#define DWELL_MS 400         // A card held on the reader
+#define CARD_COUNT 300
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// READER MODES
+// ==========================================
+
+// Poll: REQA on every loop pass, antenna on all the time
+class PollMode {
+public:
+  PollMode(SimRc522& chip, Rc522Picc& picc) : chip(chip), picc(picc) {}
+
+  bool pass(CardUid& uid) {
+    uint8_t sak;
+    bool found = picc.requestA() && picc.select(uid, sak);
+    if (found) {
+      picc.haltA();
+    }
+    chip.waitUs(LOOP_US);
+    return found;
+  }
+
+  SimRc522& chip;
+  Rc522Picc& picc;
+};
+
+// IRQ: Rc522CardReader::sense() and readCard() - a REQA probe every
+// CARD_SENSE_INTERVAL with the field on for CARD_SENSE_WINDOW, the task
+// asleep until the IRQ pin or the next probe
+class IrqMode {
+public:
+  IrqMode(SimRc522& chip, Rc522Picc& picc) : chip(chip), picc(picc), probing(false), pending(false), nextSenseUs(0) {
+    picc.idle();
+    picc.antenna(false);
+  }
+
+  bool pass(CardUid& uid) {
+    if (pending) {
+      pending = false;
+      uint8_t sak;
+      picc.probeAnswered();
+      bool found = picc.select(uid, sak);
+      if (found) {
+        picc.haltA();
+      }
+      endProbe();
+      chip.waitUs(LOOP_US);
+      return found;
+    }
+    if (chip.nowUs() >= nextSenseUs) {
+      if (probing) {
+        endProbe();
+      } else {
+        startProbe();
+      }
+    }
+    while (chip.nowUs() < nextSenseUs) {
+      if (probing && chip.irqRaised()) {
+        pending = true;
+        break;
+      }
+      chip.waitUs(IRQ_STEP_US);
+    }
+    chip.waitUs(LOOP_US);
+    return false;
+  }
+
+  SimRc522& chip;
+  Rc522Picc& picc;
+
+private:
+  void startProbe() {
+    picc.antenna(true);
+    picc.startRequestA();
+    probing = true;
+    nextSenseUs = chip.nowUs() + CARD_SENSE_WINDOW * 1000.0;
+  }
+
+  void endProbe() {
+    picc.idle();
+    picc.antenna(false);
+    probing = false;
+    nextSenseUs = chip.nowUs() + (CARD_SENSE_INTERVAL - CARD_SENSE_WINDOW) * 1000.0;
+  }
+
+  bool probing;
+  bool pending;
+  double nextSenseUs;
+};
+
+// ==========================================
+// RUN
+// ==========================================
+
+struct DetectResult {
+  uint32_t detected;         // Cards read at least once while in the field
+  uint32_t rereads;          // Same card read again before it left
+  double meanDetectMs;       // Card in the field to UID read
+  double worstDetectMs;
+  double antennaDuty;        // Share of the time the field is on
+  double transactionsPerS;   // SPI transactions per second
+  double seconds;
+};
+
+// Cards come every 1-3 s, each held DWELL_MS, in both modes alike
+template <class Mode>
+static DetectResult run(SimRc522& chip, Rc522Picc& picc, Mode& mode) {
+  DetectResult r = {};
+  uint32_t seed = 777;
+  double arriveUs = 1000000;
+  uint32_t card = 0;
+  bool present = false;
+  bool seen = false;
+  double sumMs = 0;
+  const uint8_t none[1] = { 0 };
+
+  while (card < CARD_COUNT) {
+    double now = chip.nowUs();
+    if (!present && now >= arriveUs) {
+      uint8_t uid[4] = { 0x04, 0x5A, (uint8_t)(card >> 8), (uint8_t)card };
+      chip.card(uid, sizeof(uid));
+      present = true;
+      seen = false;
+    }
+    if (present && now >= arriveUs + DWELL_MS * 1000.0) {
+      chip.card(none, 0);
+      present = false;
+      card++;
+      seed = seed * 1664525u + 1013904223u;
+      arriveUs += DWELL_MS * 1000.0 + 1000000 + (seed >> 8) % 2000000;
+    }
+
+    CardUid uid;
+    if (mode.pass(uid)) {
+      TEST_ASSERT_TRUE(present);
+      TEST_ASSERT_EQUAL_UINT8((uint8_t)card, uid.data()[3]);
+      if (seen) {
+        r.rereads++;
+      } else {
+        double ms = (chip.nowUs() - arriveUs) / 1000.0;
+        seen = true;
+        r.detected++;
+        sumMs += ms;
+        r.worstDetectMs = ms > r.worstDetectMs ? ms : r.worstDetectMs;
+      }
+    }
+    chip.resetTrace();
+  }
+
+  r.seconds = chip.nowUs() / 1e6;
+  r.meanDetectMs = r.detected ? sumMs / r.detected : 0;
+  r.antennaDuty = chip.antennaOnUs() / chip.nowUs();
+  r.transactionsPerS = picc.stats().transactions / r.seconds;
+  return r;
+}
+
+static void report(const char* name, const DetectResult& r) {
+  char line[160];
+  snprintf(line, sizeof(line),
+           "%s: %u/%u cards, detect mean %.1f ms, worst %.1f ms, field on %.1f%%, %.0f SPI transactions/s, %u rereads",
+           name, (unsigned)r.detected, (unsigned)CARD_COUNT, r.meanDetectMs, r.worstDetectMs, r.antennaDuty * 100,
+           r.transactionsPerS, (unsigned)r.rereads);
+  TEST_MESSAGE(line);
+}
+
+// ==========================================
+// TESTS
+// ==========================================
+
+static DetectResult pollResult;
+static DetectResult irqResult;
+
+void test_poll_mode() {
+  SimRc522 chip(RC522_SPI_CLOCK);
+  Rc522Picc picc(chip);
+  picc.begin();
+  PollMode mode(chip, picc);
+  pollResult = run(chip, picc, mode);
+  report("poll", pollResult);
+
+  TEST_ASSERT_EQUAL_UINT32(CARD_COUNT, pollResult.detected);
+  TEST_ASSERT_EQUAL_UINT32(0, pollResult.rereads);      // Halted and the field stays on
+  TEST_ASSERT_TRUE(pollResult.worstDetectMs <= 5.0);
+  TEST_ASSERT_TRUE(pollResult.antennaDuty >= 0.999);
+}
+
+void test_irq_mode() {
+  SimRc522 chip(RC522_SPI_CLOCK);
+  Rc522Picc picc(chip);
+  picc.begin();
+  IrqMode mode(chip, picc);
+  irqResult = run(chip, picc, mode);
+  report("irq", irqResult);
+
+  TEST_ASSERT_EQUAL_UINT32(CARD_COUNT, irqResult.detected);
+  // At most one probe interval late, plus the read
+  TEST_ASSERT_TRUE(irqResult.worstDetectMs <= CARD_SENSE_INTERVAL + 5.0);
+  TEST_ASSERT_TRUE(irqResult.antennaDuty <= (CARD_SENSE_WINDOW + 1.0) / CARD_SENSE_INTERVAL);
+  // The field goes off after a read, so a card left on the reader is read
+  // again each probe; DeviceController's repeat cache drops those
+  TEST_ASSERT_LESS_OR_EQUAL(CARD_COUNT * (DWELL_MS / CARD_SENSE_INTERVAL + 1), irqResult.rereads);
+}
+
+void test_irq_trades_latency_for_field_and_bus_time() {
+  TEST_ASSERT_TRUE(pollResult.meanDetectMs < irqResult.meanDetectMs);
+  TEST_ASSERT_TRUE(irqResult.antennaDuty < pollResult.antennaDuty / 10);
+  TEST_ASSERT_TRUE(irqResult.transactionsPerS < pollResult.transactionsPerS / 10);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_poll_mode);
+  RUN_TEST(test_irq_mode);
+  RUN_TEST(test_irq_trades_latency_for_field_and_bus_time);
+  return UNITY_END();
+}
@@ -0,0 +1,247 @@
+// CardUid (card_uid.h) and the tap path it rides on: parse and format,
+// no heap allocation per tap from reader bytes to a stored record and its
+// answer, and the cost against building the UID as a string per byte.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+#include <new>
+#include "card_uid.h"
+#include "uid_cache.h"
+#include "roster.h"
+#include "checkin_dispatcher.h"
+#include "../fakes/ram_log_storage.h"
+
+#define TAP_COUNT 2000
+#define ROSTER_CARDS 500
+#define BENCH_UIDS 200000
+
+// ==========================================
+// HEAP COUNTER
+// ==========================================
+
+static bool counting = false;
+static uint32_t heapNews = 0;
+
+void* operator new(size_t size) {
+  if (counting) {
+    heapNews++;
+  }
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void setUp() {}
+void tearDown() {
+  counting = false;
+}
+
+// ==========================================
+// PARSE AND FORMAT
+// ==========================================
+
+void test_format_and_parse_round_trip() {
+  const uint8_t raw[7] = { 0x04, 0xA1, 0x0B, 0xC2, 0x5D, 0x80, 0xFF };
+  CardUid uid(raw, sizeof(raw));
+  CardUidText text = uid.text();
+  TEST_ASSERT_EQUAL_UINT8(7, uid.size());
+  TEST_ASSERT_EQUAL_STRING("04:A1:0B:C2:5D:80:FF", text.c_str());
+  TEST_ASSERT_EQUAL(strlen(text.c_str()), uid.textLength());
+  TEST_ASSERT_TRUE(CardUid::parse(text.c_str()) == uid);
+  TEST_ASSERT_TRUE(CardUid::parse("04-a1-0b-c2-5d-80-ff") == uid);
+  TEST_ASSERT_TRUE(CardUid::parse("04 A1 0B C2 5D 80 FF") == uid);
+}
+
+void test_parse_stops_at_junk_and_at_ten_bytes() {
+  CardUidText cut = CardUid::parse("AA:BB;CC").text();
+  TEST_ASSERT_EQUAL_STRING("AA:BB", cut.c_str());
+  TEST_ASSERT_TRUE(CardUid::parse("").empty());
+  TEST_ASSERT_TRUE(CardUid::parse(NULL).empty());
+  CardUid longest = CardUid::parse("00:11:22:33:44:55:66:77:88:99:AA:BB");
+  CardUidText text = longest.text();
+  TEST_ASSERT_EQUAL_UINT8(CARD_UID_MAX, longest.size());
+  TEST_ASSERT_EQUAL_STRING("00:11:22:33:44:55:66:77:88:99", text.c_str());
+}
+
+void test_format_truncates_to_the_buffer() {
+  CardUid uid = CardUid::parse("DE:AD:BE:EF");
+  char out[6];
+  TEST_ASSERT_EQUAL(5, uid.format(out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("DE:AD", out);
+  TEST_ASSERT_EQUAL(0, uid.format(out, 0));
+  CardUidText empty = CardUid().text();
+  TEST_ASSERT_EQUAL_STRING("", empty.c_str());
+}
+
+void test_is_a_compile_time_value() {
+  constexpr CardUid uid = CardUid::parse("01:02:03:04");
+  static_assert(uid.size() == 4, "parsed at compile time");
+  static_assert(uid == CardUid::parse("01-02-03-04"), "compared at compile time");
+  TEST_ASSERT_EQUAL_UINT8(4, uid.size());
+}
+
+// ==========================================
+// TAP PATH
+// ==========================================
+
+static int fakeSend(const CheckinRecord& rec, char* studentName, size_t nameSize) {
+  (void)rec;
+  strncpy(studentName, "Student", nameSize);
+  return 200;
+}
+
+static bool fakeLink() {
+  return true;
+}
+
+static void readerBytes(uint32_t n, uint8_t* raw) {
+  raw[0] = 0x04;
+  raw[1] = (uint8_t)(n >> 16);
+  raw[2] = (uint8_t)(n >> 8);
+  raw[3] = (uint8_t)n;
+}
+
+// Reader bytes -> CardUid -> repeat cache -> roster lookup -> TapRequest
+// -> queue -> journal -> server -> TapResult -> UID text for the log.
+// Setup (roster, journal, dispatcher) may allocate; the taps may not.
+void test_tap_path_takes_nothing_from_the_heap() {
+  static Roster roster;
+  for (uint32_t n = 0; n < ROSTER_CARDS; n++) {
+    uint8_t raw[4];
+    readerBytes(n, raw);
+    TEST_ASSERT_TRUE(roster.add(raw, sizeof(raw), "Student", 0));
+  }
+  roster.finalize();
+
+  static RamLogStorage storage(CHECKIN_LOG_CAPACITY);
+  static CheckinLog journal;
+  journal.begin(&storage);
+  static CheckinDispatcher dispatcher(journal, fakeSend, NULL, fakeLink);
+  static UidCache cache(3000);
+
+  uint32_t answered = 0;
+  uint32_t known = 0;
+  size_t textChars = 0;
+  heapNews = 0;
+  counting = true;
+  for (uint32_t i = 0; i < TAP_COUNT; i++) {
+    uint8_t raw[4];
+    readerBytes(i, raw);
+    CardUid uid(raw, sizeof(raw));
+    if (cache.seenRecently(uid, i * 1000)) {
+      continue;
+    }
+    if (roster.find(uid.data(), uid.size())) {
+      known++;
+    }
+
+    TapRequest tap = {};
+    tap.uid = uid;
+    tap.tag = (uint8_t)i;
+    tap.tappedUs = i;
+    strcpy(tap.eventId, "evt");
+    if (!dispatcher.submit(tap)) {
+      break;
+    }
+    while (dispatcher.runOnce(i * 1000)) {
+    }
+    TapResult result;
+    while (dispatcher.takeResult(result)) {
+      answered++;
+    }
+    textChars += uid.text().str[0] ? uid.textLength() : 0;
+  }
+  counting = false;
+
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, heapNews, "tap path allocated on the heap");
+  TEST_ASSERT_EQUAL_UINT32(TAP_COUNT, answered);
+  TEST_ASSERT_EQUAL_UINT32(ROSTER_CARDS, known);
+  TEST_ASSERT_EQUAL(TAP_COUNT * 11, textChars);
+  TEST_ASSERT_EQUAL_UINT32(0, journal.pendingCount());
+}
+
+// ==========================================
+// BENCHMARK
+// ==========================================
+
+// What readCardUID() did before CardUid: String += per byte, then the
+// String passed along by value
+static std::string uidAsString(const uint8_t* raw, size_t len) {
+  std::string uid;
+  for (size_t i = 0; i < len; i++) {
+    char hex[4];
+    snprintf(hex, sizeof(hex), "%02X", raw[i]);
+    if (i) {
+      uid += ":";
+    }
+    uid += hex;
+  }
+  return uid;
+}
+
+void test_card_uid_benchmark() {
+  // 10 bytes, so the text is past any short-string buffer, as a String's always is
+  uint8_t raw[10] = { 0x04, 0xA1, 0x0B, 0xC2, 0x5D, 0x80, 0x3E, 0x71, 0x9A, 0x00 };
+  volatile size_t sink = 0;
+
+  heapNews = 0;
+  counting = true;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_UIDS; i++) {
+    raw[9] = (uint8_t)i;
+    CardUid uid(raw, sizeof(raw));
+    CardUid copy = uid;
+    sink = sink + copy.text().str[19];
+  }
+  double valueNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                   BENCH_UIDS;
+  counting = false;
+  uint32_t valueNews = heapNews;
+
+  heapNews = 0;
+  counting = true;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_UIDS; i++) {
+    raw[9] = (uint8_t)i;
+    std::string uid = uidAsString(raw, sizeof(raw));
+    std::string copy = uid;
+    sink = sink + copy[19];
+  }
+  double stringNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                    BENCH_UIDS;
+  counting = false;
+  uint32_t stringNews = heapNews;
+
+  char line[128];
+  snprintf(line, sizeof(line), "10-byte UID: CardUid %.1f ns, %u news; string %.1f ns, %.1f news per tap",
+           valueNs, (unsigned)valueNews, stringNs, (double)stringNews / BENCH_UIDS);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_EQUAL_UINT32(0, valueNews);
+  TEST_ASSERT_GREATER_THAN(0, stringNews);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_format_and_parse_round_trip);
+  RUN_TEST(test_parse_stops_at_junk_and_at_ten_bytes);
+  RUN_TEST(test_format_truncates_to_the_buffer);
+  RUN_TEST(test_is_a_compile_time_value);
+  RUN_TEST(test_tap_path_takes_nothing_from_the_heap);
+  RUN_TEST(test_card_uid_benchmark);
+  return UNITY_END();
+}
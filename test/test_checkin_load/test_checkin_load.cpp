@@ -0,0 +1,157 @@
+// The check-in path under load (fakes/load_model.h): a room of devices,
+// each with its own journal and CheckinDispatcher (the code the network
+// task runs), sending binary frames to a mock /api/check-in/batch.
+// Steady, bursty and rising traffic, server errors, a server and a Wi-Fi
+// outage, and an overloaded server. Every tap must reach the server
+// exactly once and the journals must drain. Each run prints its totals
+// and timeline; the simulator's loadtest command runs the same model with
+// other sizes.
+
+#include <unity.h>
+#include <stdio.h>
+#include "config.h"
+#include "../fakes/load_model.h"
+
+#define LOAD_DEVICES 50
+#define LOAD_TAPS_PER_MIN 6.0
+#define LOAD_MINUTES 10
+
+static LoadReport runLoad(LoadDistribution dist) {
+  LoadReport report;
+  LoadParams params = { LOAD_DEVICES, LOAD_TAPS_PER_MIN, dist, LOAD_MINUTES };
+  runLoadModel(params, report);
+  LoadRun& run = report.run;
+
+  char line[200];
+  snprintf(line, sizeof(line), "%s: %u of %u taps stored in %u requests over %u s, %u left; "
+           "p99 tap to result %u ms, to stored %u ms; peak journals %u",
+           loadDistNames[dist], (unsigned)report.delivered, (unsigned)report.offered, (unsigned)report.requests,
+           (unsigned)(report.spanMs / 1000), (unsigned)report.pendingEnd,
+           (unsigned)loadPercentile(run.resultMs, 0.99), (unsigned)loadPercentile(run.deliveryMs, 0.99),
+           (unsigned)run.peakPending);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "  server: %u x 503, %u transport errors, %u timeouts, %u replays answered 409; "
+           "on screen %u welcome, %u saved offline, %u failed",
+           (unsigned)run.serverErrors, (unsigned)run.transportErrors, (unsigned)run.timeouts,
+           (unsigned)run.serverDuplicates, (unsigned)run.results[CHECKIN_OK],
+           (unsigned)run.results[CHECKIN_QUEUED], (unsigned)run.results[CHECKIN_FAILED]);
+  TEST_MESSAGE(line);
+  loadTimelineHeader(line, sizeof(line));
+  TEST_MESSAGE(line);
+  for (size_t i = 0; i < loadWindows(report); i++) {
+    loadTimelineRow(report, i, line, sizeof(line));
+    TEST_MESSAGE(line);
+  }
+  return report;
+}
+
+// Replays answered 409 are fine (the seq makes them idempotent); a tap
+// that never reached the server is not
+static void assertEveryTapStoredOnce(const LoadReport& report) {
+  TEST_ASSERT_TRUE(report.offered > 0);
+  TEST_ASSERT_EQUAL_UINT32(0, report.run.dropped);
+  TEST_ASSERT_EQUAL_UINT32(0, report.run.results[CHECKIN_FAILED]);
+  TEST_ASSERT_EQUAL_UINT32(0, report.pendingEnd);
+  TEST_ASSERT_EQUAL_UINT32(report.offered, report.delivered);
+}
+
+void setUp() {
+  loadServer = { 4, 40, 2, 0 };
+  loadOutage = { 0, 0, false };
+}
+
+void tearDown() {}
+
+// ==========================================
+// TRAFFIC
+// ==========================================
+
+// 50 devices at 6 taps/min: every student sees a welcome within 250 ms,
+// nothing waits in a journal
+void test_steady_load() {
+  LoadReport report = runLoad(LOAD_UNIFORM);
+  assertEveryTapStoredOnce(report);
+  TEST_ASSERT_EQUAL_UINT32(report.offered, report.run.results[CHECKIN_OK]);
+  TEST_ASSERT_TRUE(loadPercentile(report.run.resultMs, 0.99) < 250);
+  TEST_ASSERT_EQUAL_UINT32(0, report.run.serverDuplicates);
+}
+
+// The same average, all in the first minute of every five
+void test_bursts() {
+  LoadReport report = runLoad(LOAD_BURST);
+  assertEveryTapStoredOnce(report);
+  TEST_ASSERT_TRUE(loadPercentile(report.run.resultMs, 0.99) < 250);
+}
+
+void test_ramp() {
+  LoadReport report = runLoad(LOAD_RAMP);
+  assertEveryTapStoredOnce(report);
+  TEST_ASSERT_TRUE(loadPercentile(report.run.resultMs, 0.99) < 250);
+}
+
+// ==========================================
+// FAILURES
+// ==========================================
+
+// One request in ten answered 503: the records stay in the journal and go
+// out again, the student is told it was saved
+void test_server_errors_are_retried() {
+  loadServer.errorPct = 10;
+  LoadReport report = runLoad(LOAD_UNIFORM);
+  assertEveryTapStoredOnce(report);
+  TEST_ASSERT_TRUE(report.run.serverErrors > 0);
+  TEST_ASSERT_TRUE(report.run.recordsPosted > report.delivered);
+  TEST_ASSERT_TRUE(report.run.results[CHECKIN_QUEUED] > 0);
+}
+
+// Server down for two minutes: taps pile up in the journals and drain in
+// batches once it is back
+void test_server_outage() {
+  loadOutage = { 120000, 120000, false };
+  LoadReport report = runLoad(LOAD_UNIFORM);
+  assertEveryTapStoredOnce(report);
+  TEST_ASSERT_TRUE(report.run.transportErrors > 0);
+  TEST_ASSERT_TRUE(report.run.peakPending > 100);
+  TEST_ASSERT_TRUE(report.batches < report.delivered);
+  TEST_ASSERT_TRUE(loadPercentile(report.run.deliveryMs, 0.99) > 60000);
+  TEST_ASSERT_TRUE(loadPercentile(report.run.resultMs, 0.99) < API_TIMEOUT);
+}
+
+// Wi-Fi gone for two minutes: no request is even tried, the journals
+// hold the taps
+void test_wifi_outage() {
+  loadOutage = { 120000, 120000, true };
+  LoadReport report = runLoad(LOAD_UNIFORM);
+  assertEveryTapStoredOnce(report);
+  TEST_ASSERT_EQUAL_UINT32(0, report.run.transportErrors);
+  TEST_ASSERT_EQUAL_UINT32(0, report.run.offlineRequests);
+  TEST_ASSERT_TRUE(report.run.results[CHECKIN_QUEUED] > 0);
+  TEST_ASSERT_TRUE(report.run.peakPending > 100);
+}
+
+// One slow worker against bursts: requests time out, the server stores
+// them anyway and the replays are answered 409. The backlog does not
+// clear in the drain time, but no tap is lost or stored twice.
+void test_overloaded_server_loses_nothing() {
+  loadServer = { 1, 400, 20, 0 };
+  LoadReport report = runLoad(LOAD_BURST);
+  TEST_ASSERT_TRUE(report.run.timeouts > 0);
+  TEST_ASSERT_TRUE(report.run.serverDuplicates > 0);
+  TEST_ASSERT_EQUAL_UINT32(0, report.run.dropped);
+  TEST_ASSERT_EQUAL_UINT32(0, report.run.results[CHECKIN_FAILED]);
+  TEST_ASSERT_EQUAL_UINT32(0, report.lost);
+  TEST_ASSERT_TRUE(report.pendingEnd > 0);
+  TEST_ASSERT_TRUE(report.delivered < report.offered);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_steady_load);
+  RUN_TEST(test_bursts);
+  RUN_TEST(test_ramp);
+  RUN_TEST(test_server_errors_are_retried);
+  RUN_TEST(test_server_outage);
+  RUN_TEST(test_wifi_outage);
+  RUN_TEST(test_overloaded_server_loses_nothing);
+  return UNITY_END();
+}
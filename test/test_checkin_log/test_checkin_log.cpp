@@ -0,0 +1,264 @@
+// CheckinLog recovery: torn appends, ring wrap-around, saved cursors and
+// storage erased under one.
+// Every "reboot" below is a fresh CheckinLog over the same storage.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "checkin_log.h"
+#include "../fakes/ram_log_storage.h"
+
+#define SLOTS 8
+
+static CheckinRecord makeRecord(uint8_t tag) {
+  CheckinRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.timestamp = 1700000000 + tag;
+  rec.uidLen = 4;
+  rec.uid[0] = 0x04;
+  rec.uid[3] = tag;
+  snprintf(rec.eventId, sizeof(rec.eventId), "event-%u", (unsigned)tag);
+  rec.reader = tag % 2;
+  return rec;
+}
+
+static void appendTags(CheckinLog& log, uint8_t first, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    CheckinRecord rec = makeRecord(first + i);
+    TEST_ASSERT_TRUE(log.append(rec));
+  }
+}
+
+static void ackUpTo(CheckinLog& log, uint32_t lastSeq) {
+  for (uint32_t seq = log.oldestSequence(); seq <= lastSeq; seq++) {
+    TEST_ASSERT_TRUE(log.ack(seq));
+  }
+}
+
+static void assertPending(CheckinLog& log, uint32_t tail, uint32_t next) {
+  TEST_ASSERT_EQUAL_UINT32(next, log.nextSequence());
+  TEST_ASSERT_EQUAL_UINT32(tail, log.oldestSequence());
+  TEST_ASSERT_EQUAL_UINT32(next - tail, log.pendingCount());
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_append_peek_ack_in_order() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  TEST_ASSERT_TRUE(log.begin(&storage));
+  assertPending(log, 1, 1);
+
+  appendTags(log, 1, 3);
+  CheckinRecord out;
+  TEST_ASSERT_TRUE(log.peek(out));
+  TEST_ASSERT_EQUAL_UINT32(1, out.seq);
+  TEST_ASSERT_EQUAL_STRING("event-1", out.eventId);
+  TEST_ASSERT_EQUAL_UINT8(1, out.uid[3]);
+  TEST_ASSERT_EQUAL_UINT8(1, out.reader);
+
+  // Out-of-order ack: the tail waits for seq 1
+  TEST_ASSERT_TRUE(log.ack(2));
+  assertPending(log, 1, 4);
+  TEST_ASSERT_FALSE(log.readPending(2, out));
+  TEST_ASSERT_TRUE(log.ack(1));
+  assertPending(log, 3, 4);
+}
+
+void test_full_log_refuses_append() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  log.begin(&storage);
+  appendTags(log, 1, SLOTS);
+
+  CheckinRecord rec = makeRecord(99);
+  TEST_ASSERT_FALSE(log.append(rec));
+  TEST_ASSERT_TRUE(log.ack(1));
+  TEST_ASSERT_TRUE(log.append(rec));
+  TEST_ASSERT_EQUAL_UINT32(SLOTS + 1, rec.seq);
+}
+
+void test_torn_append_reads_as_empty_slot() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  log.begin(&storage);
+  appendTags(log, 1, 5);
+  TEST_ASSERT_TRUE(log.ack(1));
+
+  storage.tearNextWrite(30);   // Power lost in the middle of seq 6
+  CheckinRecord torn = makeRecord(6);
+  log.append(torn);
+
+  CheckinLog rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(&storage));
+  assertPending(rebooted, 2, 6);
+
+  // The next append takes the torn slot over
+  CheckinRecord rec = makeRecord(7);
+  TEST_ASSERT_TRUE(rebooted.append(rec));
+  TEST_ASSERT_EQUAL_UINT32(6, rec.seq);
+  CheckinRecord out;
+  TEST_ASSERT_TRUE(rebooted.readPending(6, out));
+  TEST_ASSERT_EQUAL_STRING("event-7", out.eventId);
+}
+
+void test_torn_append_over_an_older_record() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  log.begin(&storage);
+  appendTags(log, 1, SLOTS);
+  ackUpTo(log, 3);
+
+  // seq 9 goes to slot 1, over delivered seq 1: tearing it must not
+  // bring seq 1 back or leave a head past seq 8
+  storage.tearNextWrite(CHECKIN_SLOT_SIZE - 1);
+  CheckinRecord torn = makeRecord(9);
+  log.append(torn);
+
+  CheckinLog rebooted;
+  rebooted.begin(&storage);
+  assertPending(rebooted, 4, SLOTS + 1);
+}
+
+void test_recovery_after_several_wraps() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  log.begin(&storage);
+
+  // 3.5 times round the ring, delivering as we go
+  for (uint8_t round = 0; round < 7; round++) {
+    appendTags(log, 1 + round * 4, 4);
+    ackUpTo(log, log.nextSequence() - 3);
+  }
+  assertPending(log, 27, 29);
+
+  CheckinLog rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(&storage));
+  TEST_ASSERT_EQUAL_UINT32(SLOTS, rebooted.slotsScanned());
+  assertPending(rebooted, 27, 29);
+
+  CheckinRecord out;
+  TEST_ASSERT_TRUE(rebooted.peek(out));
+  TEST_ASSERT_EQUAL_UINT32(27, out.seq);
+  TEST_ASSERT_EQUAL_STRING("event-27", out.eventId);
+  TEST_ASSERT_TRUE(rebooted.readPending(28, out));
+  TEST_ASSERT_EQUAL_UINT8(28, out.uid[3]);
+}
+
+void test_recovery_keeps_oldest_pending_across_the_wrap() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  log.begin(&storage);
+  appendTags(log, 1, SLOTS);
+  ackUpTo(log, 5);
+  appendTags(log, 9, 5);        // Slots 1..5 again: seq 9..13
+  assertPending(log, 6, 14);
+
+  CheckinLog rebooted;
+  rebooted.begin(&storage);
+  assertPending(rebooted, 6, 14);
+  TEST_ASSERT_EQUAL_UINT32(SLOTS, rebooted.pendingCount());
+
+  CheckinRecord rec = makeRecord(50);
+  TEST_ASSERT_FALSE(rebooted.append(rec));
+}
+
+void test_saved_cursor_reads_only_new_slots() {
+  RamLogStorage storage(SLOTS * 8);
+  CheckinLog log;
+  log.begin(&storage);
+  appendTags(log, 1, 10);
+  ackUpTo(log, 4);
+  uint32_t next = log.nextSequence();
+  uint32_t tail = log.tailSequence();
+
+  appendTags(log, 11, 3);       // Made after the cursor was saved
+
+  CheckinLog rebooted;
+  rebooted.begin(&storage, next, tail);
+  TEST_ASSERT_LESS_THAN(10, rebooted.slotsScanned());
+  assertPending(rebooted, 5, 14);
+}
+
+void test_saved_cursor_stops_at_a_torn_append() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  log.begin(&storage);
+  appendTags(log, 1, 3);
+  uint32_t next = log.nextSequence();
+  uint32_t tail = log.tailSequence();
+
+  appendTags(log, 4, 1);
+  storage.tearNextWrite(12);
+  CheckinRecord torn = makeRecord(5);
+  log.append(torn);
+
+  CheckinLog rebooted;
+  rebooted.begin(&storage, next, tail);
+  TEST_ASSERT_LESS_THAN(SLOTS, rebooted.slotsScanned());
+  assertPending(rebooted, 1, 5);
+}
+
+void test_stale_cursor_falls_back_to_full_scan() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  log.begin(&storage);
+  appendTags(log, 1, 3);
+
+  // A cursor from other storage, ahead of anything written here
+  CheckinLog rebooted;
+  rebooted.begin(&storage, 40, 35);
+  TEST_ASSERT_GREATER_OR_EQUAL(SLOTS, rebooted.slotsScanned());
+  assertPending(rebooted, 1, 4);
+
+  // A cursor the ring has lapped since it was saved
+  appendTags(log, 4, 3);
+  ackUpTo(log, 6);
+  appendTags(log, 7, SLOTS);
+  CheckinLog lapped;
+  lapped.begin(&storage, 2, 1);
+  assertPending(lapped, 7, 15);
+}
+
+// The journal file recreated (or its slots erased) under a saved cursor:
+// numbering goes on from the cursor, not from 1, so no seq - and no
+// Idempotency-Key - is handed out twice
+void test_erased_storage_keeps_counting_from_the_cursor() {
+  RamLogStorage storage(SLOTS);
+  CheckinLog log;
+  log.begin(&storage);
+  appendTags(log, 1, 5);
+  ackUpTo(log, 5);
+  uint32_t next = log.nextSequence();
+  uint32_t tail = log.tailSequence();
+
+  RamLogStorage erased(SLOTS);
+  CheckinLog rebooted;
+  rebooted.begin(&erased, next, tail);
+  assertPending(rebooted, next, next);
+
+  CheckinRecord rec = makeRecord(9);
+  TEST_ASSERT_TRUE(rebooted.append(rec));
+  TEST_ASSERT_EQUAL_UINT32(next, rec.seq);
+
+  // And again after a reboot without a cursor, from what the slots hold
+  CheckinLog again;
+  again.begin(&erased);
+  assertPending(again, next, next + 1);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_append_peek_ack_in_order);
+  RUN_TEST(test_full_log_refuses_append);
+  RUN_TEST(test_torn_append_reads_as_empty_slot);
+  RUN_TEST(test_torn_append_over_an_older_record);
+  RUN_TEST(test_recovery_after_several_wraps);
+  RUN_TEST(test_recovery_keeps_oldest_pending_across_the_wrap);
+  RUN_TEST(test_saved_cursor_reads_only_new_slots);
+  RUN_TEST(test_saved_cursor_stops_at_a_torn_append);
+  RUN_TEST(test_stale_cursor_falls_back_to_full_scan);
+  RUN_TEST(test_erased_storage_keeps_counting_from_the_cursor);
+  return UNITY_END();
+}
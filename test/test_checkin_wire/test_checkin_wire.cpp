@@ -0,0 +1,385 @@
+// Compact check-in frames (checkin_wire.h): layout, round trips, result
+// frames matched by seq, refusal of anything malformed, then random
+// frames damaged and fed to both decoders (build with
+// -fsanitize=address,undefined to catch overreads), and the size and
+// encode time against the JSON bodies the firmware sends.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "config.h"
+#include "card_uid.h"
+#include "checkin_wire.h"
+
+static const char* const doorNames[] = RC522_DOOR_NAMES;
+static const char eventId[] = "3f2c9a1e-7b4d-4e8a-9c61-0d5e2b7a4f10";
+
+static void makeRecords(CheckinRecord* recs, size_t count, uint32_t seed) {
+  for (size_t i = 0; i < count; i++) {
+    CheckinRecord& rec = recs[i];
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = seed + (uint32_t)i;
+    rec.timestamp = 1760000000u + (uint32_t)i * 3;
+    rec.reader = (uint8_t)(i % 2);
+    rec.uidLen = i % 4 == 3 ? 7 : 4;
+    for (uint8_t b = 0; b < rec.uidLen; b++) {
+      rec.uid[b] = (uint8_t)(0x04 + 37 * (seed + i) + 11 * b);
+    }
+    snprintf(rec.eventId, sizeof(rec.eventId), "%s", eventId);
+  }
+}
+
+static void makeResults(CheckinItemResult* results, size_t count) {
+  static const char* const names[] = { "Chandra", "Alexandria Johnson", "Dana", "Eli Okafor" };
+  for (size_t i = 0; i < count; i++) {
+    results[i].status = i % 5 == 4 ? 409 : 200;
+    snprintf(results[i].studentName, sizeof(results[i].studentName), "%s", names[i % 4]);
+  }
+}
+
+static void assertSameRecords(const CheckinRecord* expected, const CheckinRecord* actual, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    TEST_ASSERT_EQUAL_UINT32(expected[i].seq, actual[i].seq);
+    TEST_ASSERT_EQUAL_UINT32(expected[i].timestamp, actual[i].timestamp);
+    TEST_ASSERT_EQUAL_UINT8(expected[i].reader, actual[i].reader);
+    TEST_ASSERT_EQUAL_UINT8(expected[i].uidLen, actual[i].uidLen);
+    TEST_ASSERT_EQUAL_MEMORY(expected[i].uid, actual[i].uid, expected[i].uidLen);
+    TEST_ASSERT_EQUAL_STRING("", actual[i].eventId);
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// CHECK-IN FRAMES
+// ==========================================
+
+// One tap with a 4-byte UID: header, device id, one 14-byte record
+void test_one_tap_frame_layout() {
+  CheckinRecord rec;
+  makeRecords(&rec, 1, 0x01020304);
+  uint8_t frame[64];
+  size_t len = encodeCheckinFrame(DEVICE_ID, 0xA1B2C3D4, &rec, 1, frame, sizeof(frame));
+  TEST_ASSERT_EQUAL(8 + strlen(DEVICE_ID) + 10 + 4, len);
+  TEST_ASSERT_EQUAL_UINT8(CHECKIN_WIRE_REQUEST, frame[0]);
+  TEST_ASSERT_EQUAL_UINT8(CHECKIN_WIRE_VERSION, frame[1]);
+  TEST_ASSERT_EQUAL_UINT8(1, frame[2]);
+  TEST_ASSERT_EQUAL_UINT8(strlen(DEVICE_ID), frame[3]);
+  static const uint8_t handle[] = { 0xD4, 0xC3, 0xB2, 0xA1 };
+  TEST_ASSERT_EQUAL_MEMORY(handle, frame + 4, 4);
+  static const uint8_t seq[] = { 0x04, 0x03, 0x02, 0x01 };
+  TEST_ASSERT_EQUAL_MEMORY(seq, frame + 8 + strlen(DEVICE_ID), 4);
+}
+
+void test_check_in_frame_round_trip() {
+  CheckinRecord recs[CHECKIN_BATCH_MAX];
+  CheckinRecord decoded[CHECKIN_BATCH_MAX];
+  makeRecords(recs, CHECKIN_BATCH_MAX, 100);
+  uint8_t frame[JSON_BATCH_PAYLOAD_MAX];
+  size_t len = encodeCheckinFrame(DEVICE_ID, 7, recs, CHECKIN_BATCH_MAX, frame, sizeof(frame));
+  TEST_ASSERT_TRUE(len > 0);
+
+  char device[CHECKIN_WIRE_DEVICE_MAX + 1];
+  uint32_t handle = 0;
+  size_t count = 0;
+  TEST_ASSERT_TRUE(decodeCheckinFrame(frame, len, device, handle, decoded, CHECKIN_BATCH_MAX, count));
+  TEST_ASSERT_EQUAL_STRING(DEVICE_ID, device);
+  TEST_ASSERT_EQUAL_UINT32(7, handle);
+  TEST_ASSERT_EQUAL(CHECKIN_BATCH_MAX, count);
+  assertSameRecords(recs, decoded, count);
+
+  // More records than the caller has room for
+  TEST_ASSERT_FALSE(decodeCheckinFrame(frame, len, device, handle, decoded, CHECKIN_BATCH_MAX - 1, count));
+}
+
+void test_encode_refuses_what_does_not_fit() {
+  CheckinRecord recs[2];
+  makeRecords(recs, 2, 1);
+  uint8_t frame[64];
+  TEST_ASSERT_EQUAL(0, encodeCheckinFrame(DEVICE_ID, 7, recs, 0, frame, sizeof(frame)));
+  TEST_ASSERT_EQUAL(0, encodeCheckinFrame(DEVICE_ID, 7, recs, 256, frame, sizeof(frame)));
+
+  size_t len = encodeCheckinFrame(DEVICE_ID, 7, recs, 2, frame, sizeof(frame));
+  TEST_ASSERT_EQUAL(0, encodeCheckinFrame(DEVICE_ID, 7, recs, 2, frame, len - 1));
+
+  recs[1].uidLen = 0;
+  TEST_ASSERT_EQUAL(0, encodeCheckinFrame(DEVICE_ID, 7, recs, 2, frame, sizeof(frame)));
+  recs[1].uidLen = CHECKIN_UID_MAX + 1;
+  TEST_ASSERT_EQUAL(0, encodeCheckinFrame(DEVICE_ID, 7, recs, 2, frame, sizeof(frame)));
+}
+
+// ==========================================
+// RESULT FRAMES
+// ==========================================
+
+// Items are matched by seq, as the JSON results are: out of order, and
+// items for records not sent are skipped
+void test_result_frame_matched_by_seq() {
+  CheckinRecord recs[3];
+  CheckinItemResult sent[3];
+  makeRecords(recs, 3, 10);
+  makeResults(sent, 3);
+
+  // The server answers 12, 10 and a seq this device never sent
+  CheckinRecord answered[3] = { recs[2], recs[0], recs[1] };
+  answered[2].seq = 99;
+  CheckinItemResult answers[3] = { sent[2], sent[0], sent[1] };
+  uint8_t frame[4 + 3 * CHECKIN_WIRE_ITEM_MAX];
+  size_t len = encodeResultFrame(answered, answers, 3, frame, sizeof(frame));
+  TEST_ASSERT_TRUE(len > 0);
+
+  CheckinItemResult out[3] = { { -1, "" }, { -1, "" }, { -1, "" } };
+  TEST_ASSERT_TRUE(decodeResultFrame(frame, len, recs, 3, out));
+  TEST_ASSERT_EQUAL(200, out[0].status);
+  TEST_ASSERT_EQUAL_STRING("Chandra", out[0].studentName);
+  TEST_ASSERT_EQUAL(-1, out[1].status);   // Retried
+  TEST_ASSERT_EQUAL(200, out[2].status);
+  TEST_ASSERT_EQUAL_STRING("Dana", out[2].studentName);
+}
+
+void test_malformed_result_frame_leaves_results_alone() {
+  CheckinRecord recs[2];
+  CheckinItemResult sent[2];
+  makeRecords(recs, 2, 10);
+  makeResults(sent, 2);
+  uint8_t frame[4 + 2 * CHECKIN_WIRE_ITEM_MAX];
+  size_t len = encodeResultFrame(recs, sent, 2, frame, sizeof(frame));
+
+  CheckinItemResult out[2] = { { -1, "" }, { -1, "" } };
+  TEST_ASSERT_FALSE(decodeResultFrame(frame, len - 1, recs, 2, out));
+  frame[0] = CHECKIN_WIRE_REQUEST;
+  TEST_ASSERT_FALSE(decodeResultFrame(frame, len, recs, 2, out));
+  TEST_ASSERT_EQUAL(-1, out[0].status);
+  TEST_ASSERT_EQUAL(-1, out[1].status);
+}
+
+// ==========================================
+// DAMAGED FRAMES
+// ==========================================
+
+#define FUZZ_ITERATIONS 20000
+
+static uint32_t fuzzRandom(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// Random records and results encode and decode back; the same frames
+// with bytes flipped, cut short or padded are either refused or decode to
+// something valid that encodes back to the same bytes
+void test_random_frames_round_trip_and_damage_is_caught() {
+  uint32_t rng = 0x9E3779B9u;
+  uint32_t failures = 0, accepted = 0;
+  CheckinRecord recs[CHECKIN_BATCH_MAX];
+  CheckinRecord decoded[CHECKIN_BATCH_MAX];
+  CheckinItemResult results[CHECKIN_BATCH_MAX];
+  CheckinItemResult out[CHECKIN_BATCH_MAX];
+  CheckinItemResult before[CHECKIN_BATCH_MAX];
+  uint8_t buf[JSON_BATCH_PAYLOAD_MAX];
+  char device[CHECKIN_WIRE_DEVICE_MAX + 1];
+
+  for (uint32_t it = 0; it < FUZZ_ITERATIONS; it++) {
+    size_t count = 1 + fuzzRandom(rng) % CHECKIN_BATCH_MAX;
+    char deviceId[CHECKIN_WIRE_DEVICE_MAX + 1];
+    size_t idLen = fuzzRandom(rng) % (CHECKIN_WIRE_DEVICE_MAX + 1);
+    for (size_t i = 0; i < idLen; i++) {
+      deviceId[i] = (char)('!' + fuzzRandom(rng) % 94);
+    }
+    deviceId[idLen] = '\0';
+    uint32_t handle = fuzzRandom(rng);
+    for (size_t i = 0; i < count; i++) {
+      memset(&recs[i], 0, sizeof(recs[i]));
+      recs[i].seq = fuzzRandom(rng);
+      recs[i].timestamp = fuzzRandom(rng);
+      recs[i].reader = (uint8_t)fuzzRandom(rng);
+      recs[i].uidLen = (uint8_t)(1 + fuzzRandom(rng) % CHECKIN_UID_MAX);
+      for (uint8_t b = 0; b < recs[i].uidLen; b++) {
+        recs[i].uid[b] = (uint8_t)fuzzRandom(rng);
+      }
+      results[i].status = (int)(fuzzRandom(rng) % 600);
+      size_t nameLen = fuzzRandom(rng) % (CHECKIN_NAME_MAX + 1);
+      for (size_t c = 0; c < nameLen; c++) {
+        results[i].studentName[c] = (char)(1 + fuzzRandom(rng) % 255);
+      }
+      results[i].studentName[nameLen] = '\0';
+    }
+
+    bool isResult = fuzzRandom(rng) & 1;
+    size_t len = isResult ? encodeResultFrame(recs, results, count, buf, sizeof(buf))
+                          : encodeCheckinFrame(deviceId, handle, recs, count, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(len > 0);
+    size_t got = 0;
+    uint32_t gotHandle = 0;
+    if (isResult) {
+      TEST_ASSERT_TRUE(decodeResultFrame(buf, len, recs, count, out));
+      for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(results[i].status, out[i].status);
+        TEST_ASSERT_EQUAL_STRING(results[i].studentName, out[i].studentName);
+      }
+    } else {
+      TEST_ASSERT_TRUE(decodeCheckinFrame(buf, len, device, gotHandle, decoded, CHECKIN_BATCH_MAX, got));
+      TEST_ASSERT_EQUAL(count, got);
+      TEST_ASSERT_EQUAL_UINT32(handle, gotHandle);
+      TEST_ASSERT_EQUAL_STRING(deviceId, device);
+      assertSameRecords(recs, decoded, count);
+    }
+
+    // Damage it, then decode from an exactly sized heap copy so any read
+    // past the end is an ASan error
+    uint32_t kind = fuzzRandom(rng) % 3;
+    size_t damagedLen = len;
+    if (kind == 0) {
+      for (uint32_t f = 1 + fuzzRandom(rng) % 4; f > 0; f--) {
+        buf[fuzzRandom(rng) % len] = (uint8_t)fuzzRandom(rng);
+      }
+    } else if (kind == 1) {
+      damagedLen = fuzzRandom(rng) % len;
+    } else {
+      size_t extra = 1 + fuzzRandom(rng) % 16;
+      for (size_t i = 0; i < extra && len + i < sizeof(buf); i++) {
+        buf[len + i] = (uint8_t)fuzzRandom(rng);
+      }
+      damagedLen = std::min(len + extra, sizeof(buf));
+    }
+    std::vector<uint8_t> damaged(buf, buf + damagedLen);
+
+    memcpy(before, results, sizeof(before));
+    memcpy(out, results, sizeof(out));
+    if (decodeResultFrame(damaged.data(), damaged.size(), recs, count, out)) {
+      accepted++;
+      for (size_t i = 0; i < count; i++) {
+        failures += strnlen(out[i].studentName, sizeof(out[i].studentName)) > CHECKIN_NAME_MAX;
+      }
+    } else {
+      failures += memcmp(out, before, sizeof(out)) != 0;
+    }
+    if (decodeCheckinFrame(damaged.data(), damaged.size(), device, gotHandle, decoded, CHECKIN_BATCH_MAX, got)) {
+      accepted++;
+      for (size_t i = 0; i < got; i++) {
+        failures += decoded[i].uidLen == 0 || decoded[i].uidLen > CHECKIN_UID_MAX;
+      }
+      // What decodes must encode back to the same bytes (ids without NULs)
+      if (strlen(device) == damaged[3]) {
+        size_t again = encodeCheckinFrame(device, gotHandle, decoded, got, buf, sizeof(buf));
+        failures += again != damaged.size() || memcmp(buf, damaged.data(), again) != 0;
+      }
+    }
+  }
+
+  char line[96];
+  snprintf(line, sizeof(line), "%u damaged frames, %u decodes accepted them", (unsigned)FUZZ_ITERATIONS,
+           (unsigned)accepted);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_UINT32(0, failures);
+}
+
+// ==========================================
+// AGAINST JSON
+// ==========================================
+
+// The bodies postCheckIn / postCheckInBatch would send, written with
+// snprintf: a lower bound on what serializeJson costs
+static size_t jsonSingle(const CheckinRecord& rec, char* out, size_t size) {
+  CardUidText uid = CardUid(rec.uid, rec.uidLen).text();
+  return (size_t)snprintf(out, size,
+                          "{\"uid\":\"%s\",\"eventId\":\"%s\",\"deviceId\":\"%s\",\"seq\":%u,\"door\":\"%s\",\"timestamp\":%u}",
+                          uid.c_str(), rec.eventId, DEVICE_ID, (unsigned)rec.seq, doorNames[rec.reader],
+                          (unsigned)rec.timestamp);
+}
+
+static size_t jsonBatch(const CheckinRecord* recs, size_t count, char* out, size_t size) {
+  size_t len = (size_t)snprintf(out, size, "{\"deviceId\":\"%s\",\"checkIns\":[", DEVICE_ID);
+  for (size_t i = 0; i < count && len < size; i++) {
+    CardUidText uid = CardUid(recs[i].uid, recs[i].uidLen).text();
+    len += (size_t)snprintf(out + len, size - len,
+                            "%s{\"uid\":\"%s\",\"eventId\":\"%s\",\"seq\":%u,\"door\":\"%s\",\"ts\":%u}",
+                            i ? "," : "", uid.c_str(), recs[i].eventId, (unsigned)recs[i].seq,
+                            doorNames[recs[i].reader], (unsigned)recs[i].timestamp);
+  }
+  len += (size_t)snprintf(out + len, len < size ? size - len : 0, "]}");
+  return len;
+}
+
+static size_t jsonResults(const CheckinRecord* recs, const CheckinItemResult* results, size_t count,
+                          char* out, size_t size) {
+  size_t len = (size_t)snprintf(out, size, "{\"results\":[");
+  for (size_t i = 0; i < count && len < size; i++) {
+    len += (size_t)snprintf(out + len, size - len, "%s{\"seq\":%u,\"status\":%d,\"studentName\":\"%s\"}",
+                            i ? "," : "", (unsigned)recs[i].seq, results[i].status, results[i].studentName);
+  }
+  len += (size_t)snprintf(out + len, len < size ? size - len : 0, "]}");
+  return len;
+}
+
+#define BENCH_ITERATIONS 20000
+
+template <typename F>
+static double nsPerCall(F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+    fn(i);
+  }
+  std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+  return took.count() / BENCH_ITERATIONS;
+}
+
+// Frames are several times smaller than the JSON both ways, at every
+// batch size
+void test_frames_are_smaller_than_json() {
+  static const size_t sizes[] = { 1, 4, CHECKIN_BATCH_MAX };
+  static CheckinRecord recs[CHECKIN_BATCH_MAX];
+  static CheckinItemResult results[CHECKIN_BATCH_MAX];
+  static char json[JSON_BATCH_PAYLOAD_MAX];
+  static uint8_t frame[JSON_BATCH_PAYLOAD_MAX];
+  static uint8_t resultFrame[4 + CHECKIN_BATCH_MAX * CHECKIN_WIRE_ITEM_MAX];
+  volatile size_t sink = 0;
+  char line[128];
+
+  for (size_t count : sizes) {
+    makeRecords(recs, count, 100);
+    makeResults(results, count);
+    size_t jsonLen = count == 1 ? jsonSingle(recs[0], json, sizeof(json)) : jsonBatch(recs, count, json, sizeof(json));
+    size_t frameLen = encodeCheckinFrame(DEVICE_ID, 7, recs, count, frame, sizeof(frame));
+    size_t jsonResultLen = jsonResults(recs, results, count, json, sizeof(json));
+    size_t resultLen = encodeResultFrame(recs, results, count, resultFrame, sizeof(resultFrame));
+
+    double jsonNs = nsPerCall([&](uint32_t i) {
+      recs[0].seq = i;
+      sink += count == 1 ? jsonSingle(recs[0], json, sizeof(json)) : jsonBatch(recs, count, json, sizeof(json));
+    });
+    double encNs = nsPerCall([&](uint32_t i) {
+      recs[0].seq = i;
+      sink += encodeCheckinFrame(DEVICE_ID, 7, recs, count, frame, sizeof(frame));
+    });
+    recs[0].seq = 100;
+    double decNs = nsPerCall([&](uint32_t) {
+      CheckinItemResult out[CHECKIN_BATCH_MAX];
+      sink += decodeResultFrame(resultFrame, resultLen, recs, count, out) ? out[0].status : 0;
+    });
+    snprintf(line, sizeof(line), "%2u check-ins: %4u JSON vs %3u frame bytes (results %4u vs %3u), "
+             "encode %.0f vs %.0f ns, result decode %.0f ns", (unsigned)count, (unsigned)jsonLen,
+             (unsigned)frameLen, (unsigned)jsonResultLen, (unsigned)resultLen, jsonNs, encNs, decNs);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_TRUE(frameLen > 0 && frameLen * 4 < jsonLen);
+    TEST_ASSERT_TRUE(resultLen > 0 && resultLen * 2 < jsonResultLen);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_one_tap_frame_layout);
+  RUN_TEST(test_check_in_frame_round_trip);
+  RUN_TEST(test_encode_refuses_what_does_not_fit);
+  RUN_TEST(test_result_frame_matched_by_seq);
+  RUN_TEST(test_malformed_result_frame_leaves_results_alone);
+  RUN_TEST(test_random_frames_round_trip_and_damage_is_caught);
+  RUN_TEST(test_frames_are_smaller_than_json);
+  return UNITY_END();
+}
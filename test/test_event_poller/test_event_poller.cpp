@@ -0,0 +1,236 @@
+// EventPoller (event_poller.h) against a mock /api/events/active with
+// ETags, over a scripted hour: 304s, a session change, a server outage, a
+// Wi-Fi drop, no active event and a staff refresh. Then a room of devices
+// powered on together, to see the polls spread out.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "config.h"
+#include "event_poller.h"
+
+#define STEP_MS 100
+#define MINUTE_MS 60000
+#define MOCK_EVENT_BODY 140         // Bytes of a 200 answer (event JSON + ETag)
+
+// Mock endpoint: event n (0 = none), or failing while down
+struct MockEventServer {
+  uint32_t event;
+  bool down;
+  bool linkUp;
+  uint32_t requests;
+  uint32_t full;            // 200 with a body
+  uint32_t bodyBytes;
+};
+
+static MockEventServer mockEvents;
+
+static void resetServer(uint32_t event) {
+  memset(&mockEvents, 0, sizeof(mockEvents));
+  mockEvents.event = event;
+  mockEvents.linkUp = true;
+}
+
+static EventFetchResult mockPollEvent(char* etag, size_t etagSize, ActiveEvent& event) {
+  mockEvents.requests++;
+  if (mockEvents.down) {
+    return EVENT_FETCH_FAILED;
+  }
+  if (mockEvents.event == 0) {
+    return EVENT_FETCH_NONE;
+  }
+  char current[16];
+  snprintf(current, sizeof(current), "\"ev%u\"", (unsigned)mockEvents.event);
+  if (strcmp(etag, current) == 0) {
+    return EVENT_FETCH_UNCHANGED;
+  }
+  snprintf(event.id, sizeof(event.id), "00000000-0000-0000-0000-%012u", (unsigned)mockEvents.event);
+  snprintf(event.name, sizeof(event.name), "Event %u", (unsigned)mockEvents.event);
+  event.handle = 0;
+  snprintf(etag, etagSize, "%s", current);
+  mockEvents.full++;
+  mockEvents.bodyBytes += MOCK_EVENT_BODY;
+  return EVENT_FETCH_CHANGED;
+}
+
+static bool mockEventLink() {
+  return mockEvents.linkUp;
+}
+
+// ==========================================
+// AN HOUR OF POLLING
+// ==========================================
+
+struct HourRun {
+  EventPollerStats stats;
+  std::vector<uint32_t> changeAt;
+  std::vector<uint32_t> changeTo;   // Event number of each change (0 = none)
+  std::vector<uint32_t> outageGaps; // Between polls while the server is down
+  uint32_t linkDownRequests;
+};
+
+static HourRun hour;
+
+// The script, run once for the whole section
+static void runHour() {
+  resetServer(1);
+  EventPoller poller(mockPollEvent, mockEventLink, 7);
+  std::vector<uint32_t> pollAt;
+  hour.linkDownRequests = 0;
+
+  for (uint32_t t = 0; t <= 60 * MINUTE_MS; t += STEP_MS) {
+    if (t == 10 * MINUTE_MS) mockEvents.event = 2;          // Session change
+    if (t == 20 * MINUTE_MS) mockEvents.down = true;        // Server fails
+    if (t == 22 * MINUTE_MS) mockEvents.down = false;
+    if (t == 25 * MINUTE_MS) mockEvents.linkUp = false;     // Wi-Fi gone
+    if (t == 26 * MINUTE_MS) mockEvents.linkUp = true;
+    if (t == 30 * MINUTE_MS) mockEvents.event = 0;          // Event over
+    if (t == 35 * MINUTE_MS) mockEvents.event = 3;
+    if (t == 45 * MINUTE_MS) poller.refresh();              // Staff / mode entry
+
+    uint32_t before = mockEvents.requests;
+    if (poller.runOnce(t)) {
+      pollAt.push_back(t);
+    }
+    if (!mockEvents.linkUp) {
+      hour.linkDownRequests += mockEvents.requests - before;
+    }
+
+    ActiveEvent event;
+    while (poller.takeChange(event)) {
+      hour.changeAt.push_back(t);
+      hour.changeTo.push_back(event.id[0] ? (uint32_t)strtoul(event.id + 24, NULL, 10) : 0);
+    }
+  }
+
+  for (size_t i = 1; i < pollAt.size(); i++) {
+    if (pollAt[i - 1] >= 20 * MINUTE_MS && pollAt[i] <= 22 * MINUTE_MS + EVENT_POLL_INTERVAL) {
+      hour.outageGaps.push_back(pollAt[i] - pollAt[i - 1]);
+    }
+  }
+  hour.stats = poller.stats();
+
+  char line[160];
+  snprintf(line, sizeof(line), "%u requests: %u x 304, %u x 200, %u failed; %u body bytes (%u without If-None-Match)",
+           (unsigned)hour.stats.polls, (unsigned)hour.stats.notModified, (unsigned)mockEvents.full,
+           (unsigned)hour.stats.failures, (unsigned)mockEvents.bodyBytes,
+           (unsigned)(mockEvents.requests * MOCK_EVENT_BODY));
+  TEST_MESSAGE(line);
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Fetched on the first pass, before anyone presses a button
+void test_event_prefetched_on_the_first_pass() {
+  TEST_ASSERT_TRUE(hour.changeAt.size() >= 1);
+  TEST_ASSERT_EQUAL_UINT32(0, hour.changeAt[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, hour.changeTo[0]);
+}
+
+// One change per new event, one when the server has none, plus the
+// refresh
+void test_one_change_per_event_plus_the_refresh() {
+  TEST_ASSERT_EQUAL_UINT32(5, hour.changeAt.size());
+  TEST_ASSERT_EQUAL_UINT32(2, hour.changeTo[1]);
+  TEST_ASSERT_EQUAL_UINT32(0, hour.changeTo[2]);
+  TEST_ASSERT_EQUAL_UINT32(3, hour.changeTo[3]);
+  TEST_ASSERT_EQUAL_UINT32(3, hour.changeTo[4]);
+}
+
+// The event ending is reported once, within the interval, so the device
+// stops taking check-ins for it; polls that keep finding none are quiet
+void test_no_active_event_reported_once() {
+  uint32_t endedAt = hour.changeAt[2];
+  TEST_ASSERT_TRUE(endedAt >= 30 * MINUTE_MS);
+  TEST_ASSERT_TRUE(endedAt - 30 * MINUTE_MS <= EVENT_POLL_INTERVAL * 5 / 4);
+  TEST_ASSERT_TRUE(hour.changeAt[3] >= 35 * MINUTE_MS);
+}
+
+void test_session_change_seen_within_the_interval() {
+  uint32_t switchedAt = hour.changeAt[1];
+  TEST_ASSERT_TRUE(switchedAt >= 10 * MINUTE_MS);
+  TEST_ASSERT_TRUE(switchedAt - 10 * MINUTE_MS <= EVENT_POLL_INTERVAL * 5 / 4);
+}
+
+// refresh() polls at once and queues the event even though it is unchanged
+void test_refresh_polls_at_once() {
+  uint32_t refreshedAt = hour.changeAt[4];
+  TEST_ASSERT_TRUE(refreshedAt >= 45 * MINUTE_MS);
+  TEST_ASSERT_TRUE(refreshedAt <= 45 * MINUTE_MS + STEP_MS);
+}
+
+// Retries start at EVENT_POLL_RETRY and double, capped at the interval
+void test_outage_retries_back_off() {
+  TEST_ASSERT_TRUE(hour.outageGaps.size() >= 3);
+  TEST_ASSERT_EQUAL_UINT32(EVENT_POLL_RETRY, hour.outageGaps[0]);
+  for (size_t i = 1; i < hour.outageGaps.size(); i++) {
+    TEST_ASSERT_TRUE(hour.outageGaps[i] >= hour.outageGaps[i - 1]);
+    TEST_ASSERT_TRUE(hour.outageGaps[i] <= EVENT_POLL_INTERVAL);
+  }
+}
+
+void test_no_requests_while_the_link_is_down() {
+  TEST_ASSERT_EQUAL_UINT32(0, hour.linkDownRequests);
+}
+
+// Conditional requests: most polls cost a 304 and no body
+void test_most_polls_answered_304() {
+  TEST_ASSERT_TRUE(hour.stats.notModified * 10 >= hour.stats.polls * 8);
+  TEST_ASSERT_EQUAL_UINT32(4, mockEvents.full);
+}
+
+// ==========================================
+// A ROOM OF DEVICES
+// ==========================================
+
+// 50 devices powered on together all poll in the first second; after the
+// first interval the +-25% jitter has spread them out
+void test_fleet_polls_spread_out() {
+  const uint32_t devices = 50;
+  std::vector<EventPoller*> fleet;
+  for (uint32_t i = 0; i < devices; i++) {
+    fleet.push_back(new EventPoller(mockPollEvent, mockEventLink, 1000 + i * 7919));
+  }
+  resetServer(1);
+  std::vector<uint32_t> perSecond(600, 0);
+  for (uint32_t t = 0; t < 10 * MINUTE_MS; t += STEP_MS) {
+    for (EventPoller* p : fleet) {
+      if (p->runOnce(t)) {
+        perSecond[t / 1000]++;
+      }
+    }
+  }
+  for (EventPoller* p : fleet) {
+    delete p;
+  }
+  uint32_t peak = 0;
+  for (uint32_t s = 60; s < perSecond.size(); s++) {
+    peak = std::max(peak, perSecond[s]);
+  }
+
+  char line[128];
+  snprintf(line, sizeof(line), "%u devices: %u polls in the first second, then at most %u/s (%u requests in 10 min)",
+           (unsigned)devices, (unsigned)perSecond[0], (unsigned)peak, (unsigned)mockEvents.requests);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_UINT32(devices, perSecond[0]);
+  TEST_ASSERT_TRUE(peak <= devices / 5);
+}
+
+int main() {
+  UNITY_BEGIN();
+  runHour();
+  RUN_TEST(test_event_prefetched_on_the_first_pass);
+  RUN_TEST(test_one_change_per_event_plus_the_refresh);
+  RUN_TEST(test_session_change_seen_within_the_interval);
+  RUN_TEST(test_no_active_event_reported_once);
+  RUN_TEST(test_refresh_polls_at_once);
+  RUN_TEST(test_outage_retries_back_off);
+  RUN_TEST(test_no_requests_while_the_link_is_down);
+  RUN_TEST(test_most_polls_answered_304);
+  RUN_TEST(test_fleet_polls_spread_out);
+  return UNITY_END();
+}
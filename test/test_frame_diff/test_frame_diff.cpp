@@ -0,0 +1,162 @@
+// diffFrame() and the I2C cost model (frame_diff.h), then the real screen
+// transitions of a check-in rasterized (test/fakes/raster_display.h) and
+// diffed the way OledRenderer sends them, against Adafruit display():
+// the whole frame at its default 400 kHz.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "frame_diff.h"
+#include "screens.h"
+#include "../fakes/raster_display.h"
+
+static uint8_t frame[FRAME_BYTES];
+static uint8_t shadow[FRAME_BYTES];
+
+void setUp() {
+  memset(frame, 0, sizeof(frame));
+  memset(shadow, 0, sizeof(shadow));
+}
+void tearDown() {}
+
+// ==========================================
+// DIFF
+// ==========================================
+
+void test_unchanged_frame_sends_nothing() {
+  DirtySpan spans[FRAME_PAGES];
+  TEST_ASSERT_EQUAL_UINT8(0, diffFrame(frame, shadow, spans));
+  TEST_ASSERT_EQUAL(0, spanDataBytes(spans, 0));
+  TEST_ASSERT_EQUAL(0, spanWireBytes(spans, 0));
+}
+
+void test_span_covers_first_to_last_change_per_page() {
+  DirtySpan spans[FRAME_PAGES];
+  frame[0 * FRAME_COLUMNS + 5] = 0x01;
+  frame[3 * FRAME_COLUMNS + 10] = 0xFF;
+  frame[3 * FRAME_COLUMNS + 90] = 0x80;
+  frame[7 * FRAME_COLUMNS + 127] = 0x10;
+
+  uint8_t count = diffFrame(frame, shadow, spans);
+  TEST_ASSERT_EQUAL_UINT8(3, count);
+  TEST_ASSERT_EQUAL_UINT8(0, spans[0].page);
+  TEST_ASSERT_EQUAL_UINT8(5, spans[0].first);
+  TEST_ASSERT_EQUAL_UINT8(5, spans[0].last);
+  TEST_ASSERT_EQUAL_UINT8(3, spans[1].page);
+  TEST_ASSERT_EQUAL_UINT8(10, spans[1].first);
+  TEST_ASSERT_EQUAL_UINT8(90, spans[1].last);
+  TEST_ASSERT_EQUAL_UINT8(7, spans[2].page);
+  TEST_ASSERT_EQUAL_UINT8(127, spans[2].first);
+  TEST_ASSERT_EQUAL_UINT8(127, spans[2].last);
+  TEST_ASSERT_EQUAL(1 + 81 + 1, spanDataBytes(spans, count));
+}
+
+// The shadow follows the panel: the same frame again sends nothing
+void test_shadow_matches_the_panel_after_a_diff() {
+  DirtySpan spans[FRAME_PAGES];
+  for (size_t i = 0; i < FRAME_BYTES; i += 7) {
+    frame[i] = (uint8_t)i;
+  }
+  TEST_ASSERT_EQUAL_UINT8(FRAME_PAGES, diffFrame(frame, shadow, spans));
+  TEST_ASSERT_EQUAL_MEMORY(frame, shadow, FRAME_BYTES);
+  TEST_ASSERT_EQUAL_UINT8(0, diffFrame(frame, shadow, spans));
+}
+
+// ==========================================
+// WIRE COST
+// ==========================================
+
+void test_wire_bytes_and_time() {
+  // 1024 data bytes in 127-byte writes (9), each with address + control,
+  // plus the window commands
+  TEST_ASSERT_EQUAL(2 + 6 + FRAME_BYTES + 9 * 2, fullFrameWireBytes());
+  TEST_ASSERT_EQUAL_UINT32(23625, wireTimeUs(fullFrameWireBytes(), 400000));
+
+  DirtySpan one = { 2, 40, 40 };
+  TEST_ASSERT_EQUAL(2 + 6 + 1 + 2, spanWireBytes(&one, 1));
+  DirtySpan page = { 2, 0, FRAME_COLUMNS - 1 };
+  TEST_ASSERT_EQUAL(2 + 6 + FRAME_COLUMNS + 2 * 2, spanWireBytes(&page, 1));
+}
+
+// ==========================================
+// SCREEN TRANSITIONS
+// ==========================================
+
+typedef void (*BenchScreen)(HalDisplay& d);
+
+static void benchReady(HalDisplay& d) { displayAttendanceReady(d, "Demo Event"); }
+static void benchCheckingIn(HalDisplay& d) { displayCheckingIn(d, CardUid::parse("04:11:22:33")); }
+static void benchWelcome(HalDisplay& d) { displayWelcome(d, "Chandra"); }
+static void benchWelcomeNext(HalDisplay& d) { displayWelcome(d, "Dana"); }
+static void benchError(HalDisplay& d) { displayAttendanceError(d, "Already checked in"); }
+static void benchOffline(HalDisplay& d) { displaySavedOffline(d, 3); }
+static void benchOfflineNext(HalDisplay& d) { displaySavedOffline(d, 4); }
+static void benchRegReady(HalDisplay& d) { displayReady(d); }
+static void benchSending(HalDisplay& d) { displaySending(d, CardUid::parse("04:11:22:33")); }
+
+struct BenchStep {
+  const char* name;
+  BenchScreen from;
+  BenchScreen to;
+  bool sameLayout;   // Only a value changes (name, count)
+};
+
+static const BenchStep benchSteps[] = {
+  { "ready -> checking-in", benchReady, benchCheckingIn, false },
+  { "checking-in -> welcome", benchCheckingIn, benchWelcome, false },
+  { "welcome -> welcome", benchWelcome, benchWelcomeNext, true },
+  { "welcome -> ready", benchWelcome, benchReady, false },
+  { "ready -> welcome", benchReady, benchWelcome, false },
+  { "ready -> error", benchReady, benchError, false },
+  { "error -> ready", benchError, benchReady, false },
+  { "ready -> saved offline", benchReady, benchOffline, false },
+  { "offline -> offline", benchOffline, benchOfflineNext, true },
+  { "reg ready -> sending", benchRegReady, benchSending, false },
+};
+
+void test_screen_transitions_send_less_than_a_frame() {
+  static RasterDisplay raster;
+  DirtySpan spans[FRAME_PAGES];
+  size_t full = fullFrameWireBytes();
+  char line[128];
+  snprintf(line, sizeof(line), "full frame: %u bytes on the wire, %u us at 400 kHz", (unsigned)full,
+           (unsigned)wireTimeUs(full, 400000));
+  TEST_MESSAGE(line);
+
+  size_t totalWire = 0;
+  for (const BenchStep& step : benchSteps) {
+    // The panel shows 'from'; only what 'to' changes goes out
+    step.from(raster);
+    memcpy(shadow, raster.buffer(), FRAME_BYTES);
+    step.to(raster);
+    uint8_t count = diffFrame(raster.buffer(), shadow, spans);
+    size_t wire = spanWireBytes(spans, count);
+    totalWire += wire;
+    snprintf(line, sizeof(line), "%-24s %u pages, %4u data, %4u wire bytes: %5u us at 400k, %5u us at %u Hz",
+             step.name, (unsigned)count, (unsigned)spanDataBytes(spans, count), (unsigned)wire,
+             (unsigned)wireTimeUs(wire, 400000), (unsigned)wireTimeUs(wire, OLED_I2C_CLOCK),
+             (unsigned)OLED_I2C_CLOCK);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_GREATER_THAN_UINT32(0, count);
+    TEST_ASSERT_LESS_THAN(full, wire);
+    if (step.sameLayout) {
+      // A new name or count on the same screen is a page or two
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(2, count);
+      TEST_ASSERT_LESS_THAN(full / 4, wire);
+    }
+  }
+  // Over a check-in's screens, under half of what full frames cost
+  TEST_ASSERT_LESS_THAN(full * (sizeof(benchSteps) / sizeof(benchSteps[0])) / 2, totalWire);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_unchanged_frame_sends_nothing);
+  RUN_TEST(test_span_covers_first_to_last_change_per_page);
+  RUN_TEST(test_shadow_matches_the_panel_after_a_diff);
+  RUN_TEST(test_wire_bytes_and_time);
+  RUN_TEST(test_screen_transitions_send_less_than_a_frame);
+  return UNITY_END();
+}
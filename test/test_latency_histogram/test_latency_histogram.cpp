@@ -0,0 +1,155 @@
+// LatencyHistogram (latency_histogram.h): which bucket a sample lands in,
+// the percentile estimate (linear within a bucket, clamped to the largest
+// sample, the largest sample for the overflow bucket) and recording from
+// two tasks at once.
+
+#include <unity.h>
+#include <thread>
+#include "latency_histogram.h"
+
+#define THREAD_SAMPLES 100000
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// BUCKETS
+// ==========================================
+
+void test_empty_histogram_reports_zero() {
+  LatencyHistogram h;
+  TEST_ASSERT_EQUAL_UINT32(0, h.count());
+  TEST_ASSERT_EQUAL_UINT32(0, h.maxUs());
+  TEST_ASSERT_EQUAL_UINT32(0, h.percentileUs(0.0f));
+  TEST_ASSERT_EQUAL_UINT32(0, h.percentileUs(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(0, h.percentileUs(1.0f));
+  for (size_t i = 0; i <= LATENCY_BUCKETS; i++) {
+    TEST_ASSERT_EQUAL_UINT32(0, h.bucketCount(i));
+  }
+}
+
+void test_bounds_are_inclusive() {
+  LatencyHistogram h;
+  h.record(0);
+  h.record(50);
+  h.record(51);
+  h.record(10000000);
+  h.record(10000001);
+  TEST_ASSERT_EQUAL_UINT32(2, h.bucketCount(0));
+  TEST_ASSERT_EQUAL_UINT32(1, h.bucketCount(1));
+  TEST_ASSERT_EQUAL_UINT32(1, h.bucketCount(LATENCY_BUCKETS - 1));
+  TEST_ASSERT_EQUAL_UINT32(1, h.bucketCount(LATENCY_BUCKETS));
+  TEST_ASSERT_EQUAL_UINT32(5, h.count());
+  TEST_ASSERT_TRUE(h.sumUs() == 20000102ull);
+  TEST_ASSERT_EQUAL_UINT32(10000001, h.maxUs());
+  TEST_ASSERT_EQUAL_UINT32(10000000, LatencyHistogram::bucketBoundUs(LATENCY_BUCKETS - 1));
+}
+
+void test_reset_clears_everything() {
+  LatencyHistogram h;
+  h.record(700);
+  h.record(20000000);
+  h.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, h.count());
+  TEST_ASSERT_TRUE(h.sumUs() == 0);
+  TEST_ASSERT_EQUAL_UINT32(0, h.maxUs());
+  TEST_ASSERT_EQUAL_UINT32(0, h.bucketCount(5));
+  TEST_ASSERT_EQUAL_UINT32(0, h.bucketCount(LATENCY_BUCKETS));
+  TEST_ASSERT_EQUAL_UINT32(0, h.percentileUs(0.5f));
+}
+
+// ==========================================
+// PERCENTILES
+// ==========================================
+
+// All samples in (50, 100]; the largest is the bucket bound, so no clamp
+void test_single_bucket_interpolates_linearly() {
+  LatencyHistogram h;
+  h.record(60);
+  h.record(70);
+  h.record(80);
+  h.record(100);
+  TEST_ASSERT_EQUAL_UINT32(50, h.percentileUs(0.0f));
+  TEST_ASSERT_EQUAL_UINT32(62, h.percentileUs(0.25f));
+  TEST_ASSERT_EQUAL_UINT32(75, h.percentileUs(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(100, h.percentileUs(1.0f));
+}
+
+// Samples in (500, 1000] that never reach 1000: the estimate stops at
+// the largest one instead of the bucket bound
+void test_estimate_is_clamped_to_max() {
+  LatencyHistogram h;
+  h.record(550);
+  h.record(600);
+  h.record(600);
+  h.record(600);
+  TEST_ASSERT_EQUAL_UINT32(600, h.maxUs());
+  TEST_ASSERT_EQUAL_UINT32(550, h.percentileUs(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(600, h.percentileUs(1.0f));
+  TEST_ASSERT_EQUAL_UINT32(599, h.percentileUs(0.99f));
+
+  // Only zeros: the bucket [0, 50] clamps to 0
+  LatencyHistogram zeros;
+  zeros.record(0);
+  zeros.record(0);
+  TEST_ASSERT_EQUAL_UINT32(0, zeros.percentileUs(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(0, zeros.percentileUs(1.0f));
+}
+
+// Past the last bound there is nothing to interpolate to: the largest sample
+void test_overflow_bucket_reports_max() {
+  LatencyHistogram h;
+  h.record(15000000);
+  h.record(20000000);
+  TEST_ASSERT_EQUAL_UINT32(2, h.bucketCount(LATENCY_BUCKETS));
+  TEST_ASSERT_EQUAL_UINT32(20000000, h.percentileUs(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(20000000, h.percentileUs(1.0f));
+
+  // Nine taps at 1 ms and one stuck for 12 s: the median interpolates in
+  // (500, 1000], the tail is the stuck one
+  LatencyHistogram mixed;
+  for (int i = 0; i < 9; i++) {
+    mixed.record(1000);
+  }
+  mixed.record(12000000);
+  TEST_ASSERT_EQUAL_UINT32(777, mixed.percentileUs(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(1000, mixed.percentileUs(0.9f));
+  TEST_ASSERT_EQUAL_UINT32(12000000, mixed.percentileUs(0.95f));
+  TEST_ASSERT_EQUAL_UINT32(12000000, mixed.percentileUs(1.5f));
+}
+
+// ==========================================
+// CONCURRENCY
+// ==========================================
+
+// The loop and network tasks record into the same histogram
+void test_two_tasks_record_without_losing_samples() {
+  LatencyHistogram h;
+  std::thread other([&h]() {
+    for (uint32_t i = 0; i < THREAD_SAMPLES; i++) {
+      h.record(200);
+    }
+  });
+  for (uint32_t i = 0; i < THREAD_SAMPLES; i++) {
+    h.record(i == THREAD_SAMPLES / 2 ? 3000000 : 2000);
+  }
+  other.join();
+
+  TEST_ASSERT_EQUAL_UINT32(2 * THREAD_SAMPLES, h.count());
+  TEST_ASSERT_EQUAL_UINT32(THREAD_SAMPLES, h.bucketCount(2));
+  TEST_ASSERT_EQUAL_UINT32(THREAD_SAMPLES - 1, h.bucketCount(5));
+  TEST_ASSERT_TRUE(h.sumUs() == 200ull * THREAD_SAMPLES + 2000ull * (THREAD_SAMPLES - 1) + 3000000);
+  TEST_ASSERT_EQUAL_UINT32(3000000, h.maxUs());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_histogram_reports_zero);
+  RUN_TEST(test_bounds_are_inclusive);
+  RUN_TEST(test_reset_clears_everything);
+  RUN_TEST(test_single_bucket_interpolates_linearly);
+  RUN_TEST(test_estimate_is_clamped_to_max);
+  RUN_TEST(test_overflow_bucket_reports_max);
+  RUN_TEST(test_two_tasks_record_without_losing_samples);
+  return UNITY_END();
+}
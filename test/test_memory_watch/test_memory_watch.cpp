@@ -0,0 +1,725 @@
+// MemoryWatch (memory_watch.h): the level against the TLS thresholds on
+// a fixed probe, with the recovery margin and an open session, and its
+// counters written from two threads. Then an event day on a simulated
+// first-fit heap (String churn, roster syncs, TLS reconnects), once with
+// the watch only observing and once with the firmware acting on its
+// level: a roster sync stopped once the heap runs short, tag accounting,
+// the warning coming ahead of the first failed handshake, and fewer of
+// them.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <vector>
+#include "config.h"
+#include "roster.h"
+#include "memory_watch.h"
+
+// Heap as set by the test
+class FixedProbe : public MemoryProbe {
+public:
+  FixedProbe() : freeBytes(0), largest(0) {}
+  void set(uint32_t free, uint32_t block) {
+    freeBytes = free;
+    largest = block;
+  }
+  uint32_t freeHeap() override { return freeBytes; }
+  uint32_t largestBlock() override { return largest; }
+  uint32_t minFreeHeap() override { return freeBytes; }
+  bool stack(MemTask, uint32_t&, uint32_t&) override { return false; }
+
+private:
+  uint32_t freeBytes;
+  uint32_t largest;
+};
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// LEVEL
+// ==========================================
+
+void test_level_follows_the_tls_thresholds() {
+  FixedProbe probe;
+  MemoryWatch watch(probe, MEM_TLS_BLOCK, MEM_TLS_HEAP);
+  probe.set(MEM_TLS_HEAP + MEM_LOW_MARGIN, MEM_TLS_BLOCK + MEM_LOW_MARGIN);
+  TEST_ASSERT_FALSE(watch.update(1000));
+  TEST_ASSERT_EQUAL(MEMORY_OK, watch.level());
+
+  // Enough free heap, but not in one piece
+  probe.set(MEM_TLS_HEAP + MEM_LOW_MARGIN, MEM_TLS_BLOCK + MEM_LOW_MARGIN - 1);
+  TEST_ASSERT_TRUE(watch.update(2000));
+  TEST_ASSERT_EQUAL(MEMORY_LOW, watch.level());
+  TEST_ASSERT_TRUE(watch.tlsFits());
+
+  probe.set(MEM_TLS_HEAP + MEM_LOW_MARGIN, MEM_TLS_BLOCK - 1);
+  TEST_ASSERT_TRUE(watch.update(3000));
+  TEST_ASSERT_EQUAL(MEMORY_CRITICAL, watch.level());
+  TEST_ASSERT_FALSE(watch.tlsFits());
+
+  MemoryStats st = watch.stats();
+  TEST_ASSERT_EQUAL_UINT32(3, st.samples);
+  TEST_ASSERT_EQUAL_UINT32(1, st.lowEntered);
+  TEST_ASSERT_EQUAL_UINT32(1, st.criticalEntered);
+  TEST_ASSERT_EQUAL_UINT32(1, st.tlsRefused);
+  TEST_ASSERT_EQUAL_UINT32(1000, st.degradedMs);
+}
+
+// A level is left only once the heap is MEM_RECOVER_MARGIN clear of it
+void test_level_recovers_with_a_margin() {
+  FixedProbe probe;
+  MemoryWatch watch(probe, MEM_TLS_BLOCK, MEM_TLS_HEAP);
+  uint32_t okBlock = MEM_TLS_BLOCK + MEM_LOW_MARGIN;
+  probe.set(MEM_TLS_HEAP + MEM_LOW_MARGIN, okBlock - 1);
+  watch.update(0);
+  TEST_ASSERT_EQUAL(MEMORY_LOW, watch.level());
+
+  probe.set(MEM_TLS_HEAP + MEM_LOW_MARGIN + MEM_RECOVER_MARGIN, okBlock);
+  TEST_ASSERT_FALSE(watch.update(1000));
+  TEST_ASSERT_EQUAL(MEMORY_LOW, watch.level());
+
+  probe.set(MEM_TLS_HEAP + MEM_LOW_MARGIN + MEM_RECOVER_MARGIN, okBlock + MEM_RECOVER_MARGIN);
+  TEST_ASSERT_TRUE(watch.update(2000));
+  TEST_ASSERT_EQUAL(MEMORY_OK, watch.level());
+}
+
+// An open session's heap counts as free for the next handshake
+void test_open_session_counts_as_free() {
+  FixedProbe probe;
+  MemoryWatch watch(probe, MEM_TLS_BLOCK, MEM_TLS_HEAP);
+  probe.set(MEM_TLS_HEAP / 2, MEM_TLS_BLOCK + MEM_LOW_MARGIN + MEM_RECOVER_MARGIN);
+  watch.update(0);
+  TEST_ASSERT_EQUAL(MEMORY_CRITICAL, watch.level());
+
+  watch.tlsOpened(MEM_TLS_HEAP);
+  watch.update(1000);
+  TEST_ASSERT_EQUAL(MEMORY_OK, watch.level());
+  TEST_ASSERT_EQUAL_UINT32(MEM_TLS_HEAP, watch.stats().tlsLastBytes);
+
+  watch.tlsClosed();
+  watch.update(2000);
+  TEST_ASSERT_EQUAL(MEMORY_CRITICAL, watch.level());
+}
+
+// The network task counts refusals and handshakes while the loop task
+// samples; neither loses a count
+void test_counters_from_two_tasks() {
+  const uint32_t rounds = 20000;
+  FixedProbe probe;
+  MemoryWatch watch(probe, MEM_TLS_BLOCK, MEM_TLS_HEAP);
+  probe.set(MEM_TLS_HEAP, MEM_TLS_BLOCK - 1);
+  std::thread net([&] {
+    for (uint32_t i = 0; i < rounds; i++) {
+      watch.tlsFits();
+      watch.tlsOpened((int32_t)(i % 100 + 1));
+    }
+  });
+  for (uint32_t i = 0; i < rounds; i++) {
+    watch.update(i);
+    watch.stats();
+  }
+  net.join();
+
+  MemoryStats st = watch.stats();
+  TEST_ASSERT_EQUAL_UINT32(rounds, st.samples);
+  TEST_ASSERT_EQUAL_UINT32(rounds, st.tlsRefused);
+  TEST_ASSERT_EQUAL_UINT32(rounds, st.tlsOpened);
+  TEST_ASSERT_EQUAL_UINT32(100, st.tlsMaxBytes);
+}
+
+// ==========================================
+// AN EVENT DAY
+// ==========================================
+
+#define SIM_HEAP_SIZE (120 * 1024)  // Internal heap left once the core, Wi-Fi and lwIP are up
+#define SIM_HEAP_HEADER 8           // Per block
+#define SIM_TLS_CTX 1800            // mbedTLS context, config, session
+#define SIM_TLS_IN 16717            // Record buffers: 16 KB + overhead in, 4 KB out
+#define SIM_TLS_OUT 4429
+#define SIM_TLS_TEMP 10500          // Handshake only: peer certificate chain, key exchange
+#define SIM_TLS_TEMP2 6000
+#define SIM_PBUF 1600               // Received segment
+#define SIM_STICKY_MEAN 3600        // Mean lifetime of those (s)
+#define SIM_KEEPALIVE_MAX 300       // Server closes a kept-alive connection after (s)
+#define SIM_SCRAPE_INTERVAL 15      // /metrics scrapes (s)
+#define SIM_DAY_HOURS 10
+
+// First-fit heap with coalescing, as multi_heap in ESP-IDF 4.4 (the
+// Arduino 2.x core). Free bytes count whole blocks, headers included.
+class SimHeap {
+public:
+  explicit SimHeap(uint32_t size) : freeTotal(size), lowest(size) {
+    freeBlocks[0] = size;
+  }
+
+  int32_t alloc(uint32_t bytes) {
+    uint32_t need = blockSize(bytes);
+    for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+      if (it->second < need) {
+        continue;
+      }
+      uint32_t at = it->first;
+      uint32_t left = it->second - need;
+      freeBlocks.erase(it);
+      if (left >= 16) {
+        freeBlocks[at + need] = left;
+      } else {
+        need += left;
+      }
+      live[at] = need;
+      freeTotal -= need;
+      lowest = std::min(lowest, freeTotal);
+      return (int32_t)at;
+    }
+    return -1;
+  }
+
+  void release(int32_t at) {
+    auto it = live.find((uint32_t)at);
+    if (it == live.end()) {
+      return;
+    }
+    uint32_t start = it->first;
+    uint32_t size = it->second;
+    live.erase(it);
+    freeTotal += size;
+    auto next = freeBlocks.find(start + size);
+    if (next != freeBlocks.end()) {
+      size += next->second;
+      freeBlocks.erase(next);
+    }
+    auto prev = freeBlocks.lower_bound(start);
+    if (prev != freeBlocks.begin()) {
+      --prev;
+      if (prev->first + prev->second == start) {
+        prev->second += size;
+        return;
+      }
+    }
+    freeBlocks[start] = size;
+  }
+
+  // realloc: in place when shrinking or when the next block is free and
+  // big enough, else allocate, copy and free. -1 (old block kept) if no
+  // room.
+  int32_t resize(int32_t at, uint32_t bytes) {
+    if (at < 0) {
+      return alloc(bytes);
+    }
+    uint32_t need = blockSize(bytes);
+    uint32_t& size = live[(uint32_t)at];
+    if (need + 16 <= size) {
+      uint32_t spare = size - need;
+      size = need;
+      live[(uint32_t)at + need] = spare;
+      release(at + (int32_t)need);
+      return at;
+    }
+    if (need <= size) {
+      return at;
+    }
+    auto next = freeBlocks.find((uint32_t)at + size);
+    if (next != freeBlocks.end() && size + next->second >= need) {
+      uint32_t grow = need - size;
+      uint32_t left = next->second - grow;
+      freeBlocks.erase(next);
+      if (left >= 16) {
+        freeBlocks[(uint32_t)at + need] = left;
+      } else {
+        grow += left;
+      }
+      size += grow;
+      freeTotal -= grow;
+      lowest = std::min(lowest, freeTotal);
+      return at;
+    }
+    int32_t moved = alloc(bytes);
+    if (moved >= 0) {
+      release(at);
+    }
+    return moved;
+  }
+
+  uint32_t sizeOf(int32_t at) const {
+    auto it = live.find((uint32_t)at);
+    return it == live.end() ? 0 : it->second;
+  }
+  uint32_t freeBytes() const { return freeTotal; }
+  uint32_t minFree() const { return lowest; }
+  uint32_t largestFree() const {
+    uint32_t largest = 0;
+    for (const auto& b : freeBlocks) {
+      largest = std::max(largest, b.second);
+    }
+    return largest > SIM_HEAP_HEADER ? largest - SIM_HEAP_HEADER : 0;
+  }
+
+private:
+  static uint32_t blockSize(uint32_t bytes) { return ((bytes + 3) & ~3u) + SIM_HEAP_HEADER; }
+
+  std::map<uint32_t, uint32_t> freeBlocks;  // Offset -> size
+  std::map<uint32_t, uint32_t> live;
+  uint32_t freeTotal;
+  uint32_t lowest;
+};
+
+class SimMemoryProbe : public MemoryProbe {
+public:
+  explicit SimMemoryProbe(SimHeap& heap) : heap(heap) {}
+  uint32_t freeHeap() override { return heap.freeBytes(); }
+  uint32_t largestBlock() override { return heap.largestFree(); }
+  uint32_t minFreeHeap() override { return heap.minFree(); }
+  bool stack(MemTask, uint32_t&, uint32_t&) override { return false; }   // No tasks on the host
+
+private:
+  SimHeap& heap;
+};
+
+// One event day on the simulated heap: check-in requests and event polls
+// over a kept-alive TLS connection the server closes every few minutes,
+// String churn around each request (a few blocks of which stay for an
+// hour), roster syncs on every event switch and delta syncs in between.
+// With acting = false the watch only observes (the firmware before it).
+struct MemDay {
+  SimHeap heap;
+  SimMemoryProbe probe;
+  MemoryWatch watch;
+  bool acting;
+  uint32_t stickyPerMille;      // Small blocks that stay for a long while
+  uint32_t rng;
+
+  std::vector<std::pair<int32_t, uint32_t>> sticky;   // Block, until (s)
+  int32_t tls[3];               // Context, in, out (-1 = no session)
+  uint32_t tlsOpenedAt;
+  uint32_t retryAt;
+  uint32_t retryWait;
+  int32_t rosterEntries;
+  int32_t rosterNames;
+  uint32_t rosterCap, rosterCount, namesCap, namesUsed;
+  bool rosterPending;          // Deferred sync: full, or pendingAdds
+  bool pendingFull;
+  uint32_t pendingAdds;
+  uint32_t truth[MEM_TAG_COUNT];
+
+  uint32_t requests, waiting, backlogS, handshakes, failed, refused;
+  uint32_t linesShed, syncs, syncsDeferred, syncsStopped, syncsFailed;
+  uint32_t firstLowS, firstFailS, firstRefusedS;
+  uint32_t minLargest;
+
+  MemDay(bool acting, uint32_t stickyPerMille)
+    : heap(SIM_HEAP_SIZE), probe(heap), watch(probe, MEM_TLS_BLOCK, MEM_TLS_HEAP), acting(acting),
+      stickyPerMille(stickyPerMille), rng(0x5EED), tlsOpenedAt(0), retryAt(0), retryWait(0), rosterEntries(-1), rosterNames(-1),
+      rosterCap(0), rosterCount(0), namesCap(0), namesUsed(0), rosterPending(false), pendingFull(false), pendingAdds(0), requests(0),
+      waiting(0), backlogS(0), handshakes(0), failed(0), refused(0), linesShed(0), syncs(0),
+      syncsDeferred(0), syncsStopped(0), syncsFailed(0), firstLowS(UINT32_MAX), firstFailS(UINT32_MAX),
+      firstRefusedS(UINT32_MAX), minLargest(UINT32_MAX) {
+    tls[0] = tls[1] = tls[2] = -1;
+    memset(truth, 0, sizeof(truth));
+  }
+
+  uint32_t nextRandom() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  }
+
+  int32_t tagged(MemTag tag, uint32_t bytes) {
+    int32_t at = heap.alloc(bytes);
+    if (at >= 0) {
+      truth[tag] += heap.sizeOf(at);
+    }
+    return at;
+  }
+
+  void untag(MemTag tag, int32_t at) {
+    if (at >= 0) {
+      truth[tag] -= heap.sizeOf(at);
+      heap.release(at);
+    }
+  }
+
+  // A short-lived block that, now and then, outlives the request
+  void churn(uint32_t nowS, uint32_t bytes, std::vector<int32_t>& transient) {
+    int32_t at = heap.alloc(bytes);
+    if (at < 0) {
+      return;
+    }
+    if (nextRandom() % 1000 < stickyPerMille) {
+      double u = (nextRandom() % 10000 + 1) / 10001.0;
+      sticky.push_back({ at, nowS + (uint32_t)(-log(u) * SIM_STICKY_MEAN) });
+    } else {
+      transient.push_back(at);
+    }
+  }
+
+  void closeTls() {
+    MemScope scope(watch, MEM_TAG_NETWORK);
+    for (int i = 2; i >= 0; i--) {
+      untag(MEM_TAG_NETWORK, tls[i]);
+      tls[i] = -1;
+    }
+    watch.tlsClosed();
+  }
+
+  // Buffers first (mbedtls_ssl_setup), then the handshake's temporaries
+  bool openTls(uint32_t nowS) {
+    if (acting && !watch.tlsFits()) {
+      refused++;
+      firstRefusedS = std::min(firstRefusedS, nowS);
+      return false;
+    }
+    MemScope scope(watch, MEM_TAG_NETWORK);
+    static const uint32_t sizes[3] = { SIM_TLS_CTX, SIM_TLS_IN, SIM_TLS_OUT };
+    int32_t temp[2] = { -1, -1 };
+    bool ok = true;
+    for (int i = 0; i < 3 && ok; i++) {
+      tls[i] = tagged(MEM_TAG_NETWORK, sizes[i]);
+      ok = tls[i] >= 0;
+    }
+    if (ok) {
+      temp[0] = tagged(MEM_TAG_NETWORK, SIM_TLS_TEMP);
+      temp[1] = tagged(MEM_TAG_NETWORK, SIM_TLS_TEMP2);
+      ok = temp[0] >= 0 && temp[1] >= 0;
+    }
+    untag(MEM_TAG_NETWORK, temp[1]);
+    untag(MEM_TAG_NETWORK, temp[0]);
+    if (!ok) {
+      for (int i = 2; i >= 0; i--) {
+        untag(MEM_TAG_NETWORK, tls[i]);
+        tls[i] = -1;
+      }
+      failed++;
+      firstFailS = std::min(firstFailS, nowS);
+      return false;
+    }
+    handshakes++;
+    tlsOpenedAt = nowS;
+    watch.tlsOpened(scope.taken());
+    return true;
+  }
+
+  // One request on the open connection: a received segment, the client's
+  // header Strings and, unless shed, three log lines
+  void request(uint32_t nowS) {
+    std::vector<int32_t> transient;
+    churn(nowS, SIM_PBUF, transient);
+    churn(nowS, 64 + nextRandom() % 64, transient);
+    churn(nowS, 32 + nextRandom() % 32, transient);
+    if (acting && watch.degraded()) {
+      linesShed += 3;
+    } else {
+      churn(nowS, 24 + nextRandom() % 24, transient);
+      churn(nowS, 40 + nextRandom() % 80, transient);
+      churn(nowS, 24, transient);
+    }
+    for (auto it = transient.rbegin(); it != transient.rend(); ++it) {
+      heap.release(*it);
+    }
+    requests++;
+  }
+
+  // Roster arrays as Roster grows them (doubling from 256 entries / 4 KB
+  // of names), with the response's segments in between. Acting, the heap
+  // is sampled with each segment and the sync stops once it is short
+  // (RosterSync's memory guard); added says how far it got.
+  bool rosterAdd(uint32_t nowS, uint32_t n, uint32_t& added) {
+    for (uint32_t i = 0; i < n; i++) {
+      if (acting && i % 40 == 0) {
+        watch.update(nowS * 1000);
+        if (watch.degraded()) {
+          return true;
+        }
+      }
+      if (rosterCount + 1 > rosterCap) {
+        uint32_t cap = rosterCap ? rosterCap * 2 : 256;
+        int32_t grown = heap.resize(rosterEntries, cap * sizeof(RosterEntry));
+        if (grown < 0) {
+          return false;
+        }
+        rosterEntries = grown;
+        rosterCap = cap;
+      }
+      uint32_t nameLen = 10 + nextRandom() % 12;
+      if (namesUsed + nameLen > namesCap) {
+        uint32_t cap = namesCap ? namesCap * 2 : 4096;
+        int32_t grown = heap.resize(rosterNames, cap);
+        if (grown < 0) {
+          return false;
+        }
+        rosterNames = grown;
+        namesCap = cap;
+      }
+      rosterCount++;
+      namesUsed += nameLen;
+      added++;
+      if (i % 40 == 0) {
+        std::vector<int32_t> transient;
+        churn(nowS, SIM_PBUF, transient);
+        for (int32_t at : transient) {
+          heap.release(at);
+        }
+      }
+    }
+    return true;
+  }
+
+  void rosterFinalize() {
+    if (rosterCount > 0) {
+      rosterEntries = heap.resize(rosterEntries, rosterCount * sizeof(RosterEntry));
+      rosterCap = rosterCount;
+      rosterNames = heap.resize(rosterNames, namesUsed);
+      namesCap = namesUsed;
+    }
+    truth[MEM_TAG_ROSTER] = heap.sizeOf(rosterEntries) + heap.sizeOf(rosterNames);
+    watch.setHeld(MEM_TAG_ROSTER, rosterCap * sizeof(RosterEntry) + namesCap);
+  }
+
+  void rosterClear() {
+    heap.release(rosterEntries);
+    heap.release(rosterNames);
+    rosterEntries = rosterNames = -1;
+    rosterCap = rosterCount = namesCap = namesUsed = 0;
+    rosterFinalize();
+  }
+
+  // Event switch: full sync; in between: a few adds. A switch drops the
+  // old event's roster even when the sync itself has to wait.
+  void rosterSync(uint32_t nowS, uint32_t adds, bool full) {
+    if (full) {
+      rosterClear();
+    }
+    if (acting && watch.degraded()) {
+      syncsDeferred++;
+      pendingFull = rosterPending ? pendingFull || full : full;
+      pendingAdds = full || !rosterPending ? adds : pendingAdds + adds;
+      rosterPending = true;
+      return;
+    }
+    rosterPending = false;
+    syncs++;
+    uint32_t added = 0;
+    if (!rosterAdd(nowS, adds, added)) {
+      syncsFailed++;
+    } else if (added < adds) {
+      // Stopped: the rest once the heap has recovered
+      syncsStopped++;
+      rosterPending = true;
+      pendingFull = false;
+      pendingAdds = adds - added;
+    }
+    rosterFinalize();
+  }
+
+  // A /metrics scrape on the loop task: the web server's request Strings
+  void scrape(uint32_t nowS) {
+    std::vector<int32_t> transient;
+    for (int i = 0; i < 4; i++) {
+      churn(nowS, 24 + nextRandom() % 160, transient);
+    }
+    for (auto it = transient.rbegin(); it != transient.rend(); ++it) {
+      heap.release(*it);
+    }
+  }
+
+  // Boot: net and wifi task stacks, file system + web server, display
+  // buffer + task, JSON parse filters
+  void boot() {
+    heap.alloc(NET_TASK_STACK + 344);
+    heap.alloc(WIFI_TASK_STACK + 344);
+    heap.alloc(6000);
+    {
+      MemScope scope(watch, MEM_TAG_DISPLAY);
+      tagged(MEM_TAG_DISPLAY, OLED_WIDTH * OLED_HEIGHT / 8);
+      tagged(MEM_TAG_DISPLAY, OLED_TASK_STACK + 350);
+    }
+    {
+      MemScope scope(watch, MEM_TAG_JSON);
+      for (int i = 0; i < 5; i++) {
+        tagged(MEM_TAG_JSON, 96 + 24 * i);
+      }
+    }
+  }
+
+  void run() {
+    boot();
+    rosterSync(0, 600, true);
+
+    for (uint32_t s = 1; s <= SIM_DAY_HOURS * 3600; s++) {
+      // Lectures start on the hour: a burst of taps for ten minutes
+      uint32_t inHour = s % 3600;
+      uint32_t tapPct = inHour < 600 ? 35 : 2;
+      if (nextRandom() % 100 < tapPct) {
+        waiting++;
+      }
+      if (s % 30 == 0) {
+        waiting++;                // Event poll
+      }
+      if (s % 3600 == 1800 && (s / 3600) % 3 == 2) {
+        rosterSync(s, 500 + nextRandom() % 400, true);   // Next session's event
+      } else if (s % 900 == 450) {
+        rosterSync(s, 3 + nextRandom() % 10, false);
+      }
+
+      if (tls[0] >= 0 && s - tlsOpenedAt >= SIM_KEEPALIVE_MAX) {
+        closeTls();
+      }
+      if (s % SIM_SCRAPE_INTERVAL == 0) {
+        scrape(s);
+      }
+      if (waiting > 0 && tls[0] < 0 && s >= retryAt) {
+        if (openTls(s)) {
+          retryWait = 0;
+        } else {
+          retryWait = retryWait ? std::min(retryWait * 2, (uint32_t)(CHECKIN_RETRY_MAX / 1000)) : 1;
+          retryAt = s + retryWait;
+        }
+      }
+      if (tls[0] >= 0) {
+        // Backlog goes out in batches
+        for (uint32_t i = 0; i < waiting; i += CHECKIN_BATCH_MAX) {
+          request(s);
+        }
+        waiting = 0;
+      } else if (waiting > 0) {
+        backlogS++;
+      }
+
+      for (size_t i = 0; i < sticky.size();) {
+        if (sticky[i].second <= s) {
+          heap.release(sticky[i].first);
+          sticky[i] = sticky.back();
+          sticky.pop_back();
+        } else {
+          i++;
+        }
+      }
+
+      if (s % (MEM_SAMPLE_INTERVAL / 1000) == 0) {
+        watch.update(s * 1000);
+        if (watch.degraded()) {
+          firstLowS = std::min(firstLowS, s);
+        }
+        if (!watch.degraded() && rosterPending) {
+          rosterSync(s, pendingAdds, pendingFull);
+        }
+      }
+      minLargest = std::min(minLargest, heap.largestFree());
+    }
+  }
+};
+
+#define DAY_STICKY_PER_MILLE 30      // 3% of small blocks kept ~1 h
+
+static MemDay observing(false, DAY_STICKY_PER_MILLE);
+static MemDay acting(true, DAY_STICKY_PER_MILLE);
+
+static void runDays() {
+  observing.run();
+  acting.run();
+  const MemDay* days[2] = { &observing, &acting };
+  const char* names[2] = { "observing", "acting" };
+  for (int i = 0; i < 2; i++) {
+    const MemDay& d = *days[i];
+    char line[200];
+    snprintf(line, sizeof(line), "%-9s %u requests, %u handshakes, %u failed, %u refused; backlog %u s; "
+             "%u syncs (%u out of heap), %u deferred, %u stopped; %u log lines shed", names[i],
+             (unsigned)d.requests, (unsigned)d.handshakes, (unsigned)d.failed, (unsigned)d.refused,
+             (unsigned)d.backlogS, (unsigned)d.syncs, (unsigned)d.syncsFailed, (unsigned)d.syncsDeferred,
+             (unsigned)d.syncsStopped, (unsigned)d.linesShed);
+    TEST_MESSAGE(line);
+  }
+}
+
+// A full sync that starts with the heap fine and would grow the roster
+// past it. Observing, it grows until a realloc fails and the sync is
+// lost. Acting, it stops at the first sample that finds the heap short,
+// with the rest left for once it has recovered.
+void test_sync_stops_when_the_heap_runs_short() {
+  MemDay* days[2] = { new MemDay(false, 0), new MemDay(true, 0) };
+  for (MemDay* d : days) {
+    d->boot();
+    d->watch.update(0);
+    TEST_ASSERT_FALSE(d->watch.degraded());
+    d->rosterSync(1, 4000, true);
+  }
+  MemDay& before = *days[0];
+  MemDay& after = *days[1];
+
+  TEST_ASSERT_EQUAL_UINT32(1, before.syncsFailed);
+  TEST_ASSERT_FALSE(before.rosterPending);
+
+  TEST_ASSERT_EQUAL_UINT32(0, after.syncsFailed);
+  TEST_ASSERT_EQUAL_UINT32(1, after.syncsStopped);
+  TEST_ASSERT_TRUE(after.watch.degraded());
+  TEST_ASSERT_TRUE(after.rosterPending);
+  TEST_ASSERT_EQUAL_UINT32(4000 - after.rosterCount, after.pendingAdds);
+  TEST_ASSERT_TRUE(after.rosterCount < before.rosterCount);
+  TEST_ASSERT_TRUE(after.heap.minFree() > before.heap.minFree());
+
+  char line[128];
+  snprintf(line, sizeof(line), "stopped at %u of 4000 entries (observing failed at %u); lowest free %u vs %u",
+           (unsigned)after.rosterCount, (unsigned)before.rosterCount, (unsigned)after.heap.minFree(),
+           (unsigned)before.heap.minFree());
+  TEST_MESSAGE(line);
+  delete days[0];
+  delete days[1];
+}
+
+// The roster counts its own arrays, without the heap's block headers
+void test_tags_match_the_heap_model() {
+  for (uint8_t t = 0; t < MEM_TAG_COUNT; t++) {
+    MemTagStats ts = acting.watch.tagStats((MemTag)t);
+    int32_t truth = (int32_t)acting.truth[t];
+    int32_t slack = t == MEM_TAG_ROSTER ? 2 * (SIM_HEAP_HEADER + 20) : 0;
+    TEST_ASSERT_TRUE_MESSAGE(ts.held <= truth && ts.held >= truth - slack, MemoryWatch::tagName((MemTag)t));
+  }
+}
+
+void test_unwatched_heap_fragments_until_handshakes_fail() {
+  TEST_ASSERT_TRUE(observing.failed > 0);
+  TEST_ASSERT_TRUE(observing.syncsFailed > 0);
+}
+
+void test_warning_comes_before_the_first_failed_handshake() {
+  TEST_ASSERT_TRUE(observing.firstFailS != UINT32_MAX);
+  TEST_ASSERT_TRUE(observing.firstLowS < observing.firstFailS);
+  char line[64];
+  snprintf(line, sizeof(line), "warning came %u s ahead", (unsigned)(observing.firstFailS - observing.firstLowS));
+  TEST_MESSAGE(line);
+}
+
+// tlsFits() sees the largest block only; a handshake it lets through can
+// still find no room for its temporaries after the record buffers
+void test_acting_on_the_level_fails_fewer_handshakes() {
+  TEST_ASSERT_TRUE(acting.failed < observing.failed);
+  TEST_ASSERT_TRUE(acting.syncsFailed < observing.syncsFailed);
+  TEST_ASSERT_TRUE(acting.syncsDeferred > 0);
+  TEST_ASSERT_TRUE(acting.linesShed > 0);
+}
+
+void test_acting_on_the_level_shortens_the_backlog() {
+  TEST_ASSERT_TRUE(acting.backlogS < observing.backlogS);
+  TEST_ASSERT_TRUE(acting.requests > observing.requests);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_level_follows_the_tls_thresholds);
+  RUN_TEST(test_level_recovers_with_a_margin);
+  RUN_TEST(test_open_session_counts_as_free);
+  RUN_TEST(test_counters_from_two_tasks);
+  RUN_TEST(test_sync_stops_when_the_heap_runs_short);
+  runDays();
+  RUN_TEST(test_tags_match_the_heap_model);
+  RUN_TEST(test_unwatched_heap_fragments_until_handshakes_fail);
+  RUN_TEST(test_warning_comes_before_the_first_failed_handshake);
+  RUN_TEST(test_acting_on_the_level_fails_fewer_handshakes);
+  RUN_TEST(test_acting_on_the_level_shortens_the_backlog);
+  return UNITY_END();
+}
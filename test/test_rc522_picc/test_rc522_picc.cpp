@@ -0,0 +1,282 @@
+// Rc522Picc (rc522_picc.h) against the MFRC522 library's register
+// traffic for the same steps, both on the simulated chip
+// (test/fakes/sim_rc522.h): the card read is the same, the SPI
+// transactions, bytes and time per probe, card read and halt are not.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "rc522_picc.h"
+#include "../fakes/sim_rc522.h"
+
+#define LIBRARY_CLOCK 4000000   // MFRC522 library default (MFRC522_SPICLOCK)
+
+// ==========================================
+// LIBRARY PATH
+// ==========================================
+
+// The MFRC522 library's (1.4.x) register traffic for PICC_IsNewCardPresent,
+// PICC_ReadCardSerial and PICC_HaltA + PCD_StopCrypto1, without collisions
+class LibraryPath {
+public:
+  explicit LibraryPath(SimRc522& chip) : chip(chip) {}
+
+  bool isNewCardPresent() {
+    writeReg(RC522_REG_TX_MODE, 0x00);
+    writeReg(RC522_REG_RX_MODE, 0x00);
+    writeReg(RC522_REG_MOD_WIDTH, 0x26);
+    clearBits(RC522_REG_COLL, 0x80);
+    uint8_t cmd = 0x26;
+    uint8_t atqa[2];
+    size_t len = sizeof(atqa);
+    return communicate(&cmd, 1, 7, atqa, len) && len == 2;
+  }
+
+  bool readCardSerial(CardUid& uid, uint8_t& sak) {
+    static const uint8_t sel[] = { 0x93, 0x95, 0x97 };
+    uint8_t bytes[CARD_UID_MAX];
+    size_t count = 0;
+    clearBits(RC522_REG_COLL, 0x80);
+    for (uint8_t level = 0; level < 3; level++) {
+      uint8_t buf[9] = { sel[level], 0x20 };
+      writeReg(RC522_REG_BIT_FRAMING, 0);
+      size_t len = 7;
+      if (!communicate(buf, 2, 0, buf + 2, len) || len != 5) {
+        return false;
+      }
+      buf[1] = 0x70;
+      calculateCrc(buf, 7, buf + 7);
+      writeReg(RC522_REG_BIT_FRAMING, 0);
+      uint8_t answer[3];
+      len = 3;
+      if (!communicate(buf, 9, 0, answer, len) || len != 3) {
+        return false;
+      }
+      uint8_t crc[2];
+      calculateCrc(answer, 1, crc);
+      if (crc[0] != answer[1] || crc[1] != answer[2]) {
+        return false;
+      }
+      bool more = answer[0] & 0x04;
+      const uint8_t* from = more ? buf + 3 : buf + 2;
+      memcpy(bytes + count, from, more ? 3 : 4);
+      count += more ? 3 : 4;
+      if (!more) {
+        uid = CardUid(bytes, count);
+        sak = answer[0];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void haltA() {
+    uint8_t buf[4] = { 0x50, 0x00 };
+    calculateCrc(buf, 2, buf + 2);
+    size_t len = 0;
+    communicate(buf, 4, 0, NULL, len);   // Timeout is the expected outcome
+    clearBits(RC522_REG_STATUS2, 0x08);  // PCD_StopCrypto1
+  }
+
+private:
+  void writeReg(uint8_t reg, uint8_t value) {
+    chip.write(reg, &value, 1);
+  }
+
+  uint8_t readReg(uint8_t reg) {
+    uint8_t value;
+    chip.read(&reg, &value, 1);
+    return value;
+  }
+
+  void clearBits(uint8_t reg, uint8_t mask) {
+    writeReg(reg, readReg(reg) & ~mask);
+  }
+
+  // PCD_CommunicateWithPICC(PCD_Transceive, ...): polls ComIrqReg back to back
+  bool communicate(const uint8_t* data, size_t len, uint8_t lastBits, uint8_t* back, size_t& backLen) {
+    writeReg(RC522_REG_COMMAND, RC522_CMD_IDLE);
+    writeReg(RC522_REG_COM_IRQ, 0x7F);
+    writeReg(RC522_REG_FIFO_LEVEL, 0x80);
+    chip.write(RC522_REG_FIFO_DATA, data, len);
+    writeReg(RC522_REG_BIT_FRAMING, lastBits);
+    writeReg(RC522_REG_COMMAND, RC522_CMD_TRANSCEIVE);
+    writeReg(RC522_REG_BIT_FRAMING, readReg(RC522_REG_BIT_FRAMING) | 0x80);
+
+    double deadline = chip.nowUs() + 36000;
+    for (;;) {
+      uint8_t irq = readReg(RC522_REG_COM_IRQ);
+      if (irq & 0x30) {
+        break;
+      }
+      if ((irq & 0x01) || chip.nowUs() >= deadline) {
+        return false;
+      }
+    }
+    uint8_t error = readReg(RC522_REG_ERROR);
+    if (error & 0x13) {
+      return false;
+    }
+    if (back) {
+      uint8_t n = readReg(RC522_REG_FIFO_LEVEL);
+      if (n > backLen) {
+        return false;
+      }
+      backLen = n;
+      uint8_t fifoRegs[RC522_FIFO_SIZE];
+      memset(fifoRegs, RC522_REG_FIFO_DATA, n);
+      chip.read(fifoRegs, back, n);
+      readReg(RC522_REG_CONTROL);
+    }
+    return (error & 0x08) == 0;
+  }
+
+  void calculateCrc(const uint8_t* data, size_t len, uint8_t* out) {
+    writeReg(RC522_REG_COMMAND, RC522_CMD_IDLE);
+    writeReg(RC522_REG_DIV_IRQ, 0x04);
+    writeReg(RC522_REG_FIFO_LEVEL, 0x80);
+    chip.write(RC522_REG_FIFO_DATA, data, len);
+    writeReg(RC522_REG_COMMAND, RC522_CMD_CALC_CRC);
+    while (!(readReg(RC522_REG_DIV_IRQ) & 0x04)) {
+    }
+    writeReg(RC522_REG_COMMAND, RC522_CMD_IDLE);
+    out[0] = readReg(RC522_REG_CRC_RESULT_L);
+    out[1] = readReg(RC522_REG_CRC_RESULT_H);
+  }
+
+  SimRc522& chip;
+};
+
+struct SpiCost {
+  size_t transactions;
+  size_t bytes;
+  double us;
+  bool ok;
+};
+
+// Runs one step on the chip and measures the SPI traffic it made
+template <typename F>
+static SpiCost spiStep(SimRc522& chip, F step) {
+  chip.resetTrace();
+  double start = chip.nowUs();
+  bool ok = step();
+  SpiCost cost = { chip.ops.size(), 0, chip.nowUs() - start, ok };
+  for (const SpiOp& op : chip.ops) {
+    cost.bytes += op.len + 1;
+  }
+  return cost;
+}
+
+static void report(const char* step, const char* path, const SpiCost& c) {
+  char line[112];
+  snprintf(line, sizeof(line), "%-24s %-18s %5u txns %5u bytes %6.0f us", step, path, (unsigned)c.transactions,
+           (unsigned)c.bytes, c.us);
+  TEST_MESSAGE(line);
+}
+
+static const uint8_t uid4[] = { 0xDE, 0xAD, 0xBE, 0xEF };
+static const uint8_t uid7[] = { 0x04, 0x5A, 0x91, 0x2C, 0x80, 0x11, 0x22 };
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// PROBE
+// ==========================================
+
+// Poll mode with an empty field: the cost of every probe. The library
+// polls ComIrqReg until its 25 ms timer runs out; Rc522Picc reads once
+// after the frame delay.
+void test_probe_of_an_empty_field() {
+  SimRc522 libChip(LIBRARY_CLOCK);
+  LibraryPath lib(libChip);
+  SpiCost old = spiStep(libChip, [&] { return lib.isNewCardPresent(); });
+  report("probe, empty field", "library 4 MHz", old);
+  TEST_ASSERT_FALSE(old.ok);
+
+  SimRc522 chip(RC522_SPI_CLOCK);
+  Rc522Picc picc(chip);
+  picc.begin();
+  SpiCost now = spiStep(chip, [&] { return picc.requestA(); });
+  report("probe, empty field", "Rc522Picc", now);
+  TEST_ASSERT_FALSE(now.ok);
+  TEST_ASSERT_TRUE(now.transactions <= 10);
+  TEST_ASSERT_TRUE(now.transactions * 100 < old.transactions);
+  TEST_ASSERT_TRUE(now.us * 10 < old.us);
+}
+
+// ==========================================
+// CARD READ AND HALT
+// ==========================================
+
+// Field to UID: the same UID and SAK both ways, with a fraction of the
+// SPI traffic and no more time; halting no longer waits out a timeout,
+// and a halted card does not answer the next probe
+static void checkCard(const uint8_t* bytes, uint8_t len, const char* name) {
+  CardUid expect(bytes, len);
+  char step[32];
+  snprintf(step, sizeof(step), "field -> UID, %s", name);
+  char haltStep[32];
+  snprintf(haltStep, sizeof(haltStep), "halt, %s", name);
+
+  SimRc522 libChip(LIBRARY_CLOCK);
+  libChip.card(bytes, len);
+  LibraryPath lib(libChip);
+  CardUid libUid;
+  uint8_t libSak = 0;
+  SpiCost oldRead = spiStep(libChip, [&] { return lib.isNewCardPresent() && lib.readCardSerial(libUid, libSak); });
+  SpiCost oldHalt = spiStep(libChip, [&] { lib.haltA(); return true; });
+  report(step, "library 4 MHz", oldRead);
+  report(haltStep, "library 4 MHz", oldHalt);
+  TEST_ASSERT_TRUE(oldRead.ok);
+  TEST_ASSERT_TRUE(libUid == expect);
+
+  SpiCost atLibraryClock = {};
+  for (uint32_t clock : { (uint32_t)LIBRARY_CLOCK, (uint32_t)RC522_SPI_CLOCK }) {
+    SimRc522 chip(clock);
+    chip.card(bytes, len);
+    Rc522Picc picc(chip);
+    picc.begin();
+    CardUid uid;
+    uint8_t sak = 0;
+    SpiCost read = spiStep(chip, [&] { return picc.requestA() && picc.select(uid, sak); });
+    SpiCost halt = spiStep(chip, [&] { picc.haltA(); return true; });
+    char path[24];
+    snprintf(path, sizeof(path), "Rc522Picc %u MHz", (unsigned)(clock / 1000000));
+    report(step, path, read);
+    report(haltStep, path, halt);
+
+    TEST_ASSERT_TRUE(read.ok);
+    TEST_ASSERT_TRUE(uid == expect);
+    TEST_ASSERT_EQUAL_UINT8(libSak, sak);
+    TEST_ASSERT_TRUE(read.transactions * 10 < oldRead.transactions);
+    TEST_ASSERT_TRUE(read.bytes * 5 < oldRead.bytes);
+    TEST_ASSERT_TRUE(read.us < oldRead.us);
+    TEST_ASSERT_TRUE(halt.us < 1000 && oldHalt.us > 20000);
+    TEST_ASSERT_FALSE(picc.requestA());
+
+    if (clock == LIBRARY_CLOCK) {
+      atLibraryClock = read;
+    } else {
+      TEST_ASSERT_EQUAL(atLibraryClock.transactions, read.transactions);
+      TEST_ASSERT_TRUE(read.us <= atLibraryClock.us);
+    }
+  }
+}
+
+void test_four_byte_uid() {
+  checkCard(uid4, sizeof(uid4), "4-byte UID");
+}
+
+void test_seven_byte_uid() {
+  checkCard(uid7, sizeof(uid7), "7-byte UID");
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_probe_of_an_empty_field);
+  RUN_TEST(test_four_byte_uid);
+  RUN_TEST(test_seven_byte_uid);
+  return UNITY_END();
+}
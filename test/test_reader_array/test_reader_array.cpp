@@ -0,0 +1,264 @@
+// ReaderArray (reader_array.h) driving simulated readers on a virtual
+// clock, as the card loop in main.cpp does in polling mode: each poll of
+// a reader costs what an RC522 round costs, a tap costs its handling.
+// Checks the round-robin order, that a busy door cannot starve a quiet
+// one, and measures taps per second and the worst time from a card
+// entering a field to its tap.
+
+#include <unity.h>
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include "reader_array.h"
+
+#define IDLE_POLL_US 1200    // REQA with no card in the field (timeout)
+#define READ_US 6000         // REQA, anticollision, select: one UID read
+#define HANDLE_US 4000       // A tap through the loop (repeat check, log, beep, submit)
+#define LOOP_US 300          // A loop pass without a tap (buttons, results, screen)
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// SIMULATED READER
+// ==========================================
+
+static uint64_t clockUs;
+
+// Cards enter the field at the given times, each a new card. A read
+// reports the oldest card that has arrived; always() keeps one there.
+class SimReader : public CardReader {
+public:
+  explicit SimReader(uint8_t door) : door(door), present(false), serial(0), releases(0) {}
+
+  void arrive(uint64_t atUs) { arrivals.push_back(atUs); }
+  void always() { present = true; }
+
+  bool readCard(CardUid& uid) override {
+    bool card = present || (!arrivals.empty() && arrivals.front() <= clockUs);
+    if (!card) {
+      clockUs += IDLE_POLL_US;
+      return false;
+    }
+    clockUs += READ_US;
+    uint64_t arrivedUs = clockUs - READ_US;
+    if (!present) {
+      arrivedUs = arrivals.front();
+      arrivals.pop_front();
+    }
+    detectUs.push_back(clockUs - arrivedUs);
+    uint8_t bytes[4] = { 0x04, door, (uint8_t)(serial >> 8), (uint8_t)serial };
+    serial++;
+    uid = CardUid(bytes, sizeof(bytes));
+    return true;
+  }
+
+  void release() override { releases++; }
+
+  uint8_t door;
+  bool present;
+  uint16_t serial;
+  uint32_t releases;
+  std::deque<uint64_t> arrivals;
+  std::vector<uint64_t> detectUs;   // Card in the field to tap, per card
+};
+
+// One pass of the card loop
+static bool loopOnce(ReaderArray& readers, CardTap& tap) {
+  if (readers.poll(tap)) {
+    clockUs += HANDLE_US;
+    return true;
+  }
+  clockUs += LOOP_US;
+  return false;
+}
+
+// Small deterministic generator for arrival times
+static uint32_t lcgState;
+static uint32_t lcg() {
+  lcgState = lcgState * 1664525u + 1013904223u;
+  return lcgState >> 8;
+}
+
+// ==========================================
+// TESTS
+// ==========================================
+
+void test_add_refuses_null_and_extra_readers() {
+  ReaderArray readers;
+  SimReader sims[READER_MAX + 1] = { SimReader(0), SimReader(1), SimReader(2), SimReader(3), SimReader(4) };
+  TEST_ASSERT_FALSE(readers.add(NULL, 0));
+  for (uint8_t i = 0; i < READER_MAX; i++) {
+    TEST_ASSERT_TRUE(readers.add(&sims[i], (uint8_t)(10 + i)));
+  }
+  TEST_ASSERT_FALSE(readers.add(&sims[READER_MAX], 99));
+  TEST_ASSERT_EQUAL_UINT8(READER_MAX, readers.size());
+  TEST_ASSERT_EQUAL_UINT8(13, readers.id(3));
+
+  CardTap tap;
+  clockUs = 0;
+  TEST_ASSERT_FALSE(readers.poll(tap));
+  for (uint8_t i = 0; i < READER_MAX; i++) {
+    TEST_ASSERT_EQUAL_UINT32(1, readers.stats(i).polls);
+  }
+}
+
+void test_taps_alternate_when_every_door_is_busy() {
+  ReaderArray readers;
+  SimReader a(0), b(1), c(2);
+  a.always();
+  b.always();
+  c.always();
+  readers.add(&a, 0);
+  readers.add(&b, 1);
+  readers.add(&c, 2);
+
+  CardTap tap;
+  clockUs = 0;
+  for (uint32_t i = 0; i < 30; i++) {
+    TEST_ASSERT_TRUE(readers.poll(tap));
+    TEST_ASSERT_EQUAL_UINT8(i % 3, tap.reader);
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, readers.stats(1).taps);
+  TEST_ASSERT_EQUAL_UINT32(10, readers.stats(1).polls);   // One poll per tap, no wasted rounds
+  TEST_ASSERT_EQUAL_UINT32(10, b.releases);
+}
+
+// Door 0 has a card in the field on every poll; door 1 gets one card.
+// It is read on the next pass, not after door 0 goes quiet.
+void test_busy_door_does_not_starve_a_quiet_one() {
+  ReaderArray readers;
+  SimReader busy(0), quiet(1);
+  busy.always();
+  readers.add(&busy, 0);
+  readers.add(&quiet, 1);
+
+  CardTap tap;
+  clockUs = 0;
+  for (uint32_t i = 0; i < 50; i++) {
+    loopOnce(readers, tap);
+  }
+  quiet.arrive(clockUs + 1);
+  uint32_t quietTaps = 0;
+  for (uint32_t i = 0; i < 50; i++) {
+    if (loopOnce(readers, tap) && tap.reader == 1) {
+      quietTaps++;
+    }
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(1, quietTaps);
+  TEST_ASSERT_EQUAL(1, quiet.detectUs.size());
+  // Missed by at most one poll: the busy door's tap, then its own read
+  TEST_ASSERT_LESS_OR_EQUAL(2 * READ_US + HANDLE_US + IDLE_POLL_US, quiet.detectUs[0]);
+  TEST_ASSERT_GREATER_OR_EQUAL(95, readers.stats(0).taps);
+}
+
+// READER_MAX doors with cards arriving at random (mean gap given), for
+// 10 minutes of virtual time
+struct LoadResult {
+  uint32_t cards;
+  uint32_t taps;
+  double tapsPerSecond;
+  double meanDetectMs;
+  double worstDetectMs;
+};
+
+static LoadResult runLoad(uint32_t meanGapMs) {
+  const uint64_t runUs = 600ull * 1000000;
+  ReaderArray readers;
+  std::vector<SimReader> sims;
+  sims.reserve(READER_MAX);
+  lcgState = 12345;
+  LoadResult r = {};
+  for (uint8_t d = 0; d < READER_MAX; d++) {
+    sims.push_back(SimReader(d));
+    for (uint64_t t = lcg() % (meanGapMs * 1000); t < runUs; t += 1000 + lcg() % (2 * meanGapMs * 1000)) {
+      sims[d].arrive(t);
+      r.cards++;
+    }
+  }
+  for (uint8_t d = 0; d < READER_MAX; d++) {
+    readers.add(&sims[d], d);
+  }
+
+  CardTap tap;
+  clockUs = 0;
+  while (clockUs < runUs + 1000000) {
+    loopOnce(readers, tap);
+  }
+
+  double sumMs = 0;
+  for (const SimReader& sim : sims) {
+    for (uint64_t us : sim.detectUs) {
+      r.taps++;
+      sumMs += us / 1000.0;
+      r.worstDetectMs = us / 1000.0 > r.worstDetectMs ? us / 1000.0 : r.worstDetectMs;
+    }
+  }
+  r.tapsPerSecond = r.taps / (runUs / 1e6);
+  r.meanDetectMs = r.taps ? sumMs / r.taps : 0;
+  return r;
+}
+
+void test_throughput_and_worst_detect_time() {
+  // A card handled costs READ_US + HANDLE_US, so the loop tops out at
+  // 100 taps/s; 4 doors at a tap every 50 ms average is 80 taps/s
+  const uint32_t gaps[] = { 1000, 200, 50 };
+  char line[128];
+  for (uint32_t gap : gaps) {
+    LoadResult r = runLoad(gap);
+    snprintf(line, sizeof(line), "%u doors, card every %u ms each: %.1f taps/s, detect mean %.1f ms, worst %.1f ms",
+             (unsigned)READER_MAX, (unsigned)gap, r.tapsPerSecond, r.meanDetectMs, r.worstDetectMs);
+    TEST_MESSAGE(line);
+
+    // Every card is read, once
+    TEST_ASSERT_EQUAL_UINT32(r.cards, r.taps);
+    if (gap >= 200) {
+      // Light load: a card waits at most for one tap at every other door
+      // and a round of empty polls
+      TEST_ASSERT_TRUE(r.worstDetectMs <=
+                       (READER_MAX * (READ_US + HANDLE_US) + READER_MAX * IDLE_POLL_US + LOOP_US) / 1000.0);
+    }
+  }
+}
+
+// Every door busy at once: the loop runs flat out and splits it evenly
+void test_saturated_doors_share_the_loop() {
+  ReaderArray readers;
+  SimReader sims[READER_MAX] = { SimReader(0), SimReader(1), SimReader(2), SimReader(3) };
+  for (uint8_t d = 0; d < READER_MAX; d++) {
+    sims[d].always();
+    readers.add(&sims[d], d);
+  }
+
+  CardTap tap;
+  clockUs = 0;
+  while (clockUs < 10ull * 1000000) {
+    loopOnce(readers, tap);
+  }
+
+  uint32_t taps = 0;
+  for (uint8_t d = 0; d < READER_MAX; d++) {
+    taps += readers.stats(d).taps;
+  }
+  double perSecond = taps / 10.0;
+  char line[96];
+  snprintf(line, sizeof(line), "all %u doors busy: %.1f taps/s (limit %.1f)", (unsigned)READER_MAX, perSecond,
+           1e6 / (READ_US + HANDLE_US));
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_TRUE(perSecond >= 0.99 * 1e6 / (READ_US + HANDLE_US));
+  for (uint8_t d = 0; d < READER_MAX; d++) {
+    TEST_ASSERT_UINT32_WITHIN(1, taps / READER_MAX, readers.stats(d).taps);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_add_refuses_null_and_extra_readers);
+  RUN_TEST(test_taps_alternate_when_every_door_is_busy);
+  RUN_TEST(test_busy_door_does_not_starve_a_quiet_one);
+  RUN_TEST(test_throughput_and_worst_detect_time);
+  RUN_TEST(test_saturated_doors_share_the_loop);
+  return UNITY_END();
+}
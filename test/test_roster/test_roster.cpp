@@ -0,0 +1,245 @@
+// Roster: full reload over a list with local check-ins, growth under a
+// heap cap, and lookup time at the ROSTER_MAX_ENTRIES end.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "roster.h"
+#include "config.h"
+
+#define BENCH_LOOKUPS 200000
+
+void setUp() {}
+void tearDown() {}
+
+static void uidOf(uint32_t n, uint8_t* uid) {
+  uid[0] = 0x04;
+  uid[1] = (uint8_t)(n >> 16);
+  uid[2] = (uint8_t)(n >> 8);
+  uid[3] = (uint8_t)n;
+}
+
+static bool addN(Roster& roster, uint32_t n, uint8_t flags) {
+  uint8_t uid[4];
+  uidOf(n, uid);
+  char name[16];
+  snprintf(name, sizeof(name), "Student %u", (unsigned)n);
+  return roster.add(uid, sizeof(uid), name, flags);
+}
+
+static bool reloadN(Roster& roster, uint32_t n, uint8_t flags, const char* name = NULL) {
+  uint8_t uid[4];
+  uidOf(n, uid);
+  char fallback[16];
+  snprintf(fallback, sizeof(fallback), "Student %u", (unsigned)n);
+  return roster.reload(uid, sizeof(uid), name ? name : fallback, flags);
+}
+
+static RosterEntry* findN(Roster& roster, uint32_t n) {
+  uint8_t uid[4];
+  uidOf(n, uid);
+  return roster.find(uid, sizeof(uid));
+}
+
+// ==========================================
+// FULL RELOAD
+// ==========================================
+
+void test_reload_keeps_local_check_ins() {
+  Roster roster;
+  for (uint32_t i = 0; i < 100; i++) {
+    addN(roster, i, ROSTER_ALLOWED);
+  }
+  roster.finalize();
+  findN(roster, 7)->flags |= ROSTER_CHECKED_IN;   // Tapped here, not yet on the server
+
+  // The server's list predates that tap
+  roster.beginReload();
+  for (uint32_t i = 0; i < 100; i++) {
+    TEST_ASSERT_TRUE(reloadN(roster, i, ROSTER_ALLOWED));
+  }
+  roster.endReload(true);
+  roster.finalize();
+
+  TEST_ASSERT_EQUAL_UINT32(100, roster.size());
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED | ROSTER_CHECKED_IN, findN(roster, 7)->flags);
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED, findN(roster, 8)->flags);
+}
+
+void test_complete_reload_drops_unlisted_entries() {
+  Roster roster;
+  for (uint32_t i = 0; i < 10; i++) {
+    addN(roster, i, ROSTER_ALLOWED);
+  }
+  roster.finalize();
+
+  roster.beginReload();
+  for (uint32_t i = 5; i < 15; i++) {
+    TEST_ASSERT_TRUE(reloadN(roster, i, ROSTER_ALLOWED | (i == 6 ? ROSTER_CHECKED_IN : 0),
+                             i == 9 ? "Renamed" : NULL));
+  }
+  roster.endReload(true);
+  roster.finalize();
+
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+  TEST_ASSERT_NULL(findN(roster, 0));
+  TEST_ASSERT_NULL(findN(roster, 4));
+  TEST_ASSERT_NOT_NULL(findN(roster, 14));
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED | ROSTER_CHECKED_IN, findN(roster, 6)->flags);
+  TEST_ASSERT_EQUAL_STRING("Renamed", roster.nameOf(*findN(roster, 9)));
+  TEST_ASSERT_EQUAL_STRING("Student 14", roster.nameOf(*findN(roster, 14)));
+}
+
+void test_incomplete_reload_keeps_unlisted_entries() {
+  Roster roster;
+  for (uint32_t i = 0; i < 10; i++) {
+    addN(roster, i, ROSTER_ALLOWED);
+  }
+  roster.finalize();
+
+  roster.beginReload();
+  for (uint32_t i = 0; i < 3; i++) {
+    reloadN(roster, i, 0);
+  }
+  roster.endReload(false);   // Body cut off after three
+  roster.finalize();
+
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+  TEST_ASSERT_EQUAL_UINT8(0, findN(roster, 2)->flags);
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED, findN(roster, 9)->flags);
+}
+
+void test_reload_into_an_empty_roster() {
+  Roster roster;
+  roster.beginReload();
+  for (uint32_t i = 0; i < 1000; i++) {
+    TEST_ASSERT_TRUE(reloadN(roster, i, ROSTER_ALLOWED));
+  }
+  roster.endReload(true);
+  roster.finalize();
+  TEST_ASSERT_EQUAL_UINT32(1000, roster.size());
+  for (uint32_t i = 0; i < 1000; i++) {
+    TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED, findN(roster, i)->flags);
+  }
+}
+
+void test_delta_upsert_keeps_local_check_in() {
+  Roster roster;
+  addN(roster, 1, ROSTER_ALLOWED);
+  roster.finalize();
+  findN(roster, 1)->flags |= ROSTER_CHECKED_IN;
+
+  uint8_t uid[4];
+  uidOf(1, uid);
+  TEST_ASSERT_TRUE(roster.upsert(uid, sizeof(uid), "Student 1", ROSTER_ALLOWED));
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED | ROSTER_CHECKED_IN, findN(roster, 1)->flags);
+}
+
+// ==========================================
+// GROWTH
+// ==========================================
+
+static size_t growLimit;
+
+static bool capped(size_t blockBytes) {
+  return blockBytes <= growLimit;
+}
+
+void test_growth_stops_at_the_guard() {
+  Roster roster;
+  growLimit = 3000 * sizeof(RosterEntry);
+  roster.setGrowGuard(capped);
+
+  uint32_t added = 0;
+  while (added < ROSTER_MAX_ENTRIES && addN(roster, added, ROSTER_ALLOWED)) {
+    added++;
+  }
+  roster.finalize();
+
+  // Doubling would overshoot from 2048; steps take it to the cap instead
+  TEST_ASSERT_LESS_OR_EQUAL(growLimit / sizeof(RosterEntry), added);
+  TEST_ASSERT_GREATER_THAN(growLimit / sizeof(RosterEntry) - ROSTER_GROW_STEP, added);
+  TEST_ASSERT_LESS_OR_EQUAL(growLimit, roster.size() * sizeof(RosterEntry));
+  TEST_ASSERT_NOT_NULL(findN(roster, 0));
+  TEST_ASSERT_NOT_NULL(findN(roster, added - 1));
+  TEST_ASSERT_NULL(findN(roster, added));
+}
+
+void test_no_guard_grows_to_max_entries() {
+  Roster roster;
+  uint32_t added = 0;
+  while (addN(roster, added, ROSTER_ALLOWED)) {
+    added++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(ROSTER_MAX_ENTRIES, added);
+}
+
+// ==========================================
+// LOOKUP BENCHMARK
+// ==========================================
+
+// ROSTER_MAX_ENTRIES entries, lookups of members and strangers in a
+// scattered order, against a plain scan of the same entries
+void test_lookup_benchmark_at_max_entries() {
+  static Roster roster;
+  for (uint32_t i = 0; i < ROSTER_MAX_ENTRIES; i++) {
+    TEST_ASSERT_TRUE(addN(roster, i, ROSTER_ALLOWED));
+  }
+  roster.finalize();
+
+  uint32_t found = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_LOOKUPS; i++) {
+    uint32_t n = (i * 7919u) % (ROSTER_MAX_ENTRIES * 2);   // Every n five times, half not on the list
+    if (findN(roster, n)) {
+      found++;
+    }
+  }
+  double indexedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                     BENCH_LOOKUPS;
+
+  // Linear scan baseline, fewer lookups
+  const uint32_t scans = 2000;
+  uint32_t scanFound = 0;
+  uint32_t scanMembers = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < scans; i++) {
+    uint32_t n = (i * 7919u) % (ROSTER_MAX_ENTRIES * 2);
+    scanMembers += n < ROSTER_MAX_ENTRIES;
+    uint8_t uid[4];
+    uidOf(n, uid);
+    for (uint32_t e = 0; e < ROSTER_MAX_ENTRIES; e++) {
+      uint8_t other[4];
+      uidOf(e, other);
+      if (memcmp(uid, other, sizeof(uid)) == 0) {
+        scanFound++;
+        break;
+      }
+    }
+  }
+  double scanNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                  scans;
+
+  char line[128];
+  snprintf(line, sizeof(line), "%u entries: %.0f ns per lookup indexed, %.0f ns scanned, %u bytes",
+           (unsigned)ROSTER_MAX_ENTRIES, indexedNs, scanNs, (unsigned)roster.memoryBytes());
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_EQUAL_UINT32(BENCH_LOOKUPS / 2, found);
+  TEST_ASSERT_EQUAL_UINT32(scanMembers, scanFound);
+  TEST_ASSERT_LESS_THAN(scanNs / 20, indexedNs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_reload_keeps_local_check_ins);
+  RUN_TEST(test_complete_reload_drops_unlisted_entries);
+  RUN_TEST(test_incomplete_reload_keeps_unlisted_entries);
+  RUN_TEST(test_reload_into_an_empty_roster);
+  RUN_TEST(test_delta_upsert_keeps_local_check_in);
+  RUN_TEST(test_growth_stops_at_the_guard);
+  RUN_TEST(test_no_guard_grows_to_max_entries);
+  RUN_TEST(test_lookup_benchmark_at_max_entries);
+  return UNITY_END();
+}
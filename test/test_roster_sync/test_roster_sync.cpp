@@ -0,0 +1,439 @@
+// RosterSync against a mock roster server: full lists with any layout,
+// lists cut short or broken mid-array, items without a usable UID, deltas
+// with and without a base, local check-ins kept across a full sync, and
+// syncs the memory guard stops as the heap runs short.
+
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "roster_sync.h"
+#include "json_arena.h"
+#include "config.h"
+
+void setUp() {}
+void tearDown() {}
+
+class QuietLog : public HalLog {
+public:
+  void write(const char*) override {}
+};
+
+// The body in small reads, cut off after 'limit' bytes if set
+class StringInput : public RosterInput {
+public:
+  void reset(const std::string& text, size_t limit) {
+    body = text;
+    pos = 0;
+    end = limit < text.size() ? limit : text.size();
+  }
+  int read() override {
+    return pos < end ? (uint8_t)body[pos++] : -1;
+  }
+  std::string body;
+  size_t pos = 0;
+  size_t end = 0;
+};
+
+struct MockReply {
+  int status;
+  uint32_t version;
+  bool delta;
+  std::string body;
+  size_t cutAt;
+};
+
+struct MockGet {
+  uint32_t since;
+  bool full;
+};
+
+class MockRosterServer : public RosterServer {
+public:
+  int get(const char* eventId, uint32_t since, bool full, RosterReply& reply) override {
+    TEST_ASSERT_EQUAL_STRING("lecture", eventId);
+    gets.push_back({ since, full });
+    TEST_ASSERT_FALSE_MESSAGE(replies.empty(), "more requests than expected");
+    MockReply next = replies.front();
+    replies.erase(replies.begin());
+    input.reset(next.body, next.cutAt);
+    reply.version = next.version;
+    reply.delta = next.delta;
+    reply.body = &input;
+    return next.status;
+  }
+
+  void answer(int status, uint32_t version, bool delta, const std::string& body, size_t cutAt = SIZE_MAX) {
+    replies.push_back({ status, version, delta, body, cutAt });
+  }
+
+  std::vector<MockReply> replies;
+  std::vector<MockGet> gets;
+  StringInput input;
+};
+
+static QuietLog quiet;
+static JsonArena<JSON_DOC_CAPACITY> itemArena;
+
+static std::string uidText(uint32_t n) {
+  char text[16];
+  snprintf(text, sizeof(text), "04:%02X:%02X:%02X", (unsigned)(n >> 16) & 0xFF, (unsigned)(n >> 8) & 0xFF,
+           (unsigned)n & 0xFF);
+  return text;
+}
+
+static std::string item(uint32_t n, bool checkedIn = false) {
+  return "{\"uid\":\"" + uidText(n) + "\",\"name\":\"Student " + std::to_string(n) +
+         "\",\"allowed\":true,\"checkedIn\":" + (checkedIn ? "true" : "false") + ",\"extra\":[1,2]}";
+}
+
+static std::string fullList(uint32_t from, uint32_t to) {
+  std::string body = "{\"event\":\"lecture\",\"roster\":[";
+  for (uint32_t n = from; n < to; n++) {
+    body += (n > from ? "," : "") + item(n);
+  }
+  return body + "]}";
+}
+
+static RosterEntry* findN(Roster& roster, uint32_t n) {
+  CardUid uid = CardUid::parse(uidText(n).c_str());
+  return roster.find(uid.data(), uid.size());
+}
+
+// Roster at version 5 with entries [0, 10)
+static void seed(Roster& roster, RosterSync& sync) {
+  MockRosterServer server;
+  server.answer(200, 5, false, fullList(0, 10));
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, sync.sync(server, "lecture").outcome);
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+  TEST_ASSERT_EQUAL_UINT32(5, roster.version());
+}
+
+// ==========================================
+// FULL LIST
+// ==========================================
+
+void test_full_list_with_whitespace() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  MockRosterServer server;
+  server.answer(200, 7, false,
+                "{\n  \"type\": \"roster\",\n  \"roster\" :\n  [\n    " + item(1) + " ,\n    " + item(2, true) +
+                "\n  ]\n}\n");
+
+  RosterSyncResult r = sync.sync(server, "lecture");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, r.outcome);
+  TEST_ASSERT_EQUAL_UINT32(2, r.applied);
+  TEST_ASSERT_EQUAL_UINT32(0, r.skipped);
+  TEST_ASSERT_EQUAL_UINT32(7, roster.version());
+  TEST_ASSERT_EQUAL_UINT32(2, roster.size());
+  TEST_ASSERT_EQUAL_STRING("Student 1", roster.nameOf(*findN(roster, 1)));
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED | ROSTER_CHECKED_IN, findN(roster, 2)->flags);
+  TEST_ASSERT_EQUAL_UINT32(1, server.gets.size());
+  TEST_ASSERT_EQUAL_UINT32(0, server.gets[0].since);
+}
+
+void test_empty_list_empties_the_roster() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  MockRosterServer server;
+  server.answer(200, 9, false, "{\"roster\": [ ]}");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, sync.sync(server, "lecture").outcome);
+  TEST_ASSERT_EQUAL_UINT32(0, roster.size());
+  TEST_ASSERT_EQUAL_UINT32(9, roster.version());
+}
+
+void test_list_cut_short_keeps_the_rest_and_drops_the_version() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  // Server's list moved to [5, 25); the connection drops inside item 8
+  MockRosterServer server;
+  std::string body = fullList(5, 25);
+  server.answer(200, 6, false, body, body.find(uidText(8)));
+  RosterSyncResult r = sync.sync(server, "lecture");
+
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_PARTIAL, r.outcome);
+  TEST_ASSERT_EQUAL_UINT32(3, r.applied);
+  TEST_ASSERT_EQUAL_UINT32(0, roster.version());
+  TEST_ASSERT_NOT_NULL(findN(roster, 0));   // Unlisted, but the list was not complete
+  TEST_ASSERT_NOT_NULL(findN(roster, 7));
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+  TEST_ASSERT_EQUAL_UINT32(5, server.gets[0].since);
+}
+
+void test_item_that_does_not_parse_is_not_a_complete_list() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  MockRosterServer server;
+  server.answer(200, 6, false, "{\"roster\":[" + item(3) + ",{\"uid\":\"04:00:00:04\" \"name\":\"x\"}," + item(5) + "]}");
+  RosterSyncResult r = sync.sync(server, "lecture");
+
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_PARTIAL, r.outcome);
+  TEST_ASSERT_EQUAL_UINT32(1, r.applied);
+  TEST_ASSERT_EQUAL_UINT32(0, roster.version());
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+}
+
+void test_junk_between_items_is_not_a_complete_list() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  MockRosterServer server;
+  server.answer(200, 6, false, "{\"roster\":[" + item(3) + " ; " + item(4) + "]}");
+  RosterSyncResult r = sync.sync(server, "lecture");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_PARTIAL, r.outcome);
+  TEST_ASSERT_EQUAL_UINT32(0, roster.version());
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+}
+
+// Items that parse but carry no usable UID are the server's to fix: they
+// are counted apart and the version is still taken, so the next sync is a
+// delta and not another full download
+void test_items_without_a_usable_uid_keep_the_version() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  MockRosterServer server;
+  server.answer(200, 6, false,
+                "{\"roster\":[" + item(3) + ",{\"uid\":\"zz\",\"name\":\"x\"},{\"name\":\"y\"}," +
+                "{\"uid\":\"04:11:22:33:44:55:66:77:88:99:AA:BB\",\"name\":\"z\"}," + item(20) + "]}");
+  RosterSyncResult r = sync.sync(server, "lecture");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, r.outcome);
+  TEST_ASSERT_EQUAL_UINT32(2, r.applied);
+  TEST_ASSERT_EQUAL_UINT32(3, r.invalid);
+  TEST_ASSERT_EQUAL_UINT32(0, r.skipped);
+  TEST_ASSERT_EQUAL_UINT32(6, roster.version());
+  TEST_ASSERT_EQUAL_UINT32(2, roster.size());
+
+  server.answer(200, 7, true, "{\"adds\":[{\"uid\":\"\",\"name\":\"x\"}," + item(21) + "],\"removes\":[]}");
+  r = sync.sync(server, "lecture");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, r.outcome);
+  TEST_ASSERT_EQUAL_UINT32(1, r.invalid);
+  TEST_ASSERT_EQUAL_UINT32(6, server.gets[1].since);
+  TEST_ASSERT_EQUAL_UINT32(7, roster.version());
+  TEST_ASSERT_NOT_NULL(findN(roster, 21));
+}
+
+void test_body_without_a_roster_leaves_it_alone() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  MockRosterServer server;
+  server.answer(200, 6, false, "{\"error\":\"roster\",\"rosters\":[]}");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_FAILED, sync.sync(server, "lecture").outcome);
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+  TEST_ASSERT_EQUAL_UINT32(5, roster.version());
+}
+
+void test_full_sync_keeps_local_check_ins() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+  findN(roster, 3)->flags |= ROSTER_CHECKED_IN;   // Tapped here; server does not know yet
+
+  MockRosterServer server;
+  server.answer(200, 6, false, fullList(0, 12));
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, sync.sync(server, "lecture").outcome);
+  TEST_ASSERT_EQUAL_UINT32(12, roster.size());
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED | ROSTER_CHECKED_IN, findN(roster, 3)->flags);
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED, findN(roster, 4)->flags);
+}
+
+void test_not_modified_and_errors() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  MockRosterServer server;
+  server.answer(304, 0, false, "");
+  server.answer(503, 0, false, "");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_CURRENT, sync.sync(server, "lecture").outcome);
+  RosterSyncResult r = sync.sync(server, "lecture");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_FAILED, r.outcome);
+  TEST_ASSERT_EQUAL(503, r.httpCode);
+  TEST_ASSERT_EQUAL_UINT32(5, roster.version());
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+}
+
+// ==========================================
+// DELTA
+// ==========================================
+
+void test_delta_over_its_base() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  MockRosterServer server;
+  server.answer(200, 6, true,
+                "{\"adds\": [" + item(20) + ", " + item(1, true) + "], \"removes\": [\"" + uidText(2) + "\"]}");
+  RosterSyncResult r = sync.sync(server, "lecture");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, r.outcome);
+  TEST_ASSERT_TRUE(r.delta);
+  TEST_ASSERT_EQUAL_UINT32(6, roster.version());
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+  TEST_ASSERT_NULL(findN(roster, 2));
+  TEST_ASSERT_NOT_NULL(findN(roster, 20));
+  TEST_ASSERT_EQUAL_UINT8(ROSTER_ALLOWED | ROSTER_CHECKED_IN, findN(roster, 1)->flags);
+  TEST_ASSERT_EQUAL_UINT32(5, server.gets[0].since);
+}
+
+void test_delta_without_a_base_asks_for_the_full_list() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+  roster.setVersion(0);   // A partial sync dropped it
+
+  MockRosterServer server;
+  server.answer(200, 6, true, "{\"adds\":[],\"removes\":[\"" + uidText(0) + "\"]}");
+  server.answer(200, 6, false, fullList(0, 4));
+  RosterSyncResult r = sync.sync(server, "lecture");
+
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, r.outcome);
+  TEST_ASSERT_FALSE(r.delta);
+  TEST_ASSERT_EQUAL_UINT32(2, r.requests);
+  TEST_ASSERT_EQUAL_UINT32(2, server.gets.size());
+  TEST_ASSERT_FALSE(server.gets[0].full);
+  TEST_ASSERT_TRUE(server.gets[1].full);
+  TEST_ASSERT_EQUAL_UINT32(4, roster.size());
+  TEST_ASSERT_NOT_NULL(findN(roster, 0));
+  TEST_ASSERT_EQUAL_UINT32(6, roster.version());
+}
+
+void test_delta_twice_without_a_base_keeps_the_roster() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+  roster.setVersion(0);
+
+  MockRosterServer server;
+  server.answer(200, 6, true, "{\"adds\":[],\"removes\":[]}");
+  server.answer(200, 6, true, "{\"adds\":[],\"removes\":[]}");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_FAILED, sync.sync(server, "lecture").outcome);
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+  TEST_ASSERT_EQUAL_UINT32(0, roster.version());
+}
+
+void test_delta_that_does_not_parse_changes_nothing() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+
+  MockRosterServer server;
+  std::string body = "{\"adds\":[" + item(20) + "],\"removes\":[\"" + uidText(1) + "\"]}";
+  server.answer(200, 6, true, body, body.size() - 3);
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_FAILED, sync.sync(server, "lecture").outcome);
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+  TEST_ASSERT_NOT_NULL(findN(roster, 1));
+  TEST_ASSERT_NULL(findN(roster, 20));
+  TEST_ASSERT_EQUAL_UINT32(5, roster.version());
+}
+
+// ==========================================
+// MEMORY GUARD
+// ==========================================
+
+static uint32_t heapItemsLeft;    // Guard answers yes this many more times
+
+static bool heapLasts() {
+  if (heapItemsLeft == 0) {
+    return false;
+  }
+  heapItemsLeft--;
+  return true;
+}
+
+// The heap runs short after 4 items of a full list: the sync stops
+// there, keeps what it read and drops the version, like a list cut short
+void test_memory_guard_stops_a_full_list() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+  sync.setMemoryGuard(heapLasts);
+  heapItemsLeft = 4;
+
+  MockRosterServer server;
+  server.answer(200, 6, false, fullList(5, 25));
+  RosterSyncResult r = sync.sync(server, "lecture");
+
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_PARTIAL, r.outcome);
+  TEST_ASSERT_TRUE(r.stopped);
+  TEST_ASSERT_EQUAL_UINT32(4, r.applied);
+  TEST_ASSERT_EQUAL_UINT32(0, roster.version());
+  TEST_ASSERT_NOT_NULL(findN(roster, 0));
+  TEST_ASSERT_NULL(findN(roster, 10));      // Not read
+  TEST_ASSERT_EQUAL_UINT32(10, roster.size());
+
+  // Heap back: the next sync is full and completes
+  heapItemsLeft = UINT32_MAX;
+  server.answer(200, 6, false, fullList(5, 25));
+  r = sync.sync(server, "lecture");
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_UPDATED, r.outcome);
+  TEST_ASSERT_FALSE(r.stopped);
+  TEST_ASSERT_EQUAL_UINT32(0, server.gets[1].since);
+  TEST_ASSERT_EQUAL_UINT32(20, roster.size());
+  TEST_ASSERT_EQUAL_UINT32(6, roster.version());
+}
+
+// A delta is parsed in one heap document: not read at all when short,
+// the roster and its version stay as they were
+void test_memory_guard_holds_back_a_delta() {
+  Roster roster;
+  RosterSync sync(roster, quiet, &itemArena);
+  sync.begin();
+  seed(roster, sync);
+  sync.setMemoryGuard(heapLasts);
+  heapItemsLeft = 0;
+
+  MockRosterServer server;
+  server.answer(200, 6, true, "{\"adds\":[" + item(20) + "],\"removes\":[]}");
+  RosterSyncResult r = sync.sync(server, "lecture");
+
+  TEST_ASSERT_EQUAL(ROSTER_SYNC_FAILED, r.outcome);
+  TEST_ASSERT_TRUE(r.stopped);
+  TEST_ASSERT_NULL(findN(roster, 20));
+  TEST_ASSERT_EQUAL_UINT32(5, roster.version());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_full_list_with_whitespace);
+  RUN_TEST(test_empty_list_empties_the_roster);
+  RUN_TEST(test_list_cut_short_keeps_the_rest_and_drops_the_version);
+  RUN_TEST(test_item_that_does_not_parse_is_not_a_complete_list);
+  RUN_TEST(test_junk_between_items_is_not_a_complete_list);
+  RUN_TEST(test_items_without_a_usable_uid_keep_the_version);
+  RUN_TEST(test_body_without_a_roster_leaves_it_alone);
+  RUN_TEST(test_full_sync_keeps_local_check_ins);
+  RUN_TEST(test_not_modified_and_errors);
+  RUN_TEST(test_delta_over_its_base);
+  RUN_TEST(test_delta_without_a_base_asks_for_the_full_list);
+  RUN_TEST(test_delta_twice_without_a_base_keeps_the_roster);
+  RUN_TEST(test_delta_that_does_not_parse_changes_nothing);
+  RUN_TEST(test_memory_guard_stops_a_full_list);
+  RUN_TEST(test_memory_guard_holds_back_a_delta);
+  return UNITY_END();
+}
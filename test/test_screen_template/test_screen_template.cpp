@@ -0,0 +1,287 @@
+// Screen templates (screen_template.h): fitting text to its cells, the
+// compile-time layout check, drawing fields over the static layer, and
+// the static layer cache - the same pixels as drawing it through the
+// font, with only the fields rendered on a hit. Then the host time to
+// draw each real screen.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "screen_template.h"
+#include "screens.h"
+#include "../fakes/sim_hal.h"
+#include "../fakes/raster_display.h"
+
+#define RENDER_FRAMES 20000
+
+void setUp() {}
+void tearDown() {}
+
+// Rasterizes like the panel and counts the characters put through the font
+class CountingRaster : public RasterDisplay {
+public:
+  CountingRaster() : glyphs(0) {}
+  void write(const char* text, size_t len) override {
+    glyphs += len;
+    RasterDisplay::write(text, len);
+  }
+  size_t glyphs;
+};
+
+// ==========================================
+// FITTING
+// ==========================================
+
+static void checkFit(const char* expected, const char* text, size_t columns, FitMode mode, uint32_t step = 0) {
+  char out[SCREEN_FIELD_MAX + 1];
+  size_t len = fitText(text, columns, mode, step, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING(expected, out);
+  TEST_ASSERT_EQUAL(strlen(out), len);
+}
+
+void test_fit_leaves_short_text_alone() {
+  checkFit("Dana", "Dana", 10, FIT_ELLIPSIS);
+  checkFit("Dana", "Dana", 4, FIT_CLIP);
+  checkFit("Dana", "Dana", 4, FIT_SCROLL, 7);
+}
+
+void test_fit_clips_and_ellipsizes() {
+  checkFit("Alexandr", "Alexandria Johnson", 8, FIT_CLIP);
+  checkFit("Alexa...", "Alexandria Johnson", 8, FIT_ELLIPSIS);
+  // No space left hanging in front of the dots
+  checkFit("Intro...", "Intro   to Embedded", 10, FIT_ELLIPSIS);
+  // Too narrow for dots: clipped
+  checkFit("Ale", "Alexandria", 3, FIT_ELLIPSIS);
+  // Never past the output buffer
+  char out[SCREEN_FIELD_MAX + 1];
+  TEST_ASSERT_EQUAL(SCREEN_FIELD_MAX, fitText("0123456789012345678901234567890123456789", 100, FIT_CLIP, 0, out,
+                                              sizeof(out)));
+}
+
+// Rests SCREEN_SCROLL_PAUSE steps at the start, moves one character a
+// step, and comes round again after a gap
+void test_fit_scrolls_with_pause_and_gap() {
+  const char* text = "ABCDEFGH";
+  for (uint32_t step = 0; step < SCREEN_SCROLL_PAUSE; step++) {
+    checkFit("ABCDE", text, 5, FIT_SCROLL, step);
+  }
+  checkFit("BCDEF", text, 5, FIT_SCROLL, SCREEN_SCROLL_PAUSE + 1);
+  checkFit("FGH  ", text, 5, FIT_SCROLL, SCREEN_SCROLL_PAUSE + 5);
+  checkFit("H   A", text, 5, FIT_SCROLL, SCREEN_SCROLL_PAUSE + 7);
+  uint32_t cycle = 8 + SCREEN_SCROLL_GAP + SCREEN_SCROLL_PAUSE;
+  checkFit("CDEFG", text, 5, FIT_SCROLL, SCREEN_SCROLL_PAUSE + 2 + cycle);
+}
+
+// ==========================================
+// LAYOUT CHECK
+// ==========================================
+
+static constexpr StaticText titleText[] = {
+  { 0, 0, 2, "Title" },
+  { 0, 56, 1, "footer" }
+};
+static constexpr TextField valueField[] = {
+  { 0, 24, 2, FIT_SHRINK }
+};
+static constexpr TextField scrollField[] = {
+  { 0, 24, 1, FIT_SCROLL }
+};
+static constexpr StaticText tooWide[] = {
+  { 0, 0, 2, "Eleven chars" }
+};
+static constexpr StaticText tooLow[] = {
+  { 0, 50, 2, "Low" }
+};
+static constexpr TextField onTheTitle[] = {
+  { 12, 8, 1, FIT_CLIP }
+};
+
+static constexpr ScreenTemplate valueScreen = screenTemplate(titleText, valueField);
+static constexpr ScreenTemplate scrollScreen = screenTemplate(titleText, scrollField);
+
+void test_layouts_are_checked_at_compile_time() {
+  static_assert(templateFits(valueScreen), "fits");
+  static_assert(!templateFits(screenTemplate(tooWide)), "10 cells at size 2");
+  static_assert(!templateFits(screenTemplate(tooLow)), "below the last row");
+  static_assert(!templateFits(screenTemplate(titleText, onTheTitle)), "field over static text");
+  static_assert(fieldColumns(0, 1) == 21 && fieldColumns(0, 2) == 10 && fieldColumns(64, 1) == 10, "cells");
+  TEST_ASSERT_TRUE(templateFits(scrollScreen));
+}
+
+// ==========================================
+// DRAWING
+// ==========================================
+
+void test_fields_are_drawn_over_the_static_text() {
+  TextDisplay text;
+  const char* value = "Chandra";
+  TEST_ASSERT_FALSE(drawScreen(text, valueScreen, &value));
+  TEST_ASSERT_TRUE(text.line(0) == "Title");
+  TEST_ASSERT_TRUE(text.line(3) == "Chandra");
+  TEST_ASSERT_TRUE(text.line(7) == "footer");
+  TEST_ASSERT_EQUAL_UINT32(1, text.frames);
+
+  // Too long for size 2: drops to size 1 before ellipsizing
+  CountingRaster big;
+  CountingRaster small;
+  value = "Alexandria Johnson";
+  drawScreen(small, valueScreen, &value);
+  value = "Alexandr";
+  drawScreen(big, valueScreen, &value);
+  TEST_ASSERT_TRUE(memcmp(big.buffer(), small.buffer(), FRAME_BYTES) != 0);
+}
+
+void test_scroll_field_reports_it_is_moving() {
+  TextDisplay text;
+  const char* value = "Intro to Embedded Systems";
+  TEST_ASSERT_TRUE(drawScreen(text, scrollScreen, &value, 0));
+  TEST_ASSERT_TRUE(text.line(3) == "Intro to Embedded Sys");
+  drawScreen(text, scrollScreen, &value, SCREEN_SCROLL_PAUSE + 6);
+  TEST_ASSERT_TRUE(text.line(3) == "to Embedded Systems");
+  value = "Short";
+  TEST_ASSERT_FALSE(drawScreen(text, scrollScreen, &value, 3));
+}
+
+// ==========================================
+// STATIC LAYER CACHE
+// ==========================================
+
+static constexpr StaticText extraText[SCREEN_CACHE_SLOTS + 1][1] = {
+  { { 0, 0, 1, "one" } }, { { 0, 0, 1, "two" } }, { { 0, 0, 1, "three" } },
+  { { 0, 0, 1, "four" } }, { { 0, 0, 1, "five" } }
+};
+static constexpr TextField lowField[] = {
+  { 0, 32, 1, FIT_CLIP }
+};
+static constexpr ScreenTemplate extraScreens[SCREEN_CACHE_SLOTS + 1] = {
+  screenTemplate(extraText[0], lowField), screenTemplate(extraText[1], lowField),
+  screenTemplate(extraText[2], lowField), screenTemplate(extraText[3], lowField),
+  screenTemplate(extraText[4], lowField)
+};
+
+// A cache hit puts only the field through the font and leaves the same
+// pixels as the first, uncached draw
+void test_cached_layer_draws_the_same_pixels() {
+  static uint8_t first[FRAME_BYTES];
+  const char* value = "Dana";
+  CountingRaster raster;
+
+  drawScreen(raster, extraScreens[0], &value);
+  TEST_ASSERT_EQUAL(strlen("one") + strlen("Dana"), raster.glyphs);
+  memcpy(first, raster.buffer(), FRAME_BYTES);
+
+  drawScreen(raster, valueScreen, &value);
+  raster.glyphs = 0;
+  drawScreen(raster, extraScreens[0], &value);
+  TEST_ASSERT_EQUAL(strlen("Dana"), raster.glyphs);
+  TEST_ASSERT_EQUAL_MEMORY(first, raster.buffer(), FRAME_BYTES);
+
+  // A different value on the cached layer leaves nothing of the last one
+  CountingRaster fresh;
+  value = "Bob";
+  drawScreen(raster, extraScreens[0], &value);
+  fresh.clearDisplay();
+  fresh.setTextSize(1);
+  fresh.setCursor(0, 0);
+  fresh.print("one");
+  fresh.setCursor(0, 32);
+  fresh.print("Bob");
+  TEST_ASSERT_EQUAL_MEMORY(fresh.buffer(), raster.buffer(), FRAME_BYTES);
+}
+
+// More screens than slots: the least recently used is redrawn, the
+// rest stay hits, and the pixels are right either way
+void test_least_recently_used_layer_is_replaced() {
+  const char* value = "x";
+  CountingRaster raster;
+  for (size_t i = 0; i < SCREEN_CACHE_SLOTS; i++) {
+    drawScreen(raster, extraScreens[i], &value);
+  }
+  raster.glyphs = 0;
+  drawScreen(raster, extraScreens[0], &value);
+  TEST_ASSERT_EQUAL(1, raster.glyphs);
+
+  // The fifth evicts the least recently used, which is screen 1 now
+  drawScreen(raster, extraScreens[SCREEN_CACHE_SLOTS], &value);
+  raster.glyphs = 0;
+  drawScreen(raster, extraScreens[0], &value);
+  TEST_ASSERT_EQUAL(1, raster.glyphs);
+  drawScreen(raster, extraScreens[1], &value);
+  TEST_ASSERT_EQUAL(1 + strlen("two") + 1, raster.glyphs);
+
+  CountingRaster fresh;
+  fresh.clearDisplay();
+  fresh.setTextSize(1);
+  fresh.setCursor(0, 0);
+  fresh.print("two");
+  fresh.setCursor(0, 32);
+  fresh.print("x");
+  TEST_ASSERT_EQUAL_MEMORY(fresh.buffer(), raster.buffer(), FRAME_BYTES);
+}
+
+// ==========================================
+// BENCHMARK
+// ==========================================
+
+struct RenderCase {
+  const char* name;
+  void (*draw)(HalDisplay& display);
+};
+
+static void renderReady(HalDisplay& d) { displayAttendanceReady(d, "Demo Event"); }
+static void renderLongReady(HalDisplay& d) { displayAttendanceReady(d, "Intro to Embedded Systems", 7); }
+static void renderCheckingIn(HalDisplay& d) { displayCheckingIn(d, CardUid::parse("04:11:22:33")); }
+static void renderWelcome(HalDisplay& d) { displayWelcome(d, "Chandra"); }
+static void renderLongWelcome(HalDisplay& d) { displayWelcome(d, "Alexandria Johnson"); }
+static void renderOffline(HalDisplay& d) { displaySavedOffline(d, 3); }
+static void renderError(HalDisplay& d) { displayAttendanceError(d, "Already checked in"); }
+static void renderNoEvent(HalDisplay& d) { displayNoEvent(d); }
+
+static const RenderCase renderCases[] = {
+  { "ready", renderReady },
+  { "ready (long name)", renderLongReady },
+  { "checking-in", renderCheckingIn },
+  { "welcome", renderWelcome },
+  { "welcome (long name)", renderLongWelcome },
+  { "saved-offline", renderOffline },
+  { "error", renderError },
+  { "no-event", renderNoEvent }
+};
+
+// Host CPU time per frame with the cache warm; on a hit only the fields
+// go through the font
+void test_render_benchmark() {
+  static CountingRaster raster;
+  char line[96];
+  for (const RenderCase& c : renderCases) {
+    c.draw(raster);
+    raster.glyphs = 0;
+    c.draw(raster);
+    size_t glyphs = raster.glyphs;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < RENDER_FRAMES; i++) {
+      c.draw(raster);
+    }
+    std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+    snprintf(line, sizeof(line), "%-20s %7.2f us/frame, %2u glyphs", c.name, took.count() / RENDER_FRAMES,
+             (unsigned)glyphs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_OR_EQUAL(SCREEN_FIELD_MAX * 2, glyphs);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fit_leaves_short_text_alone);
+  RUN_TEST(test_fit_clips_and_ellipsizes);
+  RUN_TEST(test_fit_scrolls_with_pause_and_gap);
+  RUN_TEST(test_layouts_are_checked_at_compile_time);
+  RUN_TEST(test_fields_are_drawn_over_the_static_text);
+  RUN_TEST(test_scroll_field_reports_it_is_moving);
+  RUN_TEST(test_cached_layer_draws_the_same_pixels);
+  RUN_TEST(test_least_recently_used_layer_is_replaced);
+  RUN_TEST(test_render_benchmark);
+  return UNITY_END();
+}
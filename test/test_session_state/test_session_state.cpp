@@ -0,0 +1,187 @@
+// The session blob (session_state.h): round trip, and every way a corrupt
+// or foreign blob is refused. Then a power cycle of the loop
+// (test/fakes/device_rig.h): RAM is lost, the blob (NVS) and the journal
+// storage (flash) survive, and the device comes back on the same event.
+
+#include <unity.h>
+#include <string.h>
+#include "session_state.h"
+#include "../fakes/device_rig.h"
+
+void setUp() {}
+void tearDown() {}
+
+static SessionState sampleState() {
+  SessionState s = {};
+  s.attendanceMode = true;
+  snprintf(s.eventId, sizeof(s.eventId), "%s", "3f2c9a1e-7b4d-4e8a-9c61-0d5e2b7a4f10");
+  snprintf(s.eventName, sizeof(s.eventName), "%s", "Embedded Systems");
+  s.rosterVersion = 17;
+  s.journalNext = 1042;
+  s.journalTail = 1039;
+  return s;
+}
+
+// ==========================================
+// BLOB
+// ==========================================
+
+void test_round_trip() {
+  SessionState in = sampleState();
+  uint8_t blob[SESSION_BLOB_MAX];
+  size_t len = encodeSession(in, blob);
+  TEST_ASSERT_EQUAL(20 + strlen(in.eventId) + strlen(in.eventName) + 4, len);
+
+  SessionState out;
+  TEST_ASSERT_TRUE(decodeSession(blob, len, out));
+  TEST_ASSERT_TRUE(out.attendanceMode);
+  TEST_ASSERT_EQUAL_STRING(in.eventId, out.eventId);
+  TEST_ASSERT_EQUAL_STRING(in.eventName, out.eventName);
+  TEST_ASSERT_EQUAL_UINT32(17, out.rosterVersion);
+  TEST_ASSERT_EQUAL_UINT32(1042, out.journalNext);
+  TEST_ASSERT_EQUAL_UINT32(1039, out.journalTail);
+}
+
+void test_registration_mode_without_event() {
+  SessionState in = {};
+  uint8_t blob[SESSION_BLOB_MAX];
+  size_t len = encodeSession(in, blob);
+  TEST_ASSERT_EQUAL(24, len);
+
+  SessionState out = sampleState();
+  TEST_ASSERT_TRUE(decodeSession(blob, len, out));
+  TEST_ASSERT_FALSE(out.attendanceMode);
+  TEST_ASSERT_EQUAL_STRING("", out.eventId);
+  TEST_ASSERT_EQUAL_STRING("", out.eventName);
+}
+
+// The longest id and name fill SESSION_BLOB_MAX exactly
+void test_longest_strings_fit_the_blob() {
+  SessionState in = sampleState();
+  memset(in.eventId, 'i', CHECKIN_EVENT_ID_MAX);
+  in.eventId[CHECKIN_EVENT_ID_MAX] = '\0';
+  memset(in.eventName, 'n', ATT_EVENT_NAME_MAX);
+  in.eventName[ATT_EVENT_NAME_MAX] = '\0';
+  uint8_t blob[SESSION_BLOB_MAX];
+  size_t len = encodeSession(in, blob);
+  TEST_ASSERT_EQUAL(SESSION_BLOB_MAX, len);
+
+  SessionState out;
+  TEST_ASSERT_TRUE(decodeSession(blob, len, out));
+  TEST_ASSERT_EQUAL_STRING(in.eventName, out.eventName);
+}
+
+// Any flipped bit is caught: by the CRC, or the checks before it
+void test_every_flipped_bit_is_refused() {
+  SessionState in = sampleState();
+  uint8_t blob[SESSION_BLOB_MAX];
+  size_t len = encodeSession(in, blob);
+  for (size_t bit = 0; bit < len * 8; bit++) {
+    uint8_t bad[SESSION_BLOB_MAX];
+    memcpy(bad, blob, len);
+    bad[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+    SessionState out;
+    TEST_ASSERT_FALSE(decodeSession(bad, len, out));
+  }
+}
+
+void test_wrong_length_is_refused() {
+  SessionState in = sampleState();
+  uint8_t blob[SESSION_BLOB_MAX + 8];
+  size_t len = encodeSession(in, blob);
+  SessionState out;
+  TEST_ASSERT_FALSE(decodeSession(blob, len - 1, out));
+  TEST_ASSERT_FALSE(decodeSession(blob, len + 1, out));
+  TEST_ASSERT_FALSE(decodeSession(blob, 0, out));
+  TEST_ASSERT_FALSE(decodeSession(blob, SESSION_BLOB_MAX + 1, out));
+}
+
+// A cursor with the tail past the head cannot come from a CheckinLog;
+// refused even with a good CRC
+void test_impossible_cursor_is_refused() {
+  SessionState in = sampleState();
+  in.journalTail = in.journalNext + 1;
+  uint8_t blob[SESSION_BLOB_MAX];
+  size_t len = encodeSession(in, blob);
+  SessionState out;
+  TEST_ASSERT_FALSE(decodeSession(blob, len, out));
+}
+
+// ==========================================
+// POWER CYCLE
+// ==========================================
+
+static DeviceRig rig;
+
+// What main.cpp does across a reset: the session saved just before, a new
+// journal cursor read from storage, a cleared roster and screen
+static void powerCycle() {
+  SessionState state = {};
+  state.attendanceMode = rig.device.mode() == MODE_ATTENDANCE;
+  snprintf(state.eventId, sizeof(state.eventId), "%s", rig.attendance.eventId());
+  snprintf(state.eventName, sizeof(state.eventName), "%s", rig.attendance.eventName());
+  state.rosterVersion = rig.roster.version();
+  state.journalNext = rig.journal.nextSequence();
+  state.journalTail = rig.journal.tailSequence();
+  uint8_t nvs[SESSION_BLOB_MAX];
+  size_t len = encodeSession(state, nvs);
+
+  SessionState restored;
+  TEST_ASSERT_TRUE(decodeSession(nvs, len, restored));
+  rig.roster.clear();
+  rig.ui.releaseScreen();
+  rig.display.clearDisplay();
+  rig.journal.begin(&rig.storage, restored.journalNext, restored.journalTail);
+  rig.device.resume(restored);
+}
+
+// Taps journaled offline survive the reset and go out once the link is
+// back; the event is not fetched again
+void test_reboot_resumes_event_and_journal() {
+  rig.backend.student("04:00:00:01", "Alice", ROSTER_ALLOWED);
+  rig.startAttendance();
+  TEST_ASSERT_EQUAL_UINT32(1, rig.backend.syncs);
+
+  rigServer.linkUp = false;
+  rig.tap(0, "04:00:00:01");
+  rig.runFor(500);
+  rig.tap(1, "04:00:00:02");
+  rig.runFor(500);
+  TEST_ASSERT_EQUAL_UINT32(2, rig.journal.pendingCount());
+
+  rig.backend.eventSet = false;         // A fetch would fail now
+  powerCycle();
+  TEST_ASSERT_EQUAL(MODE_ATTENDANCE, rig.device.mode());
+  TEST_ASSERT_EQUAL(ATT_READY, rig.attendance.state());
+  TEST_ASSERT_EQUAL_STRING("evt-1", rig.attendance.eventId());
+  TEST_ASSERT_TRUE(rig.display.shows("Demo Event"));
+  TEST_ASSERT_EQUAL_UINT32(2, rig.backend.syncs);
+  TEST_ASSERT_EQUAL_UINT32(2, rig.journal.pendingCount());
+  TEST_ASSERT_TRUE(rig.journal.slotsScanned() < CHECKIN_LOG_CAPACITY);
+
+  rigServer.linkUp = true;
+  rig.runFor(CHECKIN_RETRY_MAX);
+  TEST_ASSERT_EQUAL_UINT32(0, rig.journal.pendingCount());
+  TEST_ASSERT_EQUAL_UINT32(2, rigServer.checkIns);
+}
+
+// Registration mode is saved as such and comes back as such
+void test_reboot_in_registration_mode() {
+  rig.device.switchMode();
+  TEST_ASSERT_EQUAL(MODE_REGISTRATION, rig.device.mode());
+  powerCycle();
+  TEST_ASSERT_EQUAL(MODE_REGISTRATION, rig.device.mode());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_registration_mode_without_event);
+  RUN_TEST(test_longest_strings_fit_the_blob);
+  RUN_TEST(test_every_flipped_bit_is_refused);
+  RUN_TEST(test_wrong_length_is_refused);
+  RUN_TEST(test_impossible_cursor_is_refused);
+  RUN_TEST(test_reboot_resumes_event_and_journal);
+  RUN_TEST(test_reboot_in_registration_mode);
+  return UNITY_END();
+}
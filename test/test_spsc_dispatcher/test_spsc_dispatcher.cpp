@@ -0,0 +1,302 @@
+// Two real threads on SpscQueue and CheckinDispatcher, as on the device:
+// the card task submits taps and takes results, the network task runs
+// runOnce() against a fake server. Checks nothing is lost, torn or
+// reordered, and that every tap gets exactly one answer, and reports the
+// rates reached.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "spsc_queue.h"
+#include "checkin_dispatcher.h"
+#include "../fakes/ram_log_storage.h"
+
+#define QUEUE_ITEMS 500000
+#define STRESS_TAPS 5000
+#define STRESS_TAP_GAP_MS 20     // Virtual time between taps
+#define STRESS_TIMEOUT_S 60
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// SPSC QUEUE
+// ==========================================
+
+// Wider than a word, so a torn copy would show as a mismatch
+struct Item {
+  uint32_t seq;
+  uint32_t inverse;
+  uint64_t tripled;
+};
+
+void test_queue_two_threads_in_order() {
+  static SpscQueue<Item, 64> queue;
+  std::atomic<bool> bad(false);
+  auto start = std::chrono::steady_clock::now();
+
+  std::thread producer([&] {
+    for (uint32_t i = 1; i <= QUEUE_ITEMS; i++) {
+      Item item = { i, ~i, (uint64_t)i * 3 };
+      while (!queue.push(item)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t expect = 1;
+  while (expect <= QUEUE_ITEMS) {
+    Item item;
+    if (!queue.pop(item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (item.seq != expect || item.inverse != ~expect || item.tripled != (uint64_t)expect * 3) {
+      bad = true;
+      break;
+    }
+    expect++;
+  }
+  producer.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  char line[128];
+  snprintf(line, sizeof(line), "%u items in %.3f s: %.0f items/s through a 64-slot queue",
+           (unsigned)QUEUE_ITEMS, seconds, QUEUE_ITEMS / seconds);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_FALSE_MESSAGE(bad.load(), "item out of order or torn");
+  TEST_ASSERT_EQUAL_UINT32(QUEUE_ITEMS + 1, expect);
+  TEST_ASSERT_TRUE(queue.empty());
+}
+
+void test_queue_full_and_empty_edges() {
+  SpscQueue<uint32_t, 4> queue;
+  uint32_t out;
+  TEST_ASSERT_FALSE(queue.pop(out));
+  for (uint32_t i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(queue.push(i));
+  }
+  TEST_ASSERT_FALSE(queue.push(4));
+  TEST_ASSERT_TRUE(queue.pop(out));
+  TEST_ASSERT_EQUAL_UINT32(0, out);
+  TEST_ASSERT_TRUE(queue.push(4));
+  TEST_ASSERT_EQUAL(4, queue.size());
+}
+
+// ==========================================
+// DISPATCHER
+// ==========================================
+
+// Fake server, called from the network thread only. Records are stored
+// in arrival order; a failed request stores nothing.
+static std::vector<uint32_t> stored;   // Tap index of each stored record
+static uint32_t lastStoredSeq;
+static bool seqOutOfOrder;
+static uint32_t failEvery;             // Every n-th request answers 503 (0 = never)
+static uint32_t requests;
+
+static uint32_t tapIndex(const CheckinRecord& rec) {
+  return (uint32_t)rec.uid[1] << 16 | (uint32_t)rec.uid[2] << 8 | rec.uid[3];
+}
+
+static void storeRecord(const CheckinRecord& rec) {
+  if (rec.seq <= lastStoredSeq) {
+    seqOutOfOrder = true;
+  }
+  lastStoredSeq = rec.seq;
+  stored.push_back(tapIndex(rec));
+}
+
+static int fakeSend(const CheckinRecord& rec, char* studentName, size_t nameSize) {
+  if (failEvery && ++requests % failEvery == 0) {
+    return 503;
+  }
+  storeRecord(rec);
+  strncpy(studentName, "Student", nameSize);
+  return 200;
+}
+
+static int fakeSendBatch(const CheckinRecord* recs, size_t count, CheckinItemResult* results) {
+  if (failEvery && ++requests % failEvery == 0) {
+    return 503;
+  }
+  for (size_t i = 0; i < count; i++) {
+    storeRecord(recs[i]);
+    results[i].status = 200;
+    strcpy(results[i].studentName, "Student");
+  }
+  return 200;
+}
+
+static bool fakeLink() {
+  return true;
+}
+
+struct StressOutcome {
+  std::vector<uint8_t> answers;   // Results per tap index
+  uint32_t ok;
+  uint32_t queued;
+  uint32_t failed;
+  uint32_t tagMismatches;
+  bool timedOut;
+  double seconds;                 // Wall clock, first submit to last answer
+};
+
+// Card thread = this thread; network thread runs runOnce() on a virtual
+// clock of 1 ms per pass, so batch deadlines and backoff elapse quickly.
+// Taps come every STRESS_TAP_GAP_MS of that clock, so a backoff does not
+// fill the journal however the two threads get scheduled.
+static void runStress(CheckinDispatcher& dispatcher, CheckinLog& journal, StressOutcome& out) {
+  out.answers.assign(STRESS_TAPS, 0);
+  out.ok = out.queued = out.failed = out.tagMismatches = 0;
+  out.timedOut = false;
+  std::atomic<bool> stop(false);
+  std::atomic<uint32_t> virtualMs(0);
+  std::atomic<uint32_t> pending(1);   // Journal is the network thread's alone
+
+  std::thread network([&] {
+    while (!stop.load()) {
+      uint32_t nowMs = virtualMs.load();
+      while (dispatcher.runOnce(nowMs)) {
+      }
+      pending.store(journal.pendingCount());
+      virtualMs.store(nowMs + 1);
+      std::this_thread::yield();
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::seconds(STRESS_TIMEOUT_S);
+  uint32_t answered = 0;
+  uint32_t next = 0;
+  while (answered < STRESS_TAPS) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      out.timedOut = true;
+      break;
+    }
+    // At most a queue's worth unanswered, as with taps waiting on screen:
+    // every one of them may come back in the same pass
+    if (next < STRESS_TAPS && next - answered < CHECKIN_TAP_QUEUE_SIZE &&
+        next * STRESS_TAP_GAP_MS <= virtualMs.load()) {
+      TapRequest tap = {};
+      uint8_t uid[4] = { 0x04, (uint8_t)(next >> 16), (uint8_t)(next >> 8), (uint8_t)next };
+      tap.uid = CardUid(uid, sizeof(uid));
+      tap.tag = (uint8_t)next;
+      tap.tappedUs = next;
+      strcpy(tap.eventId, "stress");
+      if (dispatcher.submit(tap)) {
+        next++;
+      }
+    }
+
+    TapResult result;
+    while (dispatcher.takeResult(result)) {
+      answered++;
+      if (result.tappedUs >= STRESS_TAPS) {
+        continue;
+      }
+      out.answers[result.tappedUs]++;
+      if (result.tag != (uint8_t)result.tappedUs) {
+        out.tagMismatches++;
+      }
+      if (result.result == CHECKIN_OK) {
+        out.ok++;
+      } else if (result.result == CHECKIN_QUEUED) {
+        out.queued++;
+      } else {
+        out.failed++;
+      }
+    }
+    std::this_thread::yield();
+  }
+  out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Let the backlog drain, then stop the network thread
+  while (pending.load() > 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  stop = true;
+  network.join();
+}
+
+static void resetServer(uint32_t failEveryN) {
+  stored.clear();
+  lastStoredSeq = 0;
+  seqOutOfOrder = false;
+  failEvery = failEveryN;
+  requests = 0;
+}
+
+// Taps are paced on the virtual clock, so this is the rate the two
+// threads keep up between them, not the card reader's
+static void reportRate(const char* mode, const StressOutcome& out) {
+  char line[160];
+  snprintf(line, sizeof(line), "%s: %u taps answered in %.3f s, %.0f taps/s (%u ok, %u queued, %u requests)",
+           mode, (unsigned)STRESS_TAPS, out.seconds, STRESS_TAPS / out.seconds, (unsigned)out.ok,
+           (unsigned)out.queued, (unsigned)requests);
+  TEST_MESSAGE(line);
+}
+
+static void assertEveryTapOnce(CheckinDispatcher& dispatcher, CheckinLog& journal, const StressOutcome& out) {
+  TEST_ASSERT_FALSE_MESSAGE(out.timedOut, "taps not answered in time");
+  TEST_ASSERT_EQUAL_UINT32(0, dispatcher.tapsDropped());
+  TEST_ASSERT_EQUAL_UINT32(0, dispatcher.resultsDropped());
+  TEST_ASSERT_EQUAL_UINT32(0, out.tagMismatches);
+  TEST_ASSERT_EQUAL_UINT32(0, out.failed);
+  for (uint32_t i = 0; i < STRESS_TAPS; i++) {
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(1, out.answers[i], "tap answered more or less than once");
+  }
+
+  // Stored once each, in tap order (oldest pending record first)
+  TEST_ASSERT_EQUAL_UINT32(0, journal.pendingCount());
+  TEST_ASSERT_FALSE_MESSAGE(seqOutOfOrder, "server saw seqs out of order");
+  TEST_ASSERT_EQUAL_UINT32(STRESS_TAPS, stored.size());
+  for (uint32_t i = 0; i < STRESS_TAPS; i++) {
+    TEST_ASSERT_EQUAL_UINT32(i, stored[i]);
+  }
+}
+
+void test_dispatcher_batched_with_server_errors() {
+  static RamLogStorage storage(CHECKIN_LOG_CAPACITY);
+  static CheckinLog journal;
+  journal.begin(&storage);
+  static CheckinDispatcher dispatcher(journal, fakeSend, fakeSendBatch, fakeLink);
+  resetServer(7);
+
+  StressOutcome out;
+  runStress(dispatcher, journal, out);
+  reportRate("batched", out);
+  assertEveryTapOnce(dispatcher, journal, out);
+  TEST_ASSERT_EQUAL_UINT32(STRESS_TAPS, out.ok + out.queued);
+  TEST_ASSERT_GREATER_THAN(0, out.queued);
+  TEST_ASSERT_LESS_THAN(STRESS_TAPS, dispatcher.batchesSent());
+}
+
+void test_dispatcher_per_tap_with_server_errors() {
+  static RamLogStorage storage(CHECKIN_LOG_CAPACITY);
+  static CheckinLog journal;
+  journal.begin(&storage);
+  static CheckinDispatcher dispatcher(journal, fakeSend, NULL, fakeLink);
+  resetServer(50);
+
+  StressOutcome out;
+  runStress(dispatcher, journal, out);
+  reportRate("per tap", out);
+  assertEveryTapOnce(dispatcher, journal, out);
+  // A failure sends the waiting taps back as queued; replay stores them
+  TEST_ASSERT_GREATER_THAN(0, out.queued);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_full_and_empty_edges);
+  RUN_TEST(test_queue_two_threads_in_order);
+  RUN_TEST(test_dispatcher_batched_with_server_errors);
+  RUN_TEST(test_dispatcher_per_tap_with_server_errors);
+  return UNITY_END();
+}
@@ -0,0 +1,195 @@
+// UiScheduler (ui_scheduler.h): held screens and buzzer patterns on
+// deadlines, and the loop around it (test/fakes/device_rig.h) reading
+// cards while a result screen is up instead of sleeping through it.
+
+#include <unity.h>
+#include "ui_scheduler.h"
+#include "screens.h"
+#include "../fakes/device_rig.h"
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// SCREENS
+// ==========================================
+
+void test_held_screen_expires_once_at_its_deadline() {
+  SimBuzzer buzzer;
+  UiScheduler ui(buzzer);
+  ui.holdScreen(1000, 500);
+  TEST_ASSERT_TRUE(ui.screenHeld());
+  TEST_ASSERT_EQUAL_UINT32(200, ui.heldForMs(1200));
+  TEST_ASSERT_FALSE(ui.poll(1499));
+  TEST_ASSERT_TRUE(ui.poll(1500));
+  TEST_ASSERT_FALSE(ui.screenHeld());
+  TEST_ASSERT_FALSE(ui.poll(1600));
+}
+
+void test_released_screen_never_expires() {
+  SimBuzzer buzzer;
+  UiScheduler ui(buzzer);
+  ui.holdScreen(0, 100);
+  ui.releaseScreen();
+  TEST_ASSERT_FALSE(ui.screenHeld());
+  TEST_ASSERT_FALSE(ui.poll(5000));
+}
+
+void test_deadline_across_millis_wrap() {
+  SimBuzzer buzzer;
+  UiScheduler ui(buzzer);
+  ui.holdScreen(0xFFFFFF00u, 0x200);
+  TEST_ASSERT_FALSE(ui.poll(0xFFFFFFF0u));
+  TEST_ASSERT_FALSE(ui.poll(0x000000FFu));
+  TEST_ASSERT_EQUAL_UINT32(1, ui.msUntilNext(0x000000FFu, 1000));
+  TEST_ASSERT_TRUE(ui.poll(0x00000100u));
+}
+
+// ==========================================
+// BUZZER
+// ==========================================
+
+void test_pattern_switches_on_its_deadlines() {
+  static const uint16_t steps[] = { 100, 50, 100 };
+  SimBuzzer buzzer;
+  UiScheduler ui(buzzer);
+  ui.playBuzzer(0, steps, 3);
+  TEST_ASSERT_TRUE(buzzer.on);
+  ui.poll(99);
+  TEST_ASSERT_TRUE(buzzer.on);
+  ui.poll(100);
+  TEST_ASSERT_FALSE(buzzer.on);
+  ui.poll(150);
+  TEST_ASSERT_TRUE(buzzer.on);
+  ui.poll(250);
+  TEST_ASSERT_FALSE(buzzer.on);
+  TEST_ASSERT_EQUAL_UINT32(4, buzzer.switches);
+  TEST_ASSERT_EQUAL_UINT32(1000, ui.msUntilNext(250, 1000));
+}
+
+// A loop pass that took long lands past several steps: they are all
+// played through and the buzzer ends off, not stuck on
+void test_late_poll_catches_up_and_ends_off() {
+  static const uint16_t steps[] = { 100, 50, 100, 50, 100 };
+  SimBuzzer buzzer;
+  UiScheduler ui(buzzer);
+  ui.playBuzzer(0, steps, 5);
+  ui.poll(170);
+  TEST_ASSERT_TRUE(buzzer.on);          // Third step, 150..250
+  TEST_ASSERT_EQUAL_UINT32(80, ui.msUntilNext(170, 1000));
+  ui.poll(5000);
+  TEST_ASSERT_FALSE(buzzer.on);
+}
+
+void test_new_pattern_replaces_the_old_one() {
+  static const uint16_t longBeep[] = { 1000 };
+  static const uint16_t shortBeep[] = { 50 };
+  static const uint16_t tooLong[UI_PATTERN_MAX + 2] = { 10, 10, 10, 10, 10, 10, 10, 10, 10, 10 };
+  SimBuzzer buzzer;
+  UiScheduler ui(buzzer);
+  ui.playBuzzer(0, longBeep, 1);
+  ui.playBuzzer(10, shortBeep, 1);
+  ui.poll(60);
+  TEST_ASSERT_FALSE(buzzer.on);
+
+  ui.playBuzzer(100, longBeep, 1);
+  ui.playBuzzer(110, shortBeep, 0);     // Empty pattern: silence now
+  TEST_ASSERT_FALSE(buzzer.on);
+
+  // Steps past UI_PATTERN_MAX are cut off
+  ui.playBuzzer(200, tooLong, UI_PATTERN_MAX + 2);
+  ui.poll(200 + 10 * UI_PATTERN_MAX);
+  TEST_ASSERT_FALSE(buzzer.on);
+  TEST_ASSERT_EQUAL_UINT32(1000, ui.msUntilNext(200 + 10 * UI_PATTERN_MAX, 1000));
+}
+
+void test_next_deadline_is_the_nearest() {
+  static const uint16_t beep[] = { 200 };
+  SimBuzzer buzzer;
+  UiScheduler ui(buzzer);
+  TEST_ASSERT_EQUAL_UINT32(50, ui.msUntilNext(0, 50));
+  ui.holdScreen(0, 1000);
+  ui.playBuzzer(0, beep, 1);
+  TEST_ASSERT_EQUAL_UINT32(200, ui.msUntilNext(0, 5000));
+  ui.poll(200);
+  TEST_ASSERT_EQUAL_UINT32(800, ui.msUntilNext(200, 5000));
+  TEST_ASSERT_EQUAL_UINT32(0, ui.msUntilNext(1200, 5000));
+}
+
+// ==========================================
+// THE LOOP AROUND IT
+// ==========================================
+
+static DeviceRig rig;
+
+// A second card while the first welcome is up is answered at once, not
+// after CHECKIN_SUCCESS_DISPLAY; the screen times out from the second tap
+void test_tap_replaces_a_held_result_at_once() {
+  rig.backend.student("04:00:00:01", "Alice", ROSTER_ALLOWED);
+  rig.backend.student("04:00:00:02", "Bob", ROSTER_ALLOWED);
+  rig.startAttendance();
+  TEST_ASSERT_EQUAL(ATT_READY, rig.attendance.state());
+
+  rig.tap(0, "04:00:00:01");
+  TEST_ASSERT_TRUE(rig.display.shows("Alice"));
+  TEST_ASSERT_TRUE(rig.buzzer.on);
+  uint32_t firstAt = rig.clock.millis();
+
+  rig.runFor(300);
+  TEST_ASSERT_FALSE(rig.buzzer.on);     // BUZZER_DURATION, switched off by the scheduler
+  rig.tap(1, "04:00:00:02");
+  TEST_ASSERT_TRUE(rig.display.shows("Bob"));
+  uint32_t secondAt = rig.clock.millis();
+  TEST_ASSERT_TRUE(secondAt - firstAt < CHECKIN_SUCCESS_DISPLAY);
+
+  rig.runFor(CHECKIN_SUCCESS_DISPLAY - RIG_TICK);
+  TEST_ASSERT_TRUE(rig.display.shows("Bob"));
+  rig.runFor(2 * RIG_TICK);
+  TEST_ASSERT_TRUE(rig.display.shows("Demo Event"));
+  TEST_ASSERT_EQUAL_UINT32(2, rig.tapsSeen);
+}
+
+// A backlog of server answers is shown one after another, each for at
+// least UI_RESULT_MIN_DISPLAY, never flashed past
+void test_queued_results_are_each_shown_for_a_while() {
+  rig.runFor(CHECKIN_ERROR_DISPLAY);
+  rig.netPaused = true;
+  rig.tap(0, "04:00:00:10");
+  rig.tap(1, "04:00:00:11");
+  rig.tap(0, "04:00:00:12");
+  TEST_ASSERT_EQUAL_UINT32(3, rig.attendance.inFlight());
+
+  rig.netPaused = false;
+  uint32_t lastFrames = rig.display.frames;
+  uint32_t lastChange = rig.clock.millis();
+  uint32_t shortest = 0xFFFFFFFFu;
+  uint32_t shown = 0;
+  while (rig.attendance.inFlight() > 0 && rig.clock.millis() - lastChange < 5000) {
+    rig.runFor(RIG_TICK);
+    if (rig.display.frames != lastFrames) {
+      if (shown > 0 && rig.clock.millis() - lastChange < shortest) {
+        shortest = rig.clock.millis() - lastChange;
+      }
+      shown++;
+      lastFrames = rig.display.frames;
+      lastChange = rig.clock.millis();
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, rig.attendance.inFlight());
+  TEST_ASSERT_EQUAL_UINT32(3, shown);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(UI_RESULT_MIN_DISPLAY, shortest);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_held_screen_expires_once_at_its_deadline);
+  RUN_TEST(test_released_screen_never_expires);
+  RUN_TEST(test_deadline_across_millis_wrap);
+  RUN_TEST(test_pattern_switches_on_its_deadlines);
+  RUN_TEST(test_late_poll_catches_up_and_ends_off);
+  RUN_TEST(test_new_pattern_replaces_the_old_one);
+  RUN_TEST(test_next_deadline_is_the_nearest);
+  RUN_TEST(test_tap_replaces_a_held_result_at_once);
+  RUN_TEST(test_queued_results_are_each_shown_for_a_while);
+  return UNITY_END();
+}
@@ -0,0 +1,282 @@
+// UidCache (uid_cache.h): the cooldown window, the oldest card falling
+// out of a full ring, forgetting a card, a lecture-start tap trace against
+// the old per-reader "last card" cooldown, and the loop around it
+// (test/fakes/device_rig.h): a tap turned away busy is not a repeat, so
+// presenting the card again goes through.
+
+#include <unity.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include "uid_cache.h"
+#include "../fakes/device_rig.h"
+
+#define WINDOW_MS 2000
+
+void setUp() {}
+void tearDown() {}
+
+static CardUid cardNo(uint32_t n) {
+  uint8_t bytes[4] = { 0x04, (uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n };
+  return CardUid(bytes, sizeof(bytes));
+}
+
+// ==========================================
+// CACHE
+// ==========================================
+
+void test_repeat_inside_the_window_is_a_hit() {
+  UidCache cache(WINDOW_MS);
+  TEST_ASSERT_FALSE(cache.seenRecently(cardNo(1), 1000));
+  TEST_ASSERT_TRUE(cache.seenRecently(cardNo(1), 1000 + WINDOW_MS - 1));
+  TEST_ASSERT_FALSE(cache.seenRecently(cardNo(2), 1500));
+  TEST_ASSERT_EQUAL_UINT32(1, cache.hits());
+  TEST_ASSERT_EQUAL_UINT32(2, cache.misses());
+  TEST_ASSERT_EQUAL_UINT8(2, cache.size());
+}
+
+// A hit does not extend the window; a card let through again after it
+// starts a new one
+void test_window_runs_from_the_tap_let_through() {
+  UidCache cache(WINDOW_MS);
+  cache.seenRecently(cardNo(1), 0);
+  TEST_ASSERT_TRUE(cache.seenRecently(cardNo(1), 1900));
+  TEST_ASSERT_FALSE(cache.seenRecently(cardNo(1), WINDOW_MS));
+  TEST_ASSERT_TRUE(cache.seenRecently(cardNo(1), WINDOW_MS + 100));
+  TEST_ASSERT_EQUAL_UINT8(1, cache.size());
+
+  // Across the millis() wrap
+  cache.clear();
+  cache.seenRecently(cardNo(1), 0xFFFFFF00u);
+  TEST_ASSERT_TRUE(cache.seenRecently(cardNo(1), 0x00000100u));
+}
+
+void test_oldest_card_falls_out_of_a_full_ring() {
+  UidCache cache(WINDOW_MS);
+  for (uint32_t n = 0; n <= UID_CACHE_ENTRIES; n++) {
+    cache.seenRecently(cardNo(n), n);
+  }
+  TEST_ASSERT_EQUAL_UINT8(UID_CACHE_ENTRIES, cache.size());
+  TEST_ASSERT_FALSE(cache.seenRecently(cardNo(0), 100));
+  for (uint32_t n = 2; n <= UID_CACHE_ENTRIES; n++) {
+    TEST_ASSERT_TRUE(cache.seenRecently(cardNo(n), 100));
+  }
+}
+
+void test_forget_lets_the_next_tap_through() {
+  UidCache cache(WINDOW_MS);
+  for (uint32_t n = 0; n < UID_CACHE_ENTRIES; n++) {
+    cache.seenRecently(cardNo(n), 0);
+  }
+  for (uint32_t n = 0; n < UID_CACHE_ENTRIES; n += 2) {
+    cache.forget(cardNo(n));
+  }
+  cache.forget(cardNo(999));            // Not there: nothing happens
+  TEST_ASSERT_EQUAL_UINT8(UID_CACHE_ENTRIES / 2, cache.size());
+
+  // Probe runs stay intact around the holes
+  for (uint32_t n = 1; n < UID_CACHE_ENTRIES; n += 2) {
+    TEST_ASSERT_TRUE(cache.seenRecently(cardNo(n), 10));
+  }
+  for (uint32_t n = 0; n < UID_CACHE_ENTRIES; n += 2) {
+    TEST_ASSERT_FALSE(cache.seenRecently(cardNo(n), 10));
+  }
+}
+
+// ==========================================
+// LECTURE-START TRACE
+// ==========================================
+
+// Students arriving at two doors, some cards slid across both antennas,
+// some tapped twice, pairs taking turns at one reader, and some
+// deliberate re-taps later on
+#define TRACE_STUDENTS 300
+#define TRACE_MAX (TRACE_STUDENTS * 4)
+#define TRACE_DOORS 2
+#define TRACE_PASSES 200
+
+struct TraceTap {
+  uint32_t ms;
+  uint16_t student;
+  uint8_t door;
+  bool repeat;      // Same card again within the cooldown - should be dropped
+};
+
+static uint32_t traceRandom(uint32_t& state, uint32_t range) {
+  state = state * 1664525u + 1013904223u;
+  return (state >> 8) % range;
+}
+
+static size_t buildTrace(TraceTap* trace) {
+  uint32_t rng = 12345;
+  uint32_t t = 0;
+  size_t n = 0;
+  for (uint16_t s = 0; s < TRACE_STUDENTS; s++) {
+    t += 150 + traceRandom(rng, 900);
+    uint8_t door = (uint8_t)traceRandom(rng, TRACE_DOORS);
+    trace[n++] = { t, s, door, false };
+    uint32_t kind = traceRandom(rng, 100);
+    if (kind < 15) {
+      // Slid across both readers
+      trace[n++] = { t + 100 + traceRandom(rng, 300), s, (uint8_t)(1 - door), true };
+    } else if (kind < 25) {
+      // Lifted and tapped again at the same reader
+      trace[n++] = { t + 300 + traceRandom(rng, 1200), s, door, true };
+    } else if (kind < 30 && s + 1 < TRACE_STUDENTS) {
+      // Taking turns with the next student at the same reader
+      uint32_t next = t + 200 + traceRandom(rng, 300);
+      trace[n++] = { next, (uint16_t)(s + 1), door, false };
+      trace[n++] = { next + 200 + traceRandom(rng, 400), s, door, true };
+      trace[n++] = { next + 700 + traceRandom(rng, 400), (uint16_t)(s + 1), door, true };
+      s++;
+      t = next;
+    }
+    if (traceRandom(rng, 100) < 10) {
+      // Back later on purpose (forgot whether it worked)
+      trace[n++] = { t + 5000 + traceRandom(rng, 20000), s, door, false };
+    }
+  }
+  std::sort(trace, trace + n, [](const TraceTap& a, const TraceTap& b) { return a.ms < b.ms; });
+  return n;
+}
+
+static CardUid traceUid(uint16_t student) {
+  uint8_t bytes[7] = { 0x04, (uint8_t)(student >> 8), (uint8_t)student, 0x5A, 0x91, 0x2C, 0x80 };
+  return CardUid(bytes, sizeof(bytes));
+}
+
+static TraceTap trace[TRACE_MAX];
+static CardUid traceUids[TRACE_MAX];
+
+// Every repeat dropped and no real tap lost, where one remembered card per
+// reader lets the slides and the turn-taking through
+void test_trace_repeats_dropped_and_no_tap_lost() {
+  size_t n = buildTrace(trace);
+  size_t repeats = 0;
+  for (size_t i = 0; i < n; i++) {
+    traceUids[i] = traceUid(trace[i].student);
+    repeats += trace[i].repeat ? 1 : 0;
+  }
+  TEST_ASSERT_TRUE(repeats > 0);
+
+  // Before: one remembered card per reader
+  struct LastCard {
+    CardUid uid;
+    uint32_t ms;
+  } last[TRACE_DOORS] = {};
+  size_t oldLeaked = 0, oldLost = 0;
+  for (size_t i = 0; i < n; i++) {
+    LastCard& l = last[trace[i].door];
+    bool drop = traceUids[i] == l.uid && trace[i].ms - l.ms < CARD_COOLDOWN;
+    if (!drop) {
+      l.uid = traceUids[i];
+      l.ms = trace[i].ms;
+    }
+    oldLeaked += trace[i].repeat && !drop ? 1 : 0;
+    oldLost += !trace[i].repeat && drop ? 1 : 0;
+  }
+
+  UidCache cache(CARD_COOLDOWN);
+  size_t newLeaked = 0, newLost = 0;
+  for (size_t i = 0; i < n; i++) {
+    bool drop = cache.seenRecently(traceUids[i], trace[i].ms);
+    newLeaked += trace[i].repeat && !drop ? 1 : 0;
+    newLost += !trace[i].repeat && drop ? 1 : 0;
+  }
+
+  char line[96];
+  snprintf(line, sizeof(line), "trace: %u taps, %u repeats within %u ms", (unsigned)n, (unsigned)repeats,
+           (unsigned)CARD_COOLDOWN);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "last card per reader: %u repeats to the server, %u taps lost",
+           (unsigned)oldLeaked, (unsigned)oldLost);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_EQUAL_UINT32(0, newLeaked);
+  TEST_ASSERT_EQUAL_UINT32(0, newLost);
+  TEST_ASSERT_EQUAL_UINT32(repeats, cache.hits());
+  TEST_ASSERT_TRUE(oldLeaked > 0);
+}
+
+// Lookup cost, the trace replayed back to back; a cleared cache gives the
+// same answers every pass
+void test_trace_lookup_cost() {
+  size_t n = buildTrace(trace);
+  uint32_t repeats = 0;
+  for (size_t i = 0; i < n; i++) {
+    traceUids[i] = traceUid(trace[i].student);
+    repeats += trace[i].repeat ? 1 : 0;
+  }
+  UidCache cache(CARD_COOLDOWN);
+  uint32_t hits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t p = 0; p < TRACE_PASSES; p++) {
+    cache.clear();
+    uint32_t offset = p * (trace[n - 1].ms + CARD_COOLDOWN);
+    for (size_t i = 0; i < n; i++) {
+      hits += cache.seenRecently(traceUids[i], trace[i].ms + offset) ? 1 : 0;
+    }
+  }
+  std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+
+  char line[96];
+  snprintf(line, sizeof(line), "%u hits / %u misses per pass, %.1f ns per lookup (%u passes)",
+           (unsigned)(hits / TRACE_PASSES), (unsigned)(n - hits / TRACE_PASSES),
+           took.count() / ((double)TRACE_PASSES * n), (unsigned)TRACE_PASSES);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_UINT32(repeats * TRACE_PASSES, hits);
+}
+
+// ==========================================
+// TURNED-AWAY TAPS
+// ==========================================
+
+static DeviceRig rig;
+
+// "Busy, tap again" (journal unavailable here, a full tap queue on the
+// board): the card presented again inside the cooldown is a retry
+void test_card_answered_busy_can_be_tapped_again() {
+  rig.backend.student("04:00:00:01", "Alice", ROSTER_ALLOWED);
+  rig.startAttendance();
+
+  rig.backend.journalUp = false;
+  rig.tap(0, "04:00:00:01");
+  TEST_ASSERT_TRUE(rig.display.shows("Busy"));
+
+  rig.backend.journalUp = true;
+  rig.runFor(300);
+  rig.tap(0, "04:00:00:01");
+  TEST_ASSERT_EQUAL_UINT32(0, rig.tapsDropped);
+  TEST_ASSERT_TRUE(rig.display.shows("Alice"));
+
+  // Taken this time: now it is a repeat
+  rig.runFor(300);
+  rig.tap(1, "04:00:00:01");
+  TEST_ASSERT_EQUAL_UINT32(1, rig.tapsDropped);
+}
+
+// Same for a card the server would decide on
+void test_unknown_card_answered_busy_can_be_tapped_again() {
+  rig.backend.journalUp = false;
+  rig.tap(1, "04:00:00:77");
+  TEST_ASSERT_TRUE(rig.display.shows("Busy"));
+  rig.backend.journalUp = true;
+  rig.runFor(100);
+  uint32_t dropped = rig.tapsDropped;
+  rig.tap(1, "04:00:00:77");
+  TEST_ASSERT_EQUAL_UINT32(dropped, rig.tapsDropped);
+  TEST_ASSERT_EQUAL_UINT32(1, rig.attendance.inFlight());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_repeat_inside_the_window_is_a_hit);
+  RUN_TEST(test_window_runs_from_the_tap_let_through);
+  RUN_TEST(test_oldest_card_falls_out_of_a_full_ring);
+  RUN_TEST(test_forget_lets_the_next_tap_through);
+  RUN_TEST(test_trace_repeats_dropped_and_no_tap_lost);
+  RUN_TEST(test_trace_lookup_cost);
+  RUN_TEST(test_card_answered_busy_can_be_tapped_again);
+  RUN_TEST(test_unknown_card_answered_busy_can_be_tapped_again);
+  return UNITY_END();
+}
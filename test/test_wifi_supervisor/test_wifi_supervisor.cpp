@@ -0,0 +1,326 @@
+// WifiSupervisor (wifi_supervisor.h) against a fake driver: joins with
+// and without a remembered AP, roaming off a fading AP, an AP power cut
+// with backoff, and the reconnect spread across a room of devices.
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "wifi_supervisor.h"
+
+#define STEP_MS 10
+
+// A hall with two APs of the event network and one foreign network.
+// Joins take 300 ms on a pinned AP, 2.2 s when the driver has to scan;
+// a scan takes 2 s; an AP weaker than -88 dBm cannot be joined or kept.
+struct FakeAp {
+  const char* ssid;
+  uint8_t bssid[6];
+  uint8_t channel;
+  int rssi;
+  bool on;
+};
+
+class FakeWifi : public WifiDriver {
+public:
+  FakeWifi() : now(0), joinedAp(-1), joiningAp(-1), eventCount(0) {
+    static const FakeAp hall[] = {
+      { "Hall", { 0xA0, 0, 0, 0, 0, 1 }, 1, -60, true },
+      { "Hall", { 0xB0, 0, 0, 0, 0, 2 }, 6, -72, true },
+      { "Guest", { 0xC0, 0, 0, 0, 0, 3 }, 11, -50, true },
+    };
+    memcpy(aps, hall, sizeof(aps));
+  }
+
+  void connect(const WifiNetwork& net, const WifiAp* ap) override {
+    leave();
+    int target = -1;
+    for (int i = 0; i < 3; i++) {
+      bool match = ap ? memcmp(aps[i].bssid, ap->bssid, 6) == 0 : strcmp(aps[i].ssid, net.ssid) == 0;
+      if (match && aps[i].on && aps[i].rssi > -88 && (target < 0 || aps[i].rssi > aps[target].rssi)) {
+        target = i;
+      }
+    }
+    if (target < 0) {
+      push(LINK_EV_DOWN, now + 2500);   // No AP found
+      return;
+    }
+    joiningAp = target;
+    push(LINK_EV_UP, now + (ap ? 300 : 2200));
+  }
+  void disconnect() override { leave(); }
+  bool startScan() override {
+    push(LINK_EV_SCAN_DONE, now + 2000);
+    return true;
+  }
+  size_t scanResults(WifiAp* out, size_t max) override {
+    size_t n = 0;
+    for (int i = 0; i < 3 && n < max; i++) {
+      if (aps[i].on && aps[i].rssi > -92) {
+        toWifiAp(i, out[n++]);
+      }
+    }
+    return n;
+  }
+  bool currentAp(WifiAp& out) override {
+    if (joinedAp < 0) {
+      return false;
+    }
+    toWifiAp(joinedAp, out);
+    return true;
+  }
+
+  // Advance to t and hand due events to the supervisor
+  void step(uint32_t t, WifiSupervisor& sup) {
+    now = t;
+    if (joinedAp >= 0 && (!aps[joinedAp].on || aps[joinedAp].rssi <= -88)) {
+      joinedAp = -1;
+      push(LINK_EV_DOWN, now);
+    }
+    for (uint8_t i = 0; i < eventCount;) {
+      if ((int32_t)(now - events[i].at) < 0) {
+        i++;
+        continue;
+      }
+      LinkEvent ev = events[i].event;
+      events[i] = events[--eventCount];
+      if (ev == LINK_EV_UP) {
+        if (joiningAp < 0 || !aps[joiningAp].on) {
+          continue;   // Join abandoned, or the AP went away meanwhile
+        }
+        joinedAp = joiningAp;
+        joiningAp = -1;
+      }
+      sup.onEvent(ev, now);
+    }
+  }
+
+  FakeAp aps[3];
+
+private:
+  struct Pending {
+    LinkEvent event;
+    uint32_t at;
+  };
+
+  // Drop the AP joined (its DOWN follows) and abandon a join in progress
+  void leave() {
+    for (uint8_t i = 0; i < eventCount;) {
+      if (events[i].event != LINK_EV_SCAN_DONE) {
+        events[i] = events[--eventCount];
+      } else {
+        i++;
+      }
+    }
+    if (joinedAp >= 0) {
+      push(LINK_EV_DOWN, now + 10);
+    }
+    joinedAp = -1;
+    joiningAp = -1;
+  }
+  void push(LinkEvent event, uint32_t at) {
+    if (eventCount < 8) {
+      events[eventCount].event = event;
+      events[eventCount].at = at;
+      eventCount++;
+    }
+  }
+  void toWifiAp(int i, WifiAp& out) {
+    memset(&out, 0, sizeof(out));
+    snprintf(out.ssid, sizeof(out.ssid), "%s", aps[i].ssid);
+    memcpy(out.bssid, aps[i].bssid, 6);
+    out.channel = aps[i].channel;
+    out.rssi = (int8_t)aps[i].rssi;
+  }
+
+  uint32_t now;
+  int joinedAp;
+  int joiningAp;
+  Pending events[8];
+  uint8_t eventCount;
+};
+
+static WifiAp hintA() {
+  WifiAp hint = {};
+  snprintf(hint.ssid, sizeof(hint.ssid), "%s", "Hall");
+  hint.bssid[0] = 0xA0;
+  hint.bssid[5] = 1;
+  hint.channel = 1;
+  return hint;
+}
+
+// Until the link is up or the time runs out; returns when it came up
+static uint32_t runUntilUp(FakeWifi& wifi, WifiSupervisor& sup, uint32_t from, uint32_t endMs) {
+  for (uint32_t t = from; t <= endMs; t += STEP_MS) {
+    wifi.step(t, sup);
+    sup.poll(t);
+    if (sup.linkUp()) {
+      return t;
+    }
+  }
+  return 0;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ==========================================
+// JOINS
+// ==========================================
+
+// The AP joined last is tried straight away: no scan
+void test_remembered_ap_joins_without_a_scan() {
+  FakeWifi wifi;
+  WifiSupervisor sup(wifi, 1);
+  TEST_ASSERT_TRUE(sup.addNetwork("Hall", "secret"));
+  WifiAp hint = hintA();
+  sup.begin(0, &hint);
+  TEST_ASSERT_EQUAL(LINK_JOINING, sup.state());
+
+  TEST_ASSERT_EQUAL_UINT32(300, runUntilUp(wifi, sup, 0, 5000));
+  TEST_ASSERT_EQUAL(LINK_ONLINE, sup.state());
+  TEST_ASSERT_EQUAL_UINT8(0xA0, sup.ap().bssid[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, sup.stats().scans);
+  TEST_ASSERT_EQUAL_UINT32(1, sup.stats().joins);
+}
+
+// Nothing remembered: a scan, then the strongest AP of a configured
+// network (the stronger foreign network is not joined)
+void test_scan_picks_the_strongest_known_ap() {
+  FakeWifi wifi;
+  WifiSupervisor sup(wifi, 2);
+  sup.addNetwork("Hall", "secret");
+  wifi.aps[1].rssi = -55;
+  sup.begin(0, NULL);
+
+  TEST_ASSERT_TRUE(runUntilUp(wifi, sup, 0, 10000) > 0);
+  TEST_ASSERT_EQUAL_UINT8(0xB0, sup.ap().bssid[0]);
+  TEST_ASSERT_EQUAL_STRING("Hall", sup.ap().ssid);
+}
+
+void test_no_network_configured_stays_idle() {
+  FakeWifi wifi;
+  WifiSupervisor sup(wifi, 3);
+  TEST_ASSERT_FALSE(sup.addNetwork("", "secret"));
+  sup.begin(0, NULL);
+  TEST_ASSERT_EQUAL_UINT32(0, runUntilUp(wifi, sup, 0, 5000));
+  TEST_ASSERT_EQUAL(LINK_IDLE, sup.state());
+  TEST_ASSERT_EQUAL_UINT32(0, sup.stats().attempts);
+}
+
+// ==========================================
+// A DAY IN THE HALL
+// ==========================================
+
+// Same script for every device: A fades and B gets stronger (roam), then
+// both APs lose power for 40 s (reconnect storm)
+#define HALL_END_MS 140000
+#define HALL_POWER_OFF_MS 60000
+#define HALL_POWER_BACK_MS 100000
+
+static void scriptAps(FakeWifi& wifi, uint32_t t) {
+  if (t >= 20000 && t < 40000) {
+    wifi.aps[0].rssi = -60 - (int)((t - 20000) * 24 / 20000);
+    wifi.aps[1].rssi = -72 + (int)((t - 20000) * 14 / 20000);
+  }
+  bool power = t < HALL_POWER_OFF_MS || t >= HALL_POWER_BACK_MS;
+  wifi.aps[0].on = power;
+  wifi.aps[1].on = power;
+}
+
+struct HallRun {
+  WifiStats stats;
+  bool cameBack;               // Link up again after the power returned
+  uint32_t backAfter;          // AP power back -> link up
+  bool upBeforeCut;            // Online on some AP just before the cut
+  uint8_t apBeforeCut;         // Its BSSID[0]
+  uint32_t longestBackoff;
+};
+
+static HallRun runHall(uint32_t seed) {
+  FakeWifi wifi;
+  WifiSupervisor sup(wifi, seed);
+  sup.addNetwork("Hall", "secret");
+  WifiAp hint = hintA();
+  sup.begin(0, &hint);
+
+  HallRun run = {};
+  for (uint32_t t = 0; t <= HALL_END_MS; t += STEP_MS) {
+    scriptAps(wifi, t);
+    wifi.step(t, sup);
+    sup.poll(t);
+    if (t == HALL_POWER_OFF_MS - STEP_MS) {
+      run.upBeforeCut = sup.linkUp();
+      run.apBeforeCut = sup.ap().bssid[0];
+    }
+    if (sup.state() == LINK_BACKOFF) {
+      run.longestBackoff = std::max(run.longestBackoff, sup.stats().lastBackoffMs);
+    }
+    if (t >= HALL_POWER_BACK_MS && sup.linkUp() && !run.cameBack) {
+      run.cameBack = true;
+      run.backAfter = t - HALL_POWER_BACK_MS;
+    }
+  }
+  run.stats = sup.stats();
+  return run;
+}
+
+// One device: roams to B while A fades, rides out the cut backing off up
+// to the ceiling, and is back after the power returns
+void test_roam_then_power_cut() {
+  HallRun run = runHall(0x9E3779B9u);
+  char line[128];
+  snprintf(line, sizeof(line), "%u joins, %u drops, %u roams, %u attempts, %u failures, %u scans, %u ms offline",
+           (unsigned)run.stats.joins, (unsigned)run.stats.drops, (unsigned)run.stats.roams,
+           (unsigned)run.stats.attempts, (unsigned)run.stats.failures, (unsigned)run.stats.scans,
+           (unsigned)run.stats.downMs);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_TRUE(run.upBeforeCut);
+  TEST_ASSERT_EQUAL_UINT8(0xB0, run.apBeforeCut);
+  TEST_ASSERT_EQUAL_UINT32(1, run.stats.roams);
+  TEST_ASSERT_EQUAL_UINT32(1, run.stats.drops);    // The cut; the roam is not a drop
+  TEST_ASSERT_TRUE(run.stats.failures > 0);
+  TEST_ASSERT_TRUE(run.longestBackoff > WIFI_BACKOFF_MIN);
+  TEST_ASSERT_TRUE(run.longestBackoff <= WIFI_BACKOFF_MAX);
+  TEST_ASSERT_TRUE(run.cameBack);
+  TEST_ASSERT_TRUE(run.backAfter <= WIFI_BACKOFF_MAX + WIFI_ATTEMPT_TIMEOUT);
+}
+
+// A room of devices: every one comes back, and the jitter spreads the
+// rejoins instead of all of them hitting the AP in the same second
+#define HALL_DEVICES 50
+
+void test_reconnects_spread_across_devices() {
+  std::vector<uint32_t> backAfter;
+  uint32_t perSecond[(HALL_END_MS - HALL_POWER_BACK_MS) / 1000 + 1] = {};
+  for (uint32_t d = 0; d < HALL_DEVICES; d++) {
+    HallRun run = runHall(0x9E3779B9u * (d + 1));
+    TEST_ASSERT_TRUE(run.cameBack);
+    TEST_ASSERT_EQUAL_UINT32(1, run.stats.roams);
+    backAfter.push_back(run.backAfter);
+    perSecond[run.backAfter / 1000]++;
+  }
+  std::sort(backAfter.begin(), backAfter.end());
+  uint32_t peak = *std::max_element(perSecond, perSecond + sizeof(perSecond) / sizeof(perSecond[0]));
+
+  char line[128];
+  snprintf(line, sizeof(line), "power back -> link up: min %u ms, median %u ms, max %u ms; peak %u joins/s",
+           (unsigned)backAfter.front(), (unsigned)backAfter[HALL_DEVICES / 2], (unsigned)backAfter.back(),
+           (unsigned)peak);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_TRUE(peak <= HALL_DEVICES / 4);
+  TEST_ASSERT_TRUE(backAfter.back() - backAfter.front() >= 5000);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_remembered_ap_joins_without_a_scan);
+  RUN_TEST(test_scan_picks_the_strongest_known_ap);
+  RUN_TEST(test_no_network_configured_stays_idle);
+  RUN_TEST(test_roam_then_power_cut);
+  RUN_TEST(test_reconnects_spread_across_devices);
+  return UNITY_END();
+}